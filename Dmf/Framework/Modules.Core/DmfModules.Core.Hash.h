@@ -0,0 +1,169 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfModules.Core.Hash.h
+
+Abstract:
+
+    Hash function shared by the "Core" DMF Library Modules that hash Keys (DMF_HashTable and
+    DMF_StaticTable). It hashes a Key 8 bytes at a time using the mixing steps of XXH64 for
+    short inputs. This file is only included by those Modules. It is not part of the Library's
+    public interface.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// Primes of XXH64.
+//
+#define DMF_HASH_PRIME_1    0x9E3779B185EBCA87ULL
+#define DMF_HASH_PRIME_2    0xC2B2AE3D27D4EB4FULL
+#define DMF_HASH_PRIME_3    0x165667B19E3779F9ULL
+#define DMF_HASH_PRIME_4    0x85EBCA77C2B2AE63ULL
+#define DMF_HASH_PRIME_5    0x27D4EB2F165667C5ULL
+
+static
+inline
+ULONGLONG
+DMF_Hash_RotateLeft(
+    _In_ ULONGLONG Value,
+    _In_ ULONG Count
+    )
+/*++
+
+Routine Description:
+
+    Rotates a 64 bit value left. Compilers generate a single instruction for this.
+
+Arguments:
+
+    Value - The value to rotate.
+    Count - Number of bits to rotate by (1 to 63).
+
+Return Value:
+
+    The rotated value.
+
+--*/
+{
+    return (Value << Count) | (Value >> (64 - Count));
+}
+
+static
+inline
+ULONGLONG
+DMF_Hash_Avalanche(
+    _In_ ULONGLONG Value
+    )
+/*++
+
+Routine Description:
+
+    Mixes the bits of a 64 bit value so that each bit of the result depends on every bit of the value.
+
+Arguments:
+
+    Value - The value to mix.
+
+Return Value:
+
+    The mixed value.
+
+--*/
+{
+    Value ^= Value >> 33;
+    Value *= DMF_HASH_PRIME_2;
+    Value ^= Value >> 29;
+    Value *= DMF_HASH_PRIME_3;
+    Value ^= Value >> 32;
+
+    return Value;
+}
+
+static
+inline
+ULONGLONG
+DMF_Hash_WordAtATime(
+    _In_ ULONGLONG Seed,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Calculates the hash of a Key 8 bytes at a time: the seed and Key length start the hash,
+    each 8 byte word of the Key is multiplied, rotated and folded in, then the remaining 4 byte
+    word and bytes. A final avalanche step mixes all the bits.
+
+Arguments:
+
+    Seed - Seed of the hash function.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    Hash of the Key. Every bit depends on every bit of the Key.
+
+--*/
+{
+    ULONGLONG result;
+    ULONGLONG lane;
+    ULONG shortLane;
+    ULONG keyIndex;
+
+    result = Seed + DMF_HASH_PRIME_5 + KeyLength;
+    keyIndex = 0;
+
+    // Key buffers need not be aligned, so each word is copied. Compilers generate a single
+    // load for a copy of this size.
+    //
+    while (KeyLength - keyIndex >= sizeof(ULONGLONG))
+    {
+        RtlCopyMemory(&lane,
+                      &Key[keyIndex],
+                      sizeof(lane));
+        lane *= DMF_HASH_PRIME_2;
+        lane = DMF_Hash_RotateLeft(lane,
+                                   31);
+        lane *= DMF_HASH_PRIME_1;
+        result ^= lane;
+        result = (DMF_Hash_RotateLeft(result,
+                                      27) * DMF_HASH_PRIME_1) + DMF_HASH_PRIME_4;
+        keyIndex += sizeof(ULONGLONG);
+    }
+
+    if (KeyLength - keyIndex >= sizeof(ULONG))
+    {
+        RtlCopyMemory(&shortLane,
+                      &Key[keyIndex],
+                      sizeof(shortLane));
+        result ^= (ULONGLONG)shortLane * DMF_HASH_PRIME_1;
+        result = (DMF_Hash_RotateLeft(result,
+                                      23) * DMF_HASH_PRIME_2) + DMF_HASH_PRIME_3;
+        keyIndex += sizeof(ULONG);
+    }
+
+    while (keyIndex < KeyLength)
+    {
+        result ^= (ULONGLONG)Key[keyIndex] * DMF_HASH_PRIME_5;
+        result = DMF_Hash_RotateLeft(result,
+                                     11) * DMF_HASH_PRIME_1;
+        keyIndex++;
+    }
+
+    return DMF_Hash_Avalanche(result);
+}
+
+// eof: DmfModules.Core.Hash.h
+//
@@ -40,7 +40,10 @@ extern "C"
 //
 #include "Dmf_BufferPool.h"
 #include "Dmf_HashTable.h"
+#include "Dmf_LruCache.h"
+#include "Dmf_StaticTable.h"
 #include "Dmf_RingBuffer.h"
+#include "Dmf_RingBufferPerProcessor.h"
 #include "Dmf_BranchTrack.h"
 #include "Dmf_Bridge.h"
 #if defined(DMF_WDF_DRIVER)
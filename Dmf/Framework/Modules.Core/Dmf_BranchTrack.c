@@ -996,6 +996,7 @@ Return Value:
     ULONG branchNameLength;
     ULONG hintNameLength;
     ULONG tableKeyLength;
+    HASHTABLE_KEY_HASH tableKeyHash;
     CHAR* keyBufferFileName;
     CHAR* keyBufferBranchName;
     CHAR* keyBufferHintName;
@@ -1084,13 +1085,21 @@ Return Value:
                   HintName,
                   hintNameLength);
 
+    // Calculate the hash before acquiring the lock so that the lock is held for less time.
+    //
+    DMF_HashTable_HashCompute(moduleContext->DmfObjectHashTable,
+                              (UCHAR*)tableKeyBuffer,
+                              tableKeyLength,
+                              &tableKeyHash);
+
     // Synchronize with calls to query data from HashTable.
     //
     DMF_ModuleLock(DmfModule);
-    ntStatus = DMF_HashTable_Find(moduleContext->DmfObjectHashTable,
-                                  (UCHAR*)tableKeyBuffer,
-                                  tableKeyLength,
-                                  CallbackFind);
+    ntStatus = DMF_HashTable_FindWithHash(moduleContext->DmfObjectHashTable,
+                                          (UCHAR*)tableKeyBuffer,
+                                          tableKeyLength,
+                                          &tableKeyHash,
+                                          CallbackFind);
     DMF_ModuleUnlock(DmfModule);
 
     DmfAssert(NT_SUCCESS(ntStatus));
@@ -1166,6 +1175,9 @@ Return Value:
     moduleConfigHashTable.MaximumKeyLength = (moduleConfigHashTable.MaximumKeyLength + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
     moduleConfigHashTable.MaximumValueLength = sizeof(ULONGLONG);
     moduleConfigHashTable.MaximumTableSize = moduleConfig->MaximumBranches;
+    // Keys contain file and branch name strings, so hash them a word at a time.
+    //
+    moduleConfigHashTable.HashFunction = HashTable_HashFunction_WordAtATime;
     DMF_DmfModuleAdd(DmfModuleInit,
                      &moduleAttributes,
                      WDF_NO_OBJECT_ATTRIBUTES,
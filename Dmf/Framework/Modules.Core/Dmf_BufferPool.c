@@ -37,6 +37,108 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Default number of buffers held in each per-processor cache.
+//
+#define BufferPool_PerProcessorCacheDepthDefault    (16)
+// Used to keep each per-processor cache and each buffer in the slab in its own cache line.
+//
+#define BufferPool_CacheLineSize                    (64)
+#define BufferPool_AlignUp(Size, Alignment)         (((Size) + ((Alignment) - 1)) & ~((size_t)(Alignment) - 1))
+#define BufferPool_CacheLineAlign(Size)             BufferPool_AlignUp(Size, BufferPool_CacheLineSize)
+
+// Default interval at which retained buffers that are no longer needed are deleted.
+//
+#define BufferPool_TrimIntervalMillisecondsDefault  (1000)
+
+// Resolution of buffer timers in Sink mode.
+//
+#define BufferPool_TimerWheelTickMilliseconds       (10)
+#define BufferPool_TimerWheelTick100ns              ((ULONGLONG)BufferPool_TimerWheelTickMilliseconds * 10000)
+// Number of slots in each level of the timer wheel (as a power of 2).
+//
+#define BufferPool_TimerWheelSlotBits               (6)
+#define BufferPool_TimerWheelSlotsPerLevel          (1 << BufferPool_TimerWheelSlotBits)
+#define BufferPool_TimerWheelSlotMask               (BufferPool_TimerWheelSlotsPerLevel - 1)
+// Number of levels in the timer wheel. Each level covers 64 times the range of the level
+// below it. With 4 levels, timers up to about 46 hours are inserted directly. Longer timers
+// are placed in the last level and cascaded until they are in range.
+//
+#define BufferPool_TimerWheelLevels                 (4)
+
+// Hierarchical timer wheel used in Sink mode. All the buffers that are put using
+// DMF_BufferPool_PutInSinkWithTimer are tracked by a single wheel that is driven by a
+// single WDFTIMER. Insert and cancel are O(1). Buffers that expire during the same tick
+// are removed under a single lock acquisition and their callbacks are called in a batch.
+//
+typedef struct
+{
+    // Lists of buffers. Level 0 holds buffers that expire in the next 64 ticks, one slot per tick.
+    // Each slot in level N holds buffers that expire in a range of 64^N ticks.
+    //
+    LIST_ENTRY Slots[BufferPool_TimerWheelLevels][BufferPool_TimerWheelSlotsPerLevel];
+    // Next tick to process. All ticks before this one have been processed.
+    //
+    ULONGLONG CurrentTick;
+    // Tick at which Timer is set to expire (valid when TimerIsArmed is TRUE).
+    //
+    ULONGLONG ArmedTick;
+    // Indicates if Timer has been set and has not yet expired.
+    //
+    BOOLEAN TimerIsArmed;
+    // Number of buffers in the wheel.
+    //
+    ULONG NumberOfEntries;
+    // The only timer used by this Module.
+    //
+    WDFTIMER Timer;
+} BUFFERPOOL_TIMER_WHEEL;
+
+// Per-processor cache (magazine) of buffers. Get/Put operations are served from
+// the cache of the current processor without acquiring the Module lock. Buffers
+// move between the cache and the Module's list in batches.
+//
+typedef struct DECLSPEC_ALIGN(BufferPool_CacheLineSize)
+{
+    // Nonzero while a thread is using this cache. If a thread finds the cache in use
+    // (because another thread was preempted or migrated while using it) it uses the
+    // Module's list instead.
+    //
+    LONG volatile InUse;
+    // Number of buffers currently in this cache.
+    //
+    ULONG NumberOfEntries;
+#if !defined(DMF_USER_MODE)
+    // IRQL of the thread that currently owns this cache.
+    //
+    KIRQL OldIrql;
+#endif // !defined(DMF_USER_MODE)
+    // Stack of buffers in this cache.
+    // NOTE: Opaque here because BUFFERPOOL_ENTRY is defined below.
+    //
+    VOID** Entries;
+} BUFFERPOOL_MAGAZINE;
+
+// Per-processor statistics counters. Each processor updates its own counters using
+// interlocked operations so that counting does not cause cache line contention between
+// processors. See DMF_BufferPool_StatisticsGet().
+//
+typedef struct DECLSPEC_ALIGN(BufferPool_CacheLineSize)
+{
+    // Number of buffers retrieved from the Module.
+    //
+    LONG64 volatile NumberOfGets;
+    // Number of buffers added to the Module.
+    //
+    LONG64 volatile NumberOfPuts;
+    // Number of buffers requested that could not be retrieved.
+    //
+    LONG64 volatile NumberOfFailedGets;
+    // Sum of the time (in microseconds) that buffers returned to the Module were owned
+    // by the Client (Source mode only).
+    //
+    LONG64 volatile CheckoutTimeMicroseconds;
+} BUFFERPOOL_COUNTERS;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +165,20 @@ typedef struct
     // Lookaside List for the source of buffers.
     //
     DMF_PORTABLE_LOOKASIDELIST LookasideList;
+    // Contiguous allocation that holds all the preallocated buffers when EnableSlabAllocation
+    // is set. NULL otherwise.
+    //
+    WDFMEMORY SlabMemory;
+    // First cache line aligned buffer in the slab.
+    //
+    UCHAR* Slab;
+    // Distance in bytes between consecutive buffers in the slab.
+    //
+    size_t SlabEntryStride;
+    // Offset of each buffer's BUFFERPOOL_ENTRY_COLD from the start of its BUFFERPOOL_ENTRY.
+    // Zero when buffers do not have a BUFFERPOOL_ENTRY_COLD (CreateWithTimer is not set).
+    //
+    ULONG EntryColdOffset;
     // Number of additional buffers allocated besides the initial buffers.
     // When buffers are returned to the list and EnableLookAside is true, if this value is
     // more than zero, the buffer is not added to the list. It is just deleted.
@@ -76,6 +192,59 @@ typedef struct
     // For debug purposes.
     //
     BOOLEAN BufferPoolEnumerating;
+    // Per-processor caches. NULL when per-processor caching is not enabled.
+    //
+    BUFFERPOOL_MAGAZINE* Magazines;
+    // Memory that holds the per-processor caches.
+    //
+    WDFMEMORY MagazinesMemory;
+    // Number of per-processor caches (one per processor).
+    //
+    ULONG NumberOfMagazines;
+    // Maximum number of buffers in each per-processor cache.
+    //
+    ULONG MagazineDepth;
+    // Number of buffers currently held in all the per-processor caches.
+    //
+    LONG volatile NumberOfBuffersInMagazines;
+    // Timer wheel that tracks buffers put using DMF_BufferPool_PutInSinkWithTimer.
+    // (Sink mode only.)
+    //
+    BUFFERPOOL_TIMER_WHEEL* TimerWheel;
+    // Memory that holds the timer wheel.
+    //
+    WDFMEMORY TimerWheelMemory;
+    // Per-processor statistics counters.
+    //
+    BUFFERPOOL_COUNTERS* Counters;
+    // Memory that holds the per-processor statistics counters.
+    //
+    WDFMEMORY CountersMemory;
+    // Number of per-processor statistics counters (one per processor).
+    //
+    ULONG NumberOfCounters;
+    // Statistics that are updated while the Module lock is held.
+    //
+    ULONGLONG NumberOfLookasideAllocations;
+    ULONGLONG NumberOfTimerExpirations;
+    ULONG MaximumNumberOfAdditionalBuffersAllocated;
+    ULONG HighWaterMark;
+    ULONG LowWaterMark;
+    // Maximum number of buffers allocated from the lookaside list that are kept in the list
+    // when they are returned instead of being deleted.
+    //
+    ULONG MaximumRetainedBuffers;
+    // Periodic timer that deletes retained buffers when demand falls.
+    // NULL when MaximumRetainedBuffers is zero.
+    //
+    WDFTIMER TrimTimer;
+    // Lowest number of buffers in the list since the trim timer last expired.
+    //
+    ULONG TrimIntervalLowWaterMark;
+    // Decaying estimate of the number of buffers the Client uses at the same time.
+    // It rises immediately when demand rises and decays each time the trim timer expires.
+    //
+    ULONG DemandEstimate;
 } DMF_CONTEXT_BufferPool;
 
 // This macro declares the following function:
@@ -102,26 +271,29 @@ typedef ULONG BufferPool_SentinelType;
 #define BufferPool_SentinelData     0x33334444
 #define BufferPool_SentinelSize     sizeof(BufferPool_SentinelType)
 
+// Location of the sentinels that follow the Client Buffer and the Client Buffer Context.
+//
+#define BufferPool_SentinelDataGet(BufferPoolEntry)     ((BufferPool_SentinelType*)((UCHAR*)(BufferPoolEntry)->ClientBuffer + (BufferPoolEntry)->SizeOfClientBuffer))
+#define BufferPool_SentinelContextGet(BufferPoolEntry)  ((BufferPool_SentinelType*)((UCHAR*)(BufferPoolEntry)->ClientBufferContext + (BufferPoolEntry)->BufferContextSize))
+
+struct _BUFFERPOOL_ENTRY;
+
+// Fields of a buffer that are only used by the timer. These are not accessed by Get and Put
+// so they are kept out of BUFFERPOOL_ENTRY. They are located after the Client Buffer Context
+// and are only present in buffers created by Source Modules that set CreateWithTimer.
+//
 typedef struct
 {
-    // Stores the location of this buffer in the list.
-    //
-    LIST_ENTRY ListEntry;
-    // WDF Memory object for this structure and the client buffer that is
-    // located immediately after this structure.
+    // The buffer that owns these fields.
     //
-    WDFMEMORY BufferPoolEntryMemory;
-    // The associated memory descriptor.
-    //
-    WDF_MEMORY_DESCRIPTOR MemoryDescriptor;
-    // Client buffer memory.
+    struct _BUFFERPOOL_ENTRY* BufferPoolEntry;
+    // Stores the location of this buffer in the Sink Module's timer wheel in cases where
+    // client wants to automatically do processing on entries in list.
     //
-    WDFMEMORY ClientBufferMemory;
-    // Timer for buffer in cases where client wants to automatically do processing on
-    // entries in list.
-    // NOTE: This timer is optionally created so it must be checked prior to use.
+    LIST_ENTRY TimerListEntry;
+    // Timer wheel tick at which the timer expires.
     //
-    WDFTIMER Timer;
+    ULONGLONG TimerExpirationTick;
     // For resetting timer again.
     //
     ULONGLONG TimerExpirationMilliseconds;
@@ -134,25 +306,57 @@ typedef struct
     // Context for this buffer's Timer Expiration Callback.
     //
     VOID* TimerExpirationCallbackContext;
+} BUFFERPOOL_ENTRY_COLD;
+
+// Meta data of each buffer. The fields used by Get and Put are first so that they are
+// in a single cache line.
+//
+typedef struct _BUFFERPOOL_ENTRY
+{
+    // Stores the location of this buffer in the list.
+    //
+    LIST_ENTRY ListEntry;
     // NOTE: This pointer points to the end of this structure.
     //
     VOID* ClientBuffer;
     // Client buffer context. Client can store per buffer information here.
     //
     VOID* ClientBufferContext;
-    // For validation purposes.
+    // Source Module that created this buffer.
     //
+    DMFMODULE CreatedByDmfModule;
+    // Timer related fields. NULL if the Source Module does not set CreateWithTimer.
+    //
+    BUFFERPOOL_ENTRY_COLD* Cold;
     ULONG SizeOfClientBuffer;
     ULONG BufferContextSize;
-    ULONG SizeOfBufferPoolEntry;
+    ULONG Signature;
+    // Time (in microseconds, truncated to 32 bits) when the Client retrieved this buffer
+    // from its Source Module. Used for statistics.
+    //
+    ULONG CheckoutTimeMicroseconds;
+    // WDF Memory object for this structure and the client buffer that is
+    // located immediately after this structure.
+    // NOTE: This is NULL when this structure is located in the Source Module's slab.
+    //
+    WDFMEMORY BufferPoolEntryMemory;
+    // Client buffer memory.
+    // NOTE: For buffers in the slab, this is created the first time it is needed.
+    //
+    WDFMEMORY ClientBufferMemory;
+#if defined(DEBUG)
+    // For validation purposes.
+    //
     LIST_ENTRY* CurrentlyInsertedList;
     DMFMODULE CurrentlyInsertedDmfModule;
-    DMFMODULE CreatedByDmfModule;
-    BufferPool_SentinelType* SentinelData;
-    BufferPool_SentinelType* SentinelContext;
-    ULONG Signature;
+    ULONG SizeOfBufferPoolEntry;
+#endif // defined(DEBUG)
 } BUFFERPOOL_ENTRY;
 
+// Get and Put only access the first cache line of BUFFERPOOL_ENTRY.
+//
+C_ASSERT(FIELD_OFFSET(BUFFERPOOL_ENTRY, BufferPoolEntryMemory) <= BufferPool_CacheLineSize);
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 BufferPool_TimerFieldsClear(
@@ -166,7 +370,7 @@ Routine Description:
     Clears fields associated with timer handling for the given buffer. These fields are 
     used to determine if the timer is enabled so that the timer can be stopped when the 
     buffer is removed from the list. It is essential that the timer be enabled only when 
-    the buffer is in the list.
+    the buffer is in the list. Buffers without timer fields are ignored.
 
 Arguments:
 
@@ -179,219 +383,193 @@ Return Value:
 
 --*/
 {
+    BUFFERPOOL_ENTRY_COLD* bufferPoolEntryCold;
+
     UNREFERENCED_PARAMETER(DmfModule);
 
     DmfAssert(DMF_ModuleIsLocked(DmfModule));
 
-    BufferPoolEntry->TimerExpirationMilliseconds = 0;
-    BufferPoolEntry->TimerExpirationAbsoluteTime100ns = 0;
-    BufferPoolEntry->TimerExpirationCallback = NULL;
-    BufferPoolEntry->TimerExpirationCallbackContext = NULL;
+    bufferPoolEntryCold = BufferPoolEntry->Cold;
+    if (bufferPoolEntryCold != NULL)
+    {
+        DmfAssert(NULL == bufferPoolEntryCold->TimerListEntry.Flink);
+        DmfAssert(NULL == bufferPoolEntryCold->TimerListEntry.Blink);
+
+        bufferPoolEntryCold->TimerExpirationTick = 0;
+        bufferPoolEntryCold->TimerExpirationMilliseconds = 0;
+        bufferPoolEntryCold->TimerExpirationAbsoluteTime100ns = 0;
+        bufferPoolEntryCold->TimerExpirationCallback = NULL;
+        bufferPoolEntryCold->TimerExpirationCallbackContext = NULL;
+    }
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-BufferPool_RemoveEntryList(
-    _In_ DMFMODULE DmfModule,
-    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+static
+BOOLEAN
+BufferPool_TimerIsSet(
     _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
     )
 /*++
 
 Routine Description:
 
-    Remove a given buffer from the buffer list.
+    Indicates if the timer of the given buffer is set.
 
 Arguments:
 
-    DmfModule - This Module's handle (for validation purposes).
-    ModuleContext - This Module's context.
-    BufferPoolEntry - The associated data of the given buffer to remove.
+    BufferPoolEntry - The given buffer.
 
 Return Value:
 
-    Void.
+    TRUE if the timer of the given buffer is set.
 
 --*/
 {
-    UNREFERENCED_PARAMETER(DmfModule);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
-
-    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
-    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
-    DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
-
-    RemoveEntryList(&BufferPoolEntry->ListEntry);
-    ModuleContext->NumberOfBuffersInList--;
-
-    BufferPoolEntry->CurrentlyInsertedList = NULL;
-    BufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
-    BufferPoolEntry->ListEntry.Blink = NULL;
-    BufferPoolEntry->ListEntry.Flink = NULL;
+    return ((BufferPoolEntry->Cold != NULL) &&
+            (BufferPoolEntry->Cold->TimerExpirationCallback != NULL));
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-BUFFERPOOL_ENTRY*
-BufferPool_RemoveHeadList(
-    _In_ DMFMODULE DmfModule,
-    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+static
+ULONGLONG
+BufferPool_CurrentTime100nsGet(
+    VOID
     )
 /*++
 
 Routine Description:
 
-    Remove the first buffer from the list (at the head of the list) in FIFO order.
-    If a timer is active for the buffer, this call cancels the timer. If it is unsuccessful
-    to cancel the timer, it skips that buffer.
+    Returns the current time used for buffer timers. This time is not affected by
+    changes to the system time.
 
 Arguments:
 
-    DmfModule - This Module's handle (for validation purposes).
-    ModuleContext - This Module's context.
+    None
 
 Return Value:
 
-    The BUFFERPOOL_ENTRY pointer associated with the buffer that is removed or
-    NULL if the list if empty.
+    The current time in 100ns units.
 
 --*/
 {
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
-    LIST_ENTRY* listEntry;
+    ULONGLONG currentTime100ns;
 
-    UNREFERENCED_PARAMETER(DmfModule);
+#if defined(DMF_USER_MODE)
+    currentTime100ns = GetTickCount64() * 10000;
+#else
+    currentTime100ns = KeQueryInterruptTime();
+#endif
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    return currentTime100ns;
+}
 
-    bufferPoolEntry = NULL;
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_CheckoutTimeStart(
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
 
-    listEntry = ModuleContext->BufferList.Flink;
-    while (listEntry != &ModuleContext->BufferList)
-    {
-        bufferPoolEntry = CONTAINING_RECORD(listEntry,
-                                            BUFFERPOOL_ENTRY,
-                                            ListEntry);
+Routine Description:
 
-        // If a timer is set, then try to stop the timer. If the timer cannot be stopped,
-        // then do not remove this buffer because its timer callback will be called
-        // very soon. This avoids a race condition between removal, enumeration and timer callbacks.
-        //
-        if (bufferPoolEntry->TimerExpirationCallback != NULL)
-        {
-            // The timer is running. Try to stop it.
-            //
-            if (! WdfTimerStop(bufferPoolEntry->Timer,
-                               FALSE))
-            {
-                // Timer callback will be called soon, so skip this buffer.
-                // (Try to remove the next buffer.)
-                //
-                listEntry = listEntry->Flink;
-                bufferPoolEntry = NULL;
-                continue;
-            }
-            else
-            {
-                // The timer has been stopped. The timer callback will not be called.
-                // Clears fields associated with timer handling.
-                // This buffer will be removed now.
-                //
-                BufferPool_TimerFieldsClear(DmfModule,
-                                            bufferPoolEntry);
-            }
-            
-        }
+    Remember when the Client retrieves the given buffer from its Source Module.
 
-        DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
-        RemoveEntryList(listEntry);
+Arguments:
 
-        ModuleContext->NumberOfBuffersInList--;
-        DmfAssert(bufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
-        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
-        bufferPoolEntry->CurrentlyInsertedList = NULL;
-        bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+    BufferPoolEntry - The given buffer.
 
-        bufferPoolEntry->ListEntry.Blink = NULL;
-        bufferPoolEntry->ListEntry.Flink = NULL;
+Return Value:
 
-        break;
-    }
+    None
 
-    return bufferPoolEntry;
+--*/
+{
+    BufferPoolEntry->CheckoutTimeMicroseconds = (ULONG)(BufferPool_CurrentTime100nsGet() / 10);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-BUFFERPOOL_ENTRY*
-BufferPool_FirstBufferPeek(
-    _In_ DMFMODULE DmfModule,
-    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+static
+ULONG
+BufferPool_CheckoutTimeGet(
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
     )
 /*++
 
 Routine Description:
 
-    Returns (but does not remove) the first buffer from the list (at the head of the list)
-    in FIFO order.
+    Returns how long the Client has owned the given buffer since it retrieved it from its
+    Source Module.
+    NOTE: The result is only correct for times less than about 71 minutes.
 
 Arguments:
 
-    DmfModule - This Module's handle (for validation purposes).
-    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
 
 Return Value:
 
-    The BUFFERPOOL_ENTRY associated with the buffer that is first in the list.
+    The time in microseconds.
 
 --*/
 {
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
-    LIST_ENTRY* listEntry;
+    return (ULONG)(BufferPool_CurrentTime100nsGet() / 10) - BufferPoolEntry->CheckoutTimeMicroseconds;
+}
 
-    UNREFERENCED_PARAMETER(DmfModule);
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_TimerExpirationSet(
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _In_ ULONGLONG TimerExpirationMilliseconds
+    )
+/*++
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+Routine Description:
 
-    if (IsListEmpty(&ModuleContext->BufferList))
-    {
-        bufferPoolEntry = NULL;
-        goto Exit;
-    }
+    Sets the fields that indicate when the timer of the given buffer expires.
 
-    DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
-    listEntry = ModuleContext->BufferList.Flink;
+Arguments:
 
-    bufferPoolEntry = CONTAINING_RECORD(listEntry,
-                                        BUFFERPOOL_ENTRY,
-                                        ListEntry);
+    BufferPoolEntry - The given buffer.
+    TimerExpirationMilliseconds - Timer expires after this many milliseconds from now.
 
-    DmfAssert(bufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
-    DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
-    DmfAssert(bufferPoolEntry->ListEntry.Blink != NULL);
-    DmfAssert(bufferPoolEntry->ListEntry.Flink != NULL);
+Return Value:
 
-Exit:
+    None
 
-    return bufferPoolEntry;
+--*/
+{
+    BUFFERPOOL_ENTRY_COLD* bufferPoolEntryCold;
+
+    bufferPoolEntryCold = BufferPoolEntry->Cold;
+    DmfAssert(bufferPoolEntryCold != NULL);
+
+    bufferPoolEntryCold->TimerExpirationMilliseconds = TimerExpirationMilliseconds;
+    bufferPoolEntryCold->TimerExpirationAbsoluteTime100ns = BufferPool_CurrentTime100nsGet() + 
+                                                            WDF_ABS_TIMEOUT_IN_MS(TimerExpirationMilliseconds);
+    // Round up so that the timer never expires early.
+    //
+    bufferPoolEntryCold->TimerExpirationTick = (bufferPoolEntryCold->TimerExpirationAbsoluteTime100ns + BufferPool_TimerWheelTick100ns - 1) /
+                                               BufferPool_TimerWheelTick100ns;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
+static
 VOID
-BufferPool_InsertTailList(
-    _In_ DMFMODULE DmfModule,
-    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+BufferPool_TimerWheelSlotInsert(
+    _Inout_ BUFFERPOOL_TIMER_WHEEL* TimerWheel,
     _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
     )
 /*++
 
 Routine Description:
 
-    Adds a given buffer to the end of the list.
+    Insert the given buffer into the slot of the timer wheel that corresponds to its
+    expiration tick.
 
 Arguments:
 
-    DmfModule - This Module's handle (for validation purposes).
-    ModuleContext - This Module's context.
+    TimerWheel - The given timer wheel.
     BufferPoolEntry - The given buffer.
 
 Return Value:
@@ -400,94 +578,163 @@ Return Value:
 
 --*/
 {
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    ULONGLONG expirationTick;
+    ULONGLONG ticksRemaining;
+    ULONGLONG maximumTicks;
+    ULONG level;
+    ULONG slotIndex;
+
+    expirationTick = BufferPoolEntry->Cold->TimerExpirationTick;
+    if (expirationTick < TimerWheel->CurrentTick)
+    {
+        // Already expired. Process it on the next tick.
+        //
+        expirationTick = TimerWheel->CurrentTick;
+    }
+    ticksRemaining = expirationTick - TimerWheel->CurrentTick;
 
-    // Verify that this buffer is not in any other list. Inserting the buffer into
-    // more than one list is a fatal error.
+    maximumTicks = ((ULONGLONG)1 << (BufferPool_TimerWheelSlotBits * BufferPool_TimerWheelLevels)) - 1;
+    if (ticksRemaining > maximumTicks)
+    {
+        // Beyond the range of the wheel. Place it in the farthest slot. It is inserted
+        // again (using its actual expiration tick) when that slot is cascaded.
+        //
+        expirationTick = TimerWheel->CurrentTick + maximumTicks;
+        ticksRemaining = maximumTicks;
+    }
+
+    // Find the lowest level whose range covers the remaining time.
     //
-    DmfAssert(BufferPoolEntry->ListEntry.Blink == NULL);
-    DmfAssert(BufferPoolEntry->ListEntry.Flink == NULL);
-    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == NULL);
-    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
-
-    // Add to end of list and increment the number of buffers in the list.
-    //
-    InsertTailList(&ModuleContext->BufferList,
-                   &BufferPoolEntry->ListEntry);
-    ModuleContext->NumberOfBuffersInList++;
+    level = 0;
+    while (ticksRemaining >= ((ULONGLONG)1 << (BufferPool_TimerWheelSlotBits * (level + 1))))
+    {
+        level++;
+    }
+    DmfAssert(level < BufferPool_TimerWheelLevels);
 
-    DmfAssert(((ModuleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-              (ModuleContext->NumberOfBuffersInList <= ModuleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == ModuleContext->NumberOfBuffersSpecifiedByClient));
+    slotIndex = (ULONG)((expirationTick >> (BufferPool_TimerWheelSlotBits * level)) & BufferPool_TimerWheelSlotMask);
 
-    // Remember this for validation purposes.
-    //
-    BufferPoolEntry->CurrentlyInsertedList = &ModuleContext->BufferList;
-    BufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+    InsertTailList(&TimerWheel->Slots[level][slotIndex],
+                   &BufferPoolEntry->Cold->TimerListEntry);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-BUFFERPOOL_ENTRY*
-BufferPool_BufferPoolEntryGetFromClientBuffer(
-    _In_ VOID* ClientBuffer
+static
+ULONG
+BufferPool_TimerWheelCascade(
+    _Inout_ BUFFERPOOL_TIMER_WHEEL* TimerWheel,
+    _In_ ULONG Level
     )
 /*++
 
 Routine Description:
 
-    Given a properly formed Client Buffer, retrieve its corresponding BUFFERPOOL_ENTRY.
+    Move all the buffers in the current slot of the given level to lower levels of the
+    timer wheel. This is done when the current tick reaches the range covered by the slot.
 
 Arguments:
 
-    ClientBuffer - The given Client Buffer.
+    TimerWheel - The given timer wheel.
+    Level - The level to cascade.
 
 Return Value:
 
-    The BUFFERPOOL_ENTRY that corresponds to ClientBuffer.
+    The index of the slot that was cascaded. When it is zero, the next level must be cascaded also.
 
 --*/
 {
+    ULONG slotIndex;
+    LIST_ENTRY cascadeList;
+    LIST_ENTRY* listEntry;
     BUFFERPOOL_ENTRY* bufferPoolEntry;
 
-    FuncEntry(DMF_TRACE);
+    DmfAssert(Level > 0);
+    DmfAssert(Level < BufferPool_TimerWheelLevels);
 
-    DmfAssert(ClientBuffer != NULL);
+    slotIndex = (ULONG)((TimerWheel->CurrentTick >> (BufferPool_TimerWheelSlotBits * Level)) & BufferPool_TimerWheelSlotMask);
 
-    // Given the Client Buffer, get the associated meta data.
-    // NOTE: The meta data is located sizeof(BUFFERPOOL_ENTRY) bytes before the Client buffer.
+    // Move the buffers to a local list first because a buffer beyond the range of the
+    // wheel may be inserted in the last level again.
     //
-    bufferPoolEntry = ((BUFFERPOOL_ENTRY*)ClientBuffer) - 1;
+    InitializeListHead(&cascadeList);
+    while (! IsListEmpty(&TimerWheel->Slots[Level][slotIndex]))
+    {
+        listEntry = RemoveHeadList(&TimerWheel->Slots[Level][slotIndex]);
+        InsertTailList(&cascadeList,
+                       listEntry);
+    }
 
-    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
-                      bufferPoolEntry->Signature == BufferPool_Signature);
-    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch",
-                      *(bufferPoolEntry->SentinelData) == BufferPool_SentinelData);
-    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch",
-                      *(bufferPoolEntry->SentinelContext) == BufferPool_SentinelContext);
+    while (! IsListEmpty(&cascadeList))
+    {
+        listEntry = RemoveHeadList(&cascadeList);
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY_COLD,
+                                            TimerListEntry)->BufferPoolEntry;
+        BufferPool_TimerWheelSlotInsert(TimerWheel,
+                                        bufferPoolEntry);
+    }
 
-    return bufferPoolEntry;
+    return slotIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONGLONG
+BufferPool_TimerWheelNextTickGet(
+    _In_ BUFFERPOOL_TIMER_WHEEL* TimerWheel
+    )
+/*++
+
+Routine Description:
+
+    Determine the next tick that must be processed. That is either the next tick that
+    has buffers that expire or the next tick where higher levels are cascaded.
+
+Arguments:
+
+    TimerWheel - The given timer wheel.
+
+Return Value:
+
+    The next tick that must be processed.
+
+--*/
+{
+    ULONGLONG tick;
+    ULONG offset;
+
+    tick = TimerWheel->CurrentTick;
+    for (offset = 0; offset < BufferPool_TimerWheelSlotsPerLevel; offset++)
+    {
+        tick = TimerWheel->CurrentTick + offset;
+        if ((0 == (tick & BufferPool_TimerWheelSlotMask)) ||
+            (! IsListEmpty(&TimerWheel->Slots[0][tick & BufferPool_TimerWheelSlotMask])))
+        {
+            break;
+        }
+    }
+
+    return tick;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
+static
 VOID
-BufferPool_BufferPoolEntryPut(
+BufferPool_TimerWheelArm(
     _In_ DMFMODULE DmfModule,
-    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
     )
 /*++
 
 Routine Description:
 
-    Given a BufferPoolEntry corresponding to a Client Buffer, add it to the
-    list of buffers.
-    NOTE: This function is only used when the Client Driver wants to return an entry
-          to the list. This function filters the add and does not add in the case when
-          an additional entry has been allocated from the look aside list when the list was empty.
+    Set the Module's timer so that it expires when the next tick that must be processed
+    is reached. The timer is not set when the wheel is empty.
 
 Arguments:
 
-    DmfModule - This Module's handle.
-    BufferPoolEntry - The given BufferPool entry corresponding to Client buffer.
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
 
 Return Value:
 
@@ -495,74 +742,78 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_BufferPool* moduleContext;
-    WDFMEMORY bufferPoolEntryMemory;
+    BUFFERPOOL_TIMER_WHEEL* timerWheel;
+    ULONGLONG nextTick;
+    ULONGLONG currentTime100ns;
+    ULONGLONG nextTime100ns;
+    ULONGLONG dueTimeMilliseconds;
+
+    UNREFERENCED_PARAMETER(DmfModule);
 
     FuncEntry(DMF_TRACE);
 
     DmfAssert(DMF_ModuleIsLocked(DmfModule));
 
-    bufferPoolEntryMemory = BufferPoolEntry->BufferPoolEntryMemory;
+    timerWheel = ModuleContext->TimerWheel;
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    if (0 == timerWheel->NumberOfEntries)
+    {
+        goto Exit;
+    }
 
-    if (moduleContext->EnableLookAside)
+    nextTick = BufferPool_TimerWheelNextTickGet(timerWheel);
+    if ((timerWheel->TimerIsArmed) &&
+        (timerWheel->ArmedTick <= nextTick))
     {
-        if (moduleContext->NumberOfAdditionalBuffersAllocated > 0)
-        {
-            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Delete Additional Buffer BufferPoolEntryMemory=0x%p", bufferPoolEntryMemory);
-            // Just delete the buffer. It returns to the lookaside list.
-            //
-            WdfObjectDelete(bufferPoolEntryMemory);
-            bufferPoolEntryMemory = NULL;
-            // There is one less additional buffer now.
-            //
-            moduleContext->NumberOfAdditionalBuffersAllocated--;
-            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
-            // Do not add the entry back into the list.
-            //
-            goto Exit;
-        }
+        // Timer already expires in time.
+        //
+        goto Exit;
     }
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Buffer BufferPoolEntryMemory=0x%p NumberOfAdditionalBuffersAllocated=%d", bufferPoolEntryMemory, moduleContext->NumberOfAdditionalBuffersAllocated);
+    currentTime100ns = BufferPool_CurrentTime100nsGet();
+    nextTime100ns = nextTick * BufferPool_TimerWheelTick100ns;
+    if (nextTime100ns > currentTime100ns)
+    {
+        dueTimeMilliseconds = (nextTime100ns - currentTime100ns + 9999) / 10000;
+    }
+    else
+    {
+        dueTimeMilliseconds = 1;
+    }
 
-    // Add the buffer to the list. (This function validates that the buffer has
-    // not already been added to another list in DEBUG mode.)
+    timerWheel->TimerIsArmed = TRUE;
+    timerWheel->ArmedTick = nextTick;
+
+    // If the timer is already in the queue, it is reset to the new time.
     //
-    BufferPool_InsertTailList(DmfModule,
-                              moduleContext,
-                              BufferPoolEntry);
+    WdfTimerStart(timerWheel->Timer,
+                  WDF_REL_TIMEOUT_IN_MS(dueTimeMilliseconds));
 
 Exit:
 
     FuncExitVoid(DMF_TRACE);
 }
 
-typedef struct
-{
-    BUFFERPOOL_ENTRY* BufferPoolEntry;
-    DMFMODULE DmfModuleInsertedList;
-} BUFFERPOOL_TIMER_CONTEXT;
-
-EVT_WDF_TIMER BufferPool_BufferPoolEntryTimerHandler;
-WDF_DECLARE_CONTEXT_TYPE(BUFFERPOOL_TIMER_CONTEXT);
-
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
 VOID
-BufferPool_BufferPoolTimerContextSet(
-    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
-    _In_opt_ DMFMODULE DmfModule
+BufferPool_TimerWheelInsert(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
     )
 /*++
 
 Routine Description:
 
-    Store the given DMF Module handle in BufferPoolEntry Timer's context.
+    Insert the given buffer into this Module's timer wheel. The buffer's expiration
+    fields must already be set.
 
 Arguments:
 
-    BufferPoolEntry - BufferPool entry which contains the Timer object.
-    BufferPoolEntry - The given DMF Module handle.
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
 
 Return Value:
 
@@ -570,444 +821,2203 @@ Return Value:
 
 --*/
 {
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
+    BUFFERPOOL_TIMER_WHEEL* timerWheel;
+    ULONGLONG currentTick;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(BufferPoolEntry->Cold != NULL);
+    DmfAssert(BufferPoolEntry->Cold->TimerListEntry.Flink == NULL);
+    DmfAssert(BufferPoolEntry->Cold->TimerListEntry.Blink == NULL);
 
-    DmfAssert(BufferPoolEntry != NULL);
-    DmfAssert(BufferPoolEntry->Timer != NULL);
+    timerWheel = ModuleContext->TimerWheel;
+    DmfAssert(timerWheel != NULL);
 
-    bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(BufferPoolEntry->Timer);
-    DmfAssert(bufferPoolTimerContext->BufferPoolEntry == BufferPoolEntry);
+    if (0 == timerWheel->NumberOfEntries)
+    {
+        // The wheel does not advance while it is empty. Move it to the current time
+        // so that the timer does not process all the ticks that have passed.
+        //
+        currentTick = BufferPool_CurrentTime100nsGet() / BufferPool_TimerWheelTick100ns;
+        if (timerWheel->CurrentTick < currentTick)
+        {
+            timerWheel->CurrentTick = currentTick;
+        }
+    }
+
+    BufferPool_TimerWheelSlotInsert(timerWheel,
+                                    BufferPoolEntry);
+    timerWheel->NumberOfEntries++;
 
-    bufferPoolTimerContext->DmfModuleInsertedList = DmfModule;
+    BufferPool_TimerWheelArm(DmfModule,
+                             ModuleContext);
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
 VOID
-BufferPool_BufferPoolEntryTimerHandler(
-    _In_ WDFTIMER WdfTimer
+BufferPool_TimerWheelRemove(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
     )
 /*++
 
 Routine Description:
 
-    Timer callback. The BufferPool entry corresponding to the timer will be removed 
-    from the list, and will be passed to the Client's timer expiration callback.
-    Upon timer expiration callback, Client owns the buffer. 
+    Remove the given buffer from this Module's timer wheel. The Module's timer is not
+    stopped. If it expires and there is nothing to do, it is not set again.
 
-Parameters:
+Arguments:
 
-    WdfTimer - The timer object that contains the PBUFFER_LIST_ENTRY.
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
 
-Return:
+Return Value:
 
     None
 
 --*/
 {
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
-    BUFFERPOOL_ENTRY* bufferPoolEntryTimer;
-    BUFFERPOOL_ENTRY* bufferPoolEntryInList;
-    DMFMODULE dmfModule;
-    DMF_CONTEXT_BufferPool* moduleContext;
-    EVT_DMF_BufferPool_TimerCallback* timerExpirationCallback;
-    LIST_ENTRY* listEntry;
+    BUFFERPOOL_ENTRY_COLD* bufferPoolEntryCold;
 
-    FuncEntry(DMF_TRACE);
+    UNREFERENCED_PARAMETER(DmfModule);
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "BufferPool Entry timer expires");
+    bufferPoolEntryCold = BufferPoolEntry->Cold;
 
-    // Get the BUFFERPOOL_TIMER_CONTEXT from the WDF Object.
-    //
-    bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(WdfTimer);
-    DmfAssert(bufferPoolTimerContext != NULL);
-    bufferPoolEntryTimer = bufferPoolTimerContext->BufferPoolEntry;
-    dmfModule = bufferPoolTimerContext->DmfModuleInsertedList;
-    DmfAssert(dmfModule != NULL);
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(bufferPoolEntryCold != NULL);
+    DmfAssert(bufferPoolEntryCold->TimerListEntry.Flink != NULL);
+    DmfAssert(bufferPoolEntryCold->TimerListEntry.Blink != NULL);
+    DmfAssert(ModuleContext->TimerWheel != NULL);
+    DmfAssert(ModuleContext->TimerWheel->NumberOfEntries > 0);
+
+    RemoveEntryList(&bufferPoolEntryCold->TimerListEntry);
+    bufferPoolEntryCold->TimerListEntry.Flink = NULL;
+    bufferPoolEntryCold->TimerListEntry.Blink = NULL;
+    ModuleContext->TimerWheel->NumberOfEntries--;
+}
 
-    moduleContext = DMF_CONTEXT_GET(dmfModule);
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_RemoveEntryList(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
 
-    DMF_ModuleLock(dmfModule);
+Routine Description:
 
-    timerExpirationCallback = NULL;
-    // If timer callback executed, buffer associated with the timer should be present in the list.
-    // But it might not be the first one. Search for it.
-    //
-    listEntry = moduleContext->BufferList.Flink;
-    while (listEntry != &moduleContext->BufferList)
-    {
-        // Prepare to call the enumeration function.
-        //
-        bufferPoolEntryInList = CONTAINING_RECORD(listEntry,
-                                                  BUFFERPOOL_ENTRY,
-                                                  ListEntry);
+    Remove a given buffer from the buffer list.
 
-        // Prepare to read the next entry in list at top of loop.
-        //
-        listEntry = listEntry->Flink;
+Arguments:
 
-        // Only remove the buffer if it's in the list AND the Client Driver's
-        // callback is not NULL. It is a legitimate case that the callback is NULL if the
-        // buffer had been removed from the list and added back without a timer.
-        //
-        if ((bufferPoolEntryInList == bufferPoolEntryTimer) &&
-            (bufferPoolEntryTimer->TimerExpirationCallback) != NULL)
-        {
-            // Found it. Remove it from list 
-            //
-            DmfAssert(bufferPoolEntryTimer->Timer != NULL);
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The associated data of the given buffer to remove.
 
-            // Remove item from list.
-            // (If the Client wants to use this buffer, Client has saved off the buffer in Client's Context).
-            // NOTE: Client Driver now owns buffer!
-            //
-            BufferPool_RemoveEntryList(dmfModule,
-                                       moduleContext,
-                                       bufferPoolEntryTimer);
-
-            timerExpirationCallback = bufferPoolEntryTimer->TimerExpirationCallback;
-            BufferPool_TimerFieldsClear(dmfModule,
-                                        bufferPoolEntryTimer);
-            
-            // The only matching buffer has been found.
-            //
-            break;
-        }
+Return Value:
 
-        // Keep searching.
-        //
-    }
+    Void.
 
-    DMF_ModuleUnlock(dmfModule);
+--*/
+{
+    UNREFERENCED_PARAMETER(DmfModule);
 
-    // Due to race conditions with cancel routines, it is possible the buffer was removed from the list
-    // during timer expiration.
-    //
-    if (timerExpirationCallback != NULL)
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+    DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
+
+    RemoveEntryList(&BufferPoolEntry->ListEntry);
+    ModuleContext->NumberOfBuffersInList--;
+    if (ModuleContext->NumberOfBuffersInList < ModuleContext->LowWaterMark)
     {
-        // Call the client driver's timer callback function.
-        //
-        timerExpirationCallback(dmfModule,
-                                bufferPoolEntryTimer->ClientBuffer,
-                                bufferPoolEntryTimer->ClientBufferContext,
-                                bufferPoolEntryTimer->TimerExpirationCallbackContext);
+        ModuleContext->LowWaterMark = ModuleContext->NumberOfBuffersInList;
     }
-    else
+    if (ModuleContext->NumberOfBuffersInList < ModuleContext->TrimIntervalLowWaterMark)
     {
-        // Buffer was removed from the list while timer was expiring.
-        //
+        ModuleContext->TrimIntervalLowWaterMark = ModuleContext->NumberOfBuffersInList;
     }
 
-    FuncExitVoid(DMF_TRACE);
+#if defined(DEBUG)
+    BufferPoolEntry->CurrentlyInsertedList = NULL;
+    BufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+#endif // defined(DEBUG)
+    BufferPoolEntry->ListEntry.Blink = NULL;
+    BufferPoolEntry->ListEntry.Flink = NULL;
 }
 
-#if defined(DMF_USER_MODE)
-_IRQL_requires_max_(PASSIVE_LEVEL)
-#else
 _IRQL_requires_max_(DISPATCH_LEVEL)
-#endif // defined(DMF_USER_MODE)
-_Must_inspect_result_
-NTSTATUS
-BufferPool_BufferPoolEntryCreateAndAddToList(
-    _In_ DMFMODULE DmfModule
+BUFFERPOOL_ENTRY*
+BufferPool_RemoveHeadList(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
     )
 /*++
 
 Routine Description:
 
-    Creates a new Client Buffer BUFFERPOOL_ENTRY and adds the Client Buffer to the
-    list of buffers.
+    Remove the first buffer from the list (at the head of the list) in FIFO order.
+    If a timer is active for the buffer, this call removes the buffer from the timer wheel.
+    NOTE: Buffers whose timer has expired are removed from the list by the timer handler
+          under the Module lock so they are never found in the list.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
 
 Return Value:
 
-    NTSTATUS
+    The BUFFERPOOL_ENTRY pointer associated with the buffer that is removed or
+    NULL if the list if empty.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_BufferPool* moduleContext;
-    DMF_CONFIG_BufferPool* moduleConfig;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
-    WDFMEMORY memory;
     BUFFERPOOL_ENTRY* bufferPoolEntry;
-    WDF_TIMER_CONFIG timerConfig;
-    WDF_OBJECT_ATTRIBUTES timerAttributes;
-    BUFFERPOOL_TIMER_CONTEXT* bufferPoolTimerContext;
+    LIST_ENTRY* listEntry;
 
-    FuncEntry(DMF_TRACE);
+    UNREFERENCED_PARAMETER(DmfModule);
 
     DmfAssert(DMF_ModuleIsLocked(DmfModule));
 
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    bufferPoolEntry = NULL;
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    listEntry = ModuleContext->BufferList.Flink;
+    if (listEntry != &ModuleContext->BufferList)
+    {
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            ListEntry);
+
+        // If a timer is set, cancel it. The timer callback will not be called.
+        //
+        if (BufferPool_TimerIsSet(bufferPoolEntry))
+        {
+            BufferPool_TimerWheelRemove(DmfModule,
+                                        ModuleContext,
+                                        bufferPoolEntry);
+            BufferPool_TimerFieldsClear(DmfModule,
+                                        bufferPoolEntry);
+        }
+
+        DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
+        RemoveEntryList(listEntry);
+
+        ModuleContext->NumberOfBuffersInList--;
+        if (ModuleContext->NumberOfBuffersInList < ModuleContext->LowWaterMark)
+        {
+            ModuleContext->LowWaterMark = ModuleContext->NumberOfBuffersInList;
+        }
+        if (ModuleContext->NumberOfBuffersInList < ModuleContext->TrimIntervalLowWaterMark)
+        {
+            ModuleContext->TrimIntervalLowWaterMark = ModuleContext->NumberOfBuffersInList;
+        }
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+#if defined(DEBUG)
+        bufferPoolEntry->CurrentlyInsertedList = NULL;
+        bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+#endif // defined(DEBUG)
+
+        bufferPoolEntry->ListEntry.Blink = NULL;
+        bufferPoolEntry->ListEntry.Flink = NULL;
+    }
+
+    return bufferPoolEntry;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BUFFERPOOL_ENTRY*
+BufferPool_FirstBufferPeek(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Returns (but does not remove) the first buffer from the list (at the head of the list)
+    in FIFO order.
+
+Arguments:
+
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    The BUFFERPOOL_ENTRY associated with the buffer that is first in the list.
+
+--*/
+{
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    LIST_ENTRY* listEntry;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    if (IsListEmpty(&ModuleContext->BufferList))
+    {
+        bufferPoolEntry = NULL;
+        goto Exit;
+    }
+
+    DmfAssert(ModuleContext->NumberOfBuffersInList > 0);
+    listEntry = ModuleContext->BufferList.Flink;
+
+    bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                        BUFFERPOOL_ENTRY,
+                                        ListEntry);
+
+    DmfAssert(bufferPoolEntry->CurrentlyInsertedList == &ModuleContext->BufferList);
+    DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+    DmfAssert(bufferPoolEntry->ListEntry.Blink != NULL);
+    DmfAssert(bufferPoolEntry->ListEntry.Flink != NULL);
+
+Exit:
+
+    return bufferPoolEntry;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_InsertTailList(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _Inout_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Adds a given buffer to the end of the list.
+
+Arguments:
+
+    DmfModule - This Module's handle (for validation purposes).
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    // Verify that this buffer is not in any other list. Inserting the buffer into
+    // more than one list is a fatal error.
+    //
+    DmfAssert(BufferPoolEntry->ListEntry.Blink == NULL);
+    DmfAssert(BufferPoolEntry->ListEntry.Flink == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
+
+    // Add to end of list and increment the number of buffers in the list.
+    //
+    InsertTailList(&ModuleContext->BufferList,
+                   &BufferPoolEntry->ListEntry);
+    ModuleContext->NumberOfBuffersInList++;
+    if (ModuleContext->NumberOfBuffersInList > ModuleContext->HighWaterMark)
+    {
+        ModuleContext->HighWaterMark = ModuleContext->NumberOfBuffersInList;
+    }
+
+    DmfAssert(((ModuleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+              (ModuleContext->NumberOfBuffersInList <= ModuleContext->NumberOfBuffersSpecifiedByClient + ModuleContext->MaximumRetainedBuffers)) ||
+              (0 == ModuleContext->NumberOfBuffersSpecifiedByClient));
+
+#if defined(DEBUG)
+    // Remember this for validation purposes.
+    //
+    BufferPoolEntry->CurrentlyInsertedList = &ModuleContext->BufferList;
+    BufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+#endif // defined(DEBUG)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BUFFERPOOL_ENTRY*
+BufferPool_BufferPoolEntryGetFromClientBuffer(
+    _In_ VOID* ClientBuffer
+    )
+/*++
+
+Routine Description:
+
+    Given a properly formed Client Buffer, retrieve its corresponding BUFFERPOOL_ENTRY.
+
+Arguments:
+
+    ClientBuffer - The given Client Buffer.
+
+Return Value:
+
+    The BUFFERPOOL_ENTRY that corresponds to ClientBuffer.
+
+--*/
+{
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(ClientBuffer != NULL);
+
+    // Given the Client Buffer, get the associated meta data.
+    // NOTE: The meta data is located sizeof(BUFFERPOOL_ENTRY) bytes before the Client buffer.
+    //
+    bufferPoolEntry = ((BUFFERPOOL_ENTRY*)ClientBuffer) - 1;
+
+    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
+                      bufferPoolEntry->Signature == BufferPool_Signature);
+    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch",
+                      *BufferPool_SentinelDataGet(bufferPoolEntry) == BufferPool_SentinelData);
+    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch",
+                      *BufferPool_SentinelContextGet(bufferPoolEntry) == BufferPool_SentinelContext);
+
+    return bufferPoolEntry;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+BufferPool_BufferPoolEntryPut(
+    _In_ DMFMODULE DmfModule,
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Given a BufferPoolEntry corresponding to a Client Buffer, add it to the
+    list of buffers.
+    NOTE: This function is only used when the Client Driver wants to return an entry
+          to the list. This function filters the add and does not add in the case when
+          an additional entry has been allocated from the look aside list when the list was empty
+          and more than MaximumRetainedBuffers such entries exist.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferPoolEntry - The given BufferPool entry corresponding to Client buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDFMEMORY bufferPoolEntryMemory;
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    bufferPoolEntryMemory = BufferPoolEntry->BufferPoolEntryMemory;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // NOTE: Buffers located in the slab are never deleted. When the pool has a slab, only
+    //       buffers allocated from the lookaside list have a BufferPoolEntryMemory.
+    //       Up to MaximumRetainedBuffers additional buffers are kept in the list so that the
+    //       next burst does not allocate them again. They are deleted by the trim timer when
+    //       demand falls.
+    //
+    if ((moduleContext->EnableLookAside) &&
+        (bufferPoolEntryMemory != NULL))
+    {
+        if (moduleContext->NumberOfAdditionalBuffersAllocated > moduleContext->MaximumRetainedBuffers)
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Delete Additional Buffer BufferPoolEntryMemory=0x%p", bufferPoolEntryMemory);
+            // Just delete the buffer. It returns to the lookaside list.
+            //
+            WdfObjectDelete(bufferPoolEntryMemory);
+            bufferPoolEntryMemory = NULL;
+            // There is one less additional buffer now.
+            //
+            moduleContext->NumberOfAdditionalBuffersAllocated--;
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+            // Do not add the entry back into the list.
+            //
+            goto Exit;
+        }
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Buffer BufferPoolEntryMemory=0x%p NumberOfAdditionalBuffersAllocated=%d", bufferPoolEntryMemory, moduleContext->NumberOfAdditionalBuffersAllocated);
+
+    // Add the buffer to the list. (This function validates that the buffer has
+    // not already been added to another list in DEBUG mode.)
+    //
+    BufferPool_InsertTailList(DmfModule,
+                              moduleContext,
+                              BufferPoolEntry);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BUFFERPOOL_COUNTERS*
+BufferPool_CountersGet(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Returns the statistics counters of the current processor. The thread may migrate to
+    another processor while it uses the counters. This is not a problem because the
+    counters are updated using interlocked operations.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    The statistics counters of the current processor or NULL if the counters have
+    been deleted (the Module is closing).
+
+--*/
+{
+    BUFFERPOOL_COUNTERS* counters;
+    ULONG processorIndex;
+
+    counters = ModuleContext->Counters;
+    if (NULL == counters)
+    {
+        goto Exit;
+    }
+
+#if !defined(DMF_USER_MODE)
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+#else
+    processorIndex = GetCurrentProcessorNumber();
+#endif // !defined(DMF_USER_MODE)
+
+    DmfAssert(ModuleContext->NumberOfCounters > 0);
+    counters = &counters[processorIndex % ModuleContext->NumberOfCounters];
+
+Exit:
+
+    return counters;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_StatisticsGetsAdd(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG NumberOfGets,
+    _In_ ULONG NumberOfFailedGets
+    )
+/*++
+
+Routine Description:
+
+    Count buffers retrieved from the Module and buffers that could not be retrieved.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    NumberOfGets - Number of buffers retrieved.
+    NumberOfFailedGets - Number of buffers requested that could not be retrieved.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_COUNTERS* counters;
+
+    counters = BufferPool_CountersGet(ModuleContext);
+    if (counters != NULL)
+    {
+        if (NumberOfGets > 0)
+        {
+            InterlockedAdd64(&counters->NumberOfGets,
+                             NumberOfGets);
+        }
+        if (NumberOfFailedGets > 0)
+        {
+            InterlockedAdd64(&counters->NumberOfFailedGets,
+                             NumberOfFailedGets);
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_StatisticsPutsAdd(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONG NumberOfPuts,
+    _In_ ULONGLONG CheckoutTimeMicroseconds
+    )
+/*++
+
+Routine Description:
+
+    Count buffers added to the Module.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    NumberOfPuts - Number of buffers added.
+    CheckoutTimeMicroseconds - Total time the Client owned the buffers (Source mode only).
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_COUNTERS* counters;
+
+    counters = BufferPool_CountersGet(ModuleContext);
+    if (counters != NULL)
+    {
+        InterlockedAdd64(&counters->NumberOfPuts,
+                         NumberOfPuts);
+        if (CheckoutTimeMicroseconds > 0)
+        {
+            InterlockedAdd64(&counters->CheckoutTimeMicroseconds,
+                             (LONG64)CheckoutTimeMicroseconds);
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+BUFFERPOOL_MAGAZINE*
+BufferPool_MagazineAcquire(
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Acquire exclusive use of the current processor's cache. In Kernel-mode, IRQL is raised
+    to DISPATCH_LEVEL so that the thread neither migrates nor is preempted while it uses
+    the cache.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    The current processor's cache or NULL if it is in use by another thread.
+
+--*/
+{
+    BUFFERPOOL_MAGAZINE* magazine;
+    ULONG processorIndex;
+#if !defined(DMF_USER_MODE)
+    KIRQL oldIrql;
+
+    KeRaiseIrql(DISPATCH_LEVEL,
+                &oldIrql);
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+#else
+    processorIndex = GetCurrentProcessorNumber();
+#endif // !defined(DMF_USER_MODE)
+
+    DmfAssert(ModuleContext->NumberOfMagazines > 0);
+    magazine = &ModuleContext->Magazines[processorIndex % ModuleContext->NumberOfMagazines];
+
+    if (InterlockedCompareExchange(&magazine->InUse,
+                                   1,
+                                   0) != 0)
+    {
+        // Another thread is using this cache. Caller uses the Module's list instead.
+        //
+#if !defined(DMF_USER_MODE)
+        KeLowerIrql(oldIrql);
+#endif // !defined(DMF_USER_MODE)
+        magazine = NULL;
+        goto Exit;
+    }
+
+#if !defined(DMF_USER_MODE)
+    magazine->OldIrql = oldIrql;
+#endif // !defined(DMF_USER_MODE)
+
+Exit:
+
+    return magazine;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_MagazineRelease(
+    _In_ BUFFERPOOL_MAGAZINE* Magazine
+    )
+/*++
+
+Routine Description:
+
+    Release a cache acquired using BufferPool_MagazineAcquire.
+
+Arguments:
+
+    Magazine - The given cache.
+
+Return Value:
+
+    None
+
+--*/
+{
+#if !defined(DMF_USER_MODE)
+    KIRQL oldIrql;
+
+    oldIrql = Magazine->OldIrql;
+#endif // !defined(DMF_USER_MODE)
+
+    DmfAssert(Magazine->InUse);
+    InterlockedExchange(&Magazine->InUse,
+                        0);
+
+#if !defined(DMF_USER_MODE)
+    KeLowerIrql(oldIrql);
+#endif // !defined(DMF_USER_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+BUFFERPOOL_ENTRY*
+BufferPool_MagazineEntryGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Remove a buffer from the current processor's cache. If the cache is empty, it is
+    refilled with up to half its depth from the Module's list using a single lock acquisition.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    The buffer removed from the cache or NULL if no buffer is available without
+    allocating a new buffer.
+
+--*/
+{
+    BUFFERPOOL_MAGAZINE* magazine;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG refillCount;
+
+    bufferPoolEntry = NULL;
+
+    magazine = BufferPool_MagazineAcquire(ModuleContext);
+    if (NULL == magazine)
+    {
+        goto Exit;
+    }
+
+    if (0 == magazine->NumberOfEntries)
+    {
+        // Refill the cache from the Module's list.
+        //
+        refillCount = ModuleContext->MagazineDepth / 2;
+
+        DMF_ModuleLock(DmfModule);
+
+        while (magazine->NumberOfEntries < refillCount)
+        {
+            bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                        ModuleContext);
+            if (NULL == bufferPoolEntry)
+            {
+                break;
+            }
+
+#if defined(DEBUG)
+            // Remember this for validation purposes. (Buffer is owned by this Module.)
+            //
+            bufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+#endif // defined(DEBUG)
+            magazine->Entries[magazine->NumberOfEntries] = bufferPoolEntry;
+            magazine->NumberOfEntries++;
+            InterlockedIncrement(&ModuleContext->NumberOfBuffersInMagazines);
+        }
+
+        DMF_ModuleUnlock(DmfModule);
+
+        bufferPoolEntry = NULL;
+    }
+
+    if (magazine->NumberOfEntries > 0)
+    {
+        magazine->NumberOfEntries--;
+        bufferPoolEntry = (BUFFERPOOL_ENTRY*)magazine->Entries[magazine->NumberOfEntries];
+        magazine->Entries[magazine->NumberOfEntries] = NULL;
+        InterlockedDecrement(&ModuleContext->NumberOfBuffersInMagazines);
+
+        DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+        DmfAssert(NULL == bufferPoolEntry->CurrentlyInsertedList);
+#if defined(DEBUG)
+        bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+#endif // defined(DEBUG)
+    }
+
+    BufferPool_MagazineRelease(magazine);
+
+Exit:
+
+    return bufferPoolEntry;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+BOOLEAN
+BufferPool_MagazineEntryPut(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Add a buffer to the current processor's cache. If the cache is full, half of it is
+    returned to the Module's list using a single lock acquisition.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    BufferPoolEntry - The given buffer.
+
+Return Value:
+
+    TRUE if the buffer was added to the cache.
+    FALSE if the cache is in use so the caller must add the buffer to the Module's list.
+
+--*/
+{
+    BUFFERPOOL_MAGAZINE* magazine;
+    BUFFERPOOL_ENTRY* bufferPoolEntryToSpill;
+    BOOLEAN returnValue;
+
+    // Verify that this buffer is not in any other list. Inserting the buffer into
+    // more than one list is a fatal error.
+    //
+    DmfAssert(BufferPoolEntry->ListEntry.Blink == NULL);
+    DmfAssert(BufferPoolEntry->ListEntry.Flink == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedList == NULL);
+    DmfAssert(BufferPoolEntry->CurrentlyInsertedDmfModule == NULL);
+
+    returnValue = FALSE;
+
+    magazine = BufferPool_MagazineAcquire(ModuleContext);
+    if (NULL == magazine)
+    {
+        goto Exit;
+    }
+
+    if (magazine->NumberOfEntries == ModuleContext->MagazineDepth)
+    {
+        // Return half of the cache to the Module's list.
+        //
+        DMF_ModuleLock(DmfModule);
+
+        while (magazine->NumberOfEntries > ModuleContext->MagazineDepth / 2)
+        {
+            magazine->NumberOfEntries--;
+            bufferPoolEntryToSpill = (BUFFERPOOL_ENTRY*)magazine->Entries[magazine->NumberOfEntries];
+            magazine->Entries[magazine->NumberOfEntries] = NULL;
+            InterlockedDecrement(&ModuleContext->NumberOfBuffersInMagazines);
+
+            DmfAssert(bufferPoolEntryToSpill->CurrentlyInsertedDmfModule == DmfModule);
+#if defined(DEBUG)
+            bufferPoolEntryToSpill->CurrentlyInsertedDmfModule = NULL;
+#endif // defined(DEBUG)
+
+            // This function deletes the buffer if it was allocated from the lookaside list.
+            //
+            BufferPool_BufferPoolEntryPut(DmfModule,
+                                          bufferPoolEntryToSpill);
+        }
+
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    DmfAssert(magazine->NumberOfEntries < ModuleContext->MagazineDepth);
+
+#if defined(DEBUG)
+    // Remember this for validation purposes. (Buffer is owned by this Module.)
+    //
+    BufferPoolEntry->CurrentlyInsertedDmfModule = DmfModule;
+#endif // defined(DEBUG)
+    magazine->Entries[magazine->NumberOfEntries] = BufferPoolEntry;
+    magazine->NumberOfEntries++;
+    InterlockedIncrement(&ModuleContext->NumberOfBuffersInMagazines);
+
+    BufferPool_MagazineRelease(magazine);
+
+    returnValue = TRUE;
+
+Exit:
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+BufferPool_MagazinesFlush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Move all the buffers in all the per-processor caches to the Module's list.
+    NOTE: This function is called when the Module closes so no other thread uses the caches.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_MAGAZINE* magazine;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG magazineIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (NULL == moduleContext->Magazines)
+    {
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    for (magazineIndex = 0; magazineIndex < moduleContext->NumberOfMagazines; magazineIndex++)
+    {
+        magazine = &moduleContext->Magazines[magazineIndex];
+        DmfAssert(! magazine->InUse);
+        while (magazine->NumberOfEntries > 0)
+        {
+            magazine->NumberOfEntries--;
+            bufferPoolEntry = (BUFFERPOOL_ENTRY*)magazine->Entries[magazine->NumberOfEntries];
+            magazine->Entries[magazine->NumberOfEntries] = NULL;
+            InterlockedDecrement(&moduleContext->NumberOfBuffersInMagazines);
+
+            DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
+#if defined(DEBUG)
+            bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+#endif // defined(DEBUG)
+
+            // This function deletes the buffer if it was allocated from the lookaside list.
+            //
+            BufferPool_BufferPoolEntryPut(DmfModule,
+                                          bufferPoolEntry);
+        }
+    }
+
+    DmfAssert(0 == moduleContext->NumberOfBuffersInMagazines);
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_TimerWheelExpiredCollect(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_BufferPool* ModuleContext,
+    _In_ ULONGLONG CurrentTick,
+    _Inout_ LIST_ENTRY* ExpiredList
+    )
+/*++
+
+Routine Description:
+
+    Advance the timer wheel up to and including the given tick. Buffers whose timer
+    has expired are removed from the wheel and from the list and are added to the
+    given list (using their TimerListEntry).
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    CurrentTick - The current tick.
+    ExpiredList - List where expired buffers are added.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERPOOL_TIMER_WHEEL* timerWheel;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    LIST_ENTRY* listEntry;
+    ULONG level;
+    ULONG slotIndex;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    timerWheel = ModuleContext->TimerWheel;
+
+    while (timerWheel->CurrentTick <= CurrentTick)
+    {
+        if (0 == timerWheel->NumberOfEntries)
+        {
+            // Nothing else can expire. Skip the remaining ticks.
+            //
+            timerWheel->CurrentTick = CurrentTick + 1;
+            break;
+        }
+
+        slotIndex = (ULONG)(timerWheel->CurrentTick & BufferPool_TimerWheelSlotMask);
+        if (0 == slotIndex)
+        {
+            // Level 0 has wrapped. Move buffers from higher levels that expire in the
+            // next range of ticks down.
+            //
+            for (level = 1; level < BufferPool_TimerWheelLevels; level++)
+            {
+                if (BufferPool_TimerWheelCascade(timerWheel,
+                                                 level) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        // All the buffers in this slot expire now.
+        //
+        while (! IsListEmpty(&timerWheel->Slots[0][slotIndex]))
+        {
+            listEntry = RemoveHeadList(&timerWheel->Slots[0][slotIndex]);
+            bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                                BUFFERPOOL_ENTRY_COLD,
+                                                TimerListEntry)->BufferPoolEntry;
+            DmfAssert(timerWheel->NumberOfEntries > 0);
+            timerWheel->NumberOfEntries--;
+            DmfAssert(bufferPoolEntry->Cold->TimerExpirationTick <= timerWheel->CurrentTick);
+            DmfAssert(bufferPoolEntry->Cold->TimerExpirationCallback != NULL);
+
+            // Remove item from list.
+            // NOTE: Client Driver owns buffer once its callback is called.
+            //
+            BufferPool_RemoveEntryList(DmfModule,
+                                       ModuleContext,
+                                       bufferPoolEntry);
+            ModuleContext->NumberOfTimerExpirations++;
+
+            InsertTailList(ExpiredList,
+                           &bufferPoolEntry->Cold->TimerListEntry);
+        }
+
+        timerWheel->CurrentTick++;
+    }
+}
+
+EVT_WDF_TIMER BufferPool_TimerWheelTimerHandler;
+
+_Function_class_(EVT_WDF_TIMER)
+_IRQL_requires_same_
+VOID
+BufferPool_TimerWheelTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Timer callback. All the buffers whose timer has expired are removed from the list
+    under a single lock acquisition. Then, each buffer is passed to its Client's timer
+    expiration callback. Upon timer expiration callback, Client owns the buffer. 
+
+Parameters:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    BUFFERPOOL_ENTRY_COLD* bufferPoolEntryCold;
+    EVT_DMF_BufferPool_TimerCallback* timerExpirationCallback;
+    VOID* timerExpirationCallbackContext;
+    LIST_ENTRY expiredList;
+    LIST_ENTRY* listEntry;
+    ULONGLONG currentTick;
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    DmfAssert(dmfModule != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    DmfAssert(moduleContext->TimerWheel != NULL);
+
+    InitializeListHead(&expiredList);
+
+    DMF_ModuleLock(dmfModule);
+
+    moduleContext->TimerWheel->TimerIsArmed = FALSE;
+
+    currentTick = BufferPool_CurrentTime100nsGet() / BufferPool_TimerWheelTick100ns;
+    BufferPool_TimerWheelExpiredCollect(dmfModule,
+                                        moduleContext,
+                                        currentTick,
+                                        &expiredList);
+
+    // Set the timer for the buffers that remain.
+    //
+    BufferPool_TimerWheelArm(dmfModule,
+                             moduleContext);
+
+    DMF_ModuleUnlock(dmfModule);
+
+    while (! IsListEmpty(&expiredList))
+    {
+        listEntry = RemoveHeadList(&expiredList);
+        bufferPoolEntryCold = CONTAINING_RECORD(listEntry,
+                                                BUFFERPOOL_ENTRY_COLD,
+                                                TimerListEntry);
+        bufferPoolEntry = bufferPoolEntryCold->BufferPoolEntry;
+
+        // The buffer is no longer in the list nor in the timer wheel so only this
+        // thread accesses it. Clear the timer fields before the Client owns the buffer.
+        //
+        timerExpirationCallback = bufferPoolEntryCold->TimerExpirationCallback;
+        timerExpirationCallbackContext = bufferPoolEntryCold->TimerExpirationCallbackContext;
+        bufferPoolEntryCold->TimerListEntry.Flink = NULL;
+        bufferPoolEntryCold->TimerListEntry.Blink = NULL;
+        bufferPoolEntryCold->TimerExpirationTick = 0;
+        bufferPoolEntryCold->TimerExpirationMilliseconds = 0;
+        bufferPoolEntryCold->TimerExpirationAbsoluteTime100ns = 0;
+        bufferPoolEntryCold->TimerExpirationCallback = NULL;
+        bufferPoolEntryCold->TimerExpirationCallbackContext = NULL;
+
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "BufferPool Entry timer expires");
+
+        // Call the client driver's timer callback function.
+        //
+        timerExpirationCallback(dmfModule,
+                                bufferPoolEntry->ClientBuffer,
+                                bufferPoolEntry->ClientBufferContext,
+                                timerExpirationCallbackContext);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_BufferPoolEntryInitialize(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _In_opt_ WDFMEMORY BufferPoolEntryMemory
+    )
+/*++
+
+Routine Description:
+
+    Populates the meta-data of a new Client Buffer BUFFERPOOL_ENTRY. The Client Buffer,
+    sentinels and Client Buffer Context are located immediately after the BUFFERPOOL_ENTRY.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferPoolEntry - The new BUFFERPOOL_ENTRY.
+    BufferPoolEntryMemory - WDF Memory object that contains BufferPoolEntry or NULL if
+                            BufferPoolEntry is located in this Module's slab.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    BUFFERPOOL_ENTRY_COLD* bufferPoolEntryCold;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    BufferPoolEntry->Signature = BufferPool_Signature;
+    BufferPoolEntry->CreatedByDmfModule = DmfModule;
+#if defined(DEBUG)
+    BufferPoolEntry->CurrentlyInsertedList = NULL;
+    BufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
+    BufferPoolEntry->SizeOfBufferPoolEntry = sizeof(BUFFERPOOL_ENTRY);
+#endif // defined(DEBUG)
+    BufferPoolEntry->BufferPoolEntryMemory = BufferPoolEntryMemory;
+    BufferPoolEntry->SizeOfClientBuffer = moduleConfig->Mode.SourceSettings.BufferSize;
+    BufferPoolEntry->BufferContextSize = moduleConfig->Mode.SourceSettings.BufferContextSize;
+    // The client buffer is located immediately after the buffer list entry.
+    //
+    BufferPoolEntry->ClientBuffer = (VOID*)(BufferPoolEntry + 1);
+    // For validation purposes to check for buffer overrun.
+    //
+    *BufferPool_SentinelDataGet(BufferPoolEntry) = BufferPool_SentinelData;
+    // The client buffer context is located immediately after the buffer sentinel data.
+    //
+    BufferPoolEntry->ClientBufferContext = (UCHAR*)BufferPool_SentinelDataGet(BufferPoolEntry) + BufferPool_SentinelSize;
+    // For validation purposes to check for buffer context overrun.
+    //
+    *BufferPool_SentinelContextGet(BufferPoolEntry) = BufferPool_SentinelContext;
+    // Timer related.
+    // NOTE: Buffers do not have their own timer. Sink Modules use a single timer wheel
+    //       for all the buffers put using DMF_BufferPool_PutInSinkWithTimer.
+    //
+    if (moduleContext->EntryColdOffset > 0)
+    {
+        bufferPoolEntryCold = (BUFFERPOOL_ENTRY_COLD*)((UCHAR*)BufferPoolEntry + moduleContext->EntryColdOffset);
+        bufferPoolEntryCold->BufferPoolEntry = BufferPoolEntry;
+        bufferPoolEntryCold->TimerListEntry.Blink = NULL;
+        bufferPoolEntryCold->TimerListEntry.Flink = NULL;
+        bufferPoolEntryCold->TimerExpirationTick = 0;
+        bufferPoolEntryCold->TimerExpirationMilliseconds = 0;
+        bufferPoolEntryCold->TimerExpirationAbsoluteTime100ns = 0;
+        bufferPoolEntryCold->TimerExpirationCallback = NULL;
+        bufferPoolEntryCold->TimerExpirationCallbackContext = NULL;
+        BufferPoolEntry->Cold = bufferPoolEntryCold;
+    }
+    else
+    {
+        BufferPoolEntry->Cold = NULL;
+    }
+    // List related.
+    //
+    BufferPoolEntry->ListEntry.Blink = NULL;
+    BufferPoolEntry->ListEntry.Flink = NULL;
+
+    // Initialize the client buffer context to all zeros.
+    //
+    RtlZeroMemory(BufferPoolEntry->ClientBufferContext,
+                  BufferPoolEntry->BufferContextSize);
+
+    // The Client Memory Handle is created by the caller (or on demand for buffers in the slab).
+    //
+    BufferPoolEntry->ClientBufferMemory = NULL;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferPool_MemoryDescriptorGet(
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _Out_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor
+    )
+/*++
+
+Routine Description:
+
+    Initializes the WDF Memory Descriptor of the given buffer. The descriptor is not stored
+    in BUFFERPOOL_ENTRY because it is rarely used.
+    Buffers in the slab use a buffer based Memory Descriptor so that no WDF object
+    is needed per buffer.
+
+Arguments:
+
+    BufferPoolEntry - The given buffer.
+    MemoryDescriptor - The WDF Memory Descriptor of the given buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (BufferPoolEntry->BufferPoolEntryMemory != NULL)
+    {
+        DmfAssert(BufferPoolEntry->ClientBufferMemory != NULL);
+        WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(MemoryDescriptor,
+                                          BufferPoolEntry->ClientBufferMemory,
+                                          NULL);
+    }
+    else
+    {
+        WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(MemoryDescriptor,
+                                          BufferPoolEntry->ClientBuffer,
+                                          BufferPoolEntry->SizeOfClientBuffer);
+    }
+}
+
+#if defined(DMF_USER_MODE)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+#else
+_IRQL_requires_max_(DISPATCH_LEVEL)
+#endif // defined(DMF_USER_MODE)
+_Must_inspect_result_
+NTSTATUS
+BufferPool_BufferPoolEntryCreate(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BUFFERPOOL_ENTRY** BufferPoolEntry
+    )
+/*++
+
+Routine Description:
+
+    Creates a new Client Buffer BUFFERPOOL_ENTRY. The new entry is not added to any list.
+    NOTE: This function does not require the Module lock so that the allocation from the
+          lookaside list can be done without holding the lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferPoolEntry - The newly created BUFFERPOOL_ENTRY.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    *BufferPoolEntry = NULL;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Allocate space for the list entry that holds the meta data for the buffer.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = DMF_Portable_LookasideListCreateMemory(&moduleContext->LookasideList,
+                                                      &memory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreateFromLookaside ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    bufferPoolEntry = (BUFFERPOOL_ENTRY*)WdfMemoryGetBuffer(memory,
+                                                            NULL);
+    BufferPool_BufferPoolEntryInitialize(DmfModule,
+                                         bufferPoolEntry,
+                                         memory);
+
+    // Create the Client Memory Handle.
+    // Some functions use Memory Descriptors and Offsets. Others use Memory Handles.
+    // -----------------------------------------------------------------------------
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
+
+    // Prevent SAL "parameter must not be zero" error.
+    //
+    #pragma warning(suppress:28160)
+    ntStatus = WdfMemoryCreatePreallocated(&objectAttributes,
+                                           bufferPoolEntry->ClientBuffer,
+                                           bufferPoolEntry->SizeOfClientBuffer,
+                                           &bufferPoolEntry->ClientBufferMemory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated ntStatus=%!STATUS!", ntStatus);
+        WdfObjectDelete(memory);
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Buffer: BufferPoolMemory=0x%p SizeOfClientBuffer=%d ClientBufferMemory=0x%p", bufferPoolEntry->BufferPoolEntryMemory, bufferPoolEntry->SizeOfClientBuffer, bufferPoolEntry->ClientBufferMemory);
+
+    *BufferPoolEntry = bufferPoolEntry;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+#if defined(DMF_USER_MODE)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+#else
+_IRQL_requires_max_(DISPATCH_LEVEL)
+#endif // defined(DMF_USER_MODE)
+_Must_inspect_result_
+NTSTATUS
+BufferPool_BufferPoolEntryCreateAndAddToList(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Creates a new Client Buffer BUFFERPOOL_ENTRY and adds the Client Buffer to the
+    list of buffers.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = BufferPool_BufferPoolEntryCreate(DmfModule,
+                                                &bufferPoolEntry);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Add the buffer to the list. (This function validates that the buffer has
+    // not already been added to another list in DEBUG mode.)
+    // NOTE: This entry goes directly into the list. Do not call BufferPool_BufferPoolEntryPut because
+    //       that function will filter buffers put into the list and delete the entries when EnableLookAside is TRUE.
+    //
+    BufferPool_InsertTailList(DmfModule,
+                              moduleContext,
+                              bufferPoolEntry);
+
+Exit:
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) &&
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->MaximumRetainedBuffers)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferPool_SlabCreate(
+    _In_ DMFMODULE DmfModule,
+    _In_ size_t SizeOfEachAllocation
+    )
+/*++
+
+Routine Description:
+
+    Allocates all the preallocated buffers from a single contiguous allocation and adds
+    them to the list of buffers. Each buffer starts on a cache line boundary. No WDF object
+    is created for each buffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SizeOfEachAllocation - Size of the BUFFERPOOL_ENTRY, Client Buffer, Client Buffer
+                           Context and sentinels of each buffer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    UCHAR* slabBuffer;
+    size_t entryStride;
+    size_t sizeToAllocate;
+    ULONG bufferCount;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    bufferCount = moduleConfig->Mode.SourceSettings.BufferCount;
+    DmfAssert(bufferCount > 0);
+
+    // Each buffer starts on its own cache line so that buffers used by different
+    // processors do not share cache lines.
+    //
+    entryStride = BufferPool_CacheLineAlign(SizeOfEachAllocation);
+    if ((entryStride < SizeOfEachAllocation) ||
+        (bufferCount > (((size_t)-1) - BufferPool_CacheLineSize) / entryStride))
+    {
+        ntStatus = STATUS_INTEGER_OVERFLOW;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Slab size overflow: BufferCount=%d SizeOfEachAllocation=%Iu", bufferCount, SizeOfEachAllocation);
+        goto Exit;
+    }
+    // Allocate an extra cache line so that the first buffer can be aligned.
+    //
+    sizeToAllocate = (entryStride * bufferCount) + BufferPool_CacheLineSize;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               moduleConfig->Mode.SourceSettings.PoolType,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->SlabMemory,
+                               (VOID**)&slabBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->SlabMemory = NULL;
+        goto Exit;
+    }
+
+    moduleContext->Slab = (UCHAR*)BufferPool_CacheLineAlign((ULONG_PTR)slabBuffer);
+    moduleContext->SlabEntryStride = entryStride;
+
+    DMF_ModuleLock(DmfModule);
+    for (bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+    {
+        bufferPoolEntry = (BUFFERPOOL_ENTRY*)(moduleContext->Slab + (bufferIndex * entryStride));
+        BufferPool_BufferPoolEntryInitialize(DmfModule,
+                                             bufferPoolEntry,
+                                             NULL);
+        BufferPool_InsertTailList(DmfModule,
+                                  moduleContext,
+                                  bufferPoolEntry);
+    }
+    DMF_ModuleUnlock(DmfModule);
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Slab: SlabMemory=0x%p BufferCount=%d EntryStride=%Iu",
+                moduleContext->SlabMemory,
+                bufferCount,
+                entryStride);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferPool_ClientBufferMemoryGet(
+    _In_ BUFFERPOOL_ENTRY* BufferPoolEntry,
+    _Out_ WDFMEMORY* ClientBufferMemory
+    )
+/*++
+
+Routine Description:
+
+    Returns the WDF Memory Handle associated with a given Client Buffer. Buffers located
+    in a slab do not have a WDF Memory Handle until it is needed, so it is created here
+    the first time it is requested. It is kept for the lifetime of the slab.
+    NOTE: The Client owns the given buffer so no lock is needed.
+
+Arguments:
+
+    BufferPoolEntry - The BUFFERPOOL_ENTRY associated with the Client Buffer.
+    ClientBufferMemory - The WDF Memory Handle associated with the Client Buffer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContextCreator;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+
+    *ClientBufferMemory = NULL;
+
+    if (BufferPoolEntry->ClientBufferMemory != NULL)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // Only buffers in the slab are created without a WDF Memory Handle.
+    //
+    moduleContextCreator = DMF_CONTEXT_GET(BufferPoolEntry->CreatedByDmfModule);
+    DmfAssert(NULL == BufferPoolEntry->BufferPoolEntryMemory);
+    DmfAssert(moduleContextCreator->SlabMemory != NULL);
+    DmfAssert(((UCHAR*)BufferPoolEntry >= moduleContextCreator->Slab) &&
+              ((size_t)((UCHAR*)BufferPoolEntry - moduleContextCreator->Slab) % moduleContextCreator->SlabEntryStride == 0));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = moduleContextCreator->SlabMemory;
+
+    // Prevent SAL "parameter must not be zero" error.
+    //
+    #pragma warning(suppress:28160)
+    ntStatus = WdfMemoryCreatePreallocated(&objectAttributes,
+                                           BufferPoolEntry->ClientBuffer,
+                                           BufferPoolEntry->SizeOfClientBuffer,
+                                           &BufferPoolEntry->ClientBufferMemory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated ntStatus=%!STATUS!", ntStatus);
+        BufferPoolEntry->ClientBufferMemory = NULL;
+        goto Exit;
+    }
+
+Exit:
+
+    *ClientBufferMemory = BufferPoolEntry->ClientBufferMemory;
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+BUFFERPOOL_ENTRY*
+BufferPool_BufferPoolEntryGet(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove the next entry (head of list) if it is present. If it is not present,
+    and if the client instantiated the Module with EnableLookAside = TRUE, then a
+    new entry is created from the associated lookaside list add added to the list.
+    It is removed and returned to the client.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NULL means there is no buffer to remove from the list; otherwise, it is the
+    BUFFERPOOL_ENTRY removed from the list.
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntryLocal;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->MaximumRetainedBuffers)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    bufferPoolEntryLocal = BufferPool_FirstBufferPeek(DmfModule,
+                                                      moduleContext);
+    if (NULL == bufferPoolEntryLocal)
+    {
+        DmfAssert(moduleContext->NumberOfBuffersInList == 0);
+        // If the Client instantiated the Module with EnableLookAside = TRUE,
+        // then create a new buffer and add it to the list.
+        //
+        if (moduleContext->EnableLookAside)
+        {
+            NTSTATUS ntStatus;
+
+            ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+
+            // Track the number of additional buffers beside those initially allocated.
+            //
+            moduleContext->NumberOfAdditionalBuffersAllocated++;
+            moduleContext->NumberOfLookasideAllocations++;
+            if (moduleContext->NumberOfAdditionalBuffersAllocated > moduleContext->MaximumNumberOfAdditionalBuffersAllocated)
+            {
+                moduleContext->MaximumNumberOfAdditionalBuffersAllocated = moduleContext->NumberOfAdditionalBuffersAllocated;
+            }
+
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Additional Buffer NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+
+            DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+                      (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->MaximumRetainedBuffers)) ||
+                      (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+            // We just created and added a new buffer. Now get it from the list.
+            //
+            bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
+                                                             moduleContext);
+        }
+        else
+        {
+            // Return no buffer because there is no buffer in the list.
+            //
+            DmfAssert(NULL == bufferPoolEntryLocal);
+        }
+    }
+    else
+    {
+        bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
+                                                         moduleContext);
+    }
+
+Exit:
+
+    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
+              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->MaximumRetainedBuffers)) ||
+              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Remove Entry: BufferPoolEntry=0x%p", bufferPoolEntryLocal);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "bufferPoolEntryLocal=0x%p", bufferPoolEntryLocal);
+
+    return bufferPoolEntryLocal;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+VOID*
+BufferPool_BufferGet(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove the next entry (head of list) if it is present. If it is not present,
+    and if the Client instantiated the Module with EnableLookAside = TRUE, then a new entry
+    is created from the associated lookaside list add added to the list. It is
+    removed and returned to the client.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    The address of the Client Buffer retrieved from the list; otherwise NULL to indicate
+    that the list is empty.
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    VOID* returnValue;
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    returnValue = NULL;
+    bufferPoolEntry = NULL;
 
-    // Allocate space for the list entry that holds the meta data for the buffer.
+    // Try the current processor's cache first so that the Module lock is not acquired.
     //
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = DmfModule;
-    ntStatus = DMF_Portable_LookasideListCreateMemory(&moduleContext->LookasideList,
-                                                      &memory);
-    if (! NT_SUCCESS(ntStatus))
+    if (moduleContext->Magazines != NULL)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreateFromLookaside ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        bufferPoolEntry = BufferPool_MagazineEntryGet(DmfModule,
+                                                      moduleContext);
     }
 
-    // Populate the buffer meta-data.
-    //
-    bufferPoolEntry = (BUFFERPOOL_ENTRY*)WdfMemoryGetBuffer(memory,
-                                                            NULL);
-
-    bufferPoolEntry->Signature = BufferPool_Signature;
-    bufferPoolEntry->CreatedByDmfModule = DmfModule;
-    bufferPoolEntry->CurrentlyInsertedList = NULL;
-    bufferPoolEntry->CurrentlyInsertedDmfModule = NULL;
-    bufferPoolEntry->BufferPoolEntryMemory = memory;
-    bufferPoolEntry->SizeOfBufferPoolEntry = sizeof(BUFFERPOOL_ENTRY);
-    bufferPoolEntry->SizeOfClientBuffer = moduleConfig->Mode.SourceSettings.BufferSize;
-    bufferPoolEntry->BufferContextSize = moduleConfig->Mode.SourceSettings.BufferContextSize;
-    // The client buffer is located immediately after the buffer list entry.
-    //
-    bufferPoolEntry->ClientBuffer = (VOID*)(bufferPoolEntry + 1);
-    // For validation purposes to check for buffer overrun.
-    //
-    bufferPoolEntry->SentinelData = (BufferPool_SentinelType*)(((UCHAR*)bufferPoolEntry->ClientBuffer) + bufferPoolEntry->SizeOfClientBuffer);
-    *(bufferPoolEntry->SentinelData) = BufferPool_SentinelData;
-    // The client buffer context is located immediately after the buffer sentinel data.
-    //
-    bufferPoolEntry->ClientBufferContext = (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize;
-    // For validation purposes to check for buffer context overrun.
-    //
-    bufferPoolEntry->SentinelContext = (BufferPool_SentinelType*)(((UCHAR*)bufferPoolEntry->ClientBufferContext) + bufferPoolEntry->BufferContextSize);
-    *(bufferPoolEntry->SentinelContext) = BufferPool_SentinelContext;
-    // Timer related.
-    //
-    if (moduleConfig->Mode.SourceSettings.CreateWithTimer)
+    if (NULL == bufferPoolEntry)
     {
-        WDF_TIMER_CONFIG_INIT(&timerConfig,
-                              BufferPool_BufferPoolEntryTimerHandler);
-
-        WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
-        WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&timerAttributes,
-                                               BUFFERPOOL_TIMER_CONTEXT);
-        // NOTE: Make the memory associated with buffer list entry, the parent of the timer.
-        // The parent will remain relevant even if the list entry is moved from one collection to another.
-        //
-        timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
-        timerAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
-
-        // Create the timer the first time this API is used. This prevents many unnecessary timers
-        // from being created when timers are not used.
-        //
-        ntStatus = WdfTimerCreate(&timerConfig,
-                                  &timerAttributes,
-                                  &bufferPoolEntry->Timer);
-        if (!NT_SUCCESS(ntStatus))
+        bufferPoolEntry = BufferPool_BufferPoolEntryGet(DmfModule);
+        if (NULL == bufferPoolEntry)
         {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            BufferPool_StatisticsGetsAdd(moduleContext,
+                                         0,
+                                         1);
             goto Exit;
         }
-
-        // Save this BUFFERPOOL_ENTRY pointer in the Timer's context.
-        //
-        bufferPoolTimerContext = WdfObjectGet_BUFFERPOOL_TIMER_CONTEXT(bufferPoolEntry->Timer);
-        bufferPoolTimerContext->BufferPoolEntry = bufferPoolEntry;
-        bufferPoolTimerContext->DmfModuleInsertedList = DmfModule;
     }
-    else
+
+    BufferPool_StatisticsGetsAdd(moduleContext,
+                                 1,
+                                 0);
+    if (moduleContext->BufferPoolMode == BufferPool_Mode_Source)
     {
-        bufferPoolEntry->Timer = NULL;
+        BufferPool_CheckoutTimeStart(bufferPoolEntry);
     }
-    BufferPool_TimerFieldsClear(DmfModule,
-                                bufferPoolEntry);
-    // List related.
+
+    DmfAssert(bufferPoolEntry != NULL);
+    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
+                      bufferPoolEntry->Signature == BufferPool_Signature);
+    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch", 
+                      *BufferPool_SentinelDataGet(bufferPoolEntry) == BufferPool_SentinelData);
+    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch", 
+                      *BufferPool_SentinelContextGet(bufferPoolEntry) == BufferPool_SentinelContext);
+    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
+    DmfAssert(sizeof(BUFFERPOOL_ENTRY) == bufferPoolEntry->SizeOfBufferPoolEntry);
+
+    returnValue = bufferPoolEntry->ClientBuffer;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+
+    return returnValue;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferPool_MagazinesCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Allocate the per-processor caches. The caches are initially empty. They are filled
+    as buffers are retrieved from and returned to the Module.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    size_t sizeToAllocate;
+    UCHAR* magazinesBuffer;
+    VOID** entries;
+    ULONG magazineIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleConfig->BufferPoolMode == BufferPool_Mode_Source);
+
+    // The caches are used at DISPATCH_LEVEL and the Module lock is acquired while the cache
+    // is in use. Therefore, a passive level lock cannot be used.
     //
-    bufferPoolEntry->ListEntry.Blink = NULL;
-    bufferPoolEntry->ListEntry.Flink = NULL;
+    if (DMF_ModuleLockIsPassive(DmfModule))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
 
-    // Initialize the client buffer context to all zeros.
+#if !defined(DMF_USER_MODE)
+    moduleContext->NumberOfMagazines = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+#else
+    moduleContext->NumberOfMagazines = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#endif // !defined(DMF_USER_MODE)
+    DmfAssert(moduleContext->NumberOfMagazines > 0);
+
+    moduleContext->MagazineDepth = moduleConfig->Mode.SourceSettings.PerProcessorCacheDepth;
+    if (0 == moduleContext->MagazineDepth)
+    {
+        moduleContext->MagazineDepth = BufferPool_PerProcessorCacheDepthDefault;
+    }
+    // Refill and spill move half the depth at a time.
     //
-    RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
-                  bufferPoolEntry->BufferContextSize);
+    if (moduleContext->MagazineDepth < 2)
+    {
+        moduleContext->MagazineDepth = 2;
+    }
 
-    // Create the Client Memory Handle.
-    // Some functions use Memory Descriptors and Offsets. Others use Memory Handles.
-    // -----------------------------------------------------------------------------
+    // Allocate all the caches in a single allocation. The cache headers come first
+    // followed by the stacks of buffers.
     //
+    sizeToAllocate = (moduleContext->NumberOfMagazines * sizeof(BUFFERPOOL_MAGAZINE)) +
+                     (moduleContext->NumberOfMagazines * moduleContext->MagazineDepth * sizeof(VOID*));
+
     WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = bufferPoolEntry->BufferPoolEntryMemory;
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->MagazinesMemory,
+                               (VOID**)&magazinesBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->MagazinesMemory = NULL;
+        goto Exit;
+    }
 
-    // Prevent SAL "parameter must not be zero" error.
+    RtlZeroMemory(magazinesBuffer,
+                  sizeToAllocate);
+
+    entries = (VOID**)(magazinesBuffer + (moduleContext->NumberOfMagazines * sizeof(BUFFERPOOL_MAGAZINE)));
+    moduleContext->Magazines = (BUFFERPOOL_MAGAZINE*)magazinesBuffer;
+    for (magazineIndex = 0; magazineIndex < moduleContext->NumberOfMagazines; magazineIndex++)
+    {
+        moduleContext->Magazines[magazineIndex].Entries = &entries[magazineIndex * moduleContext->MagazineDepth];
+    }
+    moduleContext->NumberOfBuffersInMagazines = 0;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Per-processor caches: NumberOfMagazines=%d MagazineDepth=%d",
+                moduleContext->NumberOfMagazines,
+                moduleContext->MagazineDepth);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferPool_CountersCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Allocate the per-processor statistics counters. Each processor's counters are
+    located in their own cache line.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    size_t sizeToAllocate;
+    UCHAR* countersBuffer;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+#if !defined(DMF_USER_MODE)
+    moduleContext->NumberOfCounters = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+#else
+    moduleContext->NumberOfCounters = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#endif // !defined(DMF_USER_MODE)
+    DmfAssert(moduleContext->NumberOfCounters > 0);
+
+    // Allocate an extra cache line so that the first counters can be aligned.
     //
-    #pragma warning(suppress:28160)
-    ntStatus = WdfMemoryCreatePreallocated(&objectAttributes,
-                                           bufferPoolEntry->ClientBuffer,
-                                           bufferPoolEntry->SizeOfClientBuffer,
-                                           &bufferPoolEntry->ClientBufferMemory);
+    sizeToAllocate = (moduleContext->NumberOfCounters * sizeof(BUFFERPOOL_COUNTERS)) + BufferPool_CacheLineSize;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->CountersMemory,
+                               (VOID**)&countersBuffer);
     if (! NT_SUCCESS(ntStatus))
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreatePreallocated ntStatus=%!STATUS!", ntStatus);
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->CountersMemory = NULL;
+        moduleContext->NumberOfCounters = 0;
         goto Exit;
     }
 
-    WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(&bufferPoolEntry->MemoryDescriptor,
-                                      bufferPoolEntry->ClientBufferMemory,
-                                      NULL);
+    RtlZeroMemory(countersBuffer,
+                  sizeToAllocate);
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Buffer: BufferPoolMemory=0x%p SizeOfClientBuffer=%d ClientBufferMemory=0x%p", bufferPoolEntry->BufferPoolEntryMemory, bufferPoolEntry->SizeOfClientBuffer, bufferPoolEntry->ClientBufferMemory);
+    moduleContext->Counters = (BUFFERPOOL_COUNTERS*)BufferPool_CacheLineAlign((ULONG_PTR)countersBuffer);
 
-    // Add the buffer to the list. (This function validates that the buffer has
-    // not already been added to another list in DEBUG mode.)
-    // NOTE: This entry goes directly into the list. Do not call BufferPool_BufferPoolEntryPut because
-    //       that function will filter buffers put into the list and delete the entries when EnableLookAside is TRUE.
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+EVT_WDF_TIMER BufferPool_TrimTimerHandler;
+
+_Function_class_(EVT_WDF_TIMER)
+_IRQL_requires_same_
+VOID
+BufferPool_TrimTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Periodic timer callback. Updates the estimate of the number of buffers the Client
+    uses at the same time and deletes retained buffers that exceed that estimate.
+    The buffers are removed from the list under a single lock acquisition and deleted
+    after the lock is released.
+
+Parameters:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    LIST_ENTRY trimList;
+    LIST_ENTRY* listEntry;
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersInUse;
+    ULONG numberOfBuffersToRetain;
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    DmfAssert(dmfModule != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    InitializeListHead(&trimList);
+
+    DMF_ModuleLock(dmfModule);
+
+    // The most buffers used at the same time since the last time this timer expired.
+    // NOTE: Buffers in the per-processor caches are counted as in use.
     //
-    BufferPool_InsertTailList(DmfModule,
-                              moduleContext,
-                              bufferPoolEntry);
+    numberOfBuffers = moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->NumberOfAdditionalBuffersAllocated;
+    DmfAssert(numberOfBuffers >= moduleContext->TrimIntervalLowWaterMark);
+    numberOfBuffersInUse = numberOfBuffers - moduleContext->TrimIntervalLowWaterMark;
 
-Exit:
+    // Rise immediately. Decay by half the difference each interval so that a short lull
+    // between bursts does not delete the buffers the next burst needs.
+    //
+    if (numberOfBuffersInUse >= moduleContext->DemandEstimate)
+    {
+        moduleContext->DemandEstimate = numberOfBuffersInUse;
+    }
+    else
+    {
+        moduleContext->DemandEstimate -= (moduleContext->DemandEstimate - numberOfBuffersInUse + 1) / 2;
+    }
 
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) &&
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+    numberOfBuffersToRetain = 0;
+    if (moduleContext->DemandEstimate > moduleContext->NumberOfBuffersSpecifiedByClient)
+    {
+        numberOfBuffersToRetain = moduleContext->DemandEstimate - moduleContext->NumberOfBuffersSpecifiedByClient;
+        if (numberOfBuffersToRetain > moduleContext->MaximumRetainedBuffers)
+        {
+            numberOfBuffersToRetain = moduleContext->MaximumRetainedBuffers;
+        }
+    }
+
+    // Remove the buffers that are not needed from the end of the list (the buffers least
+    // likely to be retrieved soon).
+    // NOTE: Buffers in the slab are never deleted.
+    //
+    listEntry = moduleContext->BufferList.Blink;
+    while ((moduleContext->NumberOfAdditionalBuffersAllocated > numberOfBuffersToRetain) &&
+           (listEntry != &moduleContext->BufferList))
+    {
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            ListEntry);
+        listEntry = listEntry->Blink;
+
+        if (NULL == bufferPoolEntry->BufferPoolEntryMemory)
+        {
+            continue;
+        }
+
+        BufferPool_RemoveEntryList(dmfModule,
+                                   moduleContext,
+                                   bufferPoolEntry);
+        moduleContext->NumberOfAdditionalBuffersAllocated--;
+
+        InsertTailList(&trimList,
+                       &bufferPoolEntry->ListEntry);
+    }
+
+    // Start the next interval.
+    //
+    moduleContext->TrimIntervalLowWaterMark = moduleContext->NumberOfBuffersInList;
+
+    DMF_ModuleUnlock(dmfModule);
+
+    while (! IsListEmpty(&trimList))
+    {
+        listEntry = RemoveHeadList(&trimList);
+        bufferPoolEntry = CONTAINING_RECORD(listEntry,
+                                            BUFFERPOOL_ENTRY,
+                                            ListEntry);
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Trim Retained Buffer BufferPoolEntryMemory=0x%p", bufferPoolEntry->BufferPoolEntryMemory);
 
-    return ntStatus;
+        // The buffer returns to the lookaside list.
+        //
+        WdfObjectDelete(bufferPoolEntry->BufferPoolEntryMemory);
+    }
+
+    FuncExitVoid(DMF_TRACE);
 }
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
-WDFMEMORY
-BufferPool_BufferPoolEntryGet(
-    _In_ DMFMODULE DmfModule,
-    _Out_ BUFFERPOOL_ENTRY** BufferPoolEntry
+static
+NTSTATUS
+BufferPool_TrimTimerCreate(
+    _In_ DMFMODULE DmfModule
     )
 /*++
 
 Routine Description:
 
-    Remove the next entry (head of list) if it is present. If it is not present,
-    and if the client instantiated the Module with EnableLookAside = TRUE, then a
-    new entry is created from the associated lookaside list add added to the list.
-    It is removed and returned to the client.
+    Create the low priority periodic timer that deletes retained buffers when demand falls.
+    The timer tolerates a delay of up to its period so that the system can coalesce it with
+    other timers.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    BufferPoolEntry - The associated BUFFERPOOL_ENTRY.
 
 Return Value:
 
-    NULL means there is no buffer to remove from the list; otherwise, it is the
-    WDF Memory of the entry removed from the list.
+    NTSTATUS
 
 --*/
 {
+    NTSTATUS ntStatus;
     DMF_CONTEXT_BufferPool* moduleContext;
-    WDFMEMORY returnValue;
-    BUFFERPOOL_ENTRY* bufferPoolEntryLocal;
+    DMF_CONFIG_BufferPool* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    ULONG trimIntervalMilliseconds;
+
+    PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DmfAssert(BufferPoolEntry != NULL);
-
-    DMF_ModuleLock(DmfModule);
-
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
-
-    bufferPoolEntryLocal = BufferPool_FirstBufferPeek(DmfModule,
-                                                      moduleContext);
-    if (NULL == bufferPoolEntryLocal)
+    trimIntervalMilliseconds = moduleConfig->Mode.SourceSettings.RetainedBuffersTrimIntervalMilliseconds;
+    if (0 == trimIntervalMilliseconds)
     {
-        DmfAssert(moduleContext->NumberOfBuffersInList == 0);
-        // If the Client instantiated the Module with EnableLookAside = TRUE,
-        // then create a new buffer and add it to the list.
-        //
-        if (moduleContext->EnableLookAside)
-        {
-            NTSTATUS ntStatus;
-
-            ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
-            if (! NT_SUCCESS(ntStatus))
-            {
-                goto Exit;
-            }
-
-            // Track the number of additional buffers beside those initially allocated.
-            //
-            moduleContext->NumberOfAdditionalBuffersAllocated++;
+        trimIntervalMilliseconds = BufferPool_TrimIntervalMillisecondsDefault;
+    }
 
-            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Additional Buffer NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+    WDF_TIMER_CONFIG_INIT_PERIODIC(&timerConfig,
+                                   BufferPool_TrimTimerHandler,
+                                   trimIntervalMilliseconds);
+    timerConfig.AutomaticSerialization = FALSE;
+    timerConfig.TolerableDelay = trimIntervalMilliseconds;
 
-            DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-                      (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-                      (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
 
-            // We just created and added a new buffer. Now get it from the list.
-            //
-            bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
-                                                             moduleContext);
-        }
-        else
-        {
-            // Return no buffer because there is no buffer in the list.
-            //
-            DmfAssert(NULL == bufferPoolEntryLocal);
-        }
-    }
-    else
+    ntStatus = WdfTimerCreate(&timerConfig,
+                              &objectAttributes,
+                              &moduleContext->TrimTimer);
+    if (! NT_SUCCESS(ntStatus))
     {
-        bufferPoolEntryLocal = BufferPool_RemoveHeadList(DmfModule,
-                                                         moduleContext);
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->TrimTimer = NULL;
+        goto Exit;
     }
 
-Exit:
-
-    *BufferPoolEntry = bufferPoolEntryLocal;
-    if (bufferPoolEntryLocal != NULL)
-    {
-        returnValue = bufferPoolEntryLocal->BufferPoolEntryMemory;
-    }
-    else
-    {
-        returnValue = NULL;
-    }
+    moduleContext->TrimIntervalLowWaterMark = moduleContext->NumberOfBuffersInList;
+    moduleContext->DemandEstimate = 0;
 
-    DmfAssert(((moduleContext->NumberOfBuffersSpecifiedByClient > 0) && 
-              (moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient)) ||
-              (0 == moduleContext->NumberOfBuffersSpecifiedByClient));
+    WdfTimerStart(moduleContext->TrimTimer,
+                  WDF_REL_TIMEOUT_IN_MS(trimIntervalMilliseconds));
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Remove Entry: MemoryHandle=0x%p", returnValue);
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Trim timer: MaximumRetainedBuffers=%d TrimIntervalMilliseconds=%d",
+                moduleContext->MaximumRetainedBuffers,
+                trimIntervalMilliseconds);
 
-    DMF_ModuleUnlock(DmfModule);
+Exit:
 
-    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
-    return returnValue;
+    return ntStatus;
 }
+#pragma code_seg()
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
-VOID*
-BufferPool_BufferGet(
+static
+NTSTATUS
+BufferPool_TimerWheelCreate(
     _In_ DMFMODULE DmfModule
     )
 /*++
 
 Routine Description:
 
-    Remove the next entry (head of list) if it is present. If it is not present,
-    and if the Client instantiated the Module with EnableLookAside = TRUE, then a new entry
-    is created from the associated lookaside list add added to the list. It is
-    removed and returned to the client.
+    Allocate the timer wheel and create the single timer that drives it.
 
 Arguments:
 
@@ -1015,45 +3025,79 @@ Arguments:
 
 Return Value:
 
-    The address of the Client Buffer retrieved from the list; otherwise NULL to indicate
-    that the list is empty.
+    NTSTATUS
 
 --*/
 {
-    WDFMEMORY bufferPoolEntryMemory;
-    BUFFERPOOL_ENTRY* bufferPoolEntry;
-    VOID* returnValue;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    BUFFERPOOL_TIMER_WHEEL* timerWheel;
+    ULONG level;
+    ULONG slotIndex;
+
+    PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
-    returnValue = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    bufferPoolEntryMemory = BufferPool_BufferPoolEntryGet(DmfModule,
-                                                          &bufferPoolEntry);
-    if (NULL == bufferPoolEntryMemory)
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(BUFFERPOOL_TIMER_WHEEL),
+                               &moduleContext->TimerWheelMemory,
+                               (VOID**)&timerWheel);
+    if (! NT_SUCCESS(ntStatus))
     {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->TimerWheelMemory = NULL;
         goto Exit;
     }
 
-    DmfAssert(bufferPoolEntry != NULL);
-    DmfVerifierAssert("DMF_BufferPool signature mismatch", 
-                      bufferPoolEntry->Signature == BufferPool_Signature);
-    DmfVerifierAssert("DMF_BufferPool data sentinel mismatch", 
-                      *(bufferPoolEntry->SentinelData) == BufferPool_SentinelData);
-    DmfVerifierAssert("DMF_BufferPool context sentinel mismatch", 
-                      *(bufferPoolEntry->SentinelContext) == BufferPool_SentinelContext);
-    DmfAssert(bufferPoolEntry->BufferPoolEntryMemory == bufferPoolEntryMemory);
-    DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
-    DmfAssert(sizeof(BUFFERPOOL_ENTRY) == bufferPoolEntry->SizeOfBufferPoolEntry);
+    RtlZeroMemory(timerWheel,
+                  sizeof(BUFFERPOOL_TIMER_WHEEL));
 
-    returnValue = bufferPoolEntry->ClientBuffer;
+    for (level = 0; level < BufferPool_TimerWheelLevels; level++)
+    {
+        for (slotIndex = 0; slotIndex < BufferPool_TimerWheelSlotsPerLevel; slotIndex++)
+        {
+            InitializeListHead(&timerWheel->Slots[level][slotIndex]);
+        }
+    }
+    timerWheel->CurrentTick = BufferPool_CurrentTime100nsGet() / BufferPool_TimerWheelTick100ns;
+
+    WDF_TIMER_CONFIG_INIT(&timerConfig,
+                          BufferPool_TimerWheelTimerHandler);
+    timerConfig.AutomaticSerialization = FALSE;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+    ntStatus = WdfTimerCreate(&timerConfig,
+                              &objectAttributes,
+                              &timerWheel->Timer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+        WdfObjectDelete(moduleContext->TimerWheelMemory);
+        moduleContext->TimerWheelMemory = NULL;
+        goto Exit;
+    }
+
+    moduleContext->TimerWheel = timerWheel;
 
 Exit:
 
-    FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
-    return returnValue;
+    return ntStatus;
 }
+#pragma code_seg()
 
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
@@ -1108,26 +3152,31 @@ Return Value:
     DmfAssert((moduleConfig->BufferPoolMode == BufferPool_Mode_Source) ||
               (moduleConfig->BufferPoolMode == BufferPool_Mode_Sink && moduleConfig->Mode.SourceSettings.BufferCount == 0));
     moduleContext->NumberOfBuffersSpecifiedByClient = moduleConfig->Mode.SourceSettings.BufferCount;
-
-#if defined(DMF_USER_MODE)
-    // It is not possible to use "PutWithTimer" Method when lookaside list is enabled in User-mode
-    // because buffers are deleted in the timer callback which causes the child WDFTIMER to also
-    // be deleted. That, in turn, can cause a deadlock and verifier issue.
+    // Buffers allocated from the lookaside list can only be retained when the lookaside list is used.
     //
-    if ((moduleConfig->Mode.SourceSettings.CreateWithTimer) &&
-        (moduleConfig->Mode.SourceSettings.EnableLookAside))
+    DmfAssert((0 == moduleConfig->Mode.SourceSettings.MaximumRetainedBuffers) ||
+              (moduleConfig->Mode.SourceSettings.EnableLookAside));
+    if (moduleConfig->Mode.SourceSettings.EnableLookAside)
     {
-        DmfAssert(FALSE);
-        ntStatus = STATUS_NOT_SUPPORTED;
-        goto Exit;
+        moduleContext->MaximumRetainedBuffers = moduleConfig->Mode.SourceSettings.MaximumRetainedBuffers;
+    }
+    else
+    {
+        moduleContext->MaximumRetainedBuffers = 0;
     }
-#endif
 
     // Create the list that holds all the buffers.
     //
     InitializeListHead(&moduleContext->BufferList);
     moduleContext->NumberOfBuffersInList = 0;
 
+    ntStatus = BufferPool_CountersCreate(DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_CountersCreate ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
     TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Create Buffer List: BufferCount=%d BufferSize=%d",
                 moduleConfig->Mode.SourceSettings.BufferCount,
                 moduleConfig->Mode.SourceSettings.BufferSize);
@@ -1140,6 +3189,24 @@ Return Value:
                                moduleConfig->Mode.SourceSettings.BufferContextSize +
                                BufferPool_SentinelSize +
                                BufferPool_SentinelSize;
+        if (moduleConfig->Mode.SourceSettings.CreateWithTimer)
+        {
+            // Timer fields are located after the Client Buffer Context. Buffers that are
+            // never put with a timer do not use the space.
+            //
+            sizeOfEachAllocation = (ULONG)BufferPool_AlignUp(sizeOfEachAllocation,
+                                                             sizeof(VOID*));
+            moduleContext->EntryColdOffset = sizeOfEachAllocation;
+            sizeOfEachAllocation += sizeof(BUFFERPOOL_ENTRY_COLD);
+        }
+        else
+        {
+            moduleContext->EntryColdOffset = 0;
+        }
+
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Buffer Allocation: SizeOfBufferPoolEntry=%d SizeOfEachAllocation=%d",
+                    (ULONG)sizeof(BUFFERPOOL_ENTRY),
+                    sizeOfEachAllocation);
 
         WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
         objectAttributes.ParentObject = DMF_ParentDeviceGet(DmfModule);
@@ -1161,30 +3228,78 @@ Return Value:
             goto Exit;
         }
 
-        DMF_ModuleLock(DmfModule);
-        for (bufferIndex = 0; bufferIndex < moduleConfig->Mode.SourceSettings.BufferCount; bufferIndex++)
+        if ((moduleConfig->Mode.SourceSettings.EnableSlabAllocation) &&
+            (moduleConfig->Mode.SourceSettings.BufferCount > 0))
         {
-            // This function cannot be in paged code because this call increases IRQL.
+            // All the preallocated buffers are in a single allocation.
+            // The lookaside list is still used for additional buffers.
             //
-            ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
-            if (! NT_SUCCESS(ntStatus))
+            ntStatus = BufferPool_SlabCreate(DmfModule,
+                                             sizeOfEachAllocation);
+            if (!NT_SUCCESS(ntStatus))
             {
-                break;
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_SlabCreate ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
             }
         }
-        DMF_ModuleUnlock(DmfModule);
+        else
+        {
+            DMF_ModuleLock(DmfModule);
+            for (bufferIndex = 0; bufferIndex < moduleConfig->Mode.SourceSettings.BufferCount; bufferIndex++)
+            {
+                // This function cannot be in paged code because this call increases IRQL.
+                //
+                ntStatus = BufferPool_BufferPoolEntryCreateAndAddToList(DmfModule);
+                if (! NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+            }
+            DMF_ModuleUnlock(DmfModule);
 
-        if (!NT_SUCCESS(ntStatus))
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_BufferPoolEntryCreateAndAddToList ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
+            }
+        }
+
+        // Water marks start from the number of preallocated buffers.
+        //
+        moduleContext->HighWaterMark = moduleContext->NumberOfBuffersInList;
+        moduleContext->LowWaterMark = moduleContext->NumberOfBuffersInList;
+
+        if (moduleContext->MaximumRetainedBuffers > 0)
         {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_BufferPoolEntryCreateAndAddToList ntStatus=%!STATUS!", ntStatus);
-            goto Exit;
+            ntStatus = BufferPool_TrimTimerCreate(DmfModule);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_TrimTimerCreate ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
+            }
+        }
+
+        if (moduleConfig->Mode.SourceSettings.EnablePerProcessorCache)
+        {
+            ntStatus = BufferPool_MagazinesCreate(DmfModule);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_MagazinesCreate ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
+            }
         }
     }
     else
     {
         // The list does not allocate any initial buffers.
+        // Create the timer wheel used by DMF_BufferPool_PutInSinkWithTimer.
         //
-        ntStatus = STATUS_SUCCESS;
+        ntStatus = BufferPool_TimerWheelCreate(DmfModule);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_TimerWheelCreate ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
     }
 
 Exit:
@@ -1219,7 +3334,6 @@ Return:
     BUFFERPOOL_ENTRY* bufferPoolEntryInList;
     DMF_CONTEXT_BufferPool* moduleContext;
     WDFMEMORY bufferPoolEntryMemory;
-    WDFTIMER timer;
     LIST_ENTRY* listEntry;
 
     FuncEntry(DMF_TRACE);
@@ -1232,7 +3346,7 @@ Return:
     //       (For example, a Consumer List is created with zero entries but may have had entries
     //       added to it.)
     //
-    DmfAssert((moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient) ||
+    DmfAssert((moduleContext->NumberOfBuffersInList <= moduleContext->NumberOfBuffersSpecifiedByClient + moduleContext->MaximumRetainedBuffers) ||
               (moduleContext->NumberOfBuffersSpecifiedByClient == 0));
 
     listEntry = moduleContext->BufferList.Flink;
@@ -1245,10 +3359,16 @@ Return:
                                                   ListEntry);
         bufferPoolEntryMemory = bufferPoolEntryInList->BufferPoolEntryMemory;
 
-        // Store timer in local variable so that we can wait for it after buffer
-        // is deleted outside of lock.
+        // Cancel the timer so that the timer callback is not called for this buffer.
         //
-        timer = bufferPoolEntryInList->Timer;
+        if (BufferPool_TimerIsSet(bufferPoolEntryInList))
+        {
+            BufferPool_TimerWheelRemove(DmfModule,
+                                        moduleContext,
+                                        bufferPoolEntryInList);
+            BufferPool_TimerFieldsClear(DmfModule,
+                                        bufferPoolEntryInList);
+        }
 
         // Remove from list but do not delete.
         //
@@ -1261,22 +3381,13 @@ Return:
         // List entry is now accessible only by this thread
         // Other threads accessing the collection will not find this list entry and hence will not access it.
 
-        if (timer != NULL)
+        // Buffers located in a slab are deleted when the slab is deleted.
+        //
+        if (bufferPoolEntryMemory != NULL)
         {
-            // Stop and wait for timer callback to execute.
-            // NOTE: Callback will first look in list and see that corresponding
-            //       buffer is removed so it will do nothing.
-            //
-            WdfTimerStop(timer,
-                         TRUE);
-
-            // Delete memory for entry.
-            //
-            WdfObjectDelete(timer);
-            timer = NULL;
+            WdfObjectDelete(bufferPoolEntryMemory);
+            bufferPoolEntryMemory = NULL;
         }
-        WdfObjectDelete(bufferPoolEntryMemory);
-        bufferPoolEntryMemory = NULL;
 
         DMF_ModuleLock(DmfModule);
 
@@ -1287,6 +3398,15 @@ Return:
 
     DMF_ModuleUnlock(DmfModule);
 
+    if (moduleContext->TimerWheel != NULL)
+    {
+        // Wait for the timer callback in case it is running. The wheel is empty so
+        // the callback does not set the timer again.
+        //
+        WdfTimerStop(moduleContext->TimerWheel->Timer,
+                     TRUE);
+    }
+
     // For debug purposes, make sure the list is empty.
     //
     DmfAssert(moduleContext->BufferList.Blink == &moduleContext->BufferList);
@@ -1326,8 +3446,57 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // Stop trimming before the list is destroyed. Wait for the timer callback to finish.
+    //
+    if (moduleContext->TrimTimer != NULL)
+    {
+        WdfTimerStop(moduleContext->TrimTimer,
+                     TRUE);
+        WdfObjectDelete(moduleContext->TrimTimer);
+        moduleContext->TrimTimer = NULL;
+    }
+
+    // Return buffers in the per-processor caches to the list so they are deleted with it.
+    //
+    BufferPool_MagazinesFlush(DmfModule);
+
     BufferPool_ListFlushAndDestroy(DmfModule);
 
+    // Delete the buffers in the slab. All of them must have been returned to the list.
+    //
+    if (moduleContext->SlabMemory != NULL)
+    {
+        WdfObjectDelete(moduleContext->SlabMemory);
+        moduleContext->SlabMemory = NULL;
+        moduleContext->Slab = NULL;
+        moduleContext->SlabEntryStride = 0;
+    }
+
+    if (moduleContext->TimerWheelMemory != NULL)
+    {
+        DmfAssert(0 == moduleContext->TimerWheel->NumberOfEntries);
+        WdfObjectDelete(moduleContext->TimerWheel->Timer);
+        WdfObjectDelete(moduleContext->TimerWheelMemory);
+        moduleContext->TimerWheelMemory = NULL;
+        moduleContext->TimerWheel = NULL;
+    }
+
+    if (moduleContext->MagazinesMemory != NULL)
+    {
+        WdfObjectDelete(moduleContext->MagazinesMemory);
+        moduleContext->MagazinesMemory = NULL;
+        moduleContext->Magazines = NULL;
+        moduleContext->NumberOfMagazines = 0;
+    }
+
+    if (moduleContext->CountersMemory != NULL)
+    {
+        moduleContext->Counters = NULL;
+        WdfObjectDelete(moduleContext->CountersMemory);
+        moduleContext->CountersMemory = NULL;
+        moduleContext->NumberOfCounters = 0;
+    }
+
     // Delete the look aside list.
     //
 #if !defined(DMF_USER_MODE)
@@ -1560,7 +3729,7 @@ Return Value:
     //
     DmfAssert(bufferPoolEntry->CreatedByDmfModule == DmfModule);
 
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize);
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
 
     DmfAssert(ClientBufferContext != NULL);
     *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
@@ -1605,6 +3774,10 @@ Return Value:
 
     DMF_ModuleUnlock(DmfModule);
 
+    // Buffers in the per-processor caches are also in the pool.
+    //
+    numberOfBuffersInList += (ULONG)moduleContext->NumberOfBuffersInMagazines;
+
     FuncExit(DMF_TRACE, "numberOfBuffersInList=%d", numberOfBuffersInList);
 
     return numberOfBuffersInList;
@@ -1644,9 +3817,6 @@ Return Value:
     BOOLEAN doneEnumerating;
     BufferPool_EnumerationDispositionType enumerationDisposition;
     LIST_ENTRY* listEntry;
-    BOOLEAN timerWasInQueue;
-    ULARGE_INTEGER currentSystemTime;
-    LONG64 differenceInTime100ns;
 
     FuncEntry(DMF_TRACE);
 
@@ -1659,7 +3829,6 @@ Return Value:
 
     DMF_ModuleLock(DmfModule);
 
-    differenceInTime100ns = 0;
     doneEnumerating = FALSE;
     if (ClientBuffer != NULL)
     {
@@ -1686,37 +3855,14 @@ Return Value:
                                             BUFFERPOOL_ENTRY,
                                             ListEntry);
 
-        // Prepare to read the next entry in list at top of loop.
-        //
-        listEntry = listEntry->Flink;
-
-        if (bufferPoolEntry->TimerExpirationCallback != NULL)
-        {
-            // Temporarily try to stop the timer to prevent future race conditions. 
-            //
-            if (! WdfTimerStop(bufferPoolEntry->Timer,
-                               FALSE))
-            {
-                // Timer callback will be called soon, so skip this buffer.
-                //
-                continue;
-            }
-#if defined(DMF_USER_MODE)
-            FILETIME fileTime;
-            GetSystemTimeAsFileTime(&fileTime);
-            currentSystemTime.QuadPart = (((ULONGLONG)fileTime.dwHighDateTime) << 32) + fileTime.dwLowDateTime;
-#else
-            KeQuerySystemTime((PLARGE_INTEGER)&currentSystemTime);
-#endif
-            if (currentSystemTime.QuadPart >= bufferPoolEntry->TimerExpirationAbsoluteTime100ns)
-            {
-                differenceInTime100ns = 0;
-            }
-            else
-            {
-                differenceInTime100ns = currentSystemTime.QuadPart - bufferPoolEntry->TimerExpirationAbsoluteTime100ns;
-            }
-        }
+        // Prepare to read the next entry in list at top of loop.
+        //
+        listEntry = listEntry->Flink;
+
+        // NOTE: Buffers whose timer has expired are removed from the list by the timer handler
+        //       under the Module lock. Therefore, the timer of this buffer cannot expire while
+        //       it is enumerated and it does not need to be stopped.
+        //
 
         DmfAssert(bufferPoolEntry->CurrentlyInsertedList != NULL);
         DmfAssert(bufferPoolEntry->CurrentlyInsertedDmfModule == DmfModule);
@@ -1742,13 +3888,8 @@ Return Value:
             case BufferPool_EnumerationDisposition_ContinueEnumeration:
             {
                 // Continue enumeration with next item.
+                // The timer (if any) continues to run.
                 //
-                if (bufferPoolEntry->TimerExpirationCallback != NULL)
-                {
-                    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                                    differenceInTime100ns);
-                    DmfAssert(! timerWasInQueue);
-                }
                 break;
             }
             case BufferPool_EnumerationDisposition_RemoveAndStopEnumeration:
@@ -1758,8 +3899,14 @@ Return Value:
                 doneEnumerating = TRUE;
                 DmfAssert(ClientBuffer != NULL);
 
-                // The timer has been stopped. Clear the associated fields.
+                // Stop the timer and clear the associated fields.
                 //
+                if (BufferPool_TimerIsSet(bufferPoolEntry))
+                {
+                    BufferPool_TimerWheelRemove(DmfModule,
+                                                moduleContext,
+                                                bufferPoolEntry);
+                }
                 BufferPool_TimerFieldsClear(DmfModule,
                                             bufferPoolEntry);
 
@@ -1777,7 +3924,7 @@ Return Value:
 
                 if (ClientBufferContext != NULL)
                 {
-                    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize);
+                    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
                     DmfAssert(ClientBufferContext != NULL);
                     *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
                 }
@@ -1791,8 +3938,14 @@ Return Value:
             }
             case BufferPool_EnumerationDisposition_StopTimerAndContinueEnumeration:
             {
-                // The timer was stopped. Clear the associated fields.
+                // Stop the timer and clear the associated fields.
                 //
+                if (BufferPool_TimerIsSet(bufferPoolEntry))
+                {
+                    BufferPool_TimerWheelRemove(DmfModule,
+                                                moduleContext,
+                                                bufferPoolEntry);
+                }
                 BufferPool_TimerFieldsClear(DmfModule,
                                             bufferPoolEntry);
                 break;
@@ -1805,13 +3958,19 @@ Return Value:
             }
             case BufferPool_EnumerationDisposition_ResetTimerAndContinueEnumeration:
             {
-                // Continue enumeration with next item.
+                // Restart the timer using its original timeout and continue enumeration
+                // with next item.
                 //
-                if (bufferPoolEntry->TimerExpirationCallback)
+                if (BufferPool_TimerIsSet(bufferPoolEntry))
                 {
-                    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                                    WDF_REL_TIMEOUT_IN_MS(bufferPoolEntry->TimerExpirationMilliseconds));
-                    DmfAssert(! timerWasInQueue);
+                    BufferPool_TimerWheelRemove(DmfModule,
+                                                moduleContext,
+                                                bufferPoolEntry);
+                    BufferPool_TimerExpirationSet(bufferPoolEntry,
+                                                  bufferPoolEntry->Cold->TimerExpirationMilliseconds);
+                    BufferPool_TimerWheelInsert(DmfModule,
+                                                moduleContext,
+                                                bufferPoolEntry);
                 }
                 break;
             }
@@ -1880,7 +4039,7 @@ Return Value:
     DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
     *ClientBuffer = bufferPoolEntry->ClientBuffer;
 
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize);
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
     if (ClientBufferContext != NULL)
     {
         if (bufferPoolEntry->BufferContextSize > 0)
@@ -1904,6 +4063,182 @@ Exit:
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetMany(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, *NumberOfBuffersRetrieved) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersRetrieved
+    )
+/*++
+
+Routine Description:
+
+    Removes up to NumberOfBuffersRequested buffers from the list (head of the list).
+    Then, returns the Client Buffers and their associated Client Buffer Contexts.
+    All the buffers that are in the list are removed using a single acquisition of the
+    Module lock. If the list does not contain enough buffers and the Client instantiated
+    the Module with EnableLookAside = TRUE, the remaining buffers are allocated from the
+    lookaside list without holding the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffersRequested - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+    NumberOfBuffersRetrieved - The number of buffers written to ClientBuffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG numberOfBuffersRetrieved;
+    ULONG numberOfBuffersCreated;
+    ULONG bufferIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+
+    DmfAssert(ClientBuffers != NULL);
+    DmfAssert(NumberOfBuffersRetrieved != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    numberOfBuffersRetrieved = 0;
+
+    // Try the current processor's cache first so that the Module lock is not acquired.
+    //
+    if (moduleContext->Magazines != NULL)
+    {
+        while (numberOfBuffersRetrieved < NumberOfBuffersRequested)
+        {
+            bufferPoolEntry = BufferPool_MagazineEntryGet(DmfModule,
+                                                          moduleContext);
+            if (NULL == bufferPoolEntry)
+            {
+                break;
+            }
+            ClientBuffers[numberOfBuffersRetrieved] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersRetrieved++;
+        }
+    }
+
+    // Remove as many buffers as possible from the list while holding the lock only once.
+    //
+    if (numberOfBuffersRetrieved < NumberOfBuffersRequested)
+    {
+        DMF_ModuleLock(DmfModule);
+
+        while (numberOfBuffersRetrieved < NumberOfBuffersRequested)
+        {
+            bufferPoolEntry = BufferPool_RemoveHeadList(DmfModule,
+                                                        moduleContext);
+            if (NULL == bufferPoolEntry)
+            {
+                DmfAssert(moduleContext->NumberOfBuffersInList == 0);
+                break;
+            }
+            ClientBuffers[numberOfBuffersRetrieved] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersRetrieved++;
+        }
+
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    // If the Client instantiated the Module with EnableLookAside = TRUE, create the
+    // remaining buffers. The allocations are done without holding the Module lock.
+    //
+    if ((numberOfBuffersRetrieved < NumberOfBuffersRequested) &&
+        (moduleContext->EnableLookAside))
+    {
+        numberOfBuffersCreated = 0;
+        while (numberOfBuffersRetrieved < NumberOfBuffersRequested)
+        {
+            ntStatus = BufferPool_BufferPoolEntryCreate(DmfModule,
+                                                        &bufferPoolEntry);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                break;
+            }
+            ClientBuffers[numberOfBuffersRetrieved] = bufferPoolEntry->ClientBuffer;
+            numberOfBuffersRetrieved++;
+            numberOfBuffersCreated++;
+        }
+
+        if (numberOfBuffersCreated > 0)
+        {
+            // Track the number of additional buffers beside those initially allocated.
+            //
+            DMF_ModuleLock(DmfModule);
+            moduleContext->NumberOfAdditionalBuffersAllocated += numberOfBuffersCreated;
+            moduleContext->NumberOfLookasideAllocations += numberOfBuffersCreated;
+            if (moduleContext->NumberOfAdditionalBuffersAllocated > moduleContext->MaximumNumberOfAdditionalBuffersAllocated)
+            {
+                moduleContext->MaximumNumberOfAdditionalBuffersAllocated = moduleContext->NumberOfAdditionalBuffersAllocated;
+            }
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Add Additional Buffers NumberOfAdditionalBuffersAllocated=%d", moduleContext->NumberOfAdditionalBuffersAllocated);
+            DMF_ModuleUnlock(DmfModule);
+        }
+    }
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffersRetrieved; bufferIndex++)
+    {
+        // This call validates the signature and sentinels of each buffer.
+        //
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        DmfAssert(sizeof(BUFFERPOOL_ENTRY) == bufferPoolEntry->SizeOfBufferPoolEntry);
+
+        if (moduleContext->BufferPoolMode == BufferPool_Mode_Source)
+        {
+            BufferPool_CheckoutTimeStart(bufferPoolEntry);
+        }
+
+        if (ClientBufferContexts != NULL)
+        {
+            DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
+            if (bufferPoolEntry->BufferContextSize > 0)
+            {
+                ClientBufferContexts[bufferIndex] = bufferPoolEntry->ClientBufferContext;
+            }
+            else
+            {
+                ClientBufferContexts[bufferIndex] = NULL;
+            }
+        }
+    }
+
+    BufferPool_StatisticsGetsAdd(moduleContext,
+                                 numberOfBuffersRetrieved,
+                                 NumberOfBuffersRequested - numberOfBuffersRetrieved);
+
+    *NumberOfBuffersRetrieved = numberOfBuffersRetrieved;
+
+    if (numberOfBuffersRetrieved > 0)
+    {
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS! numberOfBuffersRetrieved=%d", ntStatus, numberOfBuffersRetrieved);
+
+    return ntStatus;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -1955,14 +4290,23 @@ Return Value:
     DmfAssert(bufferPoolEntry->ClientBuffer != NULL);
     *ClientBuffer = bufferPoolEntry->ClientBuffer;
 
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize);
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
     DmfAssert(ClientBufferContext != NULL);
     *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
 
     DmfAssert(ClientBufferMemory != NULL);
-    *ClientBufferMemory = bufferPoolEntry->ClientBufferMemory;
-
-    ntStatus = STATUS_SUCCESS;
+    ntStatus = BufferPool_ClientBufferMemoryGet(bufferPoolEntry,
+                                                ClientBufferMemory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // Return the buffer so that it is not leaked.
+        //
+        DMF_BufferPool_Put(DmfModule,
+                           clientBuffer);
+        *ClientBuffer = NULL;
+        *ClientBufferContext = NULL;
+        goto Exit;
+    }
 
 Exit:
 
@@ -2023,9 +4367,10 @@ Return Value:
     *ClientBuffer = bufferPoolEntry->ClientBuffer;
 
     DmfAssert(MemoryDescriptor != NULL);
-    *MemoryDescriptor = bufferPoolEntry->MemoryDescriptor;
+    BufferPool_MemoryDescriptorGet(bufferPoolEntry,
+                                   MemoryDescriptor);
 
-    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)(bufferPoolEntry->SentinelData) + BufferPool_SentinelSize);
+    DmfAssert(bufferPoolEntry->ClientBufferContext == (UCHAR*)BufferPool_SentinelDataGet(bufferPoolEntry) + BufferPool_SentinelSize);
     DmfAssert(ClientBufferContext != NULL);
     *ClientBufferContext = bufferPoolEntry->ClientBufferContext;
 
@@ -2087,13 +4432,23 @@ Return Value:
 
     if (MemoryDescriptor != NULL)
     {
-        *MemoryDescriptor = bufferPoolEntry->MemoryDescriptor;
+        BufferPool_MemoryDescriptorGet(bufferPoolEntry,
+                                       MemoryDescriptor);
     }
 
     if (ClientBufferMemory != NULL)
     {
-        DmfAssert(bufferPoolEntry->ClientBufferMemory != NULL);
-        *ClientBufferMemory = bufferPoolEntry->ClientBufferMemory;
+        NTSTATUS ntStatus;
+
+        // The WDF Memory Handle of buffers in a slab is created on demand. If it cannot
+        // be created, NULL is returned.
+        //
+        ntStatus = BufferPool_ClientBufferMemoryGet(bufferPoolEntry,
+                                                    ClientBufferMemory);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "BufferPool_ClientBufferMemoryGet ntStatus=%!STATUS!", ntStatus);
+        }
     }
 
     if (ClientBufferSize != NULL)
@@ -2163,6 +4518,10 @@ Return Value:
     //
     if (moduleContext->BufferPoolMode == BufferPool_Mode_Source)
     {
+        BufferPool_StatisticsPutsAdd(moduleContext,
+                                     1,
+                                     BufferPool_CheckoutTimeGet(bufferPoolEntry));
+
         // Clear the Client Buffer.
         //
         RtlZeroMemory(ClientBuffer,
@@ -2176,10 +4535,33 @@ Return Value:
             RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
                           bufferPoolEntry->BufferContextSize);
         }
-        DmfAssert(NULL == bufferPoolEntry->TimerExpirationCallback);
-        DmfAssert(0 == bufferPoolEntry->TimerExpirationAbsoluteTime100ns);
-        DmfAssert(0 == bufferPoolEntry->TimerExpirationMilliseconds);
-        DmfAssert(NULL == bufferPoolEntry->TimerExpirationCallbackContext);
+        DmfAssert((NULL == bufferPoolEntry->Cold) ||
+                  ((NULL == bufferPoolEntry->Cold->TimerExpirationCallback) &&
+                   (0 == bufferPoolEntry->Cold->TimerExpirationAbsoluteTime100ns) &&
+                   (0 == bufferPoolEntry->Cold->TimerExpirationMilliseconds) &&
+                   (NULL == bufferPoolEntry->Cold->TimerExpirationCallbackContext)));
+
+        // Try the current processor's cache first so that the Module lock is not acquired.
+        // Buffers allocated from the lookaside list that are not retained are returned using
+        // the Module's list so they are deleted. (Buffers in the slab are never deleted.)
+        //
+        if ((moduleContext->Magazines != NULL) &&
+            ((moduleContext->NumberOfAdditionalBuffersAllocated <= moduleContext->MaximumRetainedBuffers) ||
+             (NULL == bufferPoolEntry->BufferPoolEntryMemory)))
+        {
+            if (BufferPool_MagazineEntryPut(DmfModule,
+                                            moduleContext,
+                                            bufferPoolEntry))
+            {
+                goto Exit;
+            }
+        }
+    }
+    else
+    {
+        BufferPool_StatisticsPutsAdd(moduleContext,
+                                     1,
+                                     0);
     }
 
     DMF_ModuleLock(DmfModule);
@@ -2189,6 +4571,96 @@ Return Value:
 
     DMF_ModuleUnlock(DmfModule);
 
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_PutMany(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    )
+/*++
+
+Routine Description:
+
+    Adds several Client Buffers to the list using a single acquisition of the Module lock.
+    The buffers are added in the order they appear in ClientBuffers.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffers - The buffers to add to the list.
+                    NOTE: Each must be a properly formed buffer that was created by this Module.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_ENTRY* bufferPoolEntry;
+    ULONG bufferIndex;
+    ULONGLONG checkoutTimeMicroseconds;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            BufferPool);
+
+    DmfAssert((ClientBuffers != NULL) || (0 == NumberOfBuffers));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    checkoutTimeMicroseconds = 0;
+
+    // In Source mode, clear out the buffers before inserting into buffer list.
+    // This is done before the lock is acquired so that the lock is held only for list operations.
+    //
+    if (moduleContext->BufferPoolMode == BufferPool_Mode_Source)
+    {
+        for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+            DmfAssert(bufferPoolEntry->CreatedByDmfModule == DmfModule);
+
+            checkoutTimeMicroseconds += BufferPool_CheckoutTimeGet(bufferPoolEntry);
+
+            RtlZeroMemory(bufferPoolEntry->ClientBuffer,
+                          bufferPoolEntry->SizeOfClientBuffer);
+            if (bufferPoolEntry->BufferContextSize > 0)
+            {
+                DmfAssert(bufferPoolEntry->ClientBufferContext != NULL);
+                RtlZeroMemory(bufferPoolEntry->ClientBufferContext,
+                              bufferPoolEntry->BufferContextSize);
+            }
+            DmfAssert(! BufferPool_TimerIsSet(bufferPoolEntry));
+        }
+    }
+
+    if (NumberOfBuffers > 0)
+    {
+        BufferPool_StatisticsPutsAdd(moduleContext,
+                                     NumberOfBuffers,
+                                     checkoutTimeMicroseconds);
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    for (bufferIndex = 0; bufferIndex < NumberOfBuffers; bufferIndex++)
+    {
+        bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffers[bufferIndex]);
+        BufferPool_BufferPoolEntryPut(DmfModule,
+                                      bufferPoolEntry);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -2225,13 +4697,8 @@ Return Value:
 
 --*/
 {
-    BOOLEAN timerWasInQueue;
     DMF_CONTEXT_BufferPool* moduleContext;
     BUFFERPOOL_ENTRY* bufferPoolEntry;
-#if defined(DMF_USER_MODE)
-    FILETIME fileTime;
-#endif
-    ULARGE_INTEGER currentSystemTime;
 
     FuncEntry(DMF_TRACE);
 
@@ -2243,67 +4710,127 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DmfAssert(moduleContext->BufferPoolMode == BufferPool_Mode_Sink);
-
-#if defined(DMF_USER_MODE)
-    // It is not possible to use this Method when buffers come from the "lookaside
-    // list" in User-mode because the buffers are just allocated and deallocated
-    // as needed. The problem is that in the timer callback the buffers are actually
-    // deleted and a child of the buffer is the corresponding WDFTIMER which is also
-    // deleted because it is a child object. The problem is that deleting the WDFTIMER
-    // from inside the timer callback can cause a deadlock and does cause a WDF
-    // verifier violation.
-    //
-    DMF_CONFIG_BufferPool* moduleConfig;
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
-    DmfAssert(!moduleConfig->Mode.SourceSettings.EnableLookAside);
-#endif
+    DmfAssert(moduleContext->TimerWheel != NULL);
 
     // Given the Client Buffer, get the associated meta data.
     // NOTE: Client Driver (caller) owns the buffer at this time.
     //
     bufferPoolEntry = BufferPool_BufferPoolEntryGetFromClientBuffer(ClientBuffer);
-    DmfAssert(bufferPoolEntry->Timer != NULL);
 
-    // NOTE: The timer is guaranteed to be not running,
-    //       since it was stop or expired when Client got the buffer.
+    BufferPool_StatisticsPutsAdd(moduleContext,
+                                 1,
+                                 0);
+
+    // NOTE: The buffer is guaranteed to not be in any timer wheel,
+    //       since it was removed or expired when Client got the buffer.
     //
 
     DMF_ModuleLock(DmfModule);
 
     // Set the timer parameters in buffer context.
+    // NOTE: Only buffers created by a Source Module that sets CreateWithTimer have timer fields.
     //
-    DmfAssert(bufferPoolEntry->TimerExpirationCallback == NULL);
+    DmfAssert(bufferPoolEntry->Cold != NULL);
+    DmfAssert(bufferPoolEntry->Cold->TimerExpirationCallback == NULL);
     DmfAssert(! moduleContext->BufferPoolEnumerating);
-    bufferPoolEntry->TimerExpirationCallback = TimerExpirationCallback;
-    bufferPoolEntry->TimerExpirationMilliseconds = TimerExpirationMilliseconds;
-#if defined(DMF_USER_MODE)
-    GetSystemTimeAsFileTime(&fileTime);
-    currentSystemTime.QuadPart = (((ULONGLONG)fileTime.dwHighDateTime) << 32) + fileTime.dwLowDateTime;
-#else
-    KeQuerySystemTime((PLARGE_INTEGER)&currentSystemTime);
-#endif
-    bufferPoolEntry->TimerExpirationAbsoluteTime100ns = currentSystemTime.QuadPart + WDF_ABS_TIMEOUT_IN_MS(TimerExpirationMilliseconds);
-    bufferPoolEntry->TimerExpirationCallbackContext = TimerExpirationCallbackContext;
-
-    // Save the DmfModule in the Timer's context so that the timer handler knows
-    // where to remove the buffer from.
-    //
-    BufferPool_BufferPoolTimerContextSet(bufferPoolEntry,
-                                         DmfModule);
+    bufferPoolEntry->Cold->TimerExpirationCallback = TimerExpirationCallback;
+    bufferPoolEntry->Cold->TimerExpirationCallbackContext = TimerExpirationCallbackContext;
+    BufferPool_TimerExpirationSet(bufferPoolEntry,
+                                  TimerExpirationMilliseconds);
 
     BufferPool_BufferPoolEntryPut(DmfModule,
                                   bufferPoolEntry);
 
-    // Start the timer. Timer is guaranteed to not have been in the timer queue nor running its callback function.
-    // This is because Client has no direct access to the timer. The timer was stopped when the buffer was 
-    // previously retrieved.
+    // Add the buffer to this Module's timer wheel. The timer wheel is driven by a single
+    // timer that is set as needed.
+    //
+    BufferPool_TimerWheelInsert(DmfModule,
+                                moduleContext,
+                                bufferPoolEntry);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BufferPool_Statistics* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Retrieves the runtime statistics of this Module. Clients use this information to
+    choose the number of buffers to preallocate.
+    NOTE: The counters are updated by other threads while they are read so the statistics
+          are a close approximation when the Module is in use.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Statistics - The statistics of this Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferPool* moduleContext;
+    BUFFERPOOL_COUNTERS* counters;
+    ULONG counterIndex;
+    ULONGLONG checkoutTimeMicroseconds;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferPool);
+
+    DmfAssert(Statistics != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    RtlZeroMemory(Statistics,
+                  sizeof(BufferPool_Statistics));
+    checkoutTimeMicroseconds = 0;
+
+    // Add the counters of all the processors. Interlocked operations are used so that
+    // each 64-bit counter is read atomically.
     //
-    timerWasInQueue = WdfTimerStart(bufferPoolEntry->Timer,
-                                    WDF_REL_TIMEOUT_IN_MS(TimerExpirationMilliseconds));
-    DmfAssert(! timerWasInQueue);
+    counters = moduleContext->Counters;
+    for (counterIndex = 0; counterIndex < moduleContext->NumberOfCounters; counterIndex++)
+    {
+        Statistics->NumberOfGets += (ULONGLONG)InterlockedAdd64(&counters[counterIndex].NumberOfGets,
+                                                                0);
+        Statistics->NumberOfPuts += (ULONGLONG)InterlockedAdd64(&counters[counterIndex].NumberOfPuts,
+                                                                0);
+        Statistics->NumberOfFailedGets += (ULONGLONG)InterlockedAdd64(&counters[counterIndex].NumberOfFailedGets,
+                                                                      0);
+        checkoutTimeMicroseconds += (ULONGLONG)InterlockedAdd64(&counters[counterIndex].CheckoutTimeMicroseconds,
+                                                                0);
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    Statistics->NumberOfLookasideAllocations = moduleContext->NumberOfLookasideAllocations;
+    Statistics->NumberOfTimerExpirations = moduleContext->NumberOfTimerExpirations;
+    Statistics->NumberOfAdditionalBuffersAllocated = moduleContext->NumberOfAdditionalBuffersAllocated;
+    Statistics->MaximumNumberOfAdditionalBuffersAllocated = moduleContext->MaximumNumberOfAdditionalBuffersAllocated;
+    Statistics->NumberOfBuffersInList = moduleContext->NumberOfBuffersInList;
+    Statistics->HighWaterMark = moduleContext->HighWaterMark;
+    Statistics->LowWaterMark = moduleContext->LowWaterMark;
 
     DMF_ModuleUnlock(DmfModule);
 
+    if ((moduleContext->BufferPoolMode == BufferPool_Mode_Source) &&
+        (Statistics->NumberOfPuts > 0))
+    {
+        Statistics->AverageCheckoutTimeMicroseconds = checkoutTimeMicroseconds / Statistics->NumberOfPuts;
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 
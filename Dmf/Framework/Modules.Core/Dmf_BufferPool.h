@@ -115,8 +115,65 @@ typedef struct
     // Note: Pool type can be passive if PassiveLevel in Module Attributes is set to TRUE.
     //
     POOL_TYPE PoolType;
+    // Indicates if a per-processor cache of buffers is used so that most Get/Put
+    // operations do not acquire the Module lock.
+    // Note: Not supported when PassiveLevel in Module Attributes is set to TRUE.
+    //
+    ULONG EnablePerProcessorCache;
+    // Maximum number of buffers held in each processor's cache.
+    // Zero means use the default depth.
+    //
+    ULONG PerProcessorCacheDepth;
+    // Indicates if all the preallocated buffers are placed in a single contiguous
+    // allocation (slab) instead of one allocation per buffer.
+    //
+    ULONG EnableSlabAllocation;
+    // Maximum number of buffers allocated from the lookaside list that are kept in the
+    // pool after they are returned. Only used when EnableLookAside is TRUE.
+    // Zero means buffers allocated from the lookaside list are deleted when they are returned.
+    //
+    ULONG MaximumRetainedBuffers;
+    // Interval at which retained buffers that are no longer needed are deleted.
+    // Zero means use the default interval.
+    //
+    ULONG RetainedBuffersTrimIntervalMilliseconds;
 } BufferPool_SourceSettings;
 
+// Runtime statistics of a DMF_BufferPool instance.
+//
+typedef struct
+{
+    // Number of buffers retrieved from the Module.
+    //
+    ULONGLONG NumberOfGets;
+    // Number of buffers added to the Module.
+    //
+    ULONGLONG NumberOfPuts;
+    // Number of buffers requested that could not be retrieved because no buffer was available.
+    //
+    ULONGLONG NumberOfFailedGets;
+    // Number of buffers allocated from the lookaside list because no buffer was available.
+    //
+    ULONGLONG NumberOfLookasideAllocations;
+    // Number of buffers removed from the Module because their timer expired.
+    //
+    ULONGLONG NumberOfTimerExpirations;
+    // Number of buffers allocated from the lookaside list that have not been deleted yet
+    // and the highest value it has reached.
+    //
+    ULONG NumberOfAdditionalBuffersAllocated;
+    ULONG MaximumNumberOfAdditionalBuffersAllocated;
+    // Number of buffers in the Module's list and the highest and lowest values it has reached.
+    //
+    ULONG NumberOfBuffersInList;
+    ULONG HighWaterMark;
+    ULONG LowWaterMark;
+    // Average time (in microseconds) that the Client owns a buffer retrieved from a
+    // Source Module before it returns the buffer.
+    //
+    ULONGLONG AverageCheckoutTimeMicroseconds;
+} BufferPool_Statistics;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -176,6 +233,17 @@ DMF_BufferPool_Get(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferPool_GetMany(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, *NumberOfBuffersRetrieved) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersRetrieved
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -215,6 +283,14 @@ DMF_BufferPool_Put(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_PutMany(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferPool_PutInSinkWithTimer(
@@ -225,5 +301,12 @@ DMF_BufferPool_PutInSinkWithTimer(
     _In_opt_ VOID* TimerExpirationCallbackContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferPool_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ BufferPool_Statistics* Statistics
+    );
+
 // eof: Dmf_BufferPool.h
 //
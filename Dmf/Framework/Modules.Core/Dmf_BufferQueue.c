@@ -34,39 +34,1229 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Link used to insert a buffer in the lock-free queue. It is located at the beginning of the
+// Client Buffer Context of each buffer in the producer pool. The Client's Client Buffer Context
+// follows it.
+//
+typedef struct _BUFFERQUEUE_NODE
+{
+    struct _BUFFERQUEUE_NODE* volatile Next;
+    VOID* ClientBuffer;
+} BUFFERQUEUE_NODE;
+
+// Size of the link including padding so that the Client's Client Buffer Context keeps
+// the alignment of the allocation.
+//
+#define BufferQueue_NodeSize                    ((ULONG)((sizeof(BUFFERQUEUE_NODE) + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~(MEMORY_ALLOCATION_ALIGNMENT - 1)))
+#define BufferQueue_NodeNextGet(Node)           ((BUFFERQUEUE_NODE*)ReadPointerAcquire((PVOID const volatile*)&(Node)->Next))
+#define BufferQueue_ClientBufferContextGet(Node) ((VOID*)((UCHAR*)(Node) + BufferQueue_NodeSize))
+
+// Number of buffers moved from the consumer list to the producer list at a time by Flush.
+//
+#define BufferQueue_FlushBatchSize              (16)
+
+// Retrieves a buffer without waiting (DMF_BufferQueue_Dequeue or DMF_BufferQueue_Fetch).
+//
+typedef
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+BufferQueue_BufferGetFunction(_In_ DMFMODULE DmfModule,
+                              _Out_ VOID** ClientBuffer,
+                              _Out_opt_ VOID** ClientBufferContext);
+
+// Consumer list of a single priority.
+//
+typedef struct
+{
+    // DMFMODULE to Consumer BufferPool of this lane.
+    // NULL when the lock-free queue is used.
+    //
+    DMFMODULE DmfModuleBufferPoolConsumer;
+    // Lock-free queue (multiple producers, single consumer).
+    // Producers insert at QueueHead using an interlocked exchange. The consumer removes
+    // at QueueTail. QueueStub is never given to the Client. It keeps the queue from
+    // becoming empty so that producers never access QueueTail.
+    //
+    BUFFERQUEUE_NODE* volatile QueueHead;
+    BUFFERQUEUE_NODE* QueueTail;
+    BUFFERQUEUE_NODE QueueStub;
+    // Buffers removed from the lock-free queue by DMF_BufferQueue_Enumerate that have not
+    // been dequeued. They are dequeued before the buffers in the lock-free queue.
+    // Only accessed by the consumer.
+    //
+    BUFFERQUEUE_NODE* PendingHead;
+    BUFFERQUEUE_NODE* PendingTail;
+    // Number of buffers in this lane. It is incremented before a buffer is added so that
+    // it never goes below zero.
+    //
+    LONG volatile NumberOfBuffers;
+    // Number of dequeues served by higher priority lanes while this lane had buffers.
+    //
+    LONG volatile NumberOfDequeuesSkipped;
+} BUFFERQUEUE_LANE;
+
+// Context passed to BufferQueue_EnumerationCallback.
+//
+typedef struct
+{
+    EVT_DMF_BufferPool_Enumeration* EntryEnumerationCallback;
+    VOID* ClientDriverCallbackContext;
+    BOOLEAN EnumerationStopped;
+} BUFFERQUEUE_ENUMERATION_CONTEXT;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
-typedef struct
+typedef struct
+{
+    // DMFMODULE to Producer BufferPool.
+    //
+    DMFMODULE DmfModuleBufferPoolProducer;
+    // Indicates that the consumer lists are lock-free queues.
+    //
+    BOOLEAN LockFreeQueue;
+    // Consumer lists. The lane with the highest index has the highest priority.
+    //
+    ULONG NumberOfLanes;
+    BUFFERQUEUE_LANE Lanes[BUFFERQUEUE_PRIORITY_LANES_MAXIMUM];
+    // Set when a buffer is added to the consumer list while a thread waits in
+    // DMF_BufferQueue_DequeueWait.
+    //
+    DMF_PORTABLE_EVENT DataAvailableEvent;
+    // Set when a buffer is added to the producer list while a thread waits in
+    // DMF_BufferQueue_FetchWait.
+    //
+    DMF_PORTABLE_EVENT BufferAvailableEvent;
+    // Number of threads waiting for each event. The events are only set when there are
+    // waiting threads so that Methods that do not wait never set them.
+    //
+    LONG volatile NumberOfDataWaiters;
+    LONG volatile NumberOfBufferWaiters;
+    // Set when the Module closes so that waiting threads return.
+    //
+    BOOLEAN volatile Closing;
+    // TRUE after EvtBufferQueueHighWatermark is called until EvtBufferQueueLowWatermark is called.
+    // Protected by the Module lock.
+    //
+    BOOLEAN HighWatermarkReached;
+    // TRUE while a thread calls the watermark callbacks. Protected by the Module lock.
+    //
+    BOOLEAN WatermarkNotifying;
+} DMF_CONTEXT_BufferQueue;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(BufferQueue)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(BufferQueue)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'oMQB'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BUFFERQUEUE_NODE*
+BufferQueue_NodeGet(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _In_ VOID* ClientBuffer
+    )
+/*++
+
+Routine Description:
+
+    Get the lock-free queue link of a given Client Buffer.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    ClientBuffer - The given Client Buffer.
+
+Return Value:
+
+    The link located at the beginning of the Client Buffer's context.
+
+--*/
+{
+    BUFFERQUEUE_NODE* node;
+
+    DMF_BufferPool_ContextGet(ModuleContext->DmfModuleBufferPoolProducer,
+                              ClientBuffer,
+                              (VOID**)&node);
+    node->ClientBuffer = ClientBuffer;
+
+    return node;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_LockFreeInsert(
+    _Inout_ BUFFERQUEUE_LANE* Lane,
+    _In_ BUFFERQUEUE_NODE* FirstNode,
+    _In_ BUFFERQUEUE_NODE* LastNode
+    )
+/*++
+
+Routine Description:
+
+    Insert a chain of buffers that are already linked from FirstNode to LastNode at the head
+    of a lane's lock-free queue. Any number of threads may call this function at the same time.
+
+Arguments:
+
+    Lane - The lane.
+    FirstNode - The first buffer of the chain.
+    LastNode - The last buffer of the chain.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERQUEUE_NODE* previousNode;
+
+    LastNode->Next = NULL;
+
+    // Claim the position at the head of the queue. Then, link the previous head to the
+    // chain. The consumer does not go past previousNode until that link is written.
+    //
+    previousNode = (BUFFERQUEUE_NODE*)InterlockedExchangePointer((PVOID volatile*)&Lane->QueueHead,
+                                                                 LastNode);
+    InterlockedExchangePointer((PVOID volatile*)&previousNode->Next,
+                               FirstNode);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BUFFERQUEUE_NODE*
+BufferQueue_LockFreeRemove(
+    _Inout_ BUFFERQUEUE_LANE* Lane
+    )
+/*++
+
+Routine Description:
+
+    Remove the buffer at the tail of a lane's lock-free queue.
+    NOTE: Only a single thread may call this function at the same time.
+
+Arguments:
+
+    Lane - The lane.
+
+Return Value:
+
+    The link of the removed buffer or NULL if the queue is empty. NULL is also returned
+    if the next buffer is being inserted and is not linked yet.
+
+--*/
+{
+    BUFFERQUEUE_NODE* tailNode;
+    BUFFERQUEUE_NODE* nextNode;
+    BUFFERQUEUE_NODE* removedNode;
+
+    removedNode = NULL;
+
+    tailNode = Lane->QueueTail;
+    nextNode = BufferQueue_NodeNextGet(tailNode);
+
+    if (tailNode == &Lane->QueueStub)
+    {
+        if (NULL == nextNode)
+        {
+            // The queue is empty.
+            //
+            goto Exit;
+        }
+        // Skip the stub.
+        //
+        Lane->QueueTail = nextNode;
+        tailNode = nextNode;
+        nextNode = BufferQueue_NodeNextGet(nextNode);
+    }
+
+    if (NULL == nextNode)
+    {
+        if (tailNode != ReadPointerAcquire((PVOID const volatile*)&Lane->QueueHead))
+        {
+            // A producer has claimed the head but has not linked its buffer yet.
+            // Do not wait for it since it may be running on this processor.
+            //
+            goto Exit;
+        }
+
+        // tailNode is the last buffer. Insert the stub after it so that tailNode can be
+        // removed while producers insert after the stub.
+        //
+        BufferQueue_LockFreeInsert(Lane,
+                                   &Lane->QueueStub,
+                                   &Lane->QueueStub);
+
+        nextNode = BufferQueue_NodeNextGet(tailNode);
+        if (NULL == nextNode)
+        {
+            // A producer inserted a buffer after tailNode before the stub and has not
+            // linked it yet.
+            //
+            goto Exit;
+        }
+    }
+
+    Lane->QueueTail = nextNode;
+    removedNode = tailNode;
+
+Exit:
+
+    return removedNode;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BUFFERQUEUE_NODE*
+BufferQueue_LockFreeDequeue(
+    _Inout_ BUFFERQUEUE_LANE* Lane
+    )
+/*++
+
+Routine Description:
+
+    Remove the next buffer from a lane when the lock-free queue is used.
+    Buffers in the pending list are removed before buffers in the lock-free queue.
+    NOTE: Only a single thread may call this function at the same time.
+
+Arguments:
+
+    Lane - The lane.
+
+Return Value:
+
+    The link of the removed buffer or NULL if there is no buffer.
+
+--*/
+{
+    BUFFERQUEUE_NODE* node;
+
+    node = Lane->PendingHead;
+    if (node != NULL)
+    {
+        Lane->PendingHead = node->Next;
+        if (NULL == Lane->PendingHead)
+        {
+            Lane->PendingTail = NULL;
+        }
+    }
+    else
+    {
+        node = BufferQueue_LockFreeRemove(Lane);
+    }
+
+    return node;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+BufferQueue_LockFreeEnumerate(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _Inout_ BUFFERQUEUE_LANE* Lane,
+    _In_ EVT_DMF_BufferPool_Enumeration EntryEnumerationCallback,
+    _In_opt_ VOID* ClientDriverCallbackContext,
+    _Out_opt_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Enumerate all the buffers in a lane when the lock-free queue is used.
+    Buffers are moved from the lock-free queue to the pending list (preserving their order)
+    and the pending list is enumerated. Buffers that are not removed by the Client are
+    dequeued from the pending list later.
+    NOTE: Only a single thread may call this function at the same time.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Lane - The lane to enumerate.
+    EntryEnumerationCallback - Caller's enumeration function called for each buffer in the lane.
+    ClientDriverCallbackContext - Context passed for this call.
+    ClientBuffer - Receives the buffer the Client removes, if any.
+    ClientBufferContext - Receives the Client Buffer Context of the buffer the Client removes, if any.
+
+Return Value:
+
+    TRUE if the Client stopped the enumeration.
+
+--*/
+{
+    BUFFERQUEUE_NODE* node;
+    BUFFERQUEUE_NODE* previousNode;
+    BOOLEAN doneEnumerating;
+    BufferPool_EnumerationDispositionType enumerationDisposition;
+
+    // Take all the buffers that are currently linked in the lock-free queue.
+    //
+    node = BufferQueue_LockFreeRemove(Lane);
+    while (node != NULL)
+    {
+        node->Next = NULL;
+        if (NULL == Lane->PendingTail)
+        {
+            Lane->PendingHead = node;
+        }
+        else
+        {
+            Lane->PendingTail->Next = node;
+        }
+        Lane->PendingTail = node;
+        node = BufferQueue_LockFreeRemove(Lane);
+    }
+
+    doneEnumerating = FALSE;
+    previousNode = NULL;
+    node = Lane->PendingHead;
+    while ((! doneEnumerating) &&
+           (node != NULL))
+    {
+        enumerationDisposition = EntryEnumerationCallback(ModuleContext->DmfModuleBufferPoolProducer,
+                                                          node->ClientBuffer,
+                                                          BufferQueue_ClientBufferContextGet(node),
+                                                          ClientDriverCallbackContext);
+        switch (enumerationDisposition)
+        {
+            case BufferPool_EnumerationDisposition_ContinueEnumeration:
+            case BufferPool_EnumerationDisposition_StopTimerAndContinueEnumeration:
+            case BufferPool_EnumerationDisposition_ResetTimerAndContinueEnumeration:
+            {
+                // Buffers in the consumer list do not have timers.
+                //
+                previousNode = node;
+                node = node->Next;
+                break;
+            }
+            case BufferPool_EnumerationDisposition_StopEnumeration:
+            case BufferPool_EnumerationDisposition_StopTimerAndStopEnumeration:
+            case BufferPool_EnumerationDisposition_ResetTimerAndStopEnumeration:
+            {
+                doneEnumerating = TRUE;
+                break;
+            }
+            case BufferPool_EnumerationDisposition_RemoveAndStopEnumeration:
+            {
+                doneEnumerating = TRUE;
+                DmfAssert(ClientBuffer != NULL);
+
+                // Unlink the buffer from the pending list.
+                //
+                if (NULL == previousNode)
+                {
+                    Lane->PendingHead = node->Next;
+                }
+                else
+                {
+                    previousNode->Next = node->Next;
+                }
+                if (Lane->PendingTail == node)
+                {
+                    Lane->PendingTail = previousNode;
+                }
+                InterlockedDecrement(&Lane->NumberOfBuffers);
+
+                // 'Dereferencing NULL pointer'
+                // If Client specifies BufferPool_EnumerationDisposition_RemoveAndStop, Client owns the buffer
+                // so Client has to pass a valid ClientBuffer pointer.
+                //
+                #pragma warning(suppress: 6011)
+                *ClientBuffer = node->ClientBuffer;
+                if (ClientBufferContext != NULL)
+                {
+                    *ClientBufferContext = BufferQueue_ClientBufferContextGet(node);
+                }
+                break;
+            }
+            default:
+            {
+                DmfAssert(FALSE);
+                doneEnumerating = TRUE;
+                break;
+            }
+        }
+    }
+
+    return doneEnumerating;
+}
+
+_Function_class_(EVT_DMF_BufferPool_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BufferPool_EnumerationDispositionType
+BufferQueue_EnumerationCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ VOID* ClientBufferContext,
+    _In_opt_ VOID* ClientDriverCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Calls the Client's enumeration callback for a buffer in a lane's consumer pool and
+    remembers if the Client stopped the enumeration so that other lanes are not enumerated.
+
+Arguments:
+
+    DmfModule - The lane's consumer pool.
+    ClientBuffer - The enumerated buffer.
+    ClientBufferContext - The Client Buffer Context of the enumerated buffer.
+    ClientDriverCallbackContext - BUFFERQUEUE_ENUMERATION_CONTEXT.
+
+Return Value:
+
+    The disposition returned by the Client.
+
+--*/
+{
+    BUFFERQUEUE_ENUMERATION_CONTEXT* enumerationContext;
+    BufferPool_EnumerationDispositionType enumerationDisposition;
+
+    enumerationContext = (BUFFERQUEUE_ENUMERATION_CONTEXT*)ClientDriverCallbackContext;
+    DmfAssert(enumerationContext != NULL);
+
+    // 'Dereferencing NULL pointer. 'enumerationContext' contains the same NULL value as 'ClientDriverCallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    enumerationDisposition = enumerationContext->EntryEnumerationCallback(DmfModule,
+                                                                          ClientBuffer,
+                                                                          ClientBufferContext,
+                                                                          enumerationContext->ClientDriverCallbackContext);
+    switch (enumerationDisposition)
+    {
+        case BufferPool_EnumerationDisposition_ContinueEnumeration:
+        case BufferPool_EnumerationDisposition_StopTimerAndContinueEnumeration:
+        case BufferPool_EnumerationDisposition_ResetTimerAndContinueEnumeration:
+        {
+            break;
+        }
+        default:
+        {
+            enumerationContext->EnumerationStopped = TRUE;
+            break;
+        }
+    }
+
+    return enumerationDisposition;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_LaneInsert(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _Inout_ BUFFERQUEUE_LANE* Lane,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    )
+/*++
+
+Routine Description:
+
+    Add Client Buffers to a lane in the order they appear in ClientBuffers.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Lane - The lane.
+    ClientBuffers - The buffers to add.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFERQUEUE_NODE* firstNode;
+    BUFFERQUEUE_NODE* lastNode;
+    BUFFERQUEUE_NODE* node;
+    ULONG bufferIndex;
+
+    DmfAssert(NumberOfBuffers > 0);
+
+    // Count the buffers before they can be dequeued so that the count never goes below zero.
+    //
+    InterlockedAdd(&Lane->NumberOfBuffers,
+                   (LONG)NumberOfBuffers);
+
+    if (ModuleContext->LockFreeQueue)
+    {
+        // Link the buffers to each other first so that they are inserted at once.
+        //
+        firstNode = BufferQueue_NodeGet(ModuleContext,
+                                        ClientBuffers[0]);
+        lastNode = firstNode;
+        for (bufferIndex = 1; bufferIndex < NumberOfBuffers; bufferIndex++)
+        {
+            node = BufferQueue_NodeGet(ModuleContext,
+                                       ClientBuffers[bufferIndex]);
+            lastNode->Next = node;
+            lastNode = node;
+        }
+
+        BufferQueue_LockFreeInsert(Lane,
+                                   firstNode,
+                                   lastNode);
+    }
+    else if (1 == NumberOfBuffers)
+    {
+        DMF_BufferPool_Put(Lane->DmfModuleBufferPoolConsumer,
+                           ClientBuffers[0]);
+    }
+    else
+    {
+        DMF_BufferPool_PutMany(Lane->DmfModuleBufferPoolConsumer,
+                               ClientBuffers,
+                               NumberOfBuffers);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+BufferQueue_LaneRemove(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _Inout_ BUFFERQUEUE_LANE* Lane,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, return) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts
+    )
+/*++
+
+Routine Description:
+
+    Remove up to a given number of buffers from the head of a lane.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Lane - The lane.
+    NumberOfBuffersRequested - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+
+Return Value:
+
+    The number of buffers removed.
+
+--*/
+{
+    BUFFERQUEUE_NODE* node;
+    ULONG numberOfBuffersRetrieved;
+    NTSTATUS ntStatus;
+
+    if (ModuleContext->LockFreeQueue)
+    {
+        for (numberOfBuffersRetrieved = 0; numberOfBuffersRetrieved < NumberOfBuffersRequested; numberOfBuffersRetrieved++)
+        {
+            node = BufferQueue_LockFreeDequeue(Lane);
+            if (NULL == node)
+            {
+                break;
+            }
+            ClientBuffers[numberOfBuffersRetrieved] = node->ClientBuffer;
+            if (ClientBufferContexts != NULL)
+            {
+                ClientBufferContexts[numberOfBuffersRetrieved] = BufferQueue_ClientBufferContextGet(node);
+            }
+        }
+    }
+    else if (1 == NumberOfBuffersRequested)
+    {
+        ntStatus = DMF_BufferPool_Get(Lane->DmfModuleBufferPoolConsumer,
+                                      &ClientBuffers[0],
+                                      (ClientBufferContexts != NULL) ? &ClientBufferContexts[0] : NULL);
+        numberOfBuffersRetrieved = NT_SUCCESS(ntStatus) ? 1 : 0;
+    }
+    else
+    {
+        ntStatus = DMF_BufferPool_GetMany(Lane->DmfModuleBufferPoolConsumer,
+                                          NumberOfBuffersRequested,
+                                          ClientBuffers,
+                                          ClientBufferContexts,
+                                          &numberOfBuffersRetrieved);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            numberOfBuffersRetrieved = 0;
+        }
+    }
+
+    if (numberOfBuffersRetrieved > 0)
+    {
+        InterlockedAdd(&Lane->NumberOfBuffers,
+                       -(LONG)numberOfBuffersRetrieved);
+    }
+
+    return numberOfBuffersRetrieved;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+LONG
+BufferQueue_LaneSelect(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext,
+    _In_ ULONG PriorityAgingThreshold,
+    _In_ ULONG ExcludedLanes
+    )
+/*++
+
+Routine Description:
+
+    Select the lane to dequeue from: the highest priority lane that has buffers, unless a
+    lower priority lane has been skipped PriorityAgingThreshold times while it had buffers.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    PriorityAgingThreshold - Number of skipped dequeues after which a lane is served first.
+                             Zero disables aging.
+    ExcludedLanes - Bit mask of lanes not to select.
+
+Return Value:
+
+    The index of the selected lane or -1 if no lane has buffers.
+
+--*/
+{
+    LONG laneIndex;
+    BUFFERQUEUE_LANE* lane;
+
+    if (PriorityAgingThreshold > 0)
+    {
+        for (laneIndex = (LONG)ModuleContext->NumberOfLanes - 2; laneIndex >= 0; laneIndex--)
+        {
+            lane = &ModuleContext->Lanes[laneIndex];
+            if ((0 == (ExcludedLanes & (1 << laneIndex))) &&
+                (lane->NumberOfBuffers > 0) &&
+                ((ULONG)lane->NumberOfDequeuesSkipped >= PriorityAgingThreshold))
+            {
+                goto Exit;
+            }
+        }
+    }
+
+    for (laneIndex = (LONG)ModuleContext->NumberOfLanes - 1; laneIndex >= 0; laneIndex--)
+    {
+        lane = &ModuleContext->Lanes[laneIndex];
+        if ((0 == (ExcludedLanes & (1 << laneIndex))) &&
+            (lane->NumberOfBuffers > 0))
+        {
+            goto Exit;
+        }
+    }
+
+Exit:
+
+    return laneIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+BufferQueue_DequeueFromLanes(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, return) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts
+    )
+/*++
+
+Routine Description:
+
+    Remove up to a given number of buffers from the consumer lists, highest priority first.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffersRequested - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+
+Return Value:
+
+    The number of buffers removed.
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    BUFFERQUEUE_LANE* lane;
+    LONG laneIndex;
+    LONG lowerLaneIndex;
+    ULONG excludedLanes;
+    ULONG numberOfBuffersRetrieved;
+    ULONG numberOfBuffersRetrievedFromLane;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    numberOfBuffersRetrieved = 0;
+    excludedLanes = 0;
+    while (numberOfBuffersRetrieved < NumberOfBuffersRequested)
+    {
+        laneIndex = BufferQueue_LaneSelect(moduleContext,
+                                           moduleConfig->PriorityAgingThreshold,
+                                           excludedLanes);
+        if (laneIndex < 0)
+        {
+            break;
+        }
+
+        lane = &moduleContext->Lanes[laneIndex];
+        numberOfBuffersRetrievedFromLane = BufferQueue_LaneRemove(moduleContext,
+                                                                  lane,
+                                                                  NumberOfBuffersRequested - numberOfBuffersRetrieved,
+                                                                  &ClientBuffers[numberOfBuffersRetrieved],
+                                                                  (ClientBufferContexts != NULL) ? &ClientBufferContexts[numberOfBuffersRetrieved] : NULL);
+        if (0 == numberOfBuffersRetrievedFromLane)
+        {
+            // The buffers counted in this lane are still being added.
+            //
+            excludedLanes |= (1 << laneIndex);
+            continue;
+        }
+        numberOfBuffersRetrieved += numberOfBuffersRetrievedFromLane;
+
+        if (moduleConfig->PriorityAgingThreshold > 0)
+        {
+            // Lower priority lanes that still have buffers age.
+            //
+            InterlockedExchange(&lane->NumberOfDequeuesSkipped,
+                                0);
+            for (lowerLaneIndex = laneIndex - 1; lowerLaneIndex >= 0; lowerLaneIndex--)
+            {
+                if (moduleContext->Lanes[lowerLaneIndex].NumberOfBuffers > 0)
+                {
+                    InterlockedIncrement(&moduleContext->Lanes[lowerLaneIndex].NumberOfDequeuesSkipped);
+                }
+            }
+        }
+    }
+
+    return numberOfBuffersRetrieved;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_LanesFlush(
+    _In_ DMF_CONTEXT_BufferQueue* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Move all the buffers in the consumer lists to the producer list.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    VOID* clientBuffers[BufferQueue_FlushBatchSize];
+    ULONG laneIndex;
+    ULONG numberOfBuffers;
+
+    for (laneIndex = 0; laneIndex < ModuleContext->NumberOfLanes; laneIndex++)
+    {
+        do
+        {
+            numberOfBuffers = BufferQueue_LaneRemove(ModuleContext,
+                                                     &ModuleContext->Lanes[laneIndex],
+                                                     ARRAYSIZE(clientBuffers),
+                                                     clientBuffers,
+                                                     NULL);
+            if (numberOfBuffers > 0)
+            {
+                DMF_BufferPool_PutMany(ModuleContext->DmfModuleBufferPoolProducer,
+                                       clientBuffers,
+                                       numberOfBuffers);
+            }
+        } while (numberOfBuffers > 0);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONGLONG
+BufferQueue_CurrentTimeMillisecondsGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Returns the current time used for wait timeouts. This time is not affected by
+    changes to the system time.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    The current time in milliseconds.
+
+--*/
+{
+    ULONGLONG currentTimeMilliseconds;
+
+#if defined(DMF_USER_MODE)
+    currentTimeMilliseconds = GetTickCount64();
+#else
+    currentTimeMilliseconds = KeQueryInterruptTime() / 10000;
+#endif
+
+    return currentTimeMilliseconds;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_WaitersWake(
+    _In_ DMF_PORTABLE_EVENT* Event,
+    _In_ LONG volatile* NumberOfWaiters
+    )
+/*++
+
+Routine Description:
+
+    Wake a thread waiting for a given event, if any, after a buffer has been added to the
+    corresponding list.
+
+Arguments:
+
+    Event - The event the threads wait for.
+    NumberOfWaiters - The number of threads waiting for the event.
+
+Return Value:
+
+    None
+
+--*/
+{
+    // The buffer must be visible in the list before the number of waiters is read.
+    // A waiter increments the number of waiters before it checks the list. Thus, either
+    // the waiter finds the buffer or this thread finds the waiter.
+    //
+    MemoryBarrier();
+
+    if (*NumberOfWaiters > 0)
+    {
+        DMF_Portable_EventSet(Event);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_WatermarkNotify(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Calls the Client's watermark callbacks when the number of buffers in the consumer list
+    reaches the high watermark or falls to the low watermark after the high watermark was reached.
+
+    Only one thread calls the callbacks at a time. That thread reads the number of buffers again,
+    under the Module lock, after each callback returns. A thread that finds another thread calling
+    a callback returns immediately because its change of the number of buffers will be seen by that
+    thread. Thus, the callbacks always alternate, they are called in the order the watermarks are
+    crossed and the last callback always matches the number of buffers in the consumer list.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    EVT_DMF_BufferQueue_Watermark* watermarkCallback;
+    ULONG numberOfBuffersInQueue;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    if (moduleContext->WatermarkNotifying)
+    {
+        // The thread calling the callback checks the number of buffers again when the
+        // callback returns.
+        //
+        DMF_ModuleUnlock(DmfModule);
+        goto Exit;
+    }
+
+    moduleContext->WatermarkNotifying = TRUE;
+
+    for (;;)
+    {
+        numberOfBuffersInQueue = DMF_BufferQueue_Count(DmfModule);
+        if ((! moduleContext->HighWatermarkReached) &&
+            (numberOfBuffersInQueue >= moduleConfig->HighWatermark))
+        {
+            moduleContext->HighWatermarkReached = TRUE;
+            watermarkCallback = moduleConfig->EvtBufferQueueHighWatermark;
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "High watermark: numberOfBuffersInQueue=%d", numberOfBuffersInQueue);
+        }
+        else if ((moduleContext->HighWatermarkReached) &&
+                 (numberOfBuffersInQueue <= moduleConfig->LowWatermark))
+        {
+            moduleContext->HighWatermarkReached = FALSE;
+            watermarkCallback = moduleConfig->EvtBufferQueueLowWatermark;
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Low watermark: numberOfBuffersInQueue=%d", numberOfBuffersInQueue);
+        }
+        else
+        {
+            break;
+        }
+
+        // The callback is called without the lock so that it can call this Module's Methods.
+        //
+        DMF_ModuleUnlock(DmfModule);
+        if (watermarkCallback != NULL)
+        {
+            watermarkCallback(DmfModule,
+                              numberOfBuffersInQueue);
+        }
+        DMF_ModuleLock(DmfModule);
+    }
+
+    moduleContext->WatermarkNotifying = FALSE;
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_EnqueueNotify(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Called after buffers are added to the consumer list. Wakes a thread waiting for data
+    and calls the Client's high watermark callback when the watermark is reached.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
 {
-    // DMFMODULE to Producer BufferPool.
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    BufferQueue_WaitersWake(&moduleContext->DataAvailableEvent,
+                            &moduleContext->NumberOfDataWaiters);
+
+    if (moduleConfig->HighWatermark != 0)
+    {
+        BufferQueue_WatermarkNotify(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+BufferQueue_DequeueNotify(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Called after buffers are removed from the consumer list. Calls the Client's low watermark
+    callback when the number of buffers falls to the low watermark after the high watermark
+    has been reached.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONFIG_BufferQueue* moduleConfig;
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    if (moduleConfig->HighWatermark != 0)
+    {
+        BufferQueue_WatermarkNotify(DmfModule);
+    }
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+BufferQueue_BufferWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ BufferQueue_BufferGetFunction* BufferGetFunction,
+    _In_ DMF_PORTABLE_EVENT* Event,
+    _Inout_ LONG volatile* NumberOfWaiters,
+    _In_ ULONG TimeoutMilliseconds,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Retrieve a buffer using a given function. If no buffer is available, wait until a buffer
+    is added to the corresponding list or the timeout elapses.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    BufferGetFunction - Function that retrieves a buffer without waiting.
+    Event - Event that is set when a buffer is added to the corresponding list.
+    NumberOfWaiters - The number of threads waiting for Event.
+    TimeoutMilliseconds - Maximum time to wait. INFINITE means wait until a buffer is available.
+    ClientBuffer - The Client Buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is retrieved.
+    STATUS_IO_TIMEOUT if no buffer is available before the timeout elapses.
+    STATUS_INVALID_DEVICE_STATE if the Module closes while waiting.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONGLONG startTimeMilliseconds;
+    ULONGLONG elapsedMilliseconds;
+    ULONG remainingMilliseconds;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Most of the time a buffer is available and there is no need to wait.
     //
-    DMFMODULE DmfModuleBufferPoolProducer;
-    // DMFMODULE to Consumer BufferPool.
+    ntStatus = BufferGetFunction(DmfModule,
+                                 ClientBuffer,
+                                 ClientBufferContext);
+    if (NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    startTimeMilliseconds = BufferQueue_CurrentTimeMillisecondsGet();
+
+    // Threads that add buffers only set the event after they see this thread.
     //
-    DMFMODULE DmfModuleBufferPoolConsumer;
-} DMF_CONTEXT_BufferQueue;
+    InterlockedIncrement(NumberOfWaiters);
 
-// This macro declares the following function:
-// DMF_CONTEXT_GET()
-//
-DMF_MODULE_DECLARE_CONTEXT(BufferQueue)
+    for (;;)
+    {
+        if (moduleContext->Closing)
+        {
+            ntStatus = STATUS_INVALID_DEVICE_STATE;
+            break;
+        }
 
-// This macro declares the following function:
-// DMF_CONFIG_GET()
-//
-DMF_MODULE_DECLARE_CONFIG(BufferQueue)
+        ntStatus = BufferGetFunction(DmfModule,
+                                     ClientBuffer,
+                                     ClientBufferContext);
+        if (NT_SUCCESS(ntStatus))
+        {
+            break;
+        }
 
-// Memory Pool Tag.
-//
-#define MemoryTag 'oMQB'
+        if (INFINITE == TimeoutMilliseconds)
+        {
+            DMF_Portable_EventWaitForSingleObject(Event,
+                                                  NULL,
+                                                  FALSE);
+            continue;
+        }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Support Code
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+        elapsedMilliseconds = BufferQueue_CurrentTimeMillisecondsGet() - startTimeMilliseconds;
+        if (elapsedMilliseconds >= TimeoutMilliseconds)
+        {
+            ntStatus = STATUS_IO_TIMEOUT;
+            break;
+        }
+        remainingMilliseconds = TimeoutMilliseconds - (ULONG)elapsedMilliseconds;
+
+        // The event may also be set for a buffer that another thread retrieves first. In that
+        // case, wait again for the remaining time.
+        //
+        DMF_Portable_EventWaitForSingleObject(Event,
+                                              &remainingMilliseconds,
+                                              FALSE);
+    }
+
+    InterlockedDecrement(NumberOfWaiters);
+
+    // The event wakes one thread at a time. Several buffers may have been added at once
+    // (or the Module may be closing), so let the next waiting thread check as well.
+    //
+    if (*NumberOfWaiters > 0)
+    {
+        DMF_Portable_EventSet(Event);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
@@ -78,6 +1268,157 @@ DMF_MODULE_DECLARE_CONFIG(BufferQueue)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_BufferQueue_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type BufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+    STATUS_INVALID_PARAMETER if LowWatermark is not less than HighWatermark.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+    DMF_CONFIG_BufferQueue* moduleConfig;
+    BUFFERQUEUE_LANE* lane;
+    ULONG laneIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    // Otherwise, the low watermark callback could be called while the number of buffers is
+    // still at the high watermark.
+    //
+    DmfAssert((0 == moduleConfig->HighWatermark) ||
+              (moduleConfig->LowWatermark < moduleConfig->HighWatermark));
+    if ((moduleConfig->HighWatermark != 0) &&
+        (moduleConfig->LowWatermark >= moduleConfig->HighWatermark))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid watermarks: LowWatermark=%d HighWatermark=%d", moduleConfig->LowWatermark, moduleConfig->HighWatermark);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    for (laneIndex = 0; laneIndex < moduleContext->NumberOfLanes; laneIndex++)
+    {
+        lane = &moduleContext->Lanes[laneIndex];
+
+        // The lock-free queue starts with only the stub.
+        //
+        lane->QueueStub.Next = NULL;
+        lane->QueueStub.ClientBuffer = NULL;
+        lane->QueueHead = &lane->QueueStub;
+        lane->QueueTail = &lane->QueueStub;
+        lane->PendingHead = NULL;
+        lane->PendingTail = NULL;
+        lane->NumberOfBuffers = 0;
+        lane->NumberOfDequeuesSkipped = 0;
+    }
+
+    // Synchronization events wake one waiting thread at a time in both Kernel-mode and User-mode.
+    //
+    DMF_Portable_EventCreate(&moduleContext->DataAvailableEvent,
+                             SynchronizationEvent,
+                             FALSE);
+    DMF_Portable_EventCreate(&moduleContext->BufferAvailableEvent,
+                             SynchronizationEvent,
+                             FALSE);
+    moduleContext->NumberOfDataWaiters = 0;
+    moduleContext->NumberOfBufferWaiters = 0;
+    moduleContext->Closing = FALSE;
+    moduleContext->HighWatermarkReached = FALSE;
+    moduleContext->WatermarkNotifying = FALSE;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_BufferQueue_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type BufferQueue.
+    Threads waiting for buffers return STATUS_INVALID_DEVICE_STATE.
+    Buffers in the lock-free queues are returned to the producer pool so that they are deleted
+    with it. (Buffers in the consumer pools are returned to the producer pool by the consumer pools.)
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Wake threads that are waiting for buffers and wait for them to return before
+    // the events are closed.
+    //
+    moduleContext->Closing = TRUE;
+    MemoryBarrier();
+    while ((moduleContext->NumberOfDataWaiters > 0) ||
+           (moduleContext->NumberOfBufferWaiters > 0))
+    {
+        DMF_Portable_EventSet(&moduleContext->DataAvailableEvent);
+        DMF_Portable_EventSet(&moduleContext->BufferAvailableEvent);
+        DMF_Utility_DelayMilliseconds(1);
+    }
+    DMF_Portable_EventClose(&moduleContext->DataAvailableEvent);
+    DMF_Portable_EventClose(&moduleContext->BufferAvailableEvent);
+
+    if (moduleContext->LockFreeQueue)
+    {
+        BufferQueue_LanesFlush(moduleContext);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(DMF_ChildModulesAdd)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -110,6 +1451,18 @@ Return Value:
     DMF_MODULE_ATTRIBUTES moduleAttributes;
     DMF_CONFIG_BufferQueue* moduleConfig;
     DMF_CONTEXT_BufferQueue* moduleContext;
+    ULONG laneIndex;
+    static PSTR consumerInstanceNames[BUFFERQUEUE_PRIORITY_LANES_MAXIMUM] =
+    {
+        "BufferPoolConsumer",
+        "BufferPoolConsumer1",
+        "BufferPoolConsumer2",
+        "BufferPoolConsumer3",
+        "BufferPoolConsumer4",
+        "BufferPoolConsumer5",
+        "BufferPoolConsumer6",
+        "BufferPoolConsumer7"
+    };
 
     PAGED_CODE();
 
@@ -125,6 +1478,12 @@ Return Value:
                                               &moduleAttributes);
     moduleConfigProducer.BufferPoolMode = BufferPool_Mode_Source;
     moduleConfigProducer.Mode.SourceSettings = moduleConfig->SourceSettings;
+    if (moduleConfig->EnableLockFreeQueue)
+    {
+        // Each buffer carries its lock-free queue link in front of the Client's context.
+        //
+        moduleConfigProducer.Mode.SourceSettings.BufferContextSize += BufferQueue_NodeSize;
+    }
     moduleAttributes.ClientModuleInstanceName = "BufferPoolProducer";
     moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
     DMF_DmfModuleAdd(DmfModuleInit,
@@ -132,18 +1491,44 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleBufferPoolProducer);
 
-    // BufferPoolConsumer
-    // ------------------
+    // Zero means a single lane (no priorities).
+    //
+    DmfAssert(moduleConfig->NumberOfPriorityLanes <= BUFFERQUEUE_PRIORITY_LANES_MAXIMUM);
+    moduleContext->NumberOfLanes = moduleConfig->NumberOfPriorityLanes;
+    if (0 == moduleContext->NumberOfLanes)
+    {
+        moduleContext->NumberOfLanes = 1;
+    }
+    else if (moduleContext->NumberOfLanes > BUFFERQUEUE_PRIORITY_LANES_MAXIMUM)
+    {
+        moduleContext->NumberOfLanes = BUFFERQUEUE_PRIORITY_LANES_MAXIMUM;
+    }
+
+    // BufferPoolConsumer (one per lane)
+    // ---------------------------------
     //
-    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigConsumer,
-                                              &moduleAttributes);
-    moduleConfigConsumer.BufferPoolMode = BufferPool_Mode_Sink;
-    moduleAttributes.ClientModuleInstanceName = "BufferPoolConsumer";
-    moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
-    DMF_DmfModuleAdd(DmfModuleInit,
-                     &moduleAttributes,
-                     WDF_NO_OBJECT_ATTRIBUTES,
-                     &moduleContext->DmfModuleBufferPoolConsumer);
+    moduleContext->LockFreeQueue = (moduleConfig->EnableLockFreeQueue != 0);
+    for (laneIndex = 0; laneIndex < moduleContext->NumberOfLanes; laneIndex++)
+    {
+        if (moduleContext->LockFreeQueue)
+        {
+            // The lock-free queue replaces the consumer pool.
+            //
+            moduleContext->Lanes[laneIndex].DmfModuleBufferPoolConsumer = NULL;
+        }
+        else
+        {
+            DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigConsumer,
+                                                      &moduleAttributes);
+            moduleConfigConsumer.BufferPoolMode = BufferPool_Mode_Sink;
+            moduleAttributes.ClientModuleInstanceName = consumerInstanceNames[laneIndex];
+            moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+            DMF_DmfModuleAdd(DmfModuleInit,
+                             &moduleAttributes,
+                             WDF_NO_OBJECT_ATTRIBUTES,
+                             &moduleContext->Lanes[laneIndex].DmfModuleBufferPoolConsumer);
+        }
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -193,6 +1578,8 @@ Return Value:
 
     DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_BufferQueue);
     dmfCallbacksDmf_BufferQueue.ChildModulesAdd = DMF_BufferQueue_ChildModulesAdd;
+    dmfCallbacksDmf_BufferQueue.DeviceOpen = DMF_BufferQueue_Open;
+    dmfCallbacksDmf_BufferQueue.DeviceClose = DMF_BufferQueue_Close;
 
     DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_BufferQueue,
                                             BufferQueue,
@@ -230,7 +1617,7 @@ DMF_BufferQueue_Count(
 
 Routine Description:
 
-    Return the number of entries currently in the list.
+    Return the number of entries currently in the list (in all the priority lanes).
 
 Arguments:
 
@@ -244,6 +1631,7 @@ Return Value:
 {
     DMF_CONTEXT_BufferQueue* moduleContext;
     ULONG numberOfEntriesInList;
+    ULONG laneIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -252,7 +1640,11 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    numberOfEntriesInList = DMF_BufferPool_Count(moduleContext->DmfModuleBufferPoolConsumer);
+    numberOfEntriesInList = 0;
+    for (laneIndex = 0; laneIndex < moduleContext->NumberOfLanes; laneIndex++)
+    {
+        numberOfEntriesInList += (ULONG)moduleContext->Lanes[laneIndex].NumberOfBuffers;
+    }
 
     FuncExit(DMF_TRACE, "numberOfEntriesInList=%d", numberOfEntriesInList);
 
@@ -271,7 +1663,8 @@ DMF_BufferQueue_Dequeue(
 
 Routine Description:
 
-    Removes the next buffer in the consumer list (head of the list) if there is a buffer.
+    Removes the next buffer in the consumer list (head of the highest priority lane that has
+    buffers) if there is a buffer.
     Then, returns the Client Buffer and its associated Client Buffer Context.
 
 Arguments:
@@ -285,11 +1678,133 @@ Return Value:
     STATUS_SUCCESS if a buffer is removed from the list.
     STATUS_UNSUCCESSFUL if the list is empty.
 
+--*/
+{
+    NTSTATUS ntStatus;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    if (0 == BufferQueue_DequeueFromLanes(DmfModule,
+                                          1,
+                                          ClientBuffer,
+                                          ClientBufferContext))
+    {
+        *ClientBuffer = NULL;
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    BufferQueue_DequeueNotify(DmfModule);
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueMany(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, *NumberOfBuffersRetrieved) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersRetrieved
+    )
+/*++
+
+Routine Description:
+
+    Removes up to NumberOfBuffersRequested buffers from the consumer list (head of the list)
+    using a single acquisition of each priority lane's lock. Buffers are removed from the
+    highest priority lane first. Then, returns the Client Buffers and their associated
+    Client Buffer Contexts.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    NumberOfBuffersRequested - The maximum number of buffers to remove.
+    ClientBuffers - Array that receives the Client Buffers.
+    ClientBufferContexts - Optional array that receives the Client contexts associated with the buffers.
+    NumberOfBuffersRetrieved - The number of buffers written to ClientBuffers.
+
+Return Value:
+
+    STATUS_SUCCESS if at least one buffer is removed from the list.
+    STATUS_UNSUCCESSFUL if the list is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    *NumberOfBuffersRetrieved = BufferQueue_DequeueFromLanes(DmfModule,
+                                                             NumberOfBuffersRequested,
+                                                             ClientBuffers,
+                                                             ClientBufferContexts);
+    if (0 == *NumberOfBuffersRetrieved)
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        BufferQueue_DequeueNotify(DmfModule);
+        ntStatus = STATUS_SUCCESS;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMilliseconds,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the consumer list (head of the list). If the list is empty,
+    waits until a buffer is enqueued or the timeout elapses.
+    Then, returns the Client Buffer and its associated Client Buffer Context.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TimeoutMilliseconds - Maximum time to wait. INFINITE means wait until a buffer is enqueued.
+    ClientBuffer - The Client Buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_IO_TIMEOUT if the list is still empty when the timeout elapses.
+    STATUS_INVALID_DEVICE_STATE if the Module closes while waiting.
+
 --*/
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_BufferQueue* moduleContext;
 
+    PAGED_CODE();
+
     FuncEntry(DMF_TRACE);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
@@ -297,14 +1812,19 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
-                                  ClientBuffer,
-                                  ClientBufferContext);
+    ntStatus = BufferQueue_BufferWait(DmfModule,
+                                      DMF_BufferQueue_Dequeue,
+                                      &moduleContext->DataAvailableEvent,
+                                      &moduleContext->NumberOfDataWaiters,
+                                      TimeoutMilliseconds,
+                                      ClientBuffer,
+                                      ClientBufferContext);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
 }
+#pragma code_seg()
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
@@ -319,7 +1839,8 @@ DMF_BufferQueue_DequeueWithMemoryDescriptor(
 
 Routine Description:
 
-    Removes the next buffer in the list (head of the list) if there is a buffer.
+    Removes the next buffer in the list (head of the highest priority lane that has buffers)
+    if there is a buffer.
     Then, returns the Client Buffer and its associated Memory Descriptor and ClientBufferContext.
 
 Arguments:
@@ -346,10 +1867,31 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = DMF_BufferPool_GetWithMemoryDescriptor(moduleContext->DmfModuleBufferPoolConsumer,
-                                                      ClientBuffer,
-                                                      MemoryDescriptor,
-                                                      ClientBufferContext);
+    if (0 == BufferQueue_DequeueFromLanes(DmfModule,
+                                          1,
+                                          ClientBuffer,
+                                          ClientBufferContext))
+    {
+        *ClientBuffer = NULL;
+        *ClientBufferContext = NULL;
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    // The Memory Descriptor is stored with the buffer regardless of the list it is in.
+    //
+    DMF_BufferPool_ParametersGet(moduleContext->DmfModuleBufferPoolProducer,
+                                 *ClientBuffer,
+                                 MemoryDescriptor,
+                                 NULL,
+                                 NULL,
+                                 NULL,
+                                 NULL);
+
+    BufferQueue_DequeueNotify(DmfModule);
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -366,7 +1908,7 @@ DMF_BufferQueue_Enqueue(
 
 Routine Description:
 
-    Adds a Client Buffer to the consumer list.
+    Adds a Client Buffer to the consumer list (lowest priority lane).
 
 Arguments:
 
@@ -389,8 +1931,120 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolConsumer,
-                       ClientBuffer);
+    BufferQueue_LaneInsert(moduleContext,
+                           &moduleContext->Lanes[0],
+                           &ClientBuffer,
+                           1);
+
+    BufferQueue_EnqueueNotify(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueMany(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    )
+/*++
+
+Routine Description:
+
+    Adds several Client Buffers to the consumer list (lowest priority lane) using a single
+    acquisition of the consumer list's lock (or a single interlocked operation when the lock-free
+    queue is used). The buffers are added in the order they appear in ClientBuffers.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffers - The buffers to add to the list.
+                    NOTE: Each must be a properly formed buffer that was created by this Module.
+    NumberOfBuffers - The number of buffers in ClientBuffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (0 == NumberOfBuffers)
+    {
+        goto Exit;
+    }
+
+    BufferQueue_LaneInsert(moduleContext,
+                           &moduleContext->Lanes[0],
+                           ClientBuffers,
+                           NumberOfBuffers);
+
+    BufferQueue_EnqueueNotify(DmfModule);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the consumer list with a given priority. Buffers with higher
+    priority are dequeued before buffers with lower priority. Buffers with the same priority
+    are dequeued in the order they are enqueued.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Priority - Priority of the buffer. Zero is the lowest priority. NumberOfPriorityLanes - 1
+               is the highest priority. Higher values are treated as the highest priority.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(Priority < moduleContext->NumberOfLanes);
+    if (Priority >= moduleContext->NumberOfLanes)
+    {
+        Priority = moduleContext->NumberOfLanes - 1;
+    }
+
+    BufferQueue_LaneInsert(moduleContext,
+                           &moduleContext->Lanes[Priority],
+                           &ClientBuffer,
+                           1);
+
+    BufferQueue_EnqueueNotify(DmfModule);
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -410,7 +2064,10 @@ Routine Description:
 
     Enumerate all the buffers in the consumer buffer list, calling a Client Driver's callback function
     for each buffer. If the Client wishes, the buffer can be removed from the list.
-    NOTE: Module lock is held during this call.
+    Buffers are enumerated in the order they are dequeued (highest priority lane first).
+    NOTE: The lock of the lane being enumerated is held during the callback.
+    NOTE: When the lock-free queue is used, this Method is a consumer operation and no lock is held.
+          The DMFMODULE passed to the callback is the producer pool.
 
 Arguments:
 
@@ -425,6 +2082,9 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_BufferQueue* moduleContext;
+    BUFFERQUEUE_ENUMERATION_CONTEXT enumerationContext;
+    BUFFERQUEUE_LANE* lane;
+    LONG laneIndex;
 
     FuncEntry(DMF_TRACE);
 
@@ -433,11 +2093,58 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_BufferPool_Enumerate(moduleContext->DmfModuleBufferPoolConsumer,
-                             EntryEnumerationCallback,
-                             ClientDriverCallbackContext,
-                             ClientBuffer,
-                             ClientBufferContext);
+    if (ClientBuffer != NULL)
+    {
+        *ClientBuffer = NULL;
+    }
+    if (ClientBufferContext != NULL)
+    {
+        *ClientBufferContext = NULL;
+    }
+
+    enumerationContext.EntryEnumerationCallback = EntryEnumerationCallback;
+    enumerationContext.ClientDriverCallbackContext = ClientDriverCallbackContext;
+    enumerationContext.EnumerationStopped = FALSE;
+
+    for (laneIndex = (LONG)moduleContext->NumberOfLanes - 1; laneIndex >= 0; laneIndex--)
+    {
+        lane = &moduleContext->Lanes[laneIndex];
+        if (moduleContext->LockFreeQueue)
+        {
+            enumerationContext.EnumerationStopped = BufferQueue_LockFreeEnumerate(moduleContext,
+                                                                                  lane,
+                                                                                  EntryEnumerationCallback,
+                                                                                  ClientDriverCallbackContext,
+                                                                                  ClientBuffer,
+                                                                                  ClientBufferContext);
+        }
+        else
+        {
+            DMF_BufferPool_Enumerate(lane->DmfModuleBufferPoolConsumer,
+                                     BufferQueue_EnumerationCallback,
+                                     &enumerationContext,
+                                     ClientBuffer,
+                                     ClientBufferContext);
+            if ((ClientBuffer != NULL) &&
+                (*ClientBuffer != NULL))
+            {
+                InterlockedDecrement(&lane->NumberOfBuffers);
+            }
+        }
+
+        if (enumerationContext.EnumerationStopped)
+        {
+            break;
+        }
+    }
+
+    if ((ClientBuffer != NULL) &&
+        (*ClientBuffer != NULL))
+    {
+        // The Client removed a buffer.
+        //
+        BufferQueue_DequeueNotify(DmfModule);
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -483,11 +2190,78 @@ Return Value:
     ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolProducer,
                                   ClientBuffer,
                                   ClientBufferContext);
+    if (NT_SUCCESS(ntStatus) &&
+        (moduleContext->LockFreeQueue) &&
+        (ClientBufferContext != NULL))
+    {
+        // Skip the lock-free queue link.
+        //
+        *ClientBufferContext = BufferQueue_ClientBufferContextGet(*ClientBufferContext);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_FetchWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMilliseconds,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    )
+/*++
+
+Routine Description:
+
+    Removes the next buffer in the producer list (head of the list). If the list is empty,
+    waits until a buffer is returned to it or the timeout elapses.
+    Then, returns the Client Buffer and its associated Client Buffer Context.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TimeoutMilliseconds - Maximum time to wait. INFINITE means wait until a buffer is returned.
+    ClientBuffer - The Client Buffer.
+    ClientBufferContext - Client context associated with the buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if a buffer is removed from the list.
+    STATUS_IO_TIMEOUT if the list is still empty when the timeout elapses.
+    STATUS_INVALID_DEVICE_STATE if the Module closes while waiting.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_BufferQueue* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 BufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = BufferQueue_BufferWait(DmfModule,
+                                      DMF_BufferQueue_Fetch,
+                                      &moduleContext->BufferAvailableEvent,
+                                      &moduleContext->NumberOfBufferWaiters,
+                                      TimeoutMilliseconds,
+                                      ClientBuffer,
+                                      ClientBufferContext);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
 }
+#pragma code_seg()
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
@@ -499,6 +2273,7 @@ DMF_BufferQueue_Flush(
 Routine Description:
 
     Remove all buffers from consumer buffer pool and place them in producer pool.
+    NOTE: When the lock-free queue is used, this Method is a consumer operation.
 
 Arguments:
 
@@ -511,9 +2286,6 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_BufferQueue* moduleContext;
-    VOID* buffer;
-    VOID* bufferContext;
-    NTSTATUS ntStatus;
 
     FuncEntry(DMF_TRACE);
 
@@ -522,18 +2294,11 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = STATUS_SUCCESS;
-    while (NT_SUCCESS(ntStatus))
-    {
-        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
-                                      &buffer,
-                                      &bufferContext);
-        if (NT_SUCCESS(ntStatus))
-        {
-            DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
-                               buffer);
-        }
-    }
+    BufferQueue_LanesFlush(moduleContext);
+
+    BufferQueue_DequeueNotify(DmfModule);
+    BufferQueue_WaitersWake(&moduleContext->BufferAvailableEvent,
+                            &moduleContext->NumberOfBufferWaiters);
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -574,6 +2339,9 @@ Return Value:
     DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
                        ClientBuffer);
 
+    BufferQueue_WaitersWake(&moduleContext->BufferAvailableEvent,
+                            &moduleContext->NumberOfBufferWaiters);
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -20,6 +20,21 @@ Environment:
 
 #pragma once
 
+// Maximum number of priority lanes in the consumer list.
+//
+#define BUFFERQUEUE_PRIORITY_LANES_MAXIMUM      8
+
+// Callback function called when the number of buffers in the consumer list reaches
+// the high watermark or falls to the low watermark.
+//
+typedef
+_Function_class_(EVT_DMF_BufferQueue_Watermark)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_BufferQueue_Watermark(_In_ DMFMODULE DmfModule,
+                              _In_ ULONG NumberOfBuffersInQueue);
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -30,6 +45,34 @@ typedef struct
     BufferPool_SourceSettings SourceSettings;
     // Sink is configured internally. 
     //
+    // Indicates that the consumer list is a lock-free queue instead of a sink-mode BufferPool.
+    // Any number of threads may enqueue at the same time, but only a single thread may
+    // dequeue (Dequeue, DequeueMany, DequeueWithMemoryDescriptor, Enumerate and Flush) at a time.
+    //
+    ULONG EnableLockFreeQueue;
+    // Number of buffers in the consumer list at which EvtBufferQueueHighWatermark is called.
+    // Zero means the watermark callbacks are not used.
+    //
+    ULONG HighWatermark;
+    // Number of buffers in the consumer list at which EvtBufferQueueLowWatermark is called
+    // after EvtBufferQueueHighWatermark has been called. Must be less than HighWatermark.
+    //
+    ULONG LowWatermark;
+    // Optional callback called when the consumer list reaches HighWatermark.
+    //
+    EVT_DMF_BufferQueue_Watermark* EvtBufferQueueHighWatermark;
+    // Optional callback called when the consumer list falls to LowWatermark.
+    //
+    EVT_DMF_BufferQueue_Watermark* EvtBufferQueueLowWatermark;
+    // Number of priority lanes in the consumer list (up to BUFFERQUEUE_PRIORITY_LANES_MAXIMUM).
+    // Zero or one means the consumer list has a single lane.
+    //
+    ULONG NumberOfPriorityLanes;
+    // Number of buffers dequeued from higher priority lanes while a lower priority lane
+    // has buffers after which the next buffer is dequeued from the lower priority lane.
+    // Zero means lower priority lanes are only served when higher priority lanes are empty.
+    //
+    ULONG PriorityAgingThreshold;
 } DMF_CONFIG_BufferQueue;
 
 // This macro declares the following functions:
@@ -57,6 +100,27 @@ DMF_BufferQueue_Dequeue(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueMany(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfBuffersRequested,
+    _Out_writes_to_(NumberOfBuffersRequested, *NumberOfBuffersRetrieved) VOID** ClientBuffers,
+    _Out_writes_opt_(NumberOfBuffersRequested) VOID** ClientBufferContexts,
+    _Out_ ULONG* NumberOfBuffersRetrieved
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_DequeueWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMilliseconds,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -74,6 +138,22 @@ DMF_BufferQueue_Enqueue(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueMany(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfBuffers) VOID** ClientBuffers,
+    _In_ ULONG NumberOfBuffers
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_BufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferQueue_Enumerate(
@@ -93,6 +173,16 @@ DMF_BufferQueue_Fetch(
     _Out_opt_ VOID** ClientBufferContext
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_BufferQueue_FetchWait(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMilliseconds,
+    _Out_ VOID** ClientBuffer,
+    _Out_opt_ VOID** ClientBufferContext
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_BufferQueue_Flush(
@@ -23,6 +23,7 @@ Environment:
 #include "DmfModule.h"
 #include "DmfModules.Core.h"
 #include "DmfModules.Core.Trace.h"
+#include "DmfModules.Core.Hash.h"
 
 #if defined(DMF_INCLUDE_TMH)
 #include "Dmf_HashTable.tmh"
@@ -37,6 +38,10 @@ Environment:
 //
 typedef struct
 {
+    // Hash of the key (as calculated by EvtHashTableHashCalculate).
+    //
+    ULONG_PTR Hash;
+
     // The actual length of the Key data in bytes.
     //
     ULONG KeyLength;
@@ -46,14 +51,40 @@ typedef struct
     ULONG ValueLength;
 
     // Next data entry, in case of a collision.
+    // For entries that are not in use, next entry in the list of free entries.
     //
     ULONG NextEntryIndex;
 
+    // Indicates the entry holds a Key-Value pair.
+    //
+    BOOLEAN InUse;
+
     // A buffer to store key and value data. Key data comes first, value data immediately follows it.
+    // It is aligned so that the value data is aligned when the key length is a multiple of
+    // MAX_NATURAL_ALIGNMENT. This allows Clients to update values with interlocked operations.
     //
-    UCHAR RawData[ANYSIZE_ARRAY];
+    DECLSPEC_ALIGN(MAX_NATURAL_ALIGNMENT) UCHAR RawData[ANYSIZE_ARRAY];
 } DATA_ENTRY;
 
+// Maximum number of DataTable segments. The first segment holds the initial number of entries and
+// each of the others doubles the number of entries, so this is enough for any table size.
+//
+#define DATA_TABLE_SEGMENT_COUNT_MAXIMUM    (33)
+
+// State of the lock that protects the table, from the time it is acquired until it is released.
+//
+typedef struct
+{
+    // Indicates the lock is held for exclusive access.
+    //
+    BOOLEAN Exclusive;
+#if !defined(DMF_USER_MODE)
+    // IRQL to restore when the shared lock is released.
+    //
+    KIRQL OldIrql;
+#endif // !defined(DMF_USER_MODE)
+} HASH_TABLE_LOCK_STATE;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -77,30 +108,88 @@ typedef struct
     //
     ULONG HashMapSize;
 
-    // Number of elements in DataTable.
+    // Maximum number of elements in DataTable.
     //
     ULONG DataTableSize;
 
-    // Total number of allocated entries in DataTable.
+    // Number of elements in the DataTable segments allocated so far.
+    //
+    ULONG DataTableCapacity;
+
+    // Number of elements in the first DataTable segment.
+    //
+    ULONG DataSegmentSizeInitial;
+
+    // Number of DataTable segments allocated so far.
+    //
+    ULONG DataSegmentCount;
+
+    // Total number of allocated entries in DataTable. Entries past this index have never been used.
     //
     ULONG DataEntriesAllocated;
 
+    // Number of entries in DataTable that hold a Key-Value pair.
+    //
+    ULONG DataEntriesInUse;
+
+    // First entry of the list of removed entries that can be reused.
+    //
+    ULONG FreeEntryIndex;
+
+    // How entries are located in HashMap.
+    //
+    HashTable_LayoutType Layout;
+
     // An array mapping a hash of a key to an index in DataTable, where an actual key-value data is stored.
     // A hash of a key is used as an index in HashMap, and HashMap entry data is used as an index in DataTable.
-    // In case of a collision, index in HashMap will point to a first entry in a linked list of entries having the same hash.
+    // In the chained layout, in case of a collision, index in HashMap will point to a first entry in a linked list
+    // of entries having the same hash. In the open addressing layout, in case of a collision, the entry is stored
+    // in the next empty element of HashMap.
     //
     ULONG* HashMap;
     WDFMEMORY HashMapMemory;
 
-    // Array containing actual key-value data entries.
+    // Open addressing layout only. A fingerprint of the hash of the entry stored in each element of HashMap,
+    // or zero if the element is empty. It is stored in the same buffer as HashMap, after it.
+    //
+    UCHAR* Fingerprints;
+
+    // While HashMap grows, the previous HashMap (half the size of HashMap). Its entries are moved to HashMap
+    // a few at a time. The entries of the elements below RehashIndex have been moved.
+    //
+    ULONG* HashMapPrevious;
+    UCHAR* FingerprintsPrevious;
+    WDFMEMORY HashMapPreviousMemory;
+    ULONG RehashIndex;
+
+    // Segments of the array containing actual key-value data entries. The first segment holds
+    // DataSegmentSizeInitial entries. Each following segment holds as many entries as all the previous ones.
     // In case of a collision, entries with the same hash are linked into a list.
     //
-    VOID* DataTable;
-    WDFMEMORY DataTableMemory;
+    VOID* DataTable[DATA_TABLE_SEGMENT_COUNT_MAXIMUM];
+    WDFMEMORY DataTableMemory[DATA_TABLE_SEGMENT_COUNT_MAXIMUM];
 
     // A function used for hash calculation.
     //
     EVT_DMF_HashTable_HashCalculate* EvtHashTableHashCalculate;
+
+    // Seed of HashTable_HashFunction_WordAtATime. It is chosen when the Module opens so that
+    // Keys that collide in one instance do not collide in others.
+    //
+    ULONGLONG HashSeed;
+
+    // How Methods synchronize access to the table.
+    //
+    HashTable_ConcurrencyType Concurrency;
+
+    // HashTable_Concurrency_SharedReaders only. Methods that do not add or remove entries acquire it
+    // in shared mode so that they run at the same time. Other Methods acquire it in exclusive mode.
+    //
+#if !defined(DMF_USER_MODE)
+    EX_SPIN_LOCK SharedLock;
+#else
+    SRWLOCK SharedLock;
+#endif // !defined(DMF_USER_MODE)
 } DMF_CONTEXT_HashTable;
 
 // This macro declares the following function:
@@ -130,6 +219,159 @@ DMF_MODULE_DECLARE_CONFIG(HashTable)
 //
 #define HASH_MAP_SIZE_MULTIPLIER  2
 
+// Number of buckets of the previous hash map that are moved to the new hash map by each operation
+// that adds or removes entries while the hash map grows. The hash map doubles when the number of
+// entries reaches half its size, so the move is complete long before the next growth.
+//
+#define REHASH_BUCKETS_PER_OPERATION    4
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_LockAcquire(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Exclusive,
+    _Out_ HASH_TABLE_LOCK_STATE* LockState
+    )
+/*++
+
+Routine Description:
+
+    Acquires the lock that protects the table. With HashTable_Concurrency_Exclusive, the Module lock
+    is acquired regardless of the requested access. With HashTable_Concurrency_SharedReaders, the shared
+    lock is acquired in the requested mode.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Exclusive - TRUE if the caller adds or removes entries, FALSE if it only looks up entries.
+    LockState - Receives the state needed to release the lock.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    LockState->Exclusive = Exclusive;
+
+    if (HashTable_Concurrency_Exclusive == moduleContext->Concurrency)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+    else if (Exclusive)
+    {
+#if !defined(DMF_USER_MODE)
+        LockState->OldIrql = ExAcquireSpinLockExclusive(&moduleContext->SharedLock);
+#else
+        AcquireSRWLockExclusive(&moduleContext->SharedLock);
+#endif // !defined(DMF_USER_MODE)
+    }
+    else
+    {
+#if !defined(DMF_USER_MODE)
+        LockState->OldIrql = ExAcquireSpinLockShared(&moduleContext->SharedLock);
+#else
+        AcquireSRWLockShared(&moduleContext->SharedLock);
+#endif // !defined(DMF_USER_MODE)
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_LockRelease(
+    _In_ DMFMODULE DmfModule,
+    _In_ HASH_TABLE_LOCK_STATE* LockState
+    )
+/*++
+
+Routine Description:
+
+    Releases the lock acquired by HashTable_LockAcquire().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    LockState - The state returned by HashTable_LockAcquire().
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (HashTable_Concurrency_Exclusive == moduleContext->Concurrency)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+    else if (LockState->Exclusive)
+    {
+#if !defined(DMF_USER_MODE)
+        ExReleaseSpinLockExclusive(&moduleContext->SharedLock,
+                                   LockState->OldIrql);
+#else
+        ReleaseSRWLockExclusive(&moduleContext->SharedLock);
+#endif // !defined(DMF_USER_MODE)
+    }
+    else
+    {
+#if !defined(DMF_USER_MODE)
+        ExReleaseSpinLockShared(&moduleContext->SharedLock,
+                                LockState->OldIrql);
+#else
+        ReleaseSRWLockShared(&moduleContext->SharedLock);
+#endif // !defined(DMF_USER_MODE)
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+inline
+BOOLEAN
+HashTable_IsLocked(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Indicates whether the lock that protects the table is held (in any mode). Used for validation only.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    TRUE if the lock is held.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (HashTable_Concurrency_Exclusive == moduleContext->Concurrency)
+    {
+        return DMF_ModuleIsLocked(DmfModule);
+    }
+
+#if !defined(DMF_USER_MODE)
+    return (moduleContext->SharedLock != 0);
+#else
+    return (moduleContext->SharedLock.Ptr != NULL);
+#endif // !defined(DMF_USER_MODE)
+}
+
 static
 inline
 DATA_ENTRY*
@@ -154,7 +396,28 @@ Return Value:
 
 --*/
 {
-    return (DATA_ENTRY*)((UCHAR*)ModuleContext->DataTable + ModuleContext->DataEntrySize * EntryIndex);
+    ULONG segmentIndex;
+    ULONGLONG segmentEnd;
+
+    DmfAssert(EntryIndex < ModuleContext->DataTableCapacity);
+
+    // Segment 0 holds entries [0, DataSegmentSizeInitial). Segment N (N > 0) holds
+    // entries [DataSegmentSizeInitial << (N - 1), DataSegmentSizeInitial << N).
+    //
+    segmentIndex = 0;
+    segmentEnd = ModuleContext->DataSegmentSizeInitial;
+    while (EntryIndex >= segmentEnd)
+    {
+        segmentIndex++;
+        segmentEnd <<= 1;
+    }
+
+    if (segmentIndex > 0)
+    {
+        EntryIndex -= (ULONG)(segmentEnd >> 1);
+    }
+
+    return (DATA_ENTRY*)((UCHAR*)ModuleContext->DataTable[segmentIndex] + (size_t)ModuleContext->DataEntrySize * EntryIndex);
 }
 
 static
@@ -219,7 +482,7 @@ HashTable_HashCalculate(
 
 Routine Description:
 
-    Default hash function. Calculates FNV-1a hash for specified buffer.
+    Default hash function (HashTable_HashFunction_Fnv1a). Calculates FNV-1a hash for specified buffer.
 
 Arguments:
 
@@ -257,6 +520,44 @@ Return Value:
     return (result);
 }
 
+_Function_class_(EVT_DMF_HashTable_HashCalculate)
+static
+ULONG_PTR
+HashTable_HashCalculateWordAtATime(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Calculates a hash for specified buffer 8 bytes at a time using the mixing steps of XXH64.
+    The hash is seeded with a random value chosen for this Module instance.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Key - Address of the buffer containing Key data to calculate the hash.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    Hash of the data specified in Key buffer.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // On 32 bit platforms, the low bits are used. They depend on every bit of the Key.
+    //
+    return (ULONG_PTR)DMF_Hash_WordAtATime(moduleContext->HashSeed,
+                                           Key,
+                                           KeyLength);
+}
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
@@ -280,6 +581,8 @@ Return Value:
 
 --*/
 {
+    ULONG segmentIndex;
+
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
@@ -290,92 +593,115 @@ Return Value:
     {
         WdfObjectDelete(ModuleContext->HashMapMemory);
         ModuleContext->HashMap = NULL;
+        ModuleContext->Fingerprints = NULL;
+    }
+
+    if (NULL != ModuleContext->HashMapPrevious)
+    {
+        WdfObjectDelete(ModuleContext->HashMapPreviousMemory);
+        ModuleContext->HashMapPrevious = NULL;
+        ModuleContext->FingerprintsPrevious = NULL;
     }
 
-    if (NULL != ModuleContext->DataTable)
+    for (segmentIndex = 0; segmentIndex < ModuleContext->DataSegmentCount; segmentIndex++)
     {
-        WdfObjectDelete(ModuleContext->DataTableMemory);
-        ModuleContext->DataTable = NULL;
+        WdfObjectDelete(ModuleContext->DataTableMemory[segmentIndex]);
+        ModuleContext->DataTable[segmentIndex] = NULL;
     }
+    ModuleContext->DataSegmentCount = 0;
+    ModuleContext->DataTableCapacity = 0;
 
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_max_(DISPATCH_LEVEL)
 static
-NTSTATUS
-HashTable_ContextInitialize(
-    _In_ DMF_CONFIG_HashTable* ModuleConfig,
-    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+size_t
+HashTable_HashMapAllocationSizeGet(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG HashMapSize
     )
 /*++
 
 Routine Description:
 
-    Initializes the Module Context.
+    Returns the size of the buffer that holds a HashMap of a given number of elements. In the
+    open addressing layout, the fingerprints of the elements immediately follow HashMap.
 
 Arguments:
 
-    ModuleConfig - This Module's Config.
-    ModuleContext - This Module's Context to initialize.
+    ModuleContext - This Module's context.
+    HashMapSize - The given number of elements.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    Size of the buffer in bytes.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
     size_t sizeToAllocate;
 
-    PAGED_CODE();
+    sizeToAllocate = (size_t)HashMapSize * sizeof(ULONG);
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        sizeToAllocate += (size_t)HashMapSize * sizeof(UCHAR);
+    }
 
-    FuncEntry(DMF_TRACE);
+    return sizeToAllocate;
+}
 
-    DmfAssert(NULL != ModuleConfig);
-    DmfAssert(NULL != ModuleContext);
-    DmfAssert(NULL == ModuleContext->HashMap);
-    DmfAssert(NULL == ModuleContext->DataTable);
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataSegmentAdd(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
 
-    ModuleContext->MaximumKeyLength = ModuleConfig->MaximumKeyLength;
-    ModuleContext->MaximumValueLength = ModuleConfig->MaximumValueLength;
+Routine Description:
 
-    // Calculate the size of DATA_ENTRY structure and make sure it's properly aligned.
-    //
-    ModuleContext->DataEntrySize = FIELD_OFFSET(DATA_ENTRY, RawData[ModuleConfig->MaximumKeyLength + ModuleConfig->MaximumValueLength]);
-    ModuleContext->DataEntrySize = (ModuleContext->DataEntrySize + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
+    Allocates the next DataTable segment. Existing entries do not move.
 
-    ModuleContext->HashMapSize = ModuleConfig->MaximumTableSize * HASH_MAP_SIZE_MULTIPLIER;
-    ModuleContext->DataTableSize = ModuleConfig->MaximumTableSize;
+Arguments:
 
-    ModuleContext->DataEntriesAllocated = 0;
+    ModuleContext - This Module's context.
 
-    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
-                "Create hash table: MaximumKeyLength=%u, MaximumValueLength=%u, DataEntrySize=%u, MaximumTableSize=%u",
-                ModuleContext->MaximumKeyLength,
-                ModuleContext->MaximumValueLength,
-                ModuleContext->DataEntrySize,
-                ModuleConfig->MaximumTableSize);
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONGLONG segmentSize;
+    size_t sizeToAllocate;
+    ULONG segmentIndex;
 
-    // Use the default hash function, if a custom function is not specified.
+    segmentIndex = ModuleContext->DataSegmentCount;
+    DmfAssert(ModuleContext->DataTableCapacity < ModuleContext->DataTableSize);
+    DmfAssert(segmentIndex < DATA_TABLE_SEGMENT_COUNT_MAXIMUM);
+
+    // The first segment has the initial size. Each following segment doubles the capacity,
+    // but the capacity never exceeds the maximum.
     //
-    if (ModuleConfig->EvtHashTableHashCalculate != NULL)
+    if (0 == segmentIndex)
     {
-        // Custom function.
-        //
-        ModuleContext->EvtHashTableHashCalculate = ModuleConfig->EvtHashTableHashCalculate;
+        segmentSize = ModuleContext->DataSegmentSizeInitial;
     }
     else
     {
-        // Default function.
-        //
-        ModuleContext->EvtHashTableHashCalculate = HashTable_HashCalculate;
+        segmentSize = (ULONGLONG)ModuleContext->DataSegmentSizeInitial << (segmentIndex - 1);
+    }
+    if (segmentSize > (ULONGLONG)ModuleContext->DataTableSize - ModuleContext->DataTableCapacity)
+    {
+        segmentSize = (ULONGLONG)ModuleContext->DataTableSize - ModuleContext->DataTableCapacity;
     }
 
-    sizeToAllocate = ModuleContext->HashMapSize * sizeof(ULONG);
+    sizeToAllocate = (size_t)segmentSize * ModuleContext->DataEntrySize;
+    DmfAssert(sizeToAllocate != 0);
 
     WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
     // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
@@ -385,41 +711,182 @@ Return Value:
                                NonPagedPoolNx,
                                MemoryTag,
                                sizeToAllocate,
-                               &ModuleContext->HashMapMemory,
-                               (VOID**)&ModuleContext->HashMap);
+                               &ModuleContext->DataTableMemory[segmentIndex],
+                               (VOID**)&ModuleContext->DataTable[segmentIndex]);
     if (! NT_SUCCESS(ntStatus))
     {
         TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        ModuleContext->DataTable[segmentIndex] = NULL;
         goto Exit;
     }
 
-    RtlFillMemory(ModuleContext->HashMap,
-                  sizeToAllocate,
-                  INVALID_INDEX);
+    // The segment is not zeroed here because that would stall the operation that adds it for
+    // a time proportional to its size. Each entry is initialized when it is first used.
+    //
+    ModuleContext->DataSegmentCount++;
+    ModuleContext->DataTableCapacity += (ULONG)segmentSize;
 
-    sizeToAllocate = ModuleContext->DataTableSize * ModuleContext->DataEntrySize;
-    DmfAssert(sizeToAllocate != 0);
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "Add DataTable segment: segmentIndex=%u, DataTableCapacity=%u",
+                segmentIndex,
+                ModuleContext->DataTableCapacity);
 
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
-    //
-    #pragma warning(suppress:28160)
+Exit:
+
+    return ntStatus;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+HashTable_ContextInitialize(
+    _In_ DMF_CONFIG_HashTable* ModuleConfig,
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Initializes the Module Context.
+
+Arguments:
+
+    ModuleConfig - This Module's Config.
+    ModuleContext - This Module's Context to initialize.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    size_t sizeToAllocate;
+    LARGE_INTEGER counter;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(NULL != ModuleConfig);
+    DmfAssert(NULL != ModuleContext);
+    DmfAssert(NULL == ModuleContext->HashMap);
+    DmfAssert(0 == ModuleContext->DataSegmentCount);
+
+    ModuleContext->MaximumKeyLength = ModuleConfig->MaximumKeyLength;
+    ModuleContext->MaximumValueLength = ModuleConfig->MaximumValueLength;
+    DmfAssert(ModuleConfig->Layout < HashTable_Layout_Maximum);
+    ModuleContext->Layout = ModuleConfig->Layout;
+    DmfAssert(ModuleConfig->Concurrency < HashTable_Concurrency_Maximum);
+    ModuleContext->Concurrency = ModuleConfig->Concurrency;
+#if !defined(DMF_USER_MODE)
+    ModuleContext->SharedLock = 0;
+#else
+    InitializeSRWLock(&ModuleContext->SharedLock);
+#endif // !defined(DMF_USER_MODE)
+
+    // Calculate the size of DATA_ENTRY structure and make sure it's properly aligned.
+    //
+    ModuleContext->DataEntrySize = FIELD_OFFSET(DATA_ENTRY, RawData[ModuleConfig->MaximumKeyLength + ModuleConfig->MaximumValueLength]);
+    ModuleContext->DataEntrySize = (ModuleContext->DataEntrySize + MAX_NATURAL_ALIGNMENT - 1) & ~(MAX_NATURAL_ALIGNMENT - 1);
+
+    // Unless the Client asks for a smaller initial size, all the entries are allocated now.
+    //
+    ModuleContext->DataTableSize = ModuleConfig->MaximumTableSize;
+    if ((ModuleConfig->InitialTableSize > 0) &&
+        (ModuleConfig->InitialTableSize < ModuleConfig->MaximumTableSize))
+    {
+        ModuleContext->DataSegmentSizeInitial = ModuleConfig->InitialTableSize;
+    }
+    else
+    {
+        ModuleContext->DataSegmentSizeInitial = ModuleConfig->MaximumTableSize;
+    }
+    ModuleContext->HashMapSize = ModuleContext->DataSegmentSizeInitial * HASH_MAP_SIZE_MULTIPLIER;
+
+    ModuleContext->DataEntriesAllocated = 0;
+    ModuleContext->DataEntriesInUse = 0;
+    ModuleContext->FreeEntryIndex = INVALID_INDEX;
+    ModuleContext->HashMapPrevious = NULL;
+    ModuleContext->FingerprintsPrevious = NULL;
+    ModuleContext->RehashIndex = 0;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE,
+                "Create hash table: MaximumKeyLength=%u, MaximumValueLength=%u, DataEntrySize=%u, MaximumTableSize=%u, InitialTableSize=%u, Layout=%d",
+                ModuleContext->MaximumKeyLength,
+                ModuleContext->MaximumValueLength,
+                ModuleContext->DataEntrySize,
+                ModuleConfig->MaximumTableSize,
+                ModuleContext->DataSegmentSizeInitial,
+                ModuleContext->Layout);
+
+    // Use the built-in hash function selected by the Client, if a custom function is not specified.
+    //
+    DmfAssert(ModuleConfig->HashFunction < HashTable_HashFunction_Maximum);
+    if (ModuleConfig->EvtHashTableHashCalculate != NULL)
+    {
+        // Custom function.
+        //
+        ModuleContext->EvtHashTableHashCalculate = ModuleConfig->EvtHashTableHashCalculate;
+    }
+    else if (HashTable_HashFunction_WordAtATime == ModuleConfig->HashFunction)
+    {
+        // Seed it with a value that differs for each instance. It does not need to be
+        // cryptographically random. It only needs to be hard to predict from outside the driver.
+        //
+#if !defined(DMF_USER_MODE)
+        counter = KeQueryPerformanceCounter(NULL);
+#else
+        QueryPerformanceCounter(&counter);
+#endif // !defined(DMF_USER_MODE)
+        ModuleContext->HashSeed = DMF_Hash_Avalanche((ULONGLONG)counter.QuadPart ^
+                                                     (ULONGLONG)(ULONG_PTR)ModuleContext);
+        ModuleContext->EvtHashTableHashCalculate = HashTable_HashCalculateWordAtATime;
+    }
+    else
+    {
+        // Default function.
+        //
+        ModuleContext->EvtHashTableHashCalculate = HashTable_HashCalculate;
+    }
+
+    sizeToAllocate = HashTable_HashMapAllocationSizeGet(ModuleContext,
+                                                        ModuleContext->HashMapSize);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    // 'Error annotation: __formal(3,BufferSize) cannot be zero.'.
+    //
+    #pragma warning(suppress:28160)
     ntStatus = WdfMemoryCreate(&objectAttributes,
                                NonPagedPoolNx,
                                MemoryTag,
                                sizeToAllocate,
-                               &ModuleContext->DataTableMemory,
-                               (VOID**)&ModuleContext->DataTable);
+                               &ModuleContext->HashMapMemory,
+                               (VOID**)&ModuleContext->HashMap);
     if (! NT_SUCCESS(ntStatus))
     {
         TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
         goto Exit;
     }
 
-    RtlZeroMemory(ModuleContext->DataTable,
-                  sizeToAllocate);
+    RtlFillMemory(ModuleContext->HashMap,
+                  ModuleContext->HashMapSize * sizeof(ULONG),
+                  INVALID_INDEX);
 
-    ntStatus = STATUS_SUCCESS;
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        ModuleContext->Fingerprints = (UCHAR*)(ModuleContext->HashMap + ModuleContext->HashMapSize);
+        RtlZeroMemory(ModuleContext->Fingerprints,
+                      ModuleContext->HashMapSize);
+    }
+
+    ntStatus = HashTable_DataSegmentAdd(ModuleContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
 
 Exit:
 
@@ -434,102 +901,1675 @@ Exit:
 }
 #pragma code_seg()
 
+static
+inline
+UCHAR
+HashTable_FingerprintGet(
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Returns the fingerprint of a hash that is stored in the open addressing layout. The bits of
+    the hash are mixed so that the fingerprint does not depend only on the bits that select the
+    HashMap element.
+
+Arguments:
+
+    Hash - The given hash.
+
+Return Value:
+
+    The fingerprint of the given hash. It is never zero since zero indicates an empty element.
+
+--*/
+{
+    ULONG folded;
+    UCHAR fingerprint;
+
+    folded = (ULONG)Hash;
+#if defined(_WIN64)
+    folded ^= (ULONG)(Hash >> 32);
+#endif // defined(_WIN64)
+    folded *= 0x9E3779B1;
+    fingerprint = (UCHAR)(folded >> 24);
+    if (0 == fingerprint)
+    {
+        fingerprint = 1;
+    }
+
+    return fingerprint;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
 static
-NTSTATUS
-HashTable_DataEntryAllocate(
-    _In_ DMFMODULE DmfModule,
+ULONG*
+HashTable_BucketGet(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Chained layout only. Returns the address of the HashMap element that holds the first entry of
+    the list of entries that have a given hash. While HashMap grows, this is in the previous HashMap
+    unless the entries of that bucket have already been moved.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Hash - The given hash.
+
+Return Value:
+
+    Address of the HashMap element.
+
+--*/
+{
+    ULONG bucketIndex;
+
+    if (ModuleContext->HashMapPrevious != NULL)
+    {
+        bucketIndex = (ULONG)(Hash % (ModuleContext->HashMapSize / 2));
+        if (bucketIndex >= ModuleContext->RehashIndex)
+        {
+            return &ModuleContext->HashMapPrevious[bucketIndex];
+        }
+    }
+
+    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
+    //
+    bucketIndex = (ULONG)(Hash % ModuleContext->HashMapSize);
+
+    return &ModuleContext->HashMap[bucketIndex];
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG*
+HashTable_DataEntryLinkFind(
     _In_ DMF_CONTEXT_HashTable* ModuleContext,
     _In_reads_(KeyLength) UCHAR* Key,
     _In_ ULONG KeyLength,
-    _Out_ ULONG* NewEntryIndex
+    _In_ ULONG_PTR Hash
     )
 /*++
 
 Routine Description:
 
-    Allocates data entry for specified key and returns its index.
+    Chained layout only. Finds the link (HashMap element or NextEntryIndex of the previous entry)
+    that holds the index of the entry with specified key. If there is no such entry, the link at
+    the end of the list is returned. It holds INVALID_INDEX.
 
 Arguments:
 
     ModuleContext - This Module's context.
     Key - Address of the buffer containing Key data.
     KeyLength - Length of Key data in bytes.
-    NewEntryIndex - A pointer to store the index of the allocated data entry.
+    Hash - Hash of the Key.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    Address of the link.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DATA_ENTRY* entry;
-    ULONG entryIndex;
-    UCHAR* keyBuffer;
+    ULONG* link;
+    DATA_ENTRY* currentEntry;
 
-    UNREFERENCED_PARAMETER(DmfModule);
+    link = HashTable_BucketGet(ModuleContext,
+                               Hash);
+
+    // Search the table for the given key.
+    //
+    while (*link != INVALID_INDEX)
+    {
+        currentEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                                  *link);
+        if ((currentEntry->Hash == Hash) &&
+            (currentEntry->KeyLength == KeyLength) &&
+            (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
+                              Key,
+                              KeyLength) == KeyLength))
+        {
+            // We have found the element with the key we are looking for.
+            //
+            break;
+        }
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+        link = &currentEntry->NextEntryIndex;
+    }
 
-    DmfAssert(NewEntryIndex != NULL);
+    return link;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+HashTable_SlotFind(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG* HashMap,
+    _In_ UCHAR* Fingerprints,
+    _In_ ULONG HashMapSize,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Open addressing layout only. Finds the element of a given HashMap that holds the entry with
+    specified key. Elements are probed linearly from the element selected by the hash until an
+    empty element is found. The entry is only read when the fingerprint matches.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    HashMap - The given HashMap (current or previous).
+    Fingerprints - The fingerprints of the given HashMap.
+    HashMapSize - Number of elements in the given HashMap.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+
+Return Value:
+
+    Index of the element that holds the entry or INVALID_INDEX if it is not found.
+
+--*/
+{
+    ULONG slot;
+    UCHAR fingerprint;
+    DATA_ENTRY* currentEntry;
+
+    fingerprint = HashTable_FingerprintGet(Hash);
+    slot = (ULONG)(Hash % HashMapSize);
 
-    if (ModuleContext->DataEntriesAllocated >= ModuleContext->DataTableSize)
+    // There is always at least one empty element, so this loop ends.
+    //
+    while (Fingerprints[slot] != 0)
     {
-        ntStatus = STATUS_BUFFER_TOO_SMALL;
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
-        DmfAssert(FALSE);
-        goto Exit;
+        // Elements of the previous HashMap whose entry has moved keep their fingerprint
+        // so that probing continues past them, but hold INVALID_INDEX.
+        //
+        if ((Fingerprints[slot] == fingerprint) &&
+            (HashMap[slot] != INVALID_INDEX))
+        {
+            currentEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                                      HashMap[slot]);
+            if ((currentEntry->Hash == Hash) &&
+                (currentEntry->KeyLength == KeyLength) &&
+                (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
+                                  Key,
+                                  KeyLength) == KeyLength))
+            {
+                return slot;
+            }
+        }
+
+        slot++;
+        if (slot == HashMapSize)
+        {
+            slot = 0;
+        }
+    }
+
+    return INVALID_INDEX;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SlotInsert(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG EntryIndex,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Open addressing layout only. Stores an entry in the first empty element of HashMap starting at
+    the element selected by its hash.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    EntryIndex - Index of the entry in DataTable.
+    Hash - Hash of the entry's Key.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG slot;
+
+    slot = (ULONG)(Hash % ModuleContext->HashMapSize);
+    while (ModuleContext->Fingerprints[slot] != 0)
+    {
+        slot++;
+        if (slot == ModuleContext->HashMapSize)
+        {
+            slot = 0;
+        }
     }
 
-    entryIndex = ModuleContext->DataEntriesAllocated;
-    ++(ModuleContext->DataEntriesAllocated);
+    ModuleContext->Fingerprints[slot] = HashTable_FingerprintGet(Hash);
+    ModuleContext->HashMap[slot] = EntryIndex;
+}
 
-    entry = HashTable_IndexToDataEntry(ModuleContext,
-                                       entryIndex);
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_SlotDelete(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG Slot
+    )
+/*++
+
+Routine Description:
+
+    Open addressing layout only. Empties an element of HashMap. The following entries of the same
+    probe sequence are shifted back into the hole so that no marker of the deleted entry is needed
+    and probe sequences stay short.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Slot - Index of the element to empty.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG hole;
+    ULONG slot;
+    ULONG home;
+    BOOLEAN homeIsBetween;
+
+    hole = Slot;
+    slot = Slot;
+    for (;;)
+    {
+        slot++;
+        if (slot == ModuleContext->HashMapSize)
+        {
+            slot = 0;
+        }
+        if (0 == ModuleContext->Fingerprints[slot])
+        {
+            break;
+        }
+
+        // The entry can move back to the hole unless the element selected by its hash is
+        // (cyclically) after the hole.
+        //
+        home = (ULONG)(HashTable_IndexToDataEntry(ModuleContext,
+                                                  ModuleContext->HashMap[slot])->Hash % ModuleContext->HashMapSize);
+        if (hole <= slot)
+        {
+            homeIsBetween = (home > hole) && (home <= slot);
+        }
+        else
+        {
+            homeIsBetween = (home > hole) || (home <= slot);
+        }
+        if (homeIsBetween)
+        {
+            continue;
+        }
+
+        ModuleContext->Fingerprints[hole] = ModuleContext->Fingerprints[slot];
+        ModuleContext->HashMap[hole] = ModuleContext->HashMap[slot];
+        hole = slot;
+    }
+
+    ModuleContext->Fingerprints[hole] = 0;
+    ModuleContext->HashMap[hole] = INVALID_INDEX;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+HashTable_EntryIndexFind(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+
+Return Value:
+
+    Index of the entry in DataTable or INVALID_INDEX if it is not found.
+
+--*/
+{
+    ULONG slot;
+
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        slot = HashTable_SlotFind(ModuleContext,
+                                  ModuleContext->HashMap,
+                                  ModuleContext->Fingerprints,
+                                  ModuleContext->HashMapSize,
+                                  Key,
+                                  KeyLength,
+                                  Hash);
+        if (slot != INVALID_INDEX)
+        {
+            return ModuleContext->HashMap[slot];
+        }
+
+        // While HashMap grows, entries that have not moved yet are in the previous HashMap.
+        //
+        if (ModuleContext->HashMapPrevious != NULL)
+        {
+            slot = HashTable_SlotFind(ModuleContext,
+                                      ModuleContext->HashMapPrevious,
+                                      ModuleContext->FingerprintsPrevious,
+                                      ModuleContext->HashMapSize / 2,
+                                      Key,
+                                      KeyLength,
+                                      Hash);
+            if (slot != INVALID_INDEX)
+            {
+                return ModuleContext->HashMapPrevious[slot];
+            }
+        }
+
+        return INVALID_INDEX;
+    }
+
+    return *HashTable_DataEntryLinkFind(ModuleContext,
+                                        Key,
+                                        KeyLength,
+                                        Hash);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_EntryIndexInsert(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG EntryIndex,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Adds an entry that is not in HashMap to HashMap.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    EntryIndex - Index of the entry in DataTable.
+    Hash - Hash of the entry's Key.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG* bucket;
+
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        // New entries always go to the current HashMap.
+        //
+        HashTable_SlotInsert(ModuleContext,
+                             EntryIndex,
+                             Hash);
+    }
+    else
+    {
+        // Add the entry at the beginning of the list of its bucket.
+        //
+        bucket = HashTable_BucketGet(ModuleContext,
+                                     Hash);
+        HashTable_IndexToDataEntry(ModuleContext,
+                                   EntryIndex)->NextEntryIndex = *bucket;
+        *bucket = EntryIndex;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+HashTable_EntryIndexRemove(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key and removes it from HashMap.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+
+Return Value:
+
+    Index of the removed entry in DataTable or INVALID_INDEX if it is not found.
+
+--*/
+{
+    ULONG* link;
+    ULONG slot;
+    ULONG entryIndex;
+
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        slot = HashTable_SlotFind(ModuleContext,
+                                  ModuleContext->HashMap,
+                                  ModuleContext->Fingerprints,
+                                  ModuleContext->HashMapSize,
+                                  Key,
+                                  KeyLength,
+                                  Hash);
+        if (slot != INVALID_INDEX)
+        {
+            entryIndex = ModuleContext->HashMap[slot];
+            HashTable_SlotDelete(ModuleContext,
+                                 slot);
+            return entryIndex;
+        }
+
+        if (ModuleContext->HashMapPrevious != NULL)
+        {
+            slot = HashTable_SlotFind(ModuleContext,
+                                      ModuleContext->HashMapPrevious,
+                                      ModuleContext->FingerprintsPrevious,
+                                      ModuleContext->HashMapSize / 2,
+                                      Key,
+                                      KeyLength,
+                                      Hash);
+            if (slot != INVALID_INDEX)
+            {
+                // Keep the fingerprint so that probing continues past this element
+                // until the previous HashMap is freed.
+                //
+                entryIndex = ModuleContext->HashMapPrevious[slot];
+                ModuleContext->HashMapPrevious[slot] = INVALID_INDEX;
+                return entryIndex;
+            }
+        }
+
+        return INVALID_INDEX;
+    }
+
+    link = HashTable_DataEntryLinkFind(ModuleContext,
+                                       Key,
+                                       KeyLength,
+                                       Hash);
+    entryIndex = *link;
+    if (entryIndex != INVALID_INDEX)
+    {
+        *link = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex)->NextEntryIndex;
+    }
+
+    return entryIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_RehashStep(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    While HashMap grows, moves the entries of a few elements of the previous HashMap to HashMap.
+    When all the elements have moved, the previous HashMap is freed.
+    In the chained layout, the entries of bucket B of the previous HashMap move to bucket B or
+    bucket B + (HashMapSize / 2), since the size doubles. These buckets are initialized here, so
+    HashMap does not need to be initialized when it is allocated.
+    In the open addressing layout, the entry of each element is inserted in HashMap. The element
+    keeps its fingerprint so that probing in the previous HashMap still works.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG previousSize;
+    ULONG bucketsMoved;
+    ULONG entryIndex;
+    ULONG bucketIndex;
+    ULONG tailIndex[2];
+    DATA_ENTRY* dataEntry;
+
+    if (NULL == ModuleContext->HashMapPrevious)
+    {
+        return;
+    }
+
+    previousSize = ModuleContext->HashMapSize / 2;
+
+    for (bucketsMoved = 0; (bucketsMoved < REHASH_BUCKETS_PER_OPERATION) && (ModuleContext->RehashIndex < previousSize); bucketsMoved++)
+    {
+        if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+        {
+            entryIndex = ModuleContext->HashMapPrevious[ModuleContext->RehashIndex];
+            if ((ModuleContext->FingerprintsPrevious[ModuleContext->RehashIndex] != 0) &&
+                (entryIndex != INVALID_INDEX))
+            {
+                HashTable_SlotInsert(ModuleContext,
+                                     entryIndex,
+                                     HashTable_IndexToDataEntry(ModuleContext,
+                                                                entryIndex)->Hash);
+                ModuleContext->HashMapPrevious[ModuleContext->RehashIndex] = INVALID_INDEX;
+            }
+
+            ModuleContext->RehashIndex++;
+            continue;
+        }
+
+        ModuleContext->HashMap[ModuleContext->RehashIndex] = INVALID_INDEX;
+        ModuleContext->HashMap[ModuleContext->RehashIndex + previousSize] = INVALID_INDEX;
+        tailIndex[0] = INVALID_INDEX;
+        tailIndex[1] = INVALID_INDEX;
+
+        // Append each entry to the end of the list of its new bucket so that the order is kept.
+        //
+        entryIndex = ModuleContext->HashMapPrevious[ModuleContext->RehashIndex];
+        while (entryIndex != INVALID_INDEX)
+        {
+            ULONG listIndex;
+
+            dataEntry = HashTable_IndexToDataEntry(ModuleContext,
+                                                   entryIndex);
+            bucketIndex = (ULONG)(dataEntry->Hash % ModuleContext->HashMapSize);
+            DmfAssert((bucketIndex == ModuleContext->RehashIndex) ||
+                      (bucketIndex == ModuleContext->RehashIndex + previousSize));
+            listIndex = (bucketIndex == ModuleContext->RehashIndex) ? 0 : 1;
+
+            if (INVALID_INDEX == tailIndex[listIndex])
+            {
+                ModuleContext->HashMap[bucketIndex] = entryIndex;
+            }
+            else
+            {
+                HashTable_IndexToDataEntry(ModuleContext,
+                                           tailIndex[listIndex])->NextEntryIndex = entryIndex;
+            }
+            tailIndex[listIndex] = entryIndex;
+
+            entryIndex = dataEntry->NextEntryIndex;
+            dataEntry->NextEntryIndex = INVALID_INDEX;
+        }
+
+        ModuleContext->RehashIndex++;
+    }
+
+    if (ModuleContext->RehashIndex == previousSize)
+    {
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Rehash complete: HashMapSize=%u", ModuleContext->HashMapSize);
+
+        WdfObjectDelete(ModuleContext->HashMapPreviousMemory);
+        ModuleContext->HashMapPreviousMemory = NULL;
+        ModuleContext->HashMapPrevious = NULL;
+        ModuleContext->FingerprintsPrevious = NULL;
+        ModuleContext->RehashIndex = 0;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_HashMapGrow(
+    _Inout_ DMF_CONTEXT_HashTable* ModuleContext
+    )
+/*++
+
+Routine Description:
+
+    Starts doubling HashMap if the number of entries reaches the load factor. Entries are moved
+    to the new HashMap incrementally by HashTable_RehashStep(). HashMap does not grow once it has
+    the size it has when all the entries are allocated when the Module opens (HASH_MAP_SIZE_MULTIPLIER
+    times MaximumTableSize). Since there are never more than MaximumTableSize entries, that HashMap
+    is never more than half full, so a table that is allocated when the Module opens never allocates
+    memory after that.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+
+Return Value:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY hashMapMemory;
+    ULONG* hashMap;
+    ULONG hashMapSize;
+
+    if ((ModuleContext->HashMapPrevious != NULL) ||
+        (ModuleContext->DataEntriesInUse < ModuleContext->HashMapSize / HASH_MAP_SIZE_MULTIPLIER) ||
+        ((ULONGLONG)ModuleContext->HashMapSize >= (ULONGLONG)ModuleContext->DataTableSize * HASH_MAP_SIZE_MULTIPLIER) ||
+        (ModuleContext->HashMapSize > MAXULONG / 2))
+    {
+        return;
+    }
+
+    hashMapSize = ModuleContext->HashMapSize * 2;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               HashTable_HashMapAllocationSizeGet(ModuleContext,
+                                                                  hashMapSize),
+                               &hashMapMemory,
+                               (VOID**)&hashMap);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // The table still works with longer lists. Try again later.
+        //
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        return;
+    }
+
+    ModuleContext->HashMapPrevious = ModuleContext->HashMap;
+    ModuleContext->HashMapPreviousMemory = ModuleContext->HashMapMemory;
+    ModuleContext->FingerprintsPrevious = ModuleContext->Fingerprints;
+    ModuleContext->HashMap = hashMap;
+    ModuleContext->HashMapMemory = hashMapMemory;
+    ModuleContext->HashMapSize = hashMapSize;
+    ModuleContext->RehashIndex = 0;
+
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        // Only the fingerprints need to be initialized. HashMap elements are only read when
+        // their fingerprint is not zero.
+        //
+        ModuleContext->Fingerprints = (UCHAR*)(hashMap + hashMapSize);
+        RtlZeroMemory(ModuleContext->Fingerprints,
+                      hashMapSize);
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Rehash start: HashMapSize=%u", ModuleContext->HashMapSize);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryAllocate(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _Out_ ULONG* NewEntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Allocates data entry for specified key and returns its index.
+    Removed entries are reused first. Then, unused entries are used. Then, DataTable grows.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+    NewEntryIndex - A pointer to store the index of the allocated data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DATA_ENTRY* entry;
+    ULONG entryIndex;
+    UCHAR* keyBuffer;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(HashTable_IsLocked(DmfModule));
+
+    DmfAssert(NewEntryIndex != NULL);
+
+    if (ModuleContext->FreeEntryIndex != INVALID_INDEX)
+    {
+        entryIndex = ModuleContext->FreeEntryIndex;
+        entry = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex);
+        DmfAssert(! entry->InUse);
+        ModuleContext->FreeEntryIndex = entry->NextEntryIndex;
+    }
+    else
+    {
+        if (ModuleContext->DataEntriesAllocated >= ModuleContext->DataTableSize)
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No more free slots available");
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+
+        if (ModuleContext->DataEntriesAllocated >= ModuleContext->DataTableCapacity)
+        {
+            ntStatus = HashTable_DataSegmentAdd(ModuleContext);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+
+        entryIndex = ModuleContext->DataEntriesAllocated;
+        ++(ModuleContext->DataEntriesAllocated);
+
+        entry = HashTable_IndexToDataEntry(ModuleContext,
+                                           entryIndex);
+    }
+
+    ++(ModuleContext->DataEntriesInUse);
+
+    entry->Hash = Hash;
+    entry->KeyLength = KeyLength;
+    entry->ValueLength = 0;
+    entry->NextEntryIndex = INVALID_INDEX;
+    entry->InUse = TRUE;
+
+    keyBuffer = HashTable_KeyBufferGet(entry);
+
+    RtlCopyMemory(keyBuffer,
+                  Key,
+                  KeyLength);
+
+    // New Keys are added with the Value set to zero. The entry may never have been used,
+    // or it may hold the Value of a removed Key.
+    //
+    RtlZeroMemory(HashTable_ValueBufferGet(entry),
+                  ModuleContext->MaximumValueLength);
+
+    *NewEntryIndex = entryIndex;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryFindOrAllocate(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _Out_ DATA_ENTRY** DataEntry
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key. If the entry with this key does not exist - it will be created.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+    DataEntry - A pointer to store the resulting data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    ULONG entryIndex;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    DmfAssert(DataEntry != NULL);
+
+    DmfAssert(HashTable_IsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Spread the cost of growing HashMap over the operations that add entries.
+    //
+    HashTable_RehashStep(moduleContext);
+
+    entryIndex = HashTable_EntryIndexFind(moduleContext,
+                                          Key,
+                                          KeyLength,
+                                          Hash);
+    if (INVALID_INDEX == entryIndex)
+    {
+        // In the open addressing layout, HashMap must always have an empty element.
+        // It only fills up if it could not grow.
+        //
+        if ((HashTable_Layout_OpenAddressing == moduleContext->Layout) &&
+            (moduleContext->DataEntriesInUse + 1 >= moduleContext->HashMapSize))
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "HashMap is full: HashMapSize=%u", moduleContext->HashMapSize);
+            goto Exit;
+        }
+
+        // The key is not in the table. Add it.
+        //
+        ntStatus = HashTable_DataEntryAllocate(DmfModule,
+                                               moduleContext,
+                                               Key,
+                                               KeyLength,
+                                               Hash,
+                                               &entryIndex);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        HashTable_EntryIndexInsert(moduleContext,
+                                   entryIndex,
+                                   Hash);
+
+        HashTable_HashMapGrow(moduleContext);
+    }
+
+    *DataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                            entryIndex);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_DataEntryFind(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _Out_ DATA_ENTRY** DataEntry
+    )
+/*++
+
+Routine Description:
+
+    Finds the entry with specified key.
+
+Arguments:
+
+    DmfModule - DMF Module.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+    DataEntry - A pointer to store the resulting data entry.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    ULONG entryIndex;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    DmfAssert(DataEntry != NULL);
+
+    DmfAssert(HashTable_IsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    entryIndex = HashTable_EntryIndexFind(moduleContext,
+                                          Key,
+                                          KeyLength,
+                                          Hash);
+    if (INVALID_INDEX == entryIndex)
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    *DataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                            entryIndex);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_FindCallbackCall(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_ EVT_DMF_HashTable_Find* CallbackFind,
+    _In_opt_ EVT_DMF_HashTable_FindEx* CallbackFindEx,
+    _In_opt_ VOID* CallbackContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Inout_updates_to_(*ValueLength, *ValueLength) UCHAR* Value,
+    _Inout_ ULONG* ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Calls the Client's callback passed to DMF_HashTable_Find() or DMF_HashTable_FindEx().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    CallbackFind - The callback passed to DMF_HashTable_Find(), or NULL.
+    CallbackFindEx - The callback passed to DMF_HashTable_FindEx(), or NULL.
+    CallbackContext - Context passed to CallbackFindEx.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Value - Address of the Value buffer of the entry.
+    ValueLength - Address of the Value length of the entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (CallbackFind != NULL)
+    {
+        CallbackFind(DmfModule,
+                     Key,
+                     KeyLength,
+                     Value,
+                     ValueLength);
+    }
+    else
+    {
+        DmfAssert(CallbackFindEx != NULL);
+        CallbackFindEx(DmfModule,
+                       CallbackContext,
+                       Key,
+                       KeyLength,
+                       Value,
+                       ValueLength);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_Find(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _In_opt_ EVT_DMF_HashTable_Find* CallbackFind,
+    _In_opt_ EVT_DMF_HashTable_FindEx* CallbackFindEx,
+    _In_opt_ VOID* CallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Finds the specified key in the hash table and calls a callback function to process the value associated with the key.
+    In case the key is absent in the hash table, it will be added with the ValueLength set to zero, and then the callback will be called.
+    Exactly one of CallbackFind and CallbackFindEx is used.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Hash - Hash of the Key.
+    CallbackFind - The callback to process the value, or NULL if CallbackFindEx is used.
+    CallbackFindEx - The callback to process the value, or NULL if CallbackFind is used.
+    CallbackContext - Context passed to CallbackFindEx.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    DATA_ENTRY* dataEntry;
+    ULONG valueLength;
+    HASH_TABLE_LOCK_STATE lockState;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert((CallbackFind != NULL) != (CallbackFindEx != NULL));
+
+    // Synchronize with Methods to read, write and enumerate entries in table.
+    // An existing key is looked up with shared access only.
+    //
+    HashTable_LockAcquire(DmfModule,
+                          FALSE,
+                          &lockState);
+
+    if (HashTable_Concurrency_SharedReaders == moduleContext->Concurrency)
+    {
+        ntStatus = HashTable_DataEntryFind(DmfModule,
+                                           Key,
+                                           KeyLength,
+                                           Hash,
+                                           &dataEntry);
+        if (NT_SUCCESS(ntStatus))
+        {
+            // Other threads may access this entry at the same time, so the callback
+            // must not change the length of the value.
+            //
+            valueLength = dataEntry->ValueLength;
+            HashTable_FindCallbackCall(DmfModule,
+                                       CallbackFind,
+                                       CallbackFindEx,
+                                       CallbackContext,
+                                       Key,
+                                       KeyLength,
+                                       HashTable_ValueBufferGet(dataEntry),
+                                       &valueLength);
+            DmfAssert(valueLength == dataEntry->ValueLength);
+            goto Exit;
+        }
+
+        // The key is not in the table. Adding it requires exclusive access.
+        //
+        HashTable_LockRelease(DmfModule,
+                              &lockState);
+        HashTable_LockAcquire(DmfModule,
+                              TRUE,
+                              &lockState);
+    }
+
+    ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                 Key,
+                                                 KeyLength,
+                                                 Hash,
+                                                 &dataEntry);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    HashTable_FindCallbackCall(DmfModule,
+                               CallbackFind,
+                               CallbackFindEx,
+                               CallbackContext,
+                               Key,
+                               KeyLength,
+                               HashTable_ValueBufferGet(dataEntry),
+                               &dataEntry->ValueLength);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_Read(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Read the Value associated with the specified Key.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes
+    Hash - Hash of the Key.
+    ValueBuffer - Address of the buffer to store Value data
+    ValueBufferLength - The length of ValueBuffer in bytes
+    ValueLength - Actual length in bytes of the data written to ValueBuffer, or the required buffer length if ValueBufferLength is too small
+
+Return Value:
+
+    STATUS_SUCCESS - The key was found and its value was successfully stored to the output buffer.
+    STATUS_NOT_FOUND - The specified key was not found in the hash table.
+    STATUS_BUFFER_TOO_SMALL - The key was found, but the output buffer is too small to store the value.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DATA_ENTRY* dataEntry;
+    HASH_TABLE_LOCK_STATE lockState;
+
+    HashTable_LockAcquire(DmfModule,
+                          FALSE,
+                          &lockState);
+
+    ntStatus = HashTable_DataEntryFind(DmfModule,
+                                       Key,
+                                       KeyLength,
+                                       Hash,
+                                       &dataEntry);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    if (ValueBufferLength < dataEntry->ValueLength)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    if (ValueLength != NULL)
+    {
+        *ValueLength = dataEntry->ValueLength;
+    }
+
+    RtlCopyMemory(ValueBuffer,
+                  HashTable_ValueBufferGet(dataEntry),
+                  dataEntry->ValueLength);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+HashTable_Write(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ ULONG_PTR Hash,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Writes Key-Value pair to the hash table.
+    If an element with the specified key already exists - its value will be updated.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes
+    Hash - Hash of the Key.
+    Value - Address of the buffer containing Value data.
+    ValueLength - Length of Value data in bytes
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    DATA_ENTRY* dataEntry;
+    HASH_TABLE_LOCK_STATE lockState;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    HashTable_LockAcquire(DmfModule,
+                          TRUE,
+                          &lockState);
+
+    if (ValueLength > moduleContext->MaximumValueLength)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_BUFFER_OVERFLOW;
+        goto Exit;
+    }
+
+    ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
+                                                 Key,
+                                                 KeyLength,
+                                                 Hash,
+                                                 &dataEntry);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    dataEntry->ValueLength = ValueLength;
+    RtlCopyMemory(HashTable_ValueBufferGet(dataEntry), Value, ValueLength);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+HashTable_ProbeLengthsAdd(
+    _In_ DMF_CONTEXT_HashTable* ModuleContext,
+    _In_ ULONG* HashMap,
+    _In_opt_ UCHAR* Fingerprints,
+    _In_ ULONG HashMapSize,
+    _In_ ULONG ElementIndex,
+    _Inout_ HashTable_Statistics* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Adds the probe length of the entries referenced by an element of a given HashMap to the statistics.
+    The probe length of an entry is the number of entries a lookup of its Key compares: its position in
+    the list of its bucket in the chained layout, or one more than its distance from the element selected
+    by its hash in the open addressing layout.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    HashMap - The given HashMap (current or previous).
+    Fingerprints - The fingerprints of the given HashMap. Open addressing layout only.
+    HashMapSize - Number of elements in the given HashMap.
+    ElementIndex - Index of the element of the given HashMap.
+    Statistics - The statistics to update.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG entryIndex;
+    ULONG home;
+    ULONG probeLength;
+
+    if (HashTable_Layout_OpenAddressing == ModuleContext->Layout)
+    {
+        DmfAssert(Fingerprints != NULL);
+
+        // Elements of the previous HashMap whose entry has moved hold INVALID_INDEX.
+        //
+        if ((0 == Fingerprints[ElementIndex]) ||
+            (INVALID_INDEX == HashMap[ElementIndex]))
+        {
+            return;
+        }
+
+        // The probe sequence wraps around the end of HashMap.
+        //
+        home = (ULONG)(HashTable_IndexToDataEntry(ModuleContext,
+                                                  HashMap[ElementIndex])->Hash % HashMapSize);
+        if (ElementIndex >= home)
+        {
+            probeLength = ElementIndex - home + 1;
+        }
+        else
+        {
+            probeLength = ElementIndex + HashMapSize - home + 1;
+        }
+
+        Statistics->TotalProbeLength += probeLength;
+        if (probeLength > Statistics->MaximumProbeLength)
+        {
+            Statistics->MaximumProbeLength = probeLength;
+        }
+        return;
+    }
+
+    probeLength = 0;
+    entryIndex = HashMap[ElementIndex];
+    while (entryIndex != INVALID_INDEX)
+    {
+        probeLength++;
+        Statistics->TotalProbeLength += probeLength;
+        entryIndex = HashTable_IndexToDataEntry(ModuleContext,
+                                                entryIndex)->NextEntryIndex;
+    }
+
+    if (probeLength > Statistics->MaximumProbeLength)
+    {
+        Statistics->MaximumProbeLength = probeLength;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_HashTable_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type HashTable.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    NT_STATUS code indicating success or failure.
+
+--*/
+{
+    DMF_CONFIG_HashTable* moduleConfig;
+    DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = HashTable_ContextInitialize(moduleConfig,
+                                           moduleContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_HashTable_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type HashTable.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    HashTable_ContextCleanup(moduleContext);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_HashTable;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_HashTable;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_HashTable);
+    dmfCallbacksDmf_HashTable.DeviceOpen = DMF_HashTable_Open;
+    dmfCallbacksDmf_HashTable.DeviceClose = DMF_HashTable_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_HashTable,
+                                            HashTable,
+                                            DMF_CONTEXT_HashTable,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_HashTable.CallbacksDmf = &dmfCallbacksDmf_HashTable;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_HashTable,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_HashTable_Enumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ EVT_DMF_HashTable_Enumerate* CallbackEnumerate,
+    _In_ VOID* CallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Enumerates the content of the hash table and calls a callback function for each entry.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    CallbackEnumerate - The callback to be called during enumeration. Enumeration stops when the callback returns FALSE.
+    CallbackContext - Context pointer to pass into callback function.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_HashTable* moduleContext;
+    ULONG entryIndex;
+    HASH_TABLE_LOCK_STATE lockState;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
-    entry->KeyLength = KeyLength;
-    entry->ValueLength = 0;
-    entry->NextEntryIndex = INVALID_INDEX;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    keyBuffer = HashTable_KeyBufferGet(entry);
+    // Synchronize with calls to add items to table.
+    //
+    HashTable_LockAcquire(DmfModule,
+                          FALSE,
+                          &lockState);
 
-    RtlCopyMemory(keyBuffer,
-                  Key,
-                  KeyLength);
+    for (entryIndex = 0; entryIndex < moduleContext->DataEntriesAllocated; ++entryIndex)
+    {
+        DATA_ENTRY* dataEntry = HashTable_IndexToDataEntry(moduleContext, entryIndex);
 
-    *NewEntryIndex = entryIndex;
+        if (! dataEntry->InUse)
+        {
+            // This entry has been removed.
+            //
+            continue;
+        }
 
-    ntStatus = STATUS_SUCCESS;
+        if (! CallbackEnumerate(DmfModule,
+                                HashTable_KeyBufferGet(dataEntry),
+                                dataEntry->KeyLength,
+                                HashTable_ValueBufferGet(dataEntry),
+                                dataEntry->ValueLength,
+                                CallbackContext))
+        {
+            break;
+        }
+    }
 
-Exit:
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
 
-    return ntStatus;
+    FuncExitVoid(DMF_TRACE);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
-static
 NTSTATUS
-HashTable_DataEntryFindOrAllocate(
+DMF_HashTable_Find(
     _In_ DMFMODULE DmfModule,
     _In_reads_(KeyLength) UCHAR* Key,
     _In_ ULONG KeyLength,
-    _Out_ DATA_ENTRY** DataEntry
+    _In_ EVT_DMF_HashTable_Find* CallbackFind
     )
 /*++
 
 Routine Description:
 
-    Finds the entry with specified key. If the entry with this key does not exist - it will be created.
+    Finds the specified key in the hash table and calls a callback function to process the value associated with the key.
+    In case the key is absent in the hash table, it will be added with the ValueLength set to zero, and then the callback will be called.
 
 Arguments:
 
-    DmfModule - DMF Module.
+    DmfModule - This Module's handle.
     Key - Address of the buffer containing Key data.
     KeyLength - Length of Key data in bytes.
-    DataEntry - A pointer to store the resulting data entry.
+    CallbackFind - The callback to process the value.
 
 Return Value:
 
@@ -537,115 +2577,57 @@ Return Value:
 
 --*/
 {
-    ULONG_PTR hash;
-    ULONG entryIndex;
-    NTSTATUS ntStatus;
     DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG_PTR hash;
 
-    DmfAssert(DataEntry != NULL);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+
     hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
                                                     Key,
                                                     KeyLength);
 
-    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
-    //
-    hash = hash % moduleContext->HashMapSize;
-
-    entryIndex = moduleContext->HashMap[hash];
-
-    if (INVALID_INDEX == entryIndex)
-    {
-        ntStatus = HashTable_DataEntryAllocate(DmfModule,
-                                               moduleContext,
-                                               Key,
-                                               KeyLength,
-                                               &entryIndex);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            goto Exit;
-        }
-
-        moduleContext->HashMap[hash] = entryIndex;
-        *DataEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                entryIndex);
-    }
-    else
-    {
-        DATA_ENTRY* currentEntry;
-
-        // Search the table for the given key.
-        //
-        do
-        {
-            currentEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                      entryIndex);
-            if ((currentEntry->KeyLength == KeyLength) &&
-                (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
-                                  Key,
-                                  KeyLength) == KeyLength))
-            {
-                // We have found the element with the key we are looking for.
-                //
-                *DataEntry = currentEntry;
-                break;
-            }
-
-            entryIndex = currentEntry->NextEntryIndex;
-
-        } while (entryIndex != INVALID_INDEX);
-
-        if (INVALID_INDEX == entryIndex)
-        {
-            ntStatus = HashTable_DataEntryAllocate(DmfModule,
-                                                   moduleContext,
-                                                   Key,
-                                                   KeyLength,
-                                                   &entryIndex);
-            if (! NT_SUCCESS(ntStatus))
-            {
-                goto Exit;
-            }
-
-            currentEntry->NextEntryIndex = entryIndex;
-            *DataEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                    entryIndex);
-        }
-    }
-
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
+    ntStatus = HashTable_Find(DmfModule,
+                              Key,
+                              KeyLength,
+                              hash,
+                              CallbackFind,
+                              NULL,
+                              NULL);
 
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
-static
 NTSTATUS
-HashTable_DataEntryFind(
+DMF_HashTable_FindEx(
     _In_ DMFMODULE DmfModule,
     _In_reads_(KeyLength) UCHAR* Key,
     _In_ ULONG KeyLength,
-    _Out_ DATA_ENTRY** DataEntry
+    _In_ EVT_DMF_HashTable_FindEx* CallbackFindEx,
+    _In_ VOID* CallbackContext
     )
 /*++
 
 Routine Description:
 
-    Finds the entry with specified key.
+    Finds the specified key in the hash table and calls a callback function to process the value associated with the key.
+    In case the key is absent in the hash table, it will be added with the ValueLength set to zero, and then the callback will be called.
+    Caller can use this Method to perform actions other than updating the hash table record.
 
 Arguments:
 
-    DmfModule - DMF Module.
+    DmfModule - This Module's handle.
     Key - Address of the buffer containing Key data.
     KeyLength - Length of Key data in bytes.
-    DataEntry - A pointer to store the resulting data entry.
+    CallbackFind - The callback to process the value.
+    CallbackContext - Context passed to caller's callback.
 
 Return Value:
 
@@ -653,96 +2635,57 @@ Return Value:
 
 --*/
 {
-    ULONG_PTR hash;
-    DATA_ENTRY* currentEntry;
-    ULONG entryIndex;
-    NTSTATUS ntStatus;
     DMF_CONTEXT_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG_PTR hash;
 
-    DmfAssert(DataEntry != NULL);
-
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    DmfAssert(CallbackFindEx != NULL);
+
     hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
                                                     Key,
                                                     KeyLength);
 
-    // Adjust the hash value to the size of the hash table, so that we can use the hash as an index in this table.
-    //
-    hash = hash % moduleContext->HashMapSize;
-
-    entryIndex = moduleContext->HashMap[hash];
-    if (INVALID_INDEX == entryIndex)
-    {
-        ntStatus = STATUS_NOT_FOUND;
-        goto Exit;
-    }
-
-    // Search the table for the given key.
-    //
-    do
-    {
-        currentEntry = HashTable_IndexToDataEntry(moduleContext,
-                                                  entryIndex);
-
-        if ((currentEntry->KeyLength == KeyLength) &&
-            (RtlCompareMemory(HashTable_KeyBufferGet(currentEntry),
+    ntStatus = HashTable_Find(DmfModule,
                               Key,
-                              KeyLength) == KeyLength))
-        {
-            // We have found the element with the key we are looking for.
-            //
-            break;
-        }
-
-        entryIndex = currentEntry->NextEntryIndex;
-    } while (entryIndex != INVALID_INDEX);
-
-    if (INVALID_INDEX == entryIndex)
-    {
-        ntStatus = STATUS_NOT_FOUND;
-        goto Exit;
-    }
-
-    *DataEntry = currentEntry;
-
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
+                              KeyLength,
+                              hash,
+                              NULL,
+                              CallbackFindEx,
+                              CallbackContext);
 
     return ntStatus;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
-static
 NTSTATUS
-DMF_HashTable_Open(
-    _In_ DMFMODULE DmfModule
+DMF_HashTable_FindWithHash(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
+    _In_ EVT_DMF_HashTable_Find* CallbackFind
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type HashTable.
+    Same as DMF_HashTable_Find() but uses the hash of the Key returned by DMF_HashTable_HashCompute()
+    instead of calculating it.
 
 Arguments:
 
-    DmfModule - The given DMF Module.
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    KeyHash - The hash of the Key returned by DMF_HashTable_HashCompute().
+    CallbackFind - The callback to process the value.
 
 Return Value:
 
@@ -750,50 +2693,50 @@ Return Value:
 
 --*/
 {
-    DMF_CONFIG_HashTable* moduleConfig;
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
 
-    PAGED_CODE();
-
-    FuncEntry(DMF_TRACE);
-
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = HashTable_ContextInitialize(moduleConfig,
-                                           moduleContext);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        goto Exit;
-    }
-
-Exit:
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    DmfAssert(KeyHash != NULL);
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    ntStatus = HashTable_Find(DmfModule,
+                              Key,
+                              KeyLength,
+                              KeyHash->Hash,
+                              CallbackFind,
+                              NULL,
+                              NULL);
 
     return ntStatus;
 }
-#pragma code_seg()
 
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Close)
-_IRQL_requires_max_(PASSIVE_LEVEL)
-static
+_IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-DMF_HashTable_Close(
-    _In_ DMFMODULE DmfModule
+DMF_HashTable_HashCompute(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ HASHTABLE_KEY_HASH* KeyHash
     )
 /*++
 
 Routine Description:
 
-    Uninitialize an instance of a DMF Module of type HashTable.
+    Calculates the hash of a Key so that it can be passed to the Methods that take a precomputed hash
+    (DMF_HashTable_FindWithHash, DMF_HashTable_ReadWithHash and DMF_HashTable_WriteWithHash). Clients that
+    access the same Key many times calculate its hash only once.
 
 Arguments:
 
-    DmfModule - The given DMF Module.
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    KeyHash - Receives the hash of the Key. It is only valid for this Module instance.
 
 Return Value:
 
@@ -803,366 +2746,363 @@ Return Value:
 {
     DMF_CONTEXT_HashTable* moduleContext;
 
-    PAGED_CODE();
-
-    FuncEntry(DMF_TRACE);
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    HashTable_ContextCleanup(moduleContext);
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    DmfAssert(KeyHash != NULL);
 
-    FuncExitVoid(DMF_TRACE);
+    KeyHash->Hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                             Key,
+                                                             KeyLength);
 }
-#pragma code_seg()
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// Public Calls by Client
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_HashTable_Create(
-    _In_ WDFDEVICE Device,
-    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
-    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
-    _Out_ DMFMODULE* DmfModule
+DMF_HashTable_Read(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
     )
 /*++
 
 Routine Description:
 
-    Create an instance of a DMF Module.
+    Read the Value associated with the specified Key.
 
 Arguments:
 
-    Device - Client Driver's WDFDEVICE object.
-    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
-    ObjectAttributes - WDF object attributes for DMFMODULE.
-    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes
+    ValueBuffer - Address of the buffer to store Value data
+    ValueBufferLength - The length of ValueBuffer in bytes
+    ValueLength - Actual length in bytes of the data written to ValueBuffer, or the required buffer length if ValueBufferLength is too small
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS - The key was found and its value was successfully stored to the output buffer.
+    STATUS_NOT_FOUND - The specified key was not found in the hash table.
+    STATUS_BUFFER_TOO_SMALL - The key was found, but the output buffer is too small to store the value.
 
 --*/
 {
+    DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
-    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_HashTable;
-    DMF_CALLBACKS_DMF dmfCallbacksDmf_HashTable;
-
-    PAGED_CODE();
-
-    FuncEntry(DMF_TRACE);
+    ULONG_PTR hash;
 
-    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_HashTable);
-    dmfCallbacksDmf_HashTable.DeviceOpen = DMF_HashTable_Open;
-    dmfCallbacksDmf_HashTable.DeviceClose = DMF_HashTable_Close;
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 HashTable);
 
-    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_HashTable,
-                                            HashTable,
-                                            DMF_CONTEXT_HashTable,
-                                            DMF_MODULE_OPTIONS_DISPATCH,
-                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    dmfModuleDescriptor_HashTable.CallbacksDmf = &dmfCallbacksDmf_HashTable;
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
 
-    ntStatus = DMF_ModuleCreate(Device,
-                                DmfModuleAttributes,
-                                ObjectAttributes,
-                                &dmfModuleDescriptor_HashTable,
-                                DmfModule);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
-    }
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    ntStatus = HashTable_Read(DmfModule,
+                              Key,
+                              KeyLength,
+                              hash,
+                              ValueBuffer,
+                              ValueBufferLength,
+                              ValueLength);
 
-    return(ntStatus);
+    return ntStatus;
 }
-#pragma code_seg()
-
-// Module Methods
-//
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_HashTable_Enumerate(
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_ReadWithHash(
     _In_ DMFMODULE DmfModule,
-    _In_ EVT_DMF_HashTable_Enumerate* CallbackEnumerate,
-    _In_ VOID* CallbackContext
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
     )
 /*++
 
 Routine Description:
 
-    Enumerates the content of the hash table and calls a callback function for each entry.
+    Same as DMF_HashTable_Read() but uses the hash of the Key returned by DMF_HashTable_HashCompute()
+    instead of calculating it.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    CallbackEnumerate - The callback to be called during enumeration. Enumeration stops when the callback returns FALSE.
-    CallbackContext - Context pointer to pass into callback function.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes
+    KeyHash - The hash of the Key returned by DMF_HashTable_HashCompute().
+    ValueBuffer - Address of the buffer to store Value data
+    ValueBufferLength - The length of ValueBuffer in bytes
+    ValueLength - Actual length in bytes of the data written to ValueBuffer, or the required buffer length if ValueBufferLength is too small
 
 Return Value:
 
-    None
+    STATUS_SUCCESS - The key was found and its value was successfully stored to the output buffer.
+    STATUS_NOT_FOUND - The specified key was not found in the hash table.
+    STATUS_BUFFER_TOO_SMALL - The key was found, but the output buffer is too small to store the value.
 
 --*/
 {
     DMF_CONTEXT_HashTable* moduleContext;
-    ULONG entryIndex;
-
-    FuncEntry(DMF_TRACE);
+    NTSTATUS ntStatus;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Synchronize with calls to add items to table.
-    //
-    DMF_ModuleLock(DmfModule);
-
-    for (entryIndex = 0; entryIndex < moduleContext->DataEntriesAllocated; ++entryIndex)
-    {
-        DATA_ENTRY* dataEntry = HashTable_IndexToDataEntry(moduleContext, entryIndex);
-
-        if (! CallbackEnumerate(DmfModule,
-                                HashTable_KeyBufferGet(dataEntry),
-                                dataEntry->KeyLength,
-                                HashTable_ValueBufferGet(dataEntry),
-                                dataEntry->ValueLength,
-                                CallbackContext))
-        {
-            break;
-        }
-    }
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    DmfAssert(KeyHash != NULL);
 
-    DMF_ModuleUnlock(DmfModule);
+    ntStatus = HashTable_Read(DmfModule,
+                              Key,
+                              KeyLength,
+                              KeyHash->Hash,
+                              ValueBuffer,
+                              ValueBufferLength,
+                              ValueLength);
 
-    FuncExitVoid(DMF_TRACE);
+    return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_HashTable_Find(
+DMF_HashTable_Remove(
     _In_ DMFMODULE DmfModule,
     _In_reads_(KeyLength) UCHAR* Key,
-    _In_ ULONG KeyLength,
-    _In_ EVT_DMF_HashTable_Find* CallbackFind
+    _In_ ULONG KeyLength
     )
 /*++
 
 Routine Description:
 
-    Finds the specified key in the hash table and calls a callback function to process the value associated with the key.
-    In case the key is absent in the hash table, it will be added with the ValueLength set to zero, and then the callback will be called.
+    Removes the Key-Value pair with the specified Key from the hash table.
+    The space it used is reused by the next Key-Value pair that is added.
 
 Arguments:
 
     DmfModule - This Module's handle.
     Key - Address of the buffer containing Key data.
-    KeyLength - Length of Key data in bytes.
-    CallbackFind - The callback to process the value.
+    KeyLength - Length of Key data in bytes
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    STATUS_SUCCESS - The key was found and removed.
+    STATUS_NOT_FOUND - The specified key was not found in the hash table.
 
 --*/
 {
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
     DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
+    ULONG entryIndex;
+    HASH_TABLE_LOCK_STATE lockState;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Synchronize with Methods to read, write and enumerate entries in table.
-    //
-    DMF_ModuleLock(DmfModule);
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
 
-    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    HashTable_LockAcquire(DmfModule,
+                          TRUE,
+                          &lockState);
 
-    ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
-                                                 Key,
-                                                 KeyLength,
-                                                 &dataEntry);
-    if (! NT_SUCCESS(ntStatus))
+    HashTable_RehashStep(moduleContext);
+
+    entryIndex = HashTable_EntryIndexRemove(moduleContext,
+                                            Key,
+                                            KeyLength,
+                                            hash);
+    if (INVALID_INDEX == entryIndex)
     {
+        ntStatus = STATUS_NOT_FOUND;
         goto Exit;
     }
 
-    DmfAssert(CallbackFind != NULL);
-    CallbackFind(DmfModule,
-                 Key,
-                 KeyLength,
-                 HashTable_ValueBufferGet(dataEntry),
-                 &dataEntry->ValueLength);
+    // Add the entry to the list of free entries.
+    //
+    dataEntry = HashTable_IndexToDataEntry(moduleContext,
+                                           entryIndex);
+
+    dataEntry->InUse = FALSE;
+    dataEntry->NextEntryIndex = moduleContext->FreeEntryIndex;
+    moduleContext->FreeEntryIndex = entryIndex;
+
+    DmfAssert(moduleContext->DataEntriesInUse > 0);
+    --(moduleContext->DataEntriesInUse);
 
     ntStatus = STATUS_SUCCESS;
 
 Exit:
 
-    DMF_ModuleUnlock(DmfModule);
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
 
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_HashTable_FindEx(
+VOID
+DMF_HashTable_StatisticsGet(
     _In_ DMFMODULE DmfModule,
-    _In_reads_(KeyLength) UCHAR* Key,
-    _In_ ULONG KeyLength,
-    _In_ EVT_DMF_HashTable_FindEx* CallbackFindEx,
-    _In_ VOID* CallbackContext
+    _Out_ HashTable_Statistics* Statistics
     )
 /*++
 
 Routine Description:
 
-    Finds the specified key in the hash table and calls a callback function to process the value associated with the key.
-    In case the key is absent in the hash table, it will be added with the ValueLength set to zero, and then the callback will be called.
-    Caller can use this Method to perform actions other than updating the hash table record.
+    Returns how evenly the entries are distributed in the hash map. Every entry is visited,
+    so this Method takes time proportional to the size of the hash table.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Key - Address of the buffer containing Key data.
-    KeyLength - Length of Key data in bytes.
-    CallbackFind - The callback to process the value.
-    CallbackContext - Context passed to caller's callback.
+    Statistics - Where the statistics are returned.
 
 Return Value:
 
-    NT_STATUS code indicating success or failure.
+    None
 
 --*/
 {
     DMF_CONTEXT_HashTable* moduleContext;
-    NTSTATUS ntStatus;
-    DATA_ENTRY* dataEntry;
+    HASH_TABLE_LOCK_STATE lockState;
+    ULONG elementIndex;
+    ULONG previousSize;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Synchronize with Methods to read, write and enumerate entries in table.
-    //
-    DMF_ModuleLock(DmfModule);
+    DmfAssert(Statistics != NULL);
 
-    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
+    RtlZeroMemory(Statistics,
+                  sizeof(HashTable_Statistics));
 
-    ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
-                                                 Key,
-                                                 KeyLength,
-                                                 &dataEntry);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        goto Exit;
-    }
+    HashTable_LockAcquire(DmfModule,
+                          FALSE,
+                          &lockState);
 
-    DmfAssert(CallbackFindEx != NULL);
-    CallbackFindEx(DmfModule,
-                   CallbackContext,
-                   Key,
-                   KeyLength,
-                   HashTable_ValueBufferGet(dataEntry),
-                   &dataEntry->ValueLength);
+    Statistics->NumberOfEntries = moduleContext->DataEntriesInUse;
+    Statistics->HashMapSize = moduleContext->HashMapSize;
 
-    ntStatus = STATUS_SUCCESS;
+    // While HashMap grows, the entries that have not moved yet are found in the previous HashMap.
+    // In the chained layout, the elements of HashMap that entries have not moved to yet are not
+    // initialized. In the open addressing layout, only elements with a fingerprint are read.
+    //
+    previousSize = moduleContext->HashMapSize / 2;
+    for (elementIndex = 0; elementIndex < moduleContext->HashMapSize; elementIndex++)
+    {
+        if ((HashTable_Layout_Chained == moduleContext->Layout) &&
+            (moduleContext->HashMapPrevious != NULL) &&
+            (elementIndex % previousSize >= moduleContext->RehashIndex))
+        {
+            continue;
+        }
 
-Exit:
+        HashTable_ProbeLengthsAdd(moduleContext,
+                                  moduleContext->HashMap,
+                                  moduleContext->Fingerprints,
+                                  moduleContext->HashMapSize,
+                                  elementIndex,
+                                  Statistics);
+    }
+
+    if (moduleContext->HashMapPrevious != NULL)
+    {
+        for (elementIndex = 0; elementIndex < previousSize; elementIndex++)
+        {
+            if ((HashTable_Layout_Chained == moduleContext->Layout) &&
+                (elementIndex < moduleContext->RehashIndex))
+            {
+                continue;
+            }
 
-    DMF_ModuleUnlock(DmfModule);
+            HashTable_ProbeLengthsAdd(moduleContext,
+                                      moduleContext->HashMapPrevious,
+                                      moduleContext->FingerprintsPrevious,
+                                      previousSize,
+                                      elementIndex,
+                                      Statistics);
+        }
+    }
 
-    return ntStatus;
+    HashTable_LockRelease(DmfModule,
+                          &lockState);
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_HashTable_Read(
+DMF_HashTable_Write(
     _In_ DMFMODULE DmfModule,
     _In_reads_(KeyLength) UCHAR* Key,
     _In_ ULONG KeyLength,
-    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
-    _In_ ULONG ValueBufferLength,
-    _Out_opt_ ULONG* ValueLength
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength
     )
 /*++
 
 Routine Description:
 
-    Read the Value associated with the specified Key.
+    Writes Key-Value pair to the hash table.
+    If an element with the specified key already exists - its value will be updated.
 
 Arguments:
 
     DmfModule - This Module's handle.
     Key - Address of the buffer containing Key data.
     KeyLength - Length of Key data in bytes
-    ValueBuffer - Address of the buffer to store Value data
-    ValueBufferLength - The length of ValueBuffer in bytes
-    ValueLength - Actual length in bytes of the data written to ValueBuffer, or the required buffer length if ValueBufferLength is too small
+    Value - Address of the buffer containing Value data.
+    ValueLength - Length of Value data in bytes
 
 Return Value:
 
-    STATUS_SUCCESS - The key was found and its value was successfully stored to the output buffer.
-    STATUS_NOT_FOUND - The specified key was not found in the hash table.
-    STATUS_BUFFER_TOO_SMALL - The key was found, but the output buffer is too small to store the value.
+    NT_STATUS code indicating success or failure.
 
 --*/
 {
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
-    DATA_ENTRY* dataEntry;
+    ULONG_PTR hash;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
-    DMF_ModuleLock(DmfModule);
-
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    ntStatus = HashTable_DataEntryFind(DmfModule,
-                                       Key,
-                                       KeyLength,
-                                       &dataEntry);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        goto Exit;
-    }
-
-    if (ValueBufferLength < dataEntry->ValueLength)
-    {
-        ntStatus = STATUS_BUFFER_TOO_SMALL;
-        goto Exit;
-    }
-
-    if (ValueLength != NULL)
-    {
-        *ValueLength = dataEntry->ValueLength;
-    }
-
-    RtlCopyMemory(ValueBuffer,
-                  HashTable_ValueBufferGet(dataEntry),
-                  dataEntry->ValueLength);
-
-    ntStatus = STATUS_SUCCESS;
+    DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
 
-Exit:
+    hash = moduleContext->EvtHashTableHashCalculate(DmfModule,
+                                                    Key,
+                                                    KeyLength);
 
-    DMF_ModuleUnlock(DmfModule);
+    ntStatus = HashTable_Write(DmfModule,
+                               Key,
+                               KeyLength,
+                               hash,
+                               Value,
+                               ValueLength);
 
     return ntStatus;
 }
@@ -1170,10 +3110,11 @@ Exit:
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_HashTable_Write(
+DMF_HashTable_WriteWithHash(
     _In_ DMFMODULE DmfModule,
     _In_reads_(KeyLength) UCHAR* Key,
     _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
     _In_reads_(ValueLength) UCHAR* Value,
     _In_ ULONG ValueLength
     )
@@ -1181,14 +3122,15 @@ DMF_HashTable_Write(
 
 Routine Description:
 
-    Writes Key-Value pair to the hash table.
-    If an element with the specified key already exists - its value will be updated.
+    Same as DMF_HashTable_Write() but uses the hash of the Key returned by DMF_HashTable_HashCompute()
+    instead of calculating it.
 
 Arguments:
 
     DmfModule - This Module's handle.
     Key - Address of the buffer containing Key data.
     KeyLength - Length of Key data in bytes
+    KeyHash - The hash of the Key returned by DMF_HashTable_HashCompute().
     Value - Address of the buffer containing Value data.
     ValueLength - Length of Value data in bytes
 
@@ -1200,41 +3142,21 @@ Return Value:
 {
     DMF_CONTEXT_HashTable* moduleContext;
     NTSTATUS ntStatus;
-    DATA_ENTRY* dataEntry;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
-    DMF_ModuleLock(DmfModule);
-
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DmfAssert(KeyLength <= moduleContext->MaximumKeyLength);
-
-    if (ValueLength > moduleContext->MaximumValueLength)
-    {
-        DmfAssert(FALSE);
-        ntStatus = STATUS_BUFFER_OVERFLOW;
-        goto Exit;
-    }
-
-    ntStatus = HashTable_DataEntryFindOrAllocate(DmfModule,
-                                                 Key,
-                                                 KeyLength,
-                                                 &dataEntry);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        goto Exit;
-    }
-
-    dataEntry->ValueLength = ValueLength;
-    RtlCopyMemory(HashTable_ValueBufferGet(dataEntry), Value, ValueLength);
-
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
-
-    DMF_ModuleUnlock(DmfModule);
+    DmfAssert(KeyHash != NULL);
+
+    ntStatus = HashTable_Write(DmfModule,
+                               Key,
+                               KeyLength,
+                               KeyHash->Hash,
+                               Value,
+                               ValueLength);
 
     return ntStatus;
 }
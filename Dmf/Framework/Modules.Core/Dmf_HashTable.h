@@ -72,6 +72,60 @@ EVT_DMF_HashTable_Enumerate(_In_ DMFMODULE DmfModule,
                             _In_ ULONG ValueLength,
                             _In_ VOID* CallbackContext);
 
+// These definitions indicate how the hash table locates Key-Value pairs.
+//
+typedef enum
+{
+    // Key-Value pairs that have the same hash are linked into a list. Each lookup follows
+    // the list of its hash.
+    //
+    HashTable_Layout_Chained = 0,
+    // Key-Value pairs that have the same hash are stored in the next empty element of the hash map.
+    // Each lookup scans consecutive elements and a compact array of 1 byte hash fingerprints, so
+    // Key-Value pairs are only read when their fingerprint matches.
+    //
+    HashTable_Layout_OpenAddressing,
+    HashTable_Layout_Maximum,
+} HashTable_LayoutType;
+
+// These definitions indicate the built-in hash function used when the Client does not set EvtHashTableHashCalculate.
+//
+typedef enum
+{
+    // FNV-1a. Processes the Key one byte at a time.
+    //
+    HashTable_HashFunction_Fnv1a = 0,
+    // Processes the Key 8 bytes at a time using the mixing steps of XXH64. It is seeded with
+    // a random value chosen for each instance, so Keys that collide in one instance do not
+    // collide in others. It is much faster than FNV-1a for long Keys.
+    //
+    HashTable_HashFunction_WordAtATime,
+    HashTable_HashFunction_Maximum,
+} HashTable_HashFunctionType;
+
+// These definitions indicate how Methods synchronize access to the hash table.
+//
+typedef enum
+{
+    // All Methods acquire the Module lock, so only one Method runs at a time.
+    //
+    HashTable_Concurrency_Exclusive = 0,
+    // Methods that do not add or remove Key-Value pairs (Read, Enumerate and Find/FindEx of an
+    // existing Key) acquire a reader-writer lock in shared mode, so they do not block each other.
+    // Methods that add or remove Key-Value pairs acquire it in exclusive mode.
+    //
+    // Memory ordering: acquiring and releasing the lock orders all accesses, so a Key-Value pair
+    // written by Write or added by Find/FindEx is visible to every Method that starts after it returns.
+    // However, Find/FindEx callbacks for an existing Key run at the same time as Read, Enumerate and
+    // callbacks for the same Key in other threads. Such callbacks must update the Value with interlocked
+    // operations (the Value is aligned for them when MaximumKeyLength is a multiple of MAX_NATURAL_ALIGNMENT)
+    // and must not change ValueLength. Read and Enumerate may return a Value while it is being updated.
+    // The Find/FindEx callback that adds a Key runs with exclusive access.
+    //
+    HashTable_Concurrency_SharedReaders,
+    HashTable_Concurrency_Maximum,
+} HashTable_ConcurrencyType;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -88,6 +142,25 @@ typedef struct
     //
     ULONG MaximumTableSize;
 
+    // Number of Key-Value pairs the hash table has space for when it is created. If it is zero
+    // (or not less than MaximumTableSize), space for MaximumTableSize Key-Value pairs is allocated
+    // when the Module opens. Otherwise, the hash table grows as needed up to MaximumTableSize.
+    //
+    ULONG InitialTableSize;
+
+    // Indicates how the hash table locates Key-Value pairs. The default is HashTable_Layout_Chained.
+    //
+    HashTable_LayoutType Layout;
+
+    // Indicates the built-in hash function to use. The default is HashTable_HashFunction_Fnv1a.
+    // It is ignored if EvtHashTableHashCalculate is set.
+    //
+    HashTable_HashFunctionType HashFunction;
+
+    // Indicates how Methods synchronize access to the hash table. The default is HashTable_Concurrency_Exclusive.
+    //
+    HashTable_ConcurrencyType Concurrency;
+
     // A callback to customize hashing algorithm.
     //
     EVT_DMF_HashTable_HashCalculate* EvtHashTableHashCalculate;
@@ -100,6 +173,32 @@ typedef struct
 //
 DECLARE_DMF_MODULE(HashTable)
 
+// Hash of a Key returned by DMF_HashTable_HashCompute(). Clients must not interpret it.
+// It is only valid for the same Key and the same Module instance.
+//
+typedef struct
+{
+    ULONG_PTR Hash;
+} HASHTABLE_KEY_HASH;
+
+// Distribution of the entries returned by DMF_HashTable_StatisticsGet().
+//
+typedef struct
+{
+    // Number of Key-Value pairs in the hash table.
+    //
+    ULONG NumberOfEntries;
+    // Number of elements in the hash map.
+    //
+    ULONG HashMapSize;
+    // Largest number of entries a lookup compares before it finds its Key.
+    //
+    ULONG MaximumProbeLength;
+    // Sum of the number of entries compared to find each Key.
+    //
+    ULONGLONG TotalProbeLength;
+} HashTable_Statistics;
+
 // Module Methods
 //
 
@@ -132,6 +231,26 @@ DMF_HashTable_FindEx(
     _In_ VOID* CallbackContext
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_FindWithHash(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
+    _In_ EVT_DMF_HashTable_Find* CallbackFind
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_HashTable_HashCompute(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ HASHTABLE_KEY_HASH* KeyHash
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -144,6 +263,35 @@ DMF_HashTable_Read(
     _Out_opt_ ULONG* ValueLength
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_ReadWithHash(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_Remove(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_HashTable_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ HashTable_Statistics* Statistics
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
@@ -155,5 +303,17 @@ DMF_HashTable_Write(
     _In_ ULONG ValueLength
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_HashTable_WriteWithHash(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_ HASHTABLE_KEY_HASH* KeyHash,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength
+    );
+
 // eof: Dmf_HashTable.h
 //
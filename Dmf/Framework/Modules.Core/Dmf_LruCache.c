@@ -0,0 +1,1284 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_LruCache.c
+
+Abstract:
+
+    A cache of Key-Value pairs with a fixed capacity in entries and in bytes. When the cache is full,
+    the least recently used entry is removed to make space for a new entry. Each entry can also
+    have a time to live. Keys are located using a child DMF_HashTable Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Core.h"
+#include "DmfModules.Core.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_LruCache.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Indicates the end of a list of entries.
+//
+#define LRUCACHE_INVALID_INDEX              ((ULONG)-1)
+
+// Each entry of the cache starts with this header. It is followed by the Key
+// (MaximumKeyLength bytes, rounded up to MAX_NATURAL_ALIGNMENT) and the Value.
+//
+typedef struct
+{
+    // Time (in milliseconds) after which the entry is expired. Zero means that it never expires.
+    //
+    ULONGLONG ExpirationTime;
+    // Index of the entry used just after this one (toward the most recently used entry).
+    // For free entries, it is the index of the next free entry.
+    //
+    ULONG Previous;
+    // Index of the entry used just before this one (toward the least recently used entry).
+    //
+    ULONG Next;
+    // Length of the Key and Value in bytes.
+    //
+    ULONG KeyLength;
+    ULONG ValueLength;
+} LRUCACHE_ENTRY_HEADER;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Maps each Key to the index of its entry.
+    //
+    DMFMODULE DmfModuleHashTable;
+    // Memory that holds all the entries. It is allocated from non-paged pool
+    // so that the cache can be used at DISPATCH_LEVEL.
+    //
+    WDFMEMORY EntriesMemory;
+    UCHAR* Entries;
+    // Size of each entry (header, Key and Value).
+    //
+    ULONG EntrySize;
+    // Offset of the Value in each entry.
+    //
+    ULONG ValueOffset;
+    // Entries in use form a doubly linked list ordered by last use.
+    //
+    ULONG MostRecentlyUsedIndex;
+    ULONG LeastRecentlyUsedIndex;
+    // Entries not in use form a singly linked list.
+    //
+    ULONG FreeIndex;
+    // Counters returned by DMF_LruCache_StatisticsGet().
+    //
+    LruCache_Statistics Statistics;
+} DMF_CONTEXT_LruCache;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(LruCache)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(LruCache)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'CurL'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONGLONG
+LruCache_CurrentTimeMillisecondsGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Returns the current time used for entry expiration. This time is not affected by
+    changes to the system time.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    The current time in milliseconds.
+
+--*/
+{
+    ULONGLONG currentTimeMilliseconds;
+
+#if defined(DMF_USER_MODE)
+    currentTimeMilliseconds = GetTickCount64();
+#else
+    currentTimeMilliseconds = KeQueryInterruptTime() / 10000;
+#endif
+
+    return currentTimeMilliseconds;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+LRUCACHE_ENTRY_HEADER*
+LruCache_EntryGet(
+    _In_ DMF_CONTEXT_LruCache* ModuleContext,
+    _In_ ULONG EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Return the entry at a given index.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    EntryIndex - The given index.
+
+Return Value:
+
+    The entry.
+
+--*/
+{
+    DmfAssert(EntryIndex != LRUCACHE_INVALID_INDEX);
+
+    return (LRUCACHE_ENTRY_HEADER*)(ModuleContext->Entries + ((SIZE_T)EntryIndex * ModuleContext->EntrySize));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+LruCache_EntryUnlink(
+    _In_ DMF_CONTEXT_LruCache* ModuleContext,
+    _In_ ULONG EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Remove a given entry from the list of entries in use.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    EntryIndex - Index of the given entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LRUCACHE_ENTRY_HEADER* entry;
+
+    entry = LruCache_EntryGet(ModuleContext,
+                              EntryIndex);
+
+    if (entry->Previous != LRUCACHE_INVALID_INDEX)
+    {
+        LruCache_EntryGet(ModuleContext,
+                          entry->Previous)->Next = entry->Next;
+    }
+    else
+    {
+        DmfAssert(ModuleContext->MostRecentlyUsedIndex == EntryIndex);
+        ModuleContext->MostRecentlyUsedIndex = entry->Next;
+    }
+
+    if (entry->Next != LRUCACHE_INVALID_INDEX)
+    {
+        LruCache_EntryGet(ModuleContext,
+                          entry->Next)->Previous = entry->Previous;
+    }
+    else
+    {
+        DmfAssert(ModuleContext->LeastRecentlyUsedIndex == EntryIndex);
+        ModuleContext->LeastRecentlyUsedIndex = entry->Previous;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+LruCache_EntryLinkMostRecent(
+    _In_ DMF_CONTEXT_LruCache* ModuleContext,
+    _In_ ULONG EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Add a given entry to the list of entries in use as the most recently used entry.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    EntryIndex - Index of the given entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LRUCACHE_ENTRY_HEADER* entry;
+
+    entry = LruCache_EntryGet(ModuleContext,
+                              EntryIndex);
+
+    entry->Previous = LRUCACHE_INVALID_INDEX;
+    entry->Next = ModuleContext->MostRecentlyUsedIndex;
+    if (ModuleContext->MostRecentlyUsedIndex != LRUCACHE_INVALID_INDEX)
+    {
+        LruCache_EntryGet(ModuleContext,
+                          ModuleContext->MostRecentlyUsedIndex)->Previous = EntryIndex;
+    }
+    else
+    {
+        DmfAssert(ModuleContext->LeastRecentlyUsedIndex == LRUCACHE_INVALID_INDEX);
+        ModuleContext->LeastRecentlyUsedIndex = EntryIndex;
+    }
+    ModuleContext->MostRecentlyUsedIndex = EntryIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+LruCache_EntryIsExpired(
+    _In_ LRUCACHE_ENTRY_HEADER* Entry,
+    _Inout_ ULONGLONG* CurrentTime
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the time to live of a given entry has elapsed. The current time is only read
+    if the entry can expire, and only once for all the entries checked by a Method.
+
+Arguments:
+
+    Entry - The given entry.
+    CurrentTime - The current time in milliseconds or zero if it has not been read yet.
+
+Return Value:
+
+    TRUE if the entry is expired.
+
+--*/
+{
+    if (0 == Entry->ExpirationTime)
+    {
+        return FALSE;
+    }
+
+    if (0 == *CurrentTime)
+    {
+        *CurrentTime = LruCache_CurrentTimeMillisecondsGet();
+    }
+
+    return (*CurrentTime >= Entry->ExpirationTime);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+LruCache_EntryEvict(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG EntryIndex,
+    _In_ LruCache_EvictionReasonType EvictionReason
+    )
+/*++
+
+Routine Description:
+
+    Remove a given entry from the cache and add it to the list of free entries.
+    The Client's eviction callback is called before the entry is freed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    EntryIndex - Index of the given entry.
+    EvictionReason - Why the entry is removed.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    DMF_CONFIG_LruCache* moduleConfig;
+    LRUCACHE_ENTRY_HEADER* entry;
+    UCHAR* key;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DmfAssert(EvictionReason != LruCache_EvictionReason_Replaced);
+
+    entry = LruCache_EntryGet(moduleContext,
+                              EntryIndex);
+    key = (UCHAR*)(entry + 1);
+
+    LruCache_EntryUnlink(moduleContext,
+                         EntryIndex);
+
+    ntStatus = DMF_HashTable_Remove(moduleContext->DmfModuleHashTable,
+                                    key,
+                                    entry->KeyLength);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    if (moduleConfig->EvtLruCacheEvict != NULL)
+    {
+        moduleConfig->EvtLruCacheEvict(DmfModule,
+                                       key,
+                                       entry->KeyLength,
+                                       (UCHAR*)entry + moduleContext->ValueOffset,
+                                       entry->ValueLength,
+                                       EvictionReason);
+    }
+
+    if (LruCache_EvictionReason_Capacity == EvictionReason)
+    {
+        moduleContext->Statistics.NumberOfEvictions++;
+    }
+    else if (LruCache_EvictionReason_Expired == EvictionReason)
+    {
+        moduleContext->Statistics.NumberOfExpirations++;
+    }
+
+    DmfAssert(moduleContext->Statistics.NumberOfEntries > 0);
+    DmfAssert(moduleContext->Statistics.NumberOfBytes >= entry->KeyLength + entry->ValueLength);
+    moduleContext->Statistics.NumberOfEntries--;
+    moduleContext->Statistics.NumberOfBytes -= entry->KeyLength + entry->ValueLength;
+
+    entry->Previous = moduleContext->FreeIndex;
+    moduleContext->FreeIndex = EntryIndex;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+LruCache_IsFull(
+    _In_ DMF_CONFIG_LruCache* ModuleConfig,
+    _In_ DMF_CONTEXT_LruCache* ModuleContext,
+    _In_ ULONG AddedEntryCount,
+    _In_ ULONG AddedByteCount
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the cache would exceed its capacity if a given number of entries and
+    bytes were added to it.
+
+Arguments:
+
+    ModuleConfig - This Module's config.
+    ModuleContext - This Module's context.
+    AddedEntryCount - The given number of entries.
+    AddedByteCount - The given number of bytes.
+
+Return Value:
+
+    TRUE if the cache would exceed its capacity.
+
+--*/
+{
+    if (ModuleContext->Statistics.NumberOfEntries + AddedEntryCount > ModuleConfig->MaximumEntryCount)
+    {
+        return TRUE;
+    }
+
+    if ((ModuleConfig->MaximumTotalBytes != 0) &&
+        (ModuleContext->Statistics.NumberOfBytes + AddedByteCount > ModuleConfig->MaximumTotalBytes))
+    {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+LruCache_LeastRecentlyUsedEvict(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG AddedEntryCount,
+    _In_ ULONG AddedByteCount,
+    _Inout_ ULONGLONG* CurrentTime
+    )
+/*++
+
+Routine Description:
+
+    Remove the least recently used entries until a given number of entries and bytes can be
+    added to the cache without exceeding its capacity.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    AddedEntryCount - The given number of entries.
+    AddedByteCount - The given number of bytes.
+    CurrentTime - The current time in milliseconds or zero if it has not been read yet.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    DMF_CONFIG_LruCache* moduleConfig;
+    ULONG entryIndex;
+    LruCache_EvictionReasonType evictionReason;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    while (LruCache_IsFull(moduleConfig,
+                           moduleContext,
+                           AddedEntryCount,
+                           AddedByteCount))
+    {
+        entryIndex = moduleContext->LeastRecentlyUsedIndex;
+        DmfAssert(entryIndex != LRUCACHE_INVALID_INDEX);
+
+        // Entries whose time to live has elapsed are reported as expired even if it is
+        // lack of space that causes their removal.
+        //
+        if (LruCache_EntryIsExpired(LruCache_EntryGet(moduleContext,
+                                                      entryIndex),
+                                    CurrentTime))
+        {
+            evictionReason = LruCache_EvictionReason_Expired;
+        }
+        else
+        {
+            evictionReason = LruCache_EvictionReason_Capacity;
+        }
+
+        LruCache_EntryEvict(DmfModule,
+                            entryIndex,
+                            evictionReason);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_LruCache_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type LruCache.
+    All the entries are allocated here so that no memory is allocated when entries are written.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_LruCache* moduleContext;
+    DMF_CONFIG_LruCache* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONGLONG entrySize;
+    ULONGLONG sizeToAllocate;
+    LRUCACHE_ENTRY_HEADER* entry;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if ((0 == moduleConfig->MaximumEntryCount) ||
+        (moduleConfig->MaximumEntryCount >= LRUCACHE_INVALID_INDEX) ||
+        (0 == moduleConfig->MaximumKeyLength) ||
+        (0 == moduleConfig->MaximumValueLength))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // The Key is rounded up so that the Value is aligned, and the entry is rounded up
+    // so that the header of the next entry is aligned.
+    //
+    entrySize = sizeof(LRUCACHE_ENTRY_HEADER) +
+                (((ULONGLONG)moduleConfig->MaximumKeyLength + MAX_NATURAL_ALIGNMENT - 1) & ~((ULONGLONG)MAX_NATURAL_ALIGNMENT - 1));
+    moduleContext->ValueOffset = (ULONG)entrySize;
+    entrySize = (entrySize + moduleConfig->MaximumValueLength + MAX_NATURAL_ALIGNMENT - 1) & ~((ULONGLONG)MAX_NATURAL_ALIGNMENT - 1);
+    sizeToAllocate = entrySize * moduleConfig->MaximumEntryCount;
+    if (sizeToAllocate > ULONG_MAX)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+    moduleContext->EntrySize = (ULONG)entrySize;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               (size_t)sizeToAllocate,
+                               &moduleContext->EntriesMemory,
+                               (VOID**)&moduleContext->Entries);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->EntriesMemory = NULL;
+        moduleContext->Entries = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(moduleContext->Entries,
+                  (size_t)sizeToAllocate);
+
+    // All the entries start in the list of free entries, in order.
+    //
+    for (ULONG entryIndex = 0; entryIndex < moduleConfig->MaximumEntryCount; entryIndex++)
+    {
+        entry = LruCache_EntryGet(moduleContext,
+                                  entryIndex);
+        entry->Previous = entryIndex + 1;
+    }
+    LruCache_EntryGet(moduleContext,
+                      moduleConfig->MaximumEntryCount - 1)->Previous = LRUCACHE_INVALID_INDEX;
+
+    moduleContext->FreeIndex = 0;
+    moduleContext->MostRecentlyUsedIndex = LRUCACHE_INVALID_INDEX;
+    moduleContext->LeastRecentlyUsedIndex = LRUCACHE_INVALID_INDEX;
+    RtlZeroMemory(&moduleContext->Statistics,
+                  sizeof(moduleContext->Statistics));
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Create cache: MaximumEntryCount=%u, MaximumTotalBytes=%u, MaximumKeyLength=%u, MaximumValueLength=%u, EntrySize=%u",
+                moduleConfig->MaximumEntryCount,
+                moduleConfig->MaximumTotalBytes,
+                moduleConfig->MaximumKeyLength,
+                moduleConfig->MaximumValueLength,
+                moduleContext->EntrySize);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_LruCache_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type LruCache.
+    The eviction callback is called for each entry still in the cache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->Entries != NULL)
+    {
+        DMF_LruCache_Flush(DmfModule);
+
+        WdfObjectDelete(moduleContext->EntriesMemory);
+        moduleContext->EntriesMemory = NULL;
+        moduleContext->Entries = NULL;
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_LruCache_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    DMF_CONFIG_LruCache* moduleConfig;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_HashTable moduleConfigHashTable;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    // HashTable
+    // ---------
+    //
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    // The Value of each Key is the index of its entry. Every entry is in the hash table,
+    // so it never needs more space than the cache. Entries are evicted before a Key is added,
+    // so the hash table never holds more than MaximumEntryCount Keys. Since all of it is
+    // allocated when it opens (InitialTableSize is zero), it never allocates memory after that.
+    //
+    moduleConfigHashTable.MaximumKeyLength = moduleConfig->MaximumKeyLength;
+    moduleConfigHashTable.MaximumValueLength = sizeof(ULONG);
+    moduleConfigHashTable.MaximumTableSize = moduleConfig->MaximumEntryCount;
+    moduleConfigHashTable.InitialTableSize = 0;
+    moduleConfigHashTable.Layout = HashTable_Layout_OpenAddressing;
+    moduleConfigHashTable.HashFunction = HashTable_HashFunction_WordAtATime;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleHashTable);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type LruCache.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_LruCache;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_LruCache;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_LruCache);
+    dmfCallbacksDmf_LruCache.ChildModulesAdd = DMF_LruCache_ChildModulesAdd;
+    dmfCallbacksDmf_LruCache.DeviceOpen = DMF_LruCache_Open;
+    dmfCallbacksDmf_LruCache.DeviceClose = DMF_LruCache_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_LruCache,
+                                            LruCache,
+                                            DMF_CONTEXT_LruCache,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_LruCache.CallbacksDmf = &dmfCallbacksDmf_LruCache;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_LruCache,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LruCache_Flush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove all the entries from the cache. The eviction callback is called for each entry
+    with LruCache_EvictionReason_Removed. The counters are not reset.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            LruCache);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    while (moduleContext->LeastRecentlyUsedIndex != LRUCACHE_INVALID_INDEX)
+    {
+        LruCache_EntryEvict(DmfModule,
+                            moduleContext->LeastRecentlyUsedIndex,
+                            LruCache_EvictionReason_Removed);
+    }
+
+    DmfAssert(0 == moduleContext->Statistics.NumberOfEntries);
+    DmfAssert(0 == moduleContext->Statistics.NumberOfBytes);
+
+    DMF_ModuleUnlock(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Get(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Reads the Value of a given Key from the cache. If the Key is found, its entry becomes the
+    most recently used entry. An entry whose time to live has elapsed is removed and not found.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    ValueBuffer - Address of the output buffer to store Value data.
+    ValueBufferLength - Output buffer length.
+    ValueLength - Address to store the actual Value length (optional).
+
+Return Value:
+
+    STATUS_SUCCESS - The Key was found and its Value was successfully stored to the output buffer.
+    STATUS_NOT_FOUND - The Key was not found in the cache or its entry is expired.
+    STATUS_BUFFER_TOO_SMALL - The Key was found, but the output buffer is too small to store the Value.
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    NTSTATUS ntStatus;
+    HASHTABLE_KEY_HASH keyHash;
+    LRUCACHE_ENTRY_HEADER* entry;
+    ULONG entryIndex;
+    ULONGLONG currentTime;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 LruCache);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Hash the Key before the Module is locked.
+    //
+    DMF_HashTable_HashCompute(moduleContext->DmfModuleHashTable,
+                              Key,
+                              KeyLength,
+                              &keyHash);
+
+    currentTime = 0;
+
+    DMF_ModuleLock(DmfModule);
+
+    ntStatus = DMF_HashTable_ReadWithHash(moduleContext->DmfModuleHashTable,
+                                          Key,
+                                          KeyLength,
+                                          &keyHash,
+                                          (UCHAR*)&entryIndex,
+                                          sizeof(entryIndex),
+                                          NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        moduleContext->Statistics.NumberOfMisses++;
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    entry = LruCache_EntryGet(moduleContext,
+                              entryIndex);
+
+    if (LruCache_EntryIsExpired(entry,
+                                &currentTime))
+    {
+        LruCache_EntryEvict(DmfModule,
+                            entryIndex,
+                            LruCache_EvictionReason_Expired);
+        moduleContext->Statistics.NumberOfMisses++;
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    moduleContext->Statistics.NumberOfHits++;
+
+    if (entryIndex != moduleContext->MostRecentlyUsedIndex)
+    {
+        LruCache_EntryUnlink(moduleContext,
+                             entryIndex);
+        LruCache_EntryLinkMostRecent(moduleContext,
+                                     entryIndex);
+    }
+
+    if (ValueLength != NULL)
+    {
+        *ValueLength = entry->ValueLength;
+    }
+
+    if (ValueBufferLength < entry->ValueLength)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    RtlCopyMemory(ValueBuffer,
+                  (UCHAR*)entry + moduleContext->ValueOffset,
+                  entry->ValueLength);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Put(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength,
+    _In_ ULONG TimeToLiveMilliseconds
+    )
+/*++
+
+Routine Description:
+
+    Writes a Key-Value pair to the cache. It becomes the most recently used entry. If the Key is
+    already in the cache, its Value is replaced. Least recently used entries are removed until
+    the new entry fits.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    Value - Address of the buffer containing Value data.
+    ValueLength - Length of Value data in bytes.
+    TimeToLiveMilliseconds - Time after which the entry expires. LRUCACHE_TIME_TO_LIVE_DEFAULT means
+                             DefaultTimeToLiveMilliseconds. LRUCACHE_TIME_TO_LIVE_INFINITE means never.
+
+Return Value:
+
+    STATUS_SUCCESS - The Key-Value pair was written.
+    STATUS_INVALID_PARAMETER - The Key is empty or longer than MaximumKeyLength.
+    STATUS_BUFFER_OVERFLOW - The Value is longer than MaximumValueLength or the Key and Value
+                             together are longer than MaximumTotalBytes.
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    DMF_CONFIG_LruCache* moduleConfig;
+    NTSTATUS ntStatus;
+    HASHTABLE_KEY_HASH keyHash;
+    LRUCACHE_ENTRY_HEADER* entry;
+    ULONG entryIndex;
+    ULONGLONG currentTime;
+    ULONGLONG expirationTime;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 LruCache);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    if (LRUCACHE_TIME_TO_LIVE_DEFAULT == TimeToLiveMilliseconds)
+    {
+        TimeToLiveMilliseconds = moduleConfig->DefaultTimeToLiveMilliseconds;
+    }
+
+    currentTime = 0;
+    expirationTime = 0;
+    if ((TimeToLiveMilliseconds != 0) &&
+        (TimeToLiveMilliseconds != LRUCACHE_TIME_TO_LIVE_INFINITE))
+    {
+        currentTime = LruCache_CurrentTimeMillisecondsGet();
+        expirationTime = currentTime + TimeToLiveMilliseconds;
+    }
+
+    // Hash the Key before the Module is locked.
+    //
+    DMF_HashTable_HashCompute(moduleContext->DmfModuleHashTable,
+                              Key,
+                              KeyLength,
+                              &keyHash);
+
+    DMF_ModuleLock(DmfModule);
+
+    if ((0 == KeyLength) ||
+        (KeyLength > moduleConfig->MaximumKeyLength))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    if ((ValueLength > moduleConfig->MaximumValueLength) ||
+        ((moduleConfig->MaximumTotalBytes != 0) &&
+         (KeyLength + ValueLength > moduleConfig->MaximumTotalBytes)))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_BUFFER_OVERFLOW;
+        goto Exit;
+    }
+
+    ntStatus = DMF_HashTable_ReadWithHash(moduleContext->DmfModuleHashTable,
+                                          Key,
+                                          KeyLength,
+                                          &keyHash,
+                                          (UCHAR*)&entryIndex,
+                                          sizeof(entryIndex),
+                                          NULL);
+    if (NT_SUCCESS(ntStatus) &&
+        LruCache_EntryIsExpired(LruCache_EntryGet(moduleContext,
+                                                  entryIndex),
+                                &currentTime))
+    {
+        // The old Value is not replaced because it already expired.
+        //
+        LruCache_EntryEvict(DmfModule,
+                            entryIndex,
+                            LruCache_EvictionReason_Expired);
+        ntStatus = STATUS_NOT_FOUND;
+    }
+
+    if (NT_SUCCESS(ntStatus))
+    {
+        // The Key is already in the cache. Its entry is reused for the new Value.
+        //
+        entry = LruCache_EntryGet(moduleContext,
+                                  entryIndex);
+
+        if (moduleConfig->EvtLruCacheEvict != NULL)
+        {
+            moduleConfig->EvtLruCacheEvict(DmfModule,
+                                           (UCHAR*)(entry + 1),
+                                           entry->KeyLength,
+                                           (UCHAR*)entry + moduleContext->ValueOffset,
+                                           entry->ValueLength,
+                                           LruCache_EvictionReason_Replaced);
+        }
+
+        // The entry is counted again when it is linked below.
+        //
+        LruCache_EntryUnlink(moduleContext,
+                             entryIndex);
+        moduleContext->Statistics.NumberOfEntries--;
+        moduleContext->Statistics.NumberOfBytes -= entry->KeyLength + entry->ValueLength;
+
+        // This entry is not in the list, so it is not removed to make space for itself.
+        //
+        LruCache_LeastRecentlyUsedEvict(DmfModule,
+                                        1,
+                                        KeyLength + ValueLength,
+                                        &currentTime);
+    }
+    else
+    {
+        LruCache_LeastRecentlyUsedEvict(DmfModule,
+                                        1,
+                                        KeyLength + ValueLength,
+                                        &currentTime);
+
+        DmfAssert(moduleContext->FreeIndex != LRUCACHE_INVALID_INDEX);
+        entryIndex = moduleContext->FreeIndex;
+        entry = LruCache_EntryGet(moduleContext,
+                                  entryIndex);
+
+        ntStatus = DMF_HashTable_WriteWithHash(moduleContext->DmfModuleHashTable,
+                                               Key,
+                                               KeyLength,
+                                               &keyHash,
+                                               (UCHAR*)&entryIndex,
+                                               sizeof(entryIndex));
+        if (! NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+
+        moduleContext->FreeIndex = entry->Previous;
+
+        entry->KeyLength = KeyLength;
+        RtlCopyMemory(entry + 1,
+                      Key,
+                      KeyLength);
+    }
+
+    entry->ValueLength = ValueLength;
+    entry->ExpirationTime = expirationTime;
+    RtlCopyMemory((UCHAR*)entry + moduleContext->ValueOffset,
+                  Value,
+                  ValueLength);
+
+    LruCache_EntryLinkMostRecent(moduleContext,
+                                 entryIndex);
+    moduleContext->Statistics.NumberOfEntries++;
+    moduleContext->Statistics.NumberOfBytes += KeyLength + ValueLength;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Remove(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Removes a given Key and its Value from the cache. The eviction callback is called
+    with LruCache_EvictionReason_Removed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS - The Key was found and removed.
+    STATUS_NOT_FOUND - The Key was not found in the cache.
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+    NTSTATUS ntStatus;
+    HASHTABLE_KEY_HASH keyHash;
+    ULONG entryIndex;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 LruCache);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_HashTable_HashCompute(moduleContext->DmfModuleHashTable,
+                              Key,
+                              KeyLength,
+                              &keyHash);
+
+    DMF_ModuleLock(DmfModule);
+
+    ntStatus = DMF_HashTable_ReadWithHash(moduleContext->DmfModuleHashTable,
+                                          Key,
+                                          KeyLength,
+                                          &keyHash,
+                                          (UCHAR*)&entryIndex,
+                                          sizeof(entryIndex),
+                                          NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    LruCache_EntryEvict(DmfModule,
+                        entryIndex,
+                        LruCache_EvictionReason_Removed);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LruCache_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ LruCache_Statistics* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Returns the counters of the cache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Statistics - Where the counters are returned.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_LruCache* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 LruCache);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    RtlCopyMemory(Statistics,
+                  &moduleContext->Statistics,
+                  sizeof(LruCache_Statistics));
+
+    DMF_ModuleUnlock(DmfModule);
+}
+
+// eof: Dmf_LruCache.c
+//
@@ -0,0 +1,180 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_LruCache.h
+
+Abstract:
+
+    Companion file to Dmf_LruCache.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// Pass this value as TimeToLiveMilliseconds to DMF_LruCache_Put() so that the entry
+// expires after DefaultTimeToLiveMilliseconds.
+//
+#define LRUCACHE_TIME_TO_LIVE_DEFAULT           (0)
+
+// Pass this value as TimeToLiveMilliseconds to DMF_LruCache_Put() so that the entry
+// never expires.
+//
+#define LRUCACHE_TIME_TO_LIVE_INFINITE          ((ULONG)-1)
+
+// These definitions indicate why an entry is removed from the cache.
+//
+typedef enum
+{
+    // The cache was full, and this was the least recently used entry.
+    //
+    LruCache_EvictionReason_Capacity = 0,
+    // The entry's time to live elapsed.
+    //
+    LruCache_EvictionReason_Expired,
+    // DMF_LruCache_Put() wrote a new Value for the entry's Key.
+    //
+    LruCache_EvictionReason_Replaced,
+    // The Client removed the entry (DMF_LruCache_Remove() or DMF_LruCache_Flush()), or the Module closed.
+    //
+    LruCache_EvictionReason_Removed,
+    LruCache_EvictionReason_Maximum,
+} LruCache_EvictionReasonType;
+
+// Callback function called for each entry removed from the cache. It allows the Client to
+// release resources that the Value refers to.
+// NOTE: It is called while the Module is locked. It must not call this Module's Methods.
+//
+typedef
+_Function_class_(EVT_DMF_LruCache_Evict)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_LruCache_Evict(_In_ DMFMODULE DmfModule,
+                       _In_reads_(KeyLength) UCHAR* Key,
+                       _In_ ULONG KeyLength,
+                       _In_reads_(ValueLength) UCHAR* Value,
+                       _In_ ULONG ValueLength,
+                       _In_ LruCache_EvictionReasonType EvictionReason);
+
+// Client uses this structure to configure the Module specific parameters.
+//
+typedef struct
+{
+    // Maximum number of entries in the cache.
+    //
+    ULONG MaximumEntryCount;
+
+    // Maximum total length in bytes of the Keys and Values of all the entries in the cache.
+    // Zero means that only MaximumEntryCount limits the cache.
+    //
+    ULONG MaximumTotalBytes;
+
+    // Maximum Key length in bytes.
+    //
+    ULONG MaximumKeyLength;
+
+    // Maximum Value length in bytes.
+    //
+    ULONG MaximumValueLength;
+
+    // Time to live of entries written with LRUCACHE_TIME_TO_LIVE_DEFAULT.
+    // Zero means that such entries never expire.
+    //
+    ULONG DefaultTimeToLiveMilliseconds;
+
+    // Optional callback called for each entry removed from the cache.
+    //
+    EVT_DMF_LruCache_Evict* EvtLruCacheEvict;
+} DMF_CONFIG_LruCache;
+
+// This macro declares the following functions:
+// DMF_LruCache_ATTRIBUTES_INIT()
+// DMF_CONFIG_LruCache_AND_ATTRIBUTES_INIT()
+// DMF_LruCache_Create()
+//
+DECLARE_DMF_MODULE(LruCache)
+
+// Counters returned by DMF_LruCache_StatisticsGet().
+//
+typedef struct
+{
+    // Number of calls to DMF_LruCache_Get() that found the Key.
+    //
+    ULONGLONG NumberOfHits;
+    // Number of calls to DMF_LruCache_Get() that did not find the Key (including expired entries).
+    //
+    ULONGLONG NumberOfMisses;
+    // Number of entries removed to make space for new entries.
+    //
+    ULONGLONG NumberOfEvictions;
+    // Number of entries removed because their time to live elapsed.
+    //
+    ULONGLONG NumberOfExpirations;
+    // Number of entries in the cache.
+    //
+    ULONG NumberOfEntries;
+    // Total length in bytes of the Keys and Values of the entries in the cache.
+    //
+    ULONG NumberOfBytes;
+} LruCache_Statistics;
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LruCache_Flush(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Get(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Put(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength,
+    _In_ ULONG TimeToLiveMilliseconds
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_LruCache_Remove(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LruCache_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ LruCache_Statistics* Statistics
+    );
+
+// eof: Dmf_LruCache.h
+//
@@ -35,6 +35,99 @@ Environment:
 
 typedef DECLSPEC_ALIGN(32) PLONG PLONG_A32;
 
+// Size of a cache line. Used to keep the producer's and consumer's data apart in
+// RingBuffer_Mode_SingleProducerSingleConsumer.
+//
+#define RingBuffer_CacheLineSize                    (64)
+
+// State owned by one side (producer or consumer) of a Ring Buffer in
+// RingBuffer_Mode_SingleProducerSingleConsumer. Each side has its own cache line so that
+// the two sides do not cause cache line contention.
+//
+typedef struct DECLSPEC_ALIGN(RingBuffer_CacheLineSize)
+{
+    // Number of items this side has written (producer) or read (consumer).
+    // It increases monotonically and wraps around. Only this side writes it (with release
+    // semantics). The other side reads it (with acquire semantics).
+    //
+    LONG volatile Index;
+    // The most recent value of the other side's Index read by this side. The other side's
+    // cache line is only read when this value indicates the Ring Buffer is full (producer)
+    // or empty (consumer).
+    //
+    ULONG OtherIndexCached;
+    // Address of the next entry this side accesses.
+    //
+    UCHAR* Pointer;
+} RING_BUFFER_SIDE;
+
+// Each variable size record starts with this header. Records (header and data) are
+// padded to RingBuffer_RecordAlignment bytes so that the header is always aligned.
+//
+typedef struct
+{
+    // Size in bytes of the record's data (not including the header or padding).
+    // If RingBuffer_RecordPadding is set, this is not a record. It is unused space (at
+    // the end of the buffer when it was written) and the rest of Size is the size in
+    // bytes of that space, including this header.
+    //
+    ULONG Size;
+} RING_BUFFER_RECORD_HEADER;
+
+#define RingBuffer_RecordAlignment                  ((ULONG)sizeof(ULONG))
+#define RingBuffer_RecordPadding                    (0x80000000)
+#define RingBuffer_RecordSizeGet(DataSize)          (((ULONG)sizeof(RING_BUFFER_RECORD_HEADER) + (DataSize) + RingBuffer_RecordAlignment - 1) & ~(RingBuffer_RecordAlignment - 1))
+
+// State of one read cursor (see DMF_RingBuffer_ReadCursorOpen()).
+// A cursor's position is not stored. The unread items of a cursor are always the newest
+// ItemsUnread items, so the cursor's next item is ItemsUnread items before the Write Pointer.
+// This way, cursors remain valid when the items are moved (DMF_RingBuffer_Reorder()).
+//
+typedef struct
+{
+    // Indicates the cursor is open.
+    //
+    BOOLEAN InUse;
+    // Number of items this cursor has not read yet.
+    //
+    ULONG ItemsUnread;
+    // Number of items deleted before this cursor read them.
+    //
+    ULONG ItemsDropped;
+} RING_BUFFER_READ_CURSOR;
+
+// Indicates the end of a chain (or no bucket) in RING_BUFFER_INDEX.
+//
+#define RingBuffer_IndexNone                        ((ULONG)-1)
+
+// Hash index of the items by key (see DMF_CONFIG_RingBuffer.IndexKeyLength).
+// Each slot of the Ring Buffer is in the chain of the bucket of the key it held when it was
+// last written. Slots are not removed when items are read or deleted. Instead, lookups skip
+// slots that are not between the Read Pointer and the Write Pointer.
+//
+typedef struct
+{
+    // Memory that holds the arrays below.
+    //
+    WDFMEMORY Memory;
+    // Offset and length of the key in each item. The index is not used if KeyLength is zero.
+    //
+    ULONG KeyOffset;
+    ULONG KeyLength;
+    // Number of buckets (a power of two).
+    //
+    ULONG BucketCount;
+    // First and last slot of the chain of each bucket. Slots are in the order they were written.
+    //
+    ULONG* BucketHeads;
+    ULONG* BucketTails;
+    // Next and previous slot in the chain of each slot, and the bucket of each slot.
+    //
+    ULONG* SlotNext;
+    ULONG* SlotPrevious;
+    ULONG* SlotBucket;
+} RING_BUFFER_INDEX;
+
 typedef struct
 {
     // Memory handle or memory that store the item data.
@@ -62,11 +155,43 @@ typedef struct
     //
     RingBuffer_ModeType Mode;
     // Number of items Ring Buffer can hold.
+    // (An upper bound on the number of records for variable size records.)
     //
     ULONG ItemsCount;
     // Items present in Ring Buffer.
+    // NOTE: In RingBuffer_Mode_SingleProducerSingleConsumer, ReadPointer, WritePointer
+    //       and ItemsPresentCount are only valid after RingBuffer_SidesSynchronize().
     //
     ULONG ItemsPresentCount;
+    // Indicates the Ring Buffer is a byte stream of variable size records. In this case,
+    // ItemSize is the maximum size of a record's data and ItemsPresentCount is the number
+    // of records present.
+    //
+    BOOLEAN VariableSizeRecords;
+    // Number of bytes used by records (and padding) present in the Ring Buffer.
+    // Only used with variable size records.
+    //
+    ULONG BytesPresentCount;
+    // Number of items reserved by DMF_RingBuffer_WriteReserve() that have not been committed yet.
+    // The reserved items start at the Write Pointer (the producer's Pointer in
+    // RingBuffer_Mode_SingleProducerSingleConsumer).
+    //
+    ULONG ItemsReserved;
+    // Memory handle and array of read cursors. NULL unless DMF_CONFIG_RingBuffer.ReadCursorCount
+    // is not zero. When read cursors are used, the Read Pointer is the oldest item that has
+    // not been read by all the open cursors and ItemsPresentCount is the number of items
+    // the slowest open cursor has not read.
+    //
+    WDFMEMORY MemoryReadCursors;
+    RING_BUFFER_READ_CURSOR* ReadCursors;
+    ULONG ReadCursorCount;
+    // Optional index of the items by key.
+    //
+    RING_BUFFER_INDEX Index;
+    // Producer and consumer state used in RingBuffer_Mode_SingleProducerSingleConsumer.
+    //
+    RING_BUFFER_SIDE Producer;
+    RING_BUFFER_SIDE Consumer;
 } RING_BUFFER;
 
 typedef struct
@@ -316,6 +441,355 @@ Return Value:
     }
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_ReadCursorPointerGet(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemsUnread
+    )
+/*++
+
+Routine Description:
+
+    Return the address of the next item of a read cursor that has a given number of
+    unread items.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    ItemsUnread - The given number of unread items.
+
+Return Value:
+
+    The address of the cursor's next item.
+
+--*/
+{
+    ULONG writeOffset;
+    ULONG unreadSize;
+
+    DmfAssert(ItemsUnread <= RingBuffer->ItemsCount);
+
+    writeOffset = (ULONG)(RingBuffer->WritePointer - RingBuffer->Items);
+    unreadSize = ItemsUnread * RingBuffer->ItemSize;
+    if (unreadSize > writeOffset)
+    {
+        return RingBuffer->Items + RingBuffer->TotalSize - (unreadSize - writeOffset);
+    }
+
+    return RingBuffer->Items + writeOffset - unreadSize;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ReadCursorsSynchronize(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Set the Read Pointer and the number of items present based on the slowest open
+    read cursor. Items that all the open cursors have read are deleted. If no cursor is open,
+    all the items are deleted.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG itemsUnreadMaximum;
+    ULONG cursorIndex;
+
+    DmfAssert(RingBuffer->ReadCursors != NULL);
+
+    itemsUnreadMaximum = 0;
+    for (cursorIndex = 0; cursorIndex < RingBuffer->ReadCursorCount; cursorIndex++)
+    {
+        if ((RingBuffer->ReadCursors[cursorIndex].InUse) &&
+            (RingBuffer->ReadCursors[cursorIndex].ItemsUnread > itemsUnreadMaximum))
+        {
+            itemsUnreadMaximum = RingBuffer->ReadCursors[cursorIndex].ItemsUnread;
+        }
+    }
+
+    RingBuffer->ItemsPresentCount = itemsUnreadMaximum;
+    RingBuffer->ReadPointer = RingBuffer_ReadCursorPointerGet(RingBuffer,
+                                                              itemsUnreadMaximum);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_ReadCursorsItemAdd(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Update the read cursors after an item has been written. Each open cursor has one more
+    item to read, unless the cursor was full. In that case, the cursor's oldest item was
+    deleted to make space for the new item, so the cursor skips it.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_READ_CURSOR* readCursor;
+    ULONG cursorIndex;
+
+    DmfAssert(RingBuffer->ReadCursors != NULL);
+
+    for (cursorIndex = 0; cursorIndex < RingBuffer->ReadCursorCount; cursorIndex++)
+    {
+        readCursor = &RingBuffer->ReadCursors[cursorIndex];
+        if (! readCursor->InUse)
+        {
+            continue;
+        }
+
+        if (readCursor->ItemsUnread == RingBuffer->ItemsCount)
+        {
+            // Only possible in RingBuffer_Mode_DeleteOldestIfFullOnWrite.
+            //
+            DmfAssert(RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+            readCursor->ItemsDropped++;
+        }
+        else
+        {
+            readCursor->ItemsUnread++;
+        }
+    }
+
+    RingBuffer_ReadCursorsSynchronize(RingBuffer);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_IndexBucketGet(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_reads_(RingBuffer->Index.KeyLength) UCHAR* Key
+    )
+/*++
+
+Routine Description:
+
+    Return the bucket of a given key. The hash is FNV-1a over the bytes of the key.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Key - The given key.
+
+Return Value:
+
+    The index of the bucket of the given key.
+
+--*/
+{
+    ULONG hash;
+    ULONG byteIndex;
+
+    DmfAssert(RingBuffer->Index.KeyLength > 0);
+
+    hash = 2166136261;
+    for (byteIndex = 0; byteIndex < RingBuffer->Index.KeyLength; byteIndex++)
+    {
+        hash ^= Key[byteIndex];
+        hash *= 16777619;
+    }
+
+    // Mix the upper bits into the lower bits since only the lower bits select the bucket.
+    //
+    hash ^= (hash >> 16);
+
+    return hash & (RingBuffer->Index.BucketCount - 1);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_IndexSlotRemove(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG Slot
+    )
+/*++
+
+Routine Description:
+
+    Remove a given slot from the chain of its bucket, if it is in one.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Slot - The given slot.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_INDEX* index;
+    ULONG bucket;
+    ULONG next;
+    ULONG previous;
+
+    index = &RingBuffer->Index;
+    bucket = index->SlotBucket[Slot];
+    if (RingBuffer_IndexNone == bucket)
+    {
+        return;
+    }
+
+    next = index->SlotNext[Slot];
+    previous = index->SlotPrevious[Slot];
+    if (previous != RingBuffer_IndexNone)
+    {
+        index->SlotNext[previous] = next;
+    }
+    else
+    {
+        index->BucketHeads[bucket] = next;
+    }
+    if (next != RingBuffer_IndexNone)
+    {
+        index->SlotPrevious[next] = previous;
+    }
+    else
+    {
+        index->BucketTails[bucket] = previous;
+    }
+
+    index->SlotBucket[Slot] = RingBuffer_IndexNone;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_IndexItemsWritten(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ UCHAR* FirstItem,
+    _In_ ULONG NumberOfItems
+    )
+/*++
+
+Routine Description:
+
+    Update the index after a number of consecutive items (modulo wrap) have been written.
+    Each slot moves to the end of the chain of the bucket of its new key. Thus, each chain
+    stays in the order the slots were written.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    FirstItem - Address of the first item that was written.
+    NumberOfItems - Number of items that were written.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_INDEX* index;
+    ULONG slot;
+    ULONG bucket;
+    ULONG itemIndex;
+
+    index = &RingBuffer->Index;
+    DmfAssert(index->KeyLength > 0);
+    DmfAssert(NumberOfItems <= RingBuffer->ItemsCount);
+
+    slot = (ULONG)((FirstItem - RingBuffer->Items) / RingBuffer->ItemSize);
+    for (itemIndex = 0; itemIndex < NumberOfItems; itemIndex++)
+    {
+        RingBuffer_IndexSlotRemove(RingBuffer,
+                                   slot);
+
+        bucket = RingBuffer_IndexBucketGet(RingBuffer,
+                                           RingBuffer->Items + ((size_t)slot * RingBuffer->ItemSize) + index->KeyOffset);
+        index->SlotNext[slot] = RingBuffer_IndexNone;
+        index->SlotPrevious[slot] = index->BucketTails[bucket];
+        if (index->BucketTails[bucket] != RingBuffer_IndexNone)
+        {
+            index->SlotNext[index->BucketTails[bucket]] = slot;
+        }
+        else
+        {
+            index->BucketHeads[bucket] = slot;
+        }
+        index->BucketTails[bucket] = slot;
+        index->SlotBucket[slot] = bucket;
+
+        slot++;
+        if (slot == RingBuffer->ItemsCount)
+        {
+            slot = 0;
+        }
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_IndexRebuild(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Rebuild the index from the items that are present. This is necessary after the items
+    move to other slots.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_INDEX* index;
+    ULONG bucket;
+    ULONG slot;
+
+    index = &RingBuffer->Index;
+    DmfAssert(index->KeyLength > 0);
+
+    for (bucket = 0; bucket < index->BucketCount; bucket++)
+    {
+        index->BucketHeads[bucket] = RingBuffer_IndexNone;
+        index->BucketTails[bucket] = RingBuffer_IndexNone;
+    }
+    for (slot = 0; slot < RingBuffer->ItemsCount; slot++)
+    {
+        index->SlotBucket[slot] = RingBuffer_IndexNone;
+    }
+
+    RingBuffer_IndexItemsWritten(RingBuffer,
+                                 RingBuffer->ReadPointer,
+                                 RingBuffer->ItemsPresentCount);
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 static
@@ -412,6 +886,13 @@ Return Value:
                            RingBuffer->WritePointer,
                            RingBuffer->ItemSize);
 
+    if (RingBuffer->Index.KeyLength > 0)
+    {
+        RingBuffer_IndexItemsWritten(RingBuffer,
+                                     RingBuffer->WritePointer,
+                                     1);
+    }
+
     // Move the Write Pointer to the next proper location.
     //
     RingBuffer->WritePointer += RingBuffer->ItemSize;
@@ -428,6 +909,11 @@ Return Value:
     RingBuffer->ItemsPresentCount++;
     DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
 
+    if (RingBuffer->ReadCursors != NULL)
+    {
+        RingBuffer_ReadCursorsItemAdd(RingBuffer);
+    }
+
 Exit:
 
     return ntStatus;
@@ -505,31 +991,2026 @@ Exit:
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RecordReadPointerAdvance(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG BytesToAdvance
+    )
+/*++
+
+Routine Description:
+
+    Remove a given number of bytes (a record or padding) at the Read Pointer, properly
+    wrapping around when necessary. Padding that follows is removed as well so that the
+    Read Pointer always points to a record when the Ring Buffer is not empty.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    BytesToAdvance - Number of bytes to remove.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_RECORD_HEADER* recordHeader;
+
+    DmfAssert(RingBuffer->VariableSizeRecords);
+
+    for (;;)
+    {
+        DmfAssert(BytesToAdvance <= RingBuffer->BytesPresentCount);
+        RingBuffer->ReadPointer += BytesToAdvance;
+        DmfAssert(RingBuffer->ReadPointer <= RingBuffer->BufferEnd);
+        if (RingBuffer->ReadPointer == RingBuffer->BufferEnd)
+        {
+            RingBuffer->ReadPointer = RingBuffer->Items;
+        }
+        RingBuffer->BytesPresentCount -= BytesToAdvance;
+
+        if (0 == RingBuffer->BytesPresentCount)
+        {
+            break;
+        }
+
+        recordHeader = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+        if (0 == (recordHeader->Size & RingBuffer_RecordPadding))
+        {
+            break;
+        }
+
+        // Skip the padding.
+        //
+        BytesToAdvance = recordHeader->Size & ~RingBuffer_RecordPadding;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RecordDelete(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Remove the oldest record from the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_RECORD_HEADER* recordHeader;
+
+    DmfAssert(RingBuffer->VariableSizeRecords);
+    DmfAssert(RingBuffer->ItemsPresentCount > 0);
+
+    recordHeader = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+    DmfAssert(0 == (recordHeader->Size & RingBuffer_RecordPadding));
+    DmfAssert(recordHeader->Size <= RingBuffer->ItemSize);
+
+    RingBuffer->ItemsPresentCount--;
+    RingBuffer_RecordReadPointerAdvance(RingBuffer,
+                                        RingBuffer_RecordSizeGet(recordHeader->Size));
+    DmfAssert((RingBuffer->ItemsPresentCount > 0) == (RingBuffer->BytesPresentCount > 0));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_RecordWrite(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Write a variable size record to the Ring Buffer. Records are never split. If the
+    record does not fit before the end of the buffer, the rest of the buffer is marked
+    as padding and the record is written at the beginning of the buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of the record's data.
+    BufferSize - Size in bytes of the record's data.
+    ItemProcessCallback - Callback function that writes into the ring buffer record.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_RECORD_HEADER* recordHeader;
+    ULONG recordSize;
+    ULONG bytesUntilEnd;
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->VariableSizeRecords);
+    DmfAssert(RingBuffer->BytesPresentCount <= RingBuffer->TotalSize);
+
+    ntStatus = STATUS_SUCCESS;
+
+    if ((0 == BufferSize) ||
+        (BufferSize > RingBuffer->ItemSize))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    recordSize = RingBuffer_RecordSizeGet(BufferSize);
+    DmfAssert(recordSize <= RingBuffer->TotalSize);
+
+    // Find contiguous space for the record, deleting the oldest records if necessary
+    // and allowed.
+    //
+    for (;;)
+    {
+        if (0 == RingBuffer->BytesPresentCount)
+        {
+            // Start at the beginning so that all the space is contiguous.
+            //
+            RingBuffer->ReadPointer = RingBuffer->Items;
+            RingBuffer->WritePointer = RingBuffer->Items;
+        }
+
+        if ((RingBuffer->WritePointer >= RingBuffer->ReadPointer) &&
+            (RingBuffer->BytesPresentCount < RingBuffer->TotalSize))
+        {
+            // Free space is from the Write Pointer to the end and from the beginning to
+            // the Read Pointer.
+            //
+            bytesUntilEnd = (ULONG)(RingBuffer->BufferEnd - RingBuffer->WritePointer);
+            if (bytesUntilEnd >= recordSize)
+            {
+                break;
+            }
+            if ((ULONG)(RingBuffer->ReadPointer - RingBuffer->Items) >= recordSize)
+            {
+                // Mark the space at the end as padding and wrap.
+                //
+                DmfAssert(bytesUntilEnd >= sizeof(RING_BUFFER_RECORD_HEADER));
+                recordHeader = (RING_BUFFER_RECORD_HEADER*)RingBuffer->WritePointer;
+                recordHeader->Size = RingBuffer_RecordPadding | bytesUntilEnd;
+                RingBuffer->BytesPresentCount += bytesUntilEnd;
+                RingBuffer->WritePointer = RingBuffer->Items;
+                break;
+            }
+        }
+        else
+        {
+            // Free space is from the Write Pointer to the Read Pointer.
+            //
+            if ((ULONG)(RingBuffer->ReadPointer - RingBuffer->WritePointer) >= recordSize)
+            {
+                break;
+            }
+        }
+
+        if (RingBuffer->Mode == RingBuffer_Mode_FailIfFullOnWrite)
+        {
+            // Ring Buffer is Full. This is an error condition.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        // Throw away the oldest record to make space for this one.
+        //
+        DmfAssert(RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+        RingBuffer_RecordDelete(RingBuffer);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "WritePointer=%d BufferSize=%d",
+                (LONG)(RingBuffer->WritePointer - RingBuffer->Items),
+                BufferSize);
+
+    recordHeader = (RING_BUFFER_RECORD_HEADER*)RingBuffer->WritePointer;
+    recordHeader->Size = BufferSize;
+
+    // Write to the Ring Buffer record in a caller specific manner.
+    //
+    (*ItemProcessCallback)(Buffer,
+                           (UCHAR*)(recordHeader + 1),
+                           BufferSize);
+
+    RingBuffer->WritePointer += recordSize;
+    DmfAssert(RingBuffer->WritePointer <= RingBuffer->BufferEnd);
+    if (RingBuffer->WritePointer == RingBuffer->BufferEnd)
+    {
+        RingBuffer->WritePointer = RingBuffer->Items;
+    }
+
+    RingBuffer->BytesPresentCount += recordSize;
+    RingBuffer->ItemsPresentCount++;
+    DmfAssert(RingBuffer->BytesPresentCount <= RingBuffer->TotalSize);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_RecordRead(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _Out_ ULONG* BytesRead,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Read the oldest variable size record from the Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address where the record's data is copied.
+    BufferSize - Size in bytes of Buffer.
+    BytesRead - Receives the size in bytes of the record's data.
+    ItemProcessCallback - Callback function that reads from the ring buffer record.
+
+Return Value:
+
+    STATUS_SUCCESS if the record was read.
+    STATUS_BUFFER_TOO_SMALL if the record does not fit in Buffer. The record is not removed.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_RECORD_HEADER* recordHeader;
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->VariableSizeRecords);
+
+    ntStatus = STATUS_SUCCESS;
+    *BytesRead = 0;
+
+    if (0 == RingBuffer->ItemsPresentCount)
+    {
+        // There are no records in the buffer to read.
+        //
+        DmfAssert(0 == RingBuffer->BytesPresentCount);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    recordHeader = (RING_BUFFER_RECORD_HEADER*)RingBuffer->ReadPointer;
+    DmfAssert(0 == (recordHeader->Size & RingBuffer_RecordPadding));
+
+    *BytesRead = recordHeader->Size;
+    if (BufferSize < recordHeader->Size)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    // Read from the Ring Buffer record in a caller specific manner.
+    //
+    (ItemProcessCallback)(Buffer,
+                          (UCHAR*)(recordHeader + 1),
+                          recordHeader->Size);
+
+    RingBuffer_RecordDelete(RingBuffer);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_WriteSingleProducer(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Write data to the Ring Buffer without acquiring a lock.
+    NOTE: Only a single thread (the producer) may call this function at the same time.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to write to the producer's entry.
+    BufferSize - Amount of data in bytes to write to the producer's entry.
+    ItemProcessCallback - Callback function that writes into the ring buffer entry.
+
+Return Value:
+
+    STATUS_SUCCESS if the data was written.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_SIDE* producer;
+    ULONG producerIndex;
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
+    DmfAssert(RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+
+    ntStatus = STATUS_SUCCESS;
+    producer = &RingBuffer->Producer;
+
+    // Only this thread writes the producer's Index.
+    //
+    producerIndex = (ULONG)producer->Index;
+    DmfAssert(producerIndex - producer->OtherIndexCached <= RingBuffer->ItemsCount);
+
+    if (producerIndex - producer->OtherIndexCached == RingBuffer->ItemsCount)
+    {
+        // The Ring Buffer appeared full the last time the consumer's Index was read.
+        // Acquire makes sure the consumer has finished reading the entry that is about
+        // to be overwritten.
+        //
+        producer->OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Consumer.Index);
+        if (producerIndex - producer->OtherIndexCached == RingBuffer->ItemsCount)
+        {
+            // Ring Buffer is Full. The oldest item cannot be deleted by the producer
+            // since only the consumer moves the consumer's Index.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+
+    // See RingBuffer_Write().
+    //
+    if (BufferSize != RingBuffer->ItemSize)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    // Write to the Ring Buffer entry in a caller specific manner.
+    //
+    (*ItemProcessCallback)(Buffer,
+                           producer->Pointer,
+                           RingBuffer->ItemSize);
+
+    producer->Pointer += RingBuffer->ItemSize;
+    DmfAssert(producer->Pointer <= RingBuffer->BufferEnd);
+    if (producer->Pointer == RingBuffer->BufferEnd)
+    {
+        producer->Pointer = RingBuffer->Items;
+    }
+
+    // Release makes sure the entry is written before the consumer sees it.
+    //
+    WriteRelease(&producer->Index,
+                 (LONG)(producerIndex + 1));
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_ReadSingleConsumer(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ RingBuffer_ItemProcessCallbackType ItemProcessCallback
+    )
+/*++
+
+Routine Description:
+
+    Read data from the Ring Buffer without acquiring a lock.
+    NOTE: Only a single thread (the consumer) may call this function at the same time.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of data to copy data read from the consumer's entry.
+    BufferSize - Amount of data in bytes to read from the consumer's entry.
+    ItemProcessCallback - Callback function that reads from the ring buffer entry.
+
+Return Value:
+
+    STATUS_SUCCESS if the data was read.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    RING_BUFFER_SIDE* consumer;
+    ULONG consumerIndex;
+
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(Buffer != NULL);
+    DmfAssert(RingBuffer->ItemSize > 0);
+    DmfAssert(RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+
+    ntStatus = STATUS_SUCCESS;
+    consumer = &RingBuffer->Consumer;
+
+    // Only this thread writes the consumer's Index.
+    //
+    consumerIndex = (ULONG)consumer->Index;
+    DmfAssert(consumer->OtherIndexCached - consumerIndex <= RingBuffer->ItemsCount);
+
+    if (consumerIndex == consumer->OtherIndexCached)
+    {
+        // The Ring Buffer appeared empty the last time the producer's Index was read.
+        // Acquire makes sure the producer has finished writing the entries counted by it.
+        //
+        consumer->OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Producer.Index);
+        if (consumerIndex == consumer->OtherIndexCached)
+        {
+            // There are no items in the buffer to read.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+
+    DmfAssert(BufferSize == RingBuffer->ItemSize);
+
+    // Read from the Ring Buffer entry in a caller specific manner.
+    // Suppress 6001: "*Buffer not initialized." It is because Buffer is either pointer or table to callback.
+    //
+    #pragma warning(suppress: 6001)
+    (ItemProcessCallback)(Buffer,
+                          consumer->Pointer,
+                          RingBuffer->ItemSize);
+
+    consumer->Pointer += RingBuffer->ItemSize;
+    DmfAssert(consumer->Pointer <= RingBuffer->BufferEnd);
+    if (consumer->Pointer == RingBuffer->BufferEnd)
+    {
+        consumer->Pointer = RingBuffer->Items;
+    }
+
+    // Release makes sure the entry has been read before the producer overwrites it.
+    //
+    WriteRelease(&consumer->Index,
+                 (LONG)(consumerIndex + 1));
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_SidesSynchronize(
+    _Inout_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    In RingBuffer_Mode_SingleProducerSingleConsumer, set the Read Pointer, Write Pointer
+    and number of items present from the consumer's and producer's state, so that
+    functions that operate on all the items can be used. Items the producer writes
+    after this call are not included.
+    NOTE: This is done on behalf of the consumer. It must not run at the same time as
+          a read.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG consumerIndex;
+    ULONG producerIndex;
+    size_t writeOffset;
+
+    DmfAssert(RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+
+    consumerIndex = (ULONG)RingBuffer->Consumer.Index;
+    producerIndex = (ULONG)ReadAcquire(&RingBuffer->Producer.Index);
+    DmfAssert(producerIndex - consumerIndex <= RingBuffer->ItemsCount);
+
+    RingBuffer->ItemsPresentCount = producerIndex - consumerIndex;
+    RingBuffer->ReadPointer = RingBuffer->Consumer.Pointer;
+
+    // Do not use the producer's Pointer since it may already be past producerIndex.
+    //
+    writeOffset = (RingBuffer->ReadPointer - RingBuffer->Items) +
+                  ((size_t)RingBuffer->ItemsPresentCount * RingBuffer->ItemSize);
+    if (writeOffset >= RingBuffer->TotalSize)
+    {
+        writeOffset -= RingBuffer->TotalSize;
+    }
+    RingBuffer->WritePointer = RingBuffer->Items + writeOffset;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RegionSplit(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ UCHAR* Position,
+    _In_ ULONG Size,
+    _Out_ UCHAR** FirstSegment,
+    _Out_ ULONG* FirstSegmentSize,
+    _Out_ UCHAR** SecondSegment,
+    _Out_ ULONG* SecondSegmentSize
+    )
+/*++
+
+Routine Description:
+
+    Split a region of the Ring Buffer's memory that starts at a given position into (up to)
+    two contiguous segments: from the position to the end of the buffer and from the
+    beginning of the buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Position - The start of the region. It is inside the buffer.
+    Size - The size of the region in bytes. It is not larger than the buffer.
+    FirstSegment - Receives the start of the first segment (NULL if Size is zero).
+    FirstSegmentSize - Receives the size in bytes of the first segment.
+    SecondSegment - Receives the start of the second segment (NULL if the region does not wrap).
+    SecondSegmentSize - Receives the size in bytes of the second segment.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG bytesUntilEnd;
+
+    DmfAssert(Position >= RingBuffer->Items);
+    DmfAssert(Position < RingBuffer->BufferEnd);
+    DmfAssert(Size <= RingBuffer->TotalSize);
+
+    *FirstSegment = NULL;
+    *FirstSegmentSize = 0;
+    *SecondSegment = NULL;
+    *SecondSegmentSize = 0;
+
+    if (0 == Size)
+    {
+        return;
+    }
+
+    bytesUntilEnd = (ULONG)(RingBuffer->BufferEnd - Position);
+    *FirstSegment = Position;
+    if (Size <= bytesUntilEnd)
+    {
+        *FirstSegmentSize = Size;
+    }
+    else
+    {
+        *FirstSegmentSize = bytesUntilEnd;
+        *SecondSegment = RingBuffer->Items;
+        *SecondSegmentSize = Size - bytesUntilEnd;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+UCHAR*
+RingBuffer_PointerAdvance(
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ UCHAR* Position,
+    _In_ ULONG Size
+    )
+/*++
+
+Routine Description:
+
+    Move a position in the Ring Buffer's memory forward by a given number of bytes,
+    wrapping around the end of the buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Position - The given position.
+    Size - Number of bytes to move. It is not larger than the buffer.
+
+Return Value:
+
+    The new position.
+
+--*/
+{
+    size_t offset;
+
+    DmfAssert(Size <= RingBuffer->TotalSize);
+
+    offset = (Position - RingBuffer->Items) + (size_t)Size;
+    if (offset >= RingBuffer->TotalSize)
+    {
+        offset -= RingBuffer->TotalSize;
+    }
+
+    return RingBuffer->Items + offset;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_ItemsFreeGet(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemsNeeded
+    )
+/*++
+
+Routine Description:
+
+    Return the number of items that can be written without deleting any item.
+    NOTE: In RingBuffer_Mode_SingleProducerSingleConsumer, only the producer may call this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    ItemsNeeded - Number of items the caller wants to write. The consumer's Index is only
+                  read if fewer items appeared free the last time it was read.
+
+Return Value:
+
+    Number of items that are free.
+
+--*/
+{
+    ULONG itemsFree;
+    ULONG producerIndex;
+
+    if (RingBuffer->Mode != RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+        itemsFree = RingBuffer->ItemsCount - RingBuffer->ItemsPresentCount;
+        goto Exit;
+    }
+
+    producerIndex = (ULONG)RingBuffer->Producer.Index;
+    itemsFree = RingBuffer->ItemsCount - (producerIndex - RingBuffer->Producer.OtherIndexCached);
+    if (itemsFree < ItemsNeeded)
+    {
+        // See RingBuffer_WriteSingleProducer().
+        //
+        RingBuffer->Producer.OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Consumer.Index);
+        itemsFree = RingBuffer->ItemsCount - (producerIndex - RingBuffer->Producer.OtherIndexCached);
+    }
+    DmfAssert(itemsFree <= RingBuffer->ItemsCount);
+
+Exit:
+
+    return itemsFree;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_WriteReserve(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG NumberOfItems
+    )
+/*++
+
+Routine Description:
+
+    Reserve space for a number of items at the Write Pointer. In
+    RingBuffer_Mode_DeleteOldestIfFullOnWrite, the oldest items are deleted to make space.
+    Otherwise, fewer items are reserved if there is not enough space.
+    The reserved items are not visible to readers until RingBuffer_WriteCommit() is called.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    NumberOfItems - Number of items to reserve. It is not larger than the number of items
+                    the Ring Buffer can hold.
+
+Return Value:
+
+    Number of items reserved.
+
+--*/
+{
+    ULONG itemsFree;
+    ULONG itemsToDelete;
+
+    DmfAssert(0 == RingBuffer->ItemsReserved);
+    DmfAssert(NumberOfItems <= RingBuffer->ItemsCount);
+
+    itemsFree = RingBuffer_ItemsFreeGet(RingBuffer,
+                                        NumberOfItems);
+    if (NumberOfItems > itemsFree)
+    {
+        if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+        {
+            // Throw away the oldest items to make space for this write.
+            //
+            itemsToDelete = NumberOfItems - itemsFree;
+            RingBuffer->ReadPointer = RingBuffer_PointerAdvance(RingBuffer,
+                                                                RingBuffer->ReadPointer,
+                                                                itemsToDelete * RingBuffer->ItemSize);
+            RingBuffer->ItemsPresentCount -= itemsToDelete;
+        }
+        else
+        {
+            NumberOfItems = itemsFree;
+        }
+    }
+
+    RingBuffer->ItemsReserved = NumberOfItems;
+
+    return NumberOfItems;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_WriteCommit(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG NumberOfItems
+    )
+/*++
+
+Routine Description:
+
+    Make a number of the items reserved by RingBuffer_WriteReserve() visible to readers and
+    release the rest of the reservation.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    NumberOfItems - Number of reserved items that have been written.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG bytesWritten;
+
+    DmfAssert(NumberOfItems <= RingBuffer->ItemsReserved);
+
+    RingBuffer->ItemsReserved = 0;
+    bytesWritten = NumberOfItems * RingBuffer->ItemSize;
+
+    if (RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        RingBuffer->Producer.Pointer = RingBuffer_PointerAdvance(RingBuffer,
+                                                                 RingBuffer->Producer.Pointer,
+                                                                 bytesWritten);
+        // Release makes sure the items are written before the consumer sees them.
+        //
+        WriteRelease(&RingBuffer->Producer.Index,
+                     (LONG)((ULONG)RingBuffer->Producer.Index + NumberOfItems));
+    }
+    else
+    {
+        if (RingBuffer->Index.KeyLength > 0)
+        {
+            RingBuffer_IndexItemsWritten(RingBuffer,
+                                         RingBuffer->WritePointer,
+                                         NumberOfItems);
+        }
+        RingBuffer->WritePointer = RingBuffer_PointerAdvance(RingBuffer,
+                                                             RingBuffer->WritePointer,
+                                                             bytesWritten);
+        RingBuffer->ItemsPresentCount += NumberOfItems;
+        DmfAssert(RingBuffer->ItemsPresentCount <= RingBuffer->ItemsCount);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_WriteMany(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_reads_(NumberOfItems * RingBuffer->ItemSize) UCHAR* Buffer,
+    _In_ ULONG NumberOfItems
+    )
+/*++
+
+Routine Description:
+
+    Write a number of items to the Ring Buffer with (at most) two copies.
+    NOTE: In RingBuffer_Mode_SingleProducerSingleConsumer, only the producer may call this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address of the items to write.
+    NumberOfItems - Number of items to write.
+
+Return Value:
+
+    Number of items written. In RingBuffer_Mode_DeleteOldestIfFullOnWrite, all the items
+    are written. Otherwise, it is less than NumberOfItems if the Ring Buffer becomes full.
+
+--*/
+{
+    UCHAR* writePointer;
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG itemsToWrite;
+    ULONG itemsWritten;
+
+    DmfAssert(RingBuffer->ItemSize > 0);
+
+    itemsToWrite = NumberOfItems;
+    if (itemsToWrite > RingBuffer->ItemsCount)
+    {
+        if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+        {
+            // The first items would be deleted by the last items anyway. Only write the last items.
+            //
+            Buffer += (size_t)(itemsToWrite - RingBuffer->ItemsCount) * RingBuffer->ItemSize;
+        }
+        itemsToWrite = RingBuffer->ItemsCount;
+    }
+
+    itemsWritten = RingBuffer_WriteReserve(RingBuffer,
+                                           itemsToWrite);
+    if (RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        writePointer = RingBuffer->Producer.Pointer;
+    }
+    else
+    {
+        writePointer = RingBuffer->WritePointer;
+    }
+    RingBuffer_RegionSplit(RingBuffer,
+                           writePointer,
+                           itemsWritten * RingBuffer->ItemSize,
+                           &firstSegment,
+                           &firstSegmentSize,
+                           &secondSegment,
+                           &secondSegmentSize);
+    if (firstSegmentSize > 0)
+    {
+        RtlCopyMemory(firstSegment,
+                      Buffer,
+                      firstSegmentSize);
+    }
+    if (secondSegmentSize > 0)
+    {
+        RtlCopyMemory(secondSegment,
+                      Buffer + firstSegmentSize,
+                      secondSegmentSize);
+    }
+    RingBuffer_WriteCommit(RingBuffer,
+                           itemsWritten);
+
+    if (RingBuffer->Mode == RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+    {
+        DmfAssert(itemsWritten == itemsToWrite);
+        itemsWritten = NumberOfItems;
+    }
+
+    return itemsWritten;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+RingBuffer_ReadMany(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _Out_writes_(MaximumNumberOfItems * RingBuffer->ItemSize) UCHAR* Buffer,
+    _In_ ULONG MaximumNumberOfItems
+    )
+/*++
+
+Routine Description:
+
+    Read (up to) a number of items from the Ring Buffer with (at most) two copies.
+    NOTE: In RingBuffer_Mode_SingleProducerSingleConsumer, only the consumer may call this function.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    Buffer - Address where the items are copied.
+    MaximumNumberOfItems - Maximum number of items to read.
+
+Return Value:
+
+    Number of items read.
+
+--*/
+{
+    RING_BUFFER_SIDE* consumer;
+    UCHAR* readPointer;
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG consumerIndex;
+    ULONG itemsPresent;
+    ULONG itemsToRead;
+
+    DmfAssert(RingBuffer->ItemSize > 0);
+
+    consumer = &RingBuffer->Consumer;
+    consumerIndex = 0;
+
+    if (RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        // See RingBuffer_ReadSingleConsumer().
+        //
+        consumerIndex = (ULONG)consumer->Index;
+        itemsPresent = consumer->OtherIndexCached - consumerIndex;
+        if (itemsPresent < MaximumNumberOfItems)
+        {
+            consumer->OtherIndexCached = (ULONG)ReadAcquire(&RingBuffer->Producer.Index);
+            itemsPresent = consumer->OtherIndexCached - consumerIndex;
+        }
+        readPointer = consumer->Pointer;
+    }
+    else
+    {
+        itemsPresent = RingBuffer->ItemsPresentCount;
+        readPointer = RingBuffer->ReadPointer;
+    }
+    DmfAssert(itemsPresent <= RingBuffer->ItemsCount);
+
+    itemsToRead = MaximumNumberOfItems;
+    if (itemsToRead > itemsPresent)
+    {
+        itemsToRead = itemsPresent;
+    }
+
+    RingBuffer_RegionSplit(RingBuffer,
+                           readPointer,
+                           itemsToRead * RingBuffer->ItemSize,
+                           &firstSegment,
+                           &firstSegmentSize,
+                           &secondSegment,
+                           &secondSegmentSize);
+    if (firstSegmentSize > 0)
+    {
+        RtlCopyMemory(Buffer,
+                      firstSegment,
+                      firstSegmentSize);
+    }
+    if (secondSegmentSize > 0)
+    {
+        RtlCopyMemory(Buffer + firstSegmentSize,
+                      secondSegment,
+                      secondSegmentSize);
+    }
+
+    readPointer = RingBuffer_PointerAdvance(RingBuffer,
+                                            readPointer,
+                                            firstSegmentSize + secondSegmentSize);
+    if (RingBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        consumer->Pointer = readPointer;
+        // Release makes sure the items have been read before the producer overwrites them.
+        //
+        WriteRelease(&consumer->Index,
+                     (LONG)(consumerIndex + itemsToRead));
+    }
+    else
+    {
+        RingBuffer->ReadPointer = readPointer;
+        RingBuffer->ItemsPresentCount -= itemsToRead;
+    }
+
+    return itemsToRead;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+RingBuffer_Create(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG ItemCount,
+    _In_ ULONG ItemSize,
+    _In_ RingBuffer_ModeType Mode,
+    _In_ ULONG RecordBufferSize,
+    _In_ ULONG ReadCursorCount,
+    _In_ ULONG IndexKeyOffset,
+    _In_ ULONG IndexKeyLength
+    )
+/*++
+
+Routine Description:
+
+    Create a Ring Buffer using parameters from the caller.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RingBuffer - The Ring Buffer management data that will be initialized.
+    ItemCount - Number of entries in the Ring Buffer.
+    ItemSize - Size in bytes of each entry in the Ring Buffer (maximum size of each
+               record's data for variable size records).
+    Mode - Indicates the mode of Ring Buffer.
+    RecordBufferSize - If not zero, the size in bytes of a Ring Buffer of variable size
+                       records. ItemCount is not used.
+    ReadCursorCount - If not zero, the maximum number of read cursors.
+    IndexKeyOffset - Offset in bytes of the key of each item in the index.
+    IndexKeyLength - If not zero, the length in bytes of the key of each item in the index.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONG totalSize;
+    ULONG swapSize;
+    ULONG bucketCount;
+    ULONG slotIndex;
+    size_t indexSize;
+
+    PAGED_CODE();
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(NULL == RingBuffer->Items);
+
+    if (0 == ItemSize)
+    {
+        ntStatus = STATUS_INVALID_PARAMETER;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    if (RecordBufferSize > 0)
+    {
+        // The buffer holds variable size records. It must hold at least one record of the
+        // maximum size. Each record is aligned, so the buffer size is too.
+        //
+        RecordBufferSize &= ~(RingBuffer_RecordAlignment - 1);
+        if ((ItemSize > RecordBufferSize) ||
+            (RingBuffer_RecordSizeGet(ItemSize) > RecordBufferSize) ||
+            (Mode == RingBuffer_Mode_SingleProducerSingleConsumer))
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+        ItemCount = RecordBufferSize / RingBuffer_RecordAlignment;
+        totalSize = RecordBufferSize;
+        swapSize = RingBuffer_RecordAlignment;
+    }
+    else
+    {
+        if (0 == ItemCount)
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+        totalSize = ItemSize * ItemCount;
+        swapSize = ItemSize;
+    }
+
+    if ((ReadCursorCount > 0) &&
+        (RecordBufferSize > 0 || Mode == RingBuffer_Mode_SingleProducerSingleConsumer))
+    {
+        // Read cursors are only supported with fixed size items and a lock.
+        //
+        ntStatus = STATUS_INVALID_PARAMETER;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    if ((IndexKeyLength > 0) &&
+        ((IndexKeyOffset > ItemSize) ||
+         (IndexKeyLength > ItemSize - IndexKeyOffset) ||
+         (RecordBufferSize > 0) ||
+         (Mode == RingBuffer_Mode_SingleProducerSingleConsumer)))
+    {
+        // The key must be inside each item. The index is only supported with fixed size
+        // items and a lock.
+        //
+        ntStatus = STATUS_INVALID_PARAMETER;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    // Create space for the Ring Buffer entries.
+    // The extra space is swap space used only by this object.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    size_t sizeToAllocate = ((size_t)totalSize + swapSize);
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &RingBuffer->MemoryRing,
+                               (VOID**)&RingBuffer->Items);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    DmfAssert(RingBuffer->MemoryRing != NULL);
+    DmfAssert(RingBuffer->Items != NULL);
+
+    // Initialize the space to zero in case not all space is used up.
+    //
+    RtlZeroMemory(RingBuffer->Items,
+                  sizeToAllocate);
+
+    // Initialize the Ring Buffer management entries.
+    //
+    RingBuffer->ReadPointer = RingBuffer->Items;
+    RingBuffer->WritePointer = RingBuffer->Items;
+    RingBuffer->ItemSize = ItemSize;
+    RingBuffer->BufferEnd = RingBuffer->Items + totalSize;
+    RingBuffer->TotalSize = totalSize;
+    RingBuffer->Mode = Mode;
+    RingBuffer->ItemsCount = ItemCount;
+    RingBuffer->ItemsPresentCount = 0;
+    RingBuffer->VariableSizeRecords = (RecordBufferSize > 0);
+    RingBuffer->BytesPresentCount = 0;
+    RingBuffer->ItemsReserved = 0;
+    RingBuffer->Producer.Index = 0;
+    RingBuffer->Producer.OtherIndexCached = 0;
+    RingBuffer->Producer.Pointer = RingBuffer->Items;
+    RingBuffer->Consumer.Index = 0;
+    RingBuffer->Consumer.OtherIndexCached = 0;
+    RingBuffer->Consumer.Pointer = RingBuffer->Items;
+
+    if (ReadCursorCount > 0)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   ReadCursorCount * sizeof(RING_BUFFER_READ_CURSOR),
+                                   &RingBuffer->MemoryReadCursors,
+                                   (VOID**)&RingBuffer->ReadCursors);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            RingBuffer->MemoryReadCursors = NULL;
+            RingBuffer->ReadCursors = NULL;
+            goto Exit;
+        }
+
+        RtlZeroMemory(RingBuffer->ReadCursors,
+                      ReadCursorCount * sizeof(RING_BUFFER_READ_CURSOR));
+        RingBuffer->ReadCursorCount = ReadCursorCount;
+    }
+
+    if (IndexKeyLength > 0)
+    {
+        // Use at least as many buckets as items so that chains are short.
+        //
+        bucketCount = 1;
+        while (bucketCount < ItemCount)
+        {
+            bucketCount <<= 1;
+        }
+
+        indexSize = (2 * (size_t)bucketCount + 3 * (size_t)ItemCount) * sizeof(ULONG);
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   indexSize,
+                                   &RingBuffer->Index.Memory,
+                                   (VOID**)&RingBuffer->Index.BucketHeads);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            RingBuffer->Index.Memory = NULL;
+            RingBuffer->Index.BucketHeads = NULL;
+            goto Exit;
+        }
+
+        RingBuffer->Index.BucketTails = RingBuffer->Index.BucketHeads + bucketCount;
+        RingBuffer->Index.SlotNext = RingBuffer->Index.BucketTails + bucketCount;
+        RingBuffer->Index.SlotPrevious = RingBuffer->Index.SlotNext + ItemCount;
+        RingBuffer->Index.SlotBucket = RingBuffer->Index.SlotPrevious + ItemCount;
+        RingBuffer->Index.BucketCount = bucketCount;
+        RingBuffer->Index.KeyOffset = IndexKeyOffset;
+        RingBuffer->Index.KeyLength = IndexKeyLength;
+
+        // All the chains are empty.
+        //
+        for (slotIndex = 0; slotIndex < bucketCount; slotIndex++)
+        {
+            RingBuffer->Index.BucketHeads[slotIndex] = RingBuffer_IndexNone;
+            RingBuffer->Index.BucketTails[slotIndex] = RingBuffer_IndexNone;
+        }
+        for (slotIndex = 0; slotIndex < ItemCount; slotIndex++)
+        {
+            RingBuffer->Index.SlotBucket[slotIndex] = RingBuffer_IndexNone;
+        }
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_RotateLeft(
+    _Inout_ RING_BUFFER* RingBuffer,
+    _In_ ULONG UnitSize,
+    _In_ ULONG UnitsToRotate
+    )
+/*++
+
+Routine Description:
+
+    Rotate the Ring Buffer's memory leftward by a given number of units (entries, or
+    alignment units for variable size records) so that the unit at index UnitsToRotate
+    moves to index 0. This uses the cycle leader algorithm: every unit is copied exactly
+    once, plus one copy to and from the swap space for each cycle. Thus, the cost is
+    O(TotalSize) regardless of UnitSize and UnitsToRotate. The extra space allocated
+    past BufferEnd is used as the swap space.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data.
+    UnitSize - Size in bytes of each unit that is moved.
+    UnitsToRotate - Number of units to rotate leftward.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG numberOfCycles;
+    ULONG cycleIndex;
+    ULONG itemSize;
+    ULONG itemsCount;
+    ULONG remainder;
+    UCHAR* addressForSwap;
+
+    DmfAssert(RingBuffer != NULL);
+    DmfAssert(UnitSize > 0);
+    DmfAssert(0 == (RingBuffer->TotalSize % UnitSize));
+
+    itemSize = UnitSize;
+    itemsCount = RingBuffer->TotalSize / UnitSize;
+    addressForSwap = RingBuffer->BufferEnd;
+
+    DmfAssert(UnitsToRotate > 0);
+    DmfAssert(UnitsToRotate < itemsCount);
+
+    // The units split into gcd(itemsCount, UnitsToRotate) independent cycles.
+    //
+    numberOfCycles = itemsCount;
+    remainder = UnitsToRotate;
+    while (remainder != 0)
+    {
+        ULONG temporary = numberOfCycles % remainder;
+        numberOfCycles = remainder;
+        remainder = temporary;
+    }
+
+    for (cycleIndex = 0; cycleIndex < numberOfCycles; cycleIndex++)
+    {
+        ULONG destinationIndex;
+        ULONG sourceIndex;
+
+        // Save the cycle leader since it is overwritten first.
+        //
+        RtlCopyMemory(addressForSwap,
+                      RingBuffer->Items + ((size_t)cycleIndex * itemSize),
+                      itemSize);
+
+        // Pull each entry of the cycle into the slot that was just vacated.
+        //
+        destinationIndex = cycleIndex;
+        for (;;)
+        {
+            sourceIndex = destinationIndex + UnitsToRotate;
+            if (sourceIndex >= itemsCount)
+            {
+                sourceIndex -= itemsCount;
+            }
+            if (sourceIndex == cycleIndex)
+            {
+                break;
+            }
+
+            RtlCopyMemory(RingBuffer->Items + ((size_t)destinationIndex * itemSize),
+                          RingBuffer->Items + ((size_t)sourceIndex * itemSize),
+                          itemSize);
+            destinationIndex = sourceIndex;
+        }
+
+        // The last slot of the cycle receives the cycle leader.
+        //
+        RtlCopyMemory(RingBuffer->Items + ((size_t)destinationIndex * itemSize),
+                      addressForSwap,
+                      itemSize);
+    }
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+RingBuffer_Delete(
+    _In_ RING_BUFFER* RingBuffer
+    )
+/*++
+
+Routine Description:
+
+    Destroy a Ring Buffer.
+
+Arguments:
+
+    RingBuffer - The Ring Buffer management data that will be destroyed.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    PAGED_CODE();
+
+    DmfAssert(RingBuffer != NULL);
+
+    if (RingBuffer->MemoryRing != NULL)
+    {
+        DmfAssert(RingBuffer->Items != NULL);
+        WdfObjectDelete(RingBuffer->MemoryRing);
+        RingBuffer->MemoryRing = NULL;
+        RingBuffer->Items = NULL;
+    }
+
+    if (RingBuffer->MemoryReadCursors != NULL)
+    {
+        WdfObjectDelete(RingBuffer->MemoryReadCursors);
+        RingBuffer->MemoryReadCursors = NULL;
+        RingBuffer->ReadCursors = NULL;
+        RingBuffer->ReadCursorCount = 0;
+    }
+
+    if (RingBuffer->Index.Memory != NULL)
+    {
+        WdfObjectDelete(RingBuffer->Index.Memory);
+        RtlZeroMemory(&RingBuffer->Index,
+                      sizeof(RingBuffer->Index));
+    }
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+BOOLEAN
+RingBuffer_ItemMatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_ VOID* BufferToFind
+    )
+/*++
+
+Routine Description:
+
+    This function compares two buffers and calls client specified callback if they match.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Buffer - Pointer to a ring buffer entry.
+    BufferSize - Size of the Buffer.
+    BufferToFind - Pointer to a structure containing details of the Buffer to find.
+
+Return Value:
+
+    TRUE so that all items in Ring Buffer are enumerated.
+
+--*/
+{
+    BUFFER_TO_FIND* bufferToFind;
+
+    bufferToFind = (BUFFER_TO_FIND*)BufferToFind;
+
+    // Check if this Buffer matches the bufferToFind.
+    // NOTE: Variable size records may be smaller than the item being searched.
+    //
+    if ((bufferToFind->ItemSize <= BufferSize) &&
+        (RtlCompareMemory(Buffer,
+                          bufferToFind->Item,
+                          bufferToFind->ItemSize) ==
+         bufferToFind->ItemSize))
+    {
+        // Found a matching buffer, call the callback supplied by Client.
+        //
+        bufferToFind->CallbackIfFound(DmfModule,
+                                      Buffer,
+                                      BufferSize,
+                                      bufferToFind->CallbackContextIfFound);
+    }
+
+    // Continue enumeration.
+    //
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBuffer_IndexEnumerateToFindItem(
+    _In_ DMFMODULE DmfModule,
+    _In_ RING_BUFFER* RingBuffer,
+    _In_ BUFFER_TO_FIND* BufferToFind
+    )
+/*++
+
+Routine Description:
+
+    Calls Client provided function for ring buffer entries that match the client provided
+    buffer using the index. Only the items in the chain of the bucket of the buffer's key
+    are compared. The items are visited from oldest to newest.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RingBuffer - The Ring Buffer management data.
+    BufferToFind - Details of the buffer to find. It must contain the key.
+
+Return Value:
+
+    None
+
+--*/
+{
+    RING_BUFFER_INDEX* index;
+    ULONG slot;
+    ULONG readSlot;
+    ULONG age;
+
+    index = &RingBuffer->Index;
+    DmfAssert(index->KeyLength > 0);
+    DmfAssert(BufferToFind->ItemSize >= index->KeyOffset + index->KeyLength);
+
+    readSlot = (ULONG)((RingBuffer->ReadPointer - RingBuffer->Items) / RingBuffer->ItemSize);
+    slot = index->BucketHeads[RingBuffer_IndexBucketGet(RingBuffer,
+                                                        BufferToFind->Item + index->KeyOffset)];
+    while (slot != RingBuffer_IndexNone)
+    {
+        // Slots are not removed from the index when items are read or deleted. Only compare
+        // the slots that hold items that are present.
+        //
+        age = (slot >= readSlot) ? (slot - readSlot) : (slot + RingBuffer->ItemsCount - readSlot);
+        if (age < RingBuffer->ItemsPresentCount)
+        {
+            RingBuffer_ItemMatch(DmfModule,
+                                 RingBuffer->Items + ((size_t)slot * RingBuffer->ItemSize),
+                                 RingBuffer->ItemSize,
+                                 BufferToFind);
+        }
+        slot = index->SlotNext[slot];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_RingBuffer_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type RingBuffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    DMF_CONFIG_RingBuffer* moduleConfig;
+
+    PAGED_CODE();
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = RingBuffer_Create(DmfModule,
+                                 &moduleContext->RingBuffer,
+                                 moduleConfig->ItemCount,
+                                 moduleConfig->ItemSize,
+                                 moduleConfig->Mode,
+                                 moduleConfig->RecordBufferSize,
+                                 moduleConfig->ReadCursorCount,
+                                 moduleConfig->IndexKeyOffset,
+                                 moduleConfig->IndexKeyLength);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_RingBuffer_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type RingBuffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    DMF_CONTEXT_RingBuffer* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    RingBuffer_Delete(&moduleContext->RingBuffer);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
-static
 NTSTATUS
-RingBuffer_Create(
+DMF_RingBuffer_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+)
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type RingBuffer.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_RingBuffer;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_RingBuffer;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_RingBuffer);
+    dmfCallbacksDmf_RingBuffer.DeviceOpen = DMF_RingBuffer_Open;
+    dmfCallbacksDmf_RingBuffer.DeviceClose = DMF_RingBuffer_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_RingBuffer,
+                                            RingBuffer,
+                                            DMF_CONTEXT_RingBuffer,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_RingBuffer.CallbacksDmf = &dmfCallbacksDmf_RingBuffer;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_RingBuffer,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ContiguousSegmentsGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _Out_ UCHAR** FirstSegment,
+    _Out_ ULONG* FirstSegmentSize,
+    _Out_ UCHAR** SecondSegment,
+    _Out_ ULONG* SecondSegmentSize
+    )
+/*++
+
+Routine Description:
+
+    Return the address and size of the (up to) two contiguous regions of the Ring Buffer's
+    memory that hold the entries currently present, oldest first. The first region starts
+    at the Read Pointer. The second region, if any, starts at the beginning of the Ring
+    Buffer's memory. The caller can consume the data in place, so no reorder is necessary.
+    NOTE: The returned addresses point into the Ring Buffer. They are only valid until the
+          Ring Buffer is next written or read. This Method is designed to be used by crash
+          dump processing where nothing else runs.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Lock - Set to TRUE if the this Method should lock the Module while reading the pointers.
+    FirstSegment - Receives the address of the oldest entry or NULL if the Ring Buffer is empty.
+    FirstSegmentSize - Receives the size in bytes of the first region.
+    SecondSegment - Receives the address of the second region or NULL if the data does not wrap.
+    SecondSegmentSize - Receives the size in bytes of the second region.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    ULONG bytesPresent;
+    ULONG bytesUntilEnd;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    DmfAssert(FirstSegment != NULL);
+    DmfAssert(FirstSegmentSize != NULL);
+    DmfAssert(SecondSegment != NULL);
+    DmfAssert(SecondSegmentSize != NULL);
+
+    *FirstSegment = NULL;
+    *FirstSegmentSize = 0;
+    *SecondSegment = NULL;
+    *SecondSegmentSize = 0;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    // When this Method is executed from a Crash Dump Handler, it must not lock since
+    // the lock may already be held.
+    //
+    if (Lock)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
+    if (ringBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        RingBuffer_SidesSynchronize(ringBuffer);
+    }
+
+    DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
+    if (0 == ringBuffer->ItemsPresentCount)
+    {
+        DmfAssert(ringBuffer->ReadPointer == ringBuffer->WritePointer);
+        goto Exit;
+    }
+
+    if (ringBuffer->VariableSizeRecords)
+    {
+        bytesPresent = ringBuffer->BytesPresentCount;
+    }
+    else
+    {
+        bytesPresent = ringBuffer->ItemsPresentCount * ringBuffer->ItemSize;
+    }
+    bytesUntilEnd = (ULONG)(ringBuffer->BufferEnd - ringBuffer->ReadPointer);
+
+    *FirstSegment = ringBuffer->ReadPointer;
+    if (bytesPresent <= bytesUntilEnd)
+    {
+        *FirstSegmentSize = bytesPresent;
+    }
+    else
+    {
+        // Data wraps around the end of the Ring Buffer.
+        //
+        *FirstSegmentSize = bytesUntilEnd;
+        *SecondSegment = ringBuffer->Items;
+        *SecondSegmentSize = bytesPresent - bytesUntilEnd;
+        DmfAssert(ringBuffer->Items + *SecondSegmentSize == ringBuffer->WritePointer);
+    }
+
+Exit:
+
+    if (Lock)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_Enumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _In_ EVT_DMF_RingBuffer_Enumeration* RingBufferItemCallback,
+    _In_opt_ VOID* RingBufferItemCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Calls Client provided function for all ring buffer entries.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Lock - Indicates if this Method should lock the Ring Buffer during enumeration.
+    RingBufferItemCallback - Client provided callback function.
+    RingBufferItemCallbackContext - Context passed to the callback.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    UCHAR* readPointer;
+    UCHAR* writePointer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // When this Method is executed from a Crash Dump Handler, it must not lock since
+    // the lock may already be held.
+    //
+    if (Lock)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
+    ringBuffer = &(moduleContext->RingBuffer);
+
+    if (ringBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        RingBuffer_SidesSynchronize(ringBuffer);
+    }
+
+    readPointer = ringBuffer->ReadPointer;
+    writePointer = ringBuffer->WritePointer;
+
+    // Check if ring buffer is empty.
+    //
+    DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
+    if (0 == ringBuffer->ItemsPresentCount)
+    {
+        DmfAssert(readPointer == writePointer);
+        goto Exit;
+    }
+
+    DmfAssert(ringBuffer->ItemSize > 0);
+
+    BOOLEAN continueEnumeration;
+
+    if (ringBuffer->VariableSizeRecords)
+    {
+        RING_BUFFER_RECORD_HEADER* recordHeader;
+        ULONG bytesRemaining;
+        ULONG recordSize;
+
+        // Enumerate each record (skipping padding) and call the client supplied callback.
+        //
+        continueEnumeration = TRUE;
+        bytesRemaining = ringBuffer->BytesPresentCount;
+        while (continueEnumeration &&
+               (bytesRemaining > 0))
+        {
+            recordHeader = (RING_BUFFER_RECORD_HEADER*)readPointer;
+            if (recordHeader->Size & RingBuffer_RecordPadding)
+            {
+                recordSize = recordHeader->Size & ~RingBuffer_RecordPadding;
+            }
+            else
+            {
+                recordSize = RingBuffer_RecordSizeGet(recordHeader->Size);
+                continueEnumeration = RingBufferItemCallback(DmfModule,
+                                                             (UCHAR*)(recordHeader + 1),
+                                                             recordHeader->Size,
+                                                             RingBufferItemCallbackContext);
+            }
+            DmfAssert(recordSize <= bytesRemaining);
+            bytesRemaining -= recordSize;
+
+            readPointer += recordSize;
+            if (readPointer == ringBuffer->BufferEnd)
+            {
+                readPointer = ringBuffer->Items;
+            }
+        }
+        goto Exit;
+    }
+
+    do
+    {
+        // Enumerate each entry and call the client supplied callback.
+        //
+        continueEnumeration = RingBufferItemCallback(DmfModule,
+                                                     readPointer,
+                                                     ringBuffer->ItemSize,
+                                                     RingBufferItemCallbackContext);
+        // Update the read pointer.
+        //
+        readPointer += ringBuffer->ItemSize;
+
+        if (readPointer == ringBuffer->BufferEnd)
+        {
+            readPointer = ringBuffer->Items;
+        }
+    } 
+    while (continueEnumeration &&
+           (readPointer != writePointer));
+
+Exit:
+
+    if (Lock)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_EnumerateToFindItem(
+    _In_ DMFMODULE DmfModule,
+    _In_ EVT_DMF_RingBuffer_Enumeration* RingBufferItemCallback,
+    _In_opt_ VOID* RingBufferItemCallbackContext,
+    _In_ UCHAR* Item,
+    _In_ ULONG ItemSize
+    )
+/*++
+
+Routine Description:
+
+    Calls Client provided function for ring buffer entries that match the client provided buffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RingBufferItemCallback - Client provided callback function.
+    RingBufferItemCallbackContext - Context passed to the callback.
+    Item - A buffer with data that the client is looking for.
+    ItemSize - Size of the data that the client is looking for.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BUFFER_TO_FIND bufferToFind;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    bufferToFind.Item = Item;
+    bufferToFind.ItemSize = ItemSize;
+    bufferToFind.CallbackIfFound = RingBufferItemCallback;
+    bufferToFind.CallbackContextIfFound = RingBufferItemCallbackContext;
+
+    DmfAssert(bufferToFind.ItemSize <= moduleContext->RingBuffer.ItemSize);
+
+    if ((moduleContext->RingBuffer.Index.KeyLength > 0) &&
+        (ItemSize >= moduleContext->RingBuffer.Index.KeyOffset + moduleContext->RingBuffer.Index.KeyLength))
+    {
+        // The buffer contains the key, so only the items with the same key hash are compared.
+        //
+        DMF_ModuleLock(DmfModule);
+        RingBuffer_IndexEnumerateToFindItem(DmfModule,
+                                            &moduleContext->RingBuffer,
+                                            &bufferToFind);
+        DMF_ModuleUnlock(DmfModule);
+    }
+    else
+    {
+        DMF_RingBuffer_Enumerate(DmfModule,
+                                 TRUE,
+                                 RingBuffer_ItemMatch,
+                                 &bufferToFind);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_Read(
     _In_ DMFMODULE DmfModule,
-    _Inout_ RING_BUFFER* RingBuffer,
-    _In_ ULONG ItemCount,
-    _In_ ULONG ItemSize,
-    _In_ RingBuffer_ModeType Mode
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize
     )
 /*++
 
 Routine Description:
 
-    Create a Ring Buffer using parameters from the caller.
+    Read data from the Ring Buffer. (Reads the whole entry.)
 
 Arguments:
 
     DmfModule - This Module's handle.
-    RingBuffer - The Ring Buffer management data that will be initialized.
-    ItemCount - Number of entries in the Ring Buffer.
-    ItemSize - Size in bytes of each entry in the Ring Buffer.
-    Mode - Indicates the mode of Ring Buffer.
+    TargetBuffer - Address of data to copy data read from the Read Pointer.
+    TargetBufferSize - Amount of data in bytes to read from the Read Pointer.
 
 Return Value:
 
@@ -538,341 +3019,709 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_CONTEXT_RingBuffer* moduleContext;
 
-    PAGED_CODE();
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
 
-    DmfAssert(RingBuffer != NULL);
-    DmfAssert(NULL == RingBuffer->Items);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    if (0 == ItemSize)
+    if (moduleContext->RingBuffer.VariableSizeRecords)
     {
-        ntStatus = STATUS_INVALID_PARAMETER;
-        DmfAssert(FALSE);
+        ULONG bytesRead;
+
+        ntStatus = DMF_RingBuffer_ReadRecord(DmfModule,
+                                             TargetBuffer,
+                                             TargetBufferSize,
+                                             &bytesRead);
         goto Exit;
     }
 
-    if (0 == ItemCount)
+    if (moduleContext->RingBuffer.ReadCursors != NULL)
     {
-        ntStatus = STATUS_INVALID_PARAMETER;
+        // Each consumer reads through its own cursor. Use DMF_RingBuffer_ReadCursorRead().
+        //
         DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
         goto Exit;
     }
 
-    // Create space for the Ring Buffer entries.
-    // The +1 is for extra swap space used only by this object.
-    //
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = DmfModule;
-    size_t sizeToAllocate = ((ItemCount + 1) * ItemSize);
-    ntStatus = WdfMemoryCreate(&objectAttributes,
-                               NonPagedPoolNx,
-                               MemoryTag,
-                               sizeToAllocate,
-                               &RingBuffer->MemoryRing,
-                               (VOID**)&RingBuffer->Items);
-    if (!NT_SUCCESS(ntStatus))
+    DmfAssert(TargetBufferSize == moduleContext->RingBuffer.ItemSize);
+
+    if (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
     {
+        // Only the consumer reads, so no lock is necessary.
+        //
+        ntStatus = RingBuffer_ReadSingleConsumer(&moduleContext->RingBuffer,
+                                                 TargetBuffer,
+                                                 TargetBufferSize,
+                                                 RingBuffer_ItemProcessCallbackRead);
         goto Exit;
     }
 
-    DmfAssert(RingBuffer->MemoryRing != NULL);
-    DmfAssert(RingBuffer->Items != NULL);
+    DMF_ModuleLock(DmfModule);
 
-    // Initialize the space to zero in case not all space is used up.
+    ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
+                               TargetBuffer,
+                               TargetBufferSize,
+                               RingBuffer_ItemProcessCallbackRead);
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadAll(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesWritten
+    )
+/*++
+
+Routine Description:
+
+    Capture data from the Ring Buffer. (Reads the full Ring Buffer.)
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetBuffer - Address of buffer to store data in.
+    TargetBufferSize - Size of Buffer.
+    BytesWritten - Number of actual bytes written.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG entriesRead;
+    BOOLEAN singleConsumer;
+
+    UNREFERENCED_PARAMETER(TargetBufferSize);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext != NULL);
+    DmfAssert(NULL != TargetBuffer);
+    DmfAssert(TargetBufferSize >= moduleContext->RingBuffer.TotalSize);
+    DmfAssert(BytesWritten != NULL);
+
+    ntStatus = STATUS_UNSUCCESSFUL;
+
+    if (moduleContext->RingBuffer.VariableSizeRecords)
+    {
+        // Record boundaries would be lost. Use DMF_RingBuffer_ReadRecord().
+        //
+        DmfAssert(FALSE);
+        *BytesWritten = 0;
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (moduleContext->RingBuffer.ReadCursors != NULL)
+    {
+        // Each consumer reads through its own cursor. Use DMF_RingBuffer_ReadCursorRead().
+        //
+        DmfAssert(FALSE);
+        *BytesWritten = 0;
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    // Only the consumer reads in RingBuffer_Mode_SingleProducerSingleConsumer, so no lock
+    // is necessary.
     //
-    RtlZeroMemory(RingBuffer->Items,
-                  sizeToAllocate);
+    singleConsumer = (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+    if (! singleConsumer)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
 
-    // Initialize the Ring Buffer management entries.
+    // Copy all the entries present with (at most) two copies.
     //
-    RingBuffer->ReadPointer = RingBuffer->Items;
-    RingBuffer->WritePointer = RingBuffer->Items;
-    RingBuffer->ItemSize = ItemSize;
-    RingBuffer->BufferEnd = RingBuffer->Items + (RingBuffer->ItemSize * ItemCount);
-    RingBuffer->TotalSize = RingBuffer->ItemSize * ItemCount;
-    RingBuffer->Mode = Mode;
-    RingBuffer->ItemsCount = ItemCount;
-    RingBuffer->ItemsPresentCount = 0;
+    entriesRead = RingBuffer_ReadMany(&moduleContext->RingBuffer,
+                                      TargetBuffer,
+                                      moduleContext->RingBuffer.ItemsCount);
+
+    *BytesWritten = entriesRead * moduleContext->RingBuffer.ItemSize;
+
+    if (! singleConsumer)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    ntStatus = STATUS_SUCCESS;
 
 Exit:
 
     return ntStatus;
 }
-#pragma code_seg()
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
-static
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ReadCursorClose(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor
+    )
+/*++
+
+Routine Description:
+
+    Close a read cursor opened by DMF_RingBuffer_ReadCursorOpen(). Items that only this
+    cursor had not read are deleted.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ReadCursor - The read cursor to close.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    DmfAssert(ringBuffer->ReadCursors != NULL);
+    DmfAssert(ReadCursor < ringBuffer->ReadCursorCount);
+
+    if ((NULL == ringBuffer->ReadCursors) ||
+        (ReadCursor >= ringBuffer->ReadCursorCount))
+    {
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    DmfAssert(ringBuffer->ReadCursors[ReadCursor].InUse);
+    ringBuffer->ReadCursors[ReadCursor].InUse = FALSE;
+    RingBuffer_ReadCursorsSynchronize(ringBuffer);
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorDroppedCountGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor,
+    _Out_ ULONG* ItemsDropped
+    )
+/*++
+
+Routine Description:
+
+    Return the number of items that were deleted (in RingBuffer_Mode_DeleteOldestIfFullOnWrite)
+    before a given read cursor read them.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ReadCursor - The given read cursor.
+    ItemsDropped - Receives the number of items the cursor skipped since it was opened.
+
+Return Value:
+
+    STATUS_SUCCESS
+    STATUS_INVALID_PARAMETER if ReadCursor is not an open read cursor.
+
+--*/
+{
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    NTSTATUS ntStatus;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    DmfAssert(ItemsDropped != NULL);
+
+    *ItemsDropped = 0;
+
+    if ((NULL == ringBuffer->ReadCursors) ||
+        (ReadCursor >= ringBuffer->ReadCursorCount))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    if (ringBuffer->ReadCursors[ReadCursor].InUse)
+    {
+        *ItemsDropped = ringBuffer->ReadCursors[ReadCursor].ItemsDropped;
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
 NTSTATUS
-RingBuffer_Delete(
-    _In_ RING_BUFFER* RingBuffer
+DMF_RingBuffer_ReadCursorOpen(
+    _In_ DMFMODULE DmfModule,
+    _Out_ ULONG* ReadCursor
     )
 /*++
 
 Routine Description:
 
-    Destroy a Ring Buffer.
+    Open a read cursor. Each consumer reads all the items written after its cursor is
+    opened, independently of the other consumers. Items are written once and are deleted
+    when all the open cursors have read them.
 
 Arguments:
 
-    RingBuffer - The Ring Buffer management data that will be destroyed.
+    DmfModule - This Module's handle.
+    ReadCursor - Receives the read cursor to pass to the other DMF_RingBuffer_ReadCursor* Methods.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS
+    STATUS_INSUFFICIENT_RESOURCES if DMF_CONFIG_RingBuffer.ReadCursorCount cursors are already open.
+    STATUS_NOT_SUPPORTED if DMF_CONFIG_RingBuffer.ReadCursorCount is zero.
 
 --*/
 {
-    PAGED_CODE();
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    NTSTATUS ntStatus;
+    ULONG cursorIndex;
 
-    DmfAssert(RingBuffer != NULL);
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
 
-    if (RingBuffer->MemoryRing != NULL)
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
+
+    DmfAssert(ReadCursor != NULL);
+
+    *ReadCursor = 0;
+
+    if (NULL == ringBuffer->ReadCursors)
     {
-        DmfAssert(RingBuffer->Items != NULL);
-        WdfObjectDelete(RingBuffer->MemoryRing);
-        RingBuffer->MemoryRing = NULL;
-        RingBuffer->Items = NULL;
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
     }
 
-    return STATUS_SUCCESS;
+    ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+
+    DMF_ModuleLock(DmfModule);
+
+    for (cursorIndex = 0; cursorIndex < ringBuffer->ReadCursorCount; cursorIndex++)
+    {
+        if (! ringBuffer->ReadCursors[cursorIndex].InUse)
+        {
+            // The new cursor starts after the newest item.
+            //
+            ringBuffer->ReadCursors[cursorIndex].InUse = TRUE;
+            ringBuffer->ReadCursors[cursorIndex].ItemsUnread = 0;
+            ringBuffer->ReadCursors[cursorIndex].ItemsDropped = 0;
+            *ReadCursor = cursorIndex;
+            ntStatus = STATUS_SUCCESS;
+            break;
+        }
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return ntStatus;
 }
-#pragma code_seg()
 
-_Function_class_(EVT_DMF_RingBuffer_Enumeration)
-BOOLEAN
-RingBuffer_ItemMatch(
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorRead(
     _In_ DMFMODULE DmfModule,
-    _Inout_updates_(BufferSize) UCHAR* Buffer,
-    _In_ ULONG BufferSize,
-    _In_ VOID* BufferToFind
+    _In_ ULONG ReadCursor,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize
     )
 /*++
 
 Routine Description:
 
-    This function compares two buffers and calls client specified callback if they match.
+    Read the next item of a given read cursor. (Reads the whole entry.)
+    Other cursors are not affected.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Buffer - Pointer to a ring buffer entry.
-    BufferSize - Size of the Buffer.
-    BufferToFind - Pointer to a structure containing details of the Buffer to find.
+    ReadCursor - The given read cursor.
+    TargetBuffer - Address of data to copy the item to.
+    TargetBufferSize - Size of TargetBuffer. It must be the size of each entry.
 
 Return Value:
 
-    TRUE so that all items in Ring Buffer are enumerated.
+    STATUS_SUCCESS
+    STATUS_UNSUCCESSFUL if the cursor has read all the items.
+    STATUS_INVALID_PARAMETER if ReadCursor is not an open read cursor.
 
 --*/
 {
-    BUFFER_TO_FIND* bufferToFind;
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    RING_BUFFER_READ_CURSOR* readCursor;
 
-    bufferToFind = (BUFFER_TO_FIND*)BufferToFind;
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
 
-    DmfAssert(bufferToFind->ItemSize <= BufferSize);
+    DmfAssert(TargetBuffer != NULL);
 
-    // Check if this Buffer matches the bufferToFind.
-    //
-    if (RtlCompareMemory(Buffer,
-                         bufferToFind->Item,
-                         bufferToFind->ItemSize) ==
-        bufferToFind->ItemSize)
+    if ((NULL == ringBuffer->ReadCursors) ||
+        (ReadCursor >= ringBuffer->ReadCursorCount) ||
+        (TargetBufferSize != ringBuffer->ItemSize))
     {
-        // Found a matching buffer, call the callback supplied by Client.
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    readCursor = &ringBuffer->ReadCursors[ReadCursor];
+    if (! readCursor->InUse)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+    }
+    else if (0 == readCursor->ItemsUnread)
+    {
+        // This cursor has read all the items.
         //
-        bufferToFind->CallbackIfFound(DmfModule,
-                                      Buffer,
-                                      BufferSize,
-                                      bufferToFind->CallbackContextIfFound);
+        ntStatus = STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        RingBuffer_ItemProcessCallbackRead(TargetBuffer,
+                                           RingBuffer_ReadCursorPointerGet(ringBuffer,
+                                                                           readCursor->ItemsUnread),
+                                           ringBuffer->ItemSize);
+        readCursor->ItemsUnread--;
+        RingBuffer_ReadCursorsSynchronize(ringBuffer);
+        ntStatus = STATUS_SUCCESS;
     }
 
-    // Continue enumeration.
-    //
-    return TRUE;
-}
+    DMF_ModuleUnlock(DmfModule);
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+Exit:
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+    return ntStatus;
+}
 
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
-_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
-static
 NTSTATUS
-DMF_RingBuffer_Open(
-    _In_ DMFMODULE DmfModule
+DMF_RingBuffer_ReadCursorReadInPlace(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor,
+    _In_ EVT_DMF_RingBuffer_Enumeration* ItemCallback,
+    _In_opt_ VOID* ItemCallbackContext
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type RingBuffer.
+    Call a given callback with the next item of a given read cursor, where the item is
+    stored in the Ring Buffer. The item is not copied.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    ReadCursor - The given read cursor.
+    ItemCallback - The given callback. It returns TRUE if the cursor moves to the next item
+                   or FALSE if the item should be read again.
+    ItemCallbackContext - Context passed to the callback.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS
+    STATUS_UNSUCCESSFUL if the cursor has read all the items.
+    STATUS_INVALID_PARAMETER if ReadCursor is not an open read cursor.
 
 --*/
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
-    DMF_CONFIG_RingBuffer* moduleConfig;
-
-    PAGED_CODE();
+    RING_BUFFER* ringBuffer;
+    RING_BUFFER_READ_CURSOR* readCursor;
+    BOOLEAN itemRead;
 
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
 
-    ntStatus = RingBuffer_Create(DmfModule,
-                                 &moduleContext->RingBuffer,
-                                 moduleConfig->ItemCount,
-                                 moduleConfig->ItemSize,
-                                 moduleConfig->Mode);
+    DmfAssert(ItemCallback != NULL);
+
+    if ((NULL == ringBuffer->ReadCursors) ||
+        (ReadCursor >= ringBuffer->ReadCursorCount))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // The lock is held while the callback runs so that the item is not overwritten.
+    //
+    DMF_ModuleLock(DmfModule);
+
+    readCursor = &ringBuffer->ReadCursors[ReadCursor];
+    if (! readCursor->InUse)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+    }
+    else if (0 == readCursor->ItemsUnread)
+    {
+        // This cursor has read all the items.
+        //
+        ntStatus = STATUS_UNSUCCESSFUL;
+    }
+    else
+    {
+        itemRead = ItemCallback(DmfModule,
+                                RingBuffer_ReadCursorPointerGet(ringBuffer,
+                                                                readCursor->ItemsUnread),
+                                ringBuffer->ItemSize,
+                                ItemCallbackContext);
+        if (itemRead)
+        {
+            readCursor->ItemsUnread--;
+            RingBuffer_ReadCursorsSynchronize(ringBuffer);
+        }
+        ntStatus = STATUS_SUCCESS;
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
 
     return ntStatus;
 }
-#pragma code_seg()
 
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Close)
-_IRQL_requires_max_(PASSIVE_LEVEL)
-static
-VOID
-DMF_RingBuffer_Close(
-    _In_ DMFMODULE DmfModule
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadMany(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_to_(TargetBufferSize, *BytesRead) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
     )
 /*++
 
 Routine Description:
 
-    Uninitialize an instance of a DMF Module of type RingBuffer.
+    Read the oldest entries from the Ring Buffer, as many as fit in the target buffer.
+    The entries are copied with (at most) two copies instead of one copy per entry.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    TargetBuffer - Address of buffer to store the entries in.
+    TargetBufferSize - Size of TargetBuffer. It should be a multiple of the size of each entry.
+    BytesRead - Number of bytes read (the number of entries read multiplied by the size of
+                each entry).
 
 Return Value:
 
-    None
+    STATUS_SUCCESS if at least one entry was read.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
 
 --*/
 {
-    PAGED_CODE();
-
     DMF_CONTEXT_RingBuffer* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG entriesRead;
+    BOOLEAN singleConsumer;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    RingBuffer_Delete(&moduleContext->RingBuffer);
-}
-#pragma code_seg()
+    DmfAssert(NULL != TargetBuffer);
+    DmfAssert(BytesRead != NULL);
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// Public Calls by Client
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+    *BytesRead = 0;
 
-#pragma code_seg("PAGE")
-_IRQL_requires_max_(PASSIVE_LEVEL)
+    if (moduleContext->RingBuffer.VariableSizeRecords)
+    {
+        // Record boundaries would be lost. Use DMF_RingBuffer_ReadRecord().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (moduleContext->RingBuffer.ReadCursors != NULL)
+    {
+        // Each consumer reads through its own cursor. Use DMF_RingBuffer_ReadCursorRead().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    // Only the consumer reads in RingBuffer_Mode_SingleProducerSingleConsumer, so no lock
+    // is necessary.
+    //
+    singleConsumer = (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+    if (! singleConsumer)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
+    entriesRead = RingBuffer_ReadMany(&moduleContext->RingBuffer,
+                                      TargetBuffer,
+                                      TargetBufferSize / moduleContext->RingBuffer.ItemSize);
+
+    if (! singleConsumer)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    if (0 == entriesRead)
+    {
+        // There are no items in the buffer to read.
+        //
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    *BytesRead = entriesRead * moduleContext->RingBuffer.ItemSize;
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_RingBuffer_Create(
-    _In_ WDFDEVICE Device,
-    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
-    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
-    _Out_ DMFMODULE* DmfModule
-)
+DMF_RingBuffer_ReadRecord(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_to_(TargetBufferSize, *BytesRead) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
+    )
 /*++
 
 Routine Description:
 
-    Create an instance of a DMF Module of type RingBuffer.
+    Read the oldest record from a Ring Buffer of variable size records.
 
 Arguments:
 
-    Device - Client Driver's WDFDEVICE object.
-    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
-    ObjectAttributes - WDF object attributes for DMFMODULE.
-    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+    DmfModule - This Module's handle.
+    TargetBuffer - Address where the record's data is copied.
+    TargetBufferSize - Size in bytes of TargetBuffer.
+    BytesRead - Receives the size in bytes of the record's data (also when TargetBuffer
+                is too small).
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if the record was read.
+    STATUS_BUFFER_TOO_SMALL if the record does not fit in TargetBuffer. The record is not removed.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is empty.
 
 --*/
 {
     NTSTATUS ntStatus;
-    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_RingBuffer;
-    DMF_CALLBACKS_DMF dmfCallbacksDmf_RingBuffer;
+    DMF_CONTEXT_RingBuffer* moduleContext;
 
-    PAGED_CODE();
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBuffer);
 
-    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_RingBuffer);
-    dmfCallbacksDmf_RingBuffer.DeviceOpen = DMF_RingBuffer_Open;
-    dmfCallbacksDmf_RingBuffer.DeviceClose = DMF_RingBuffer_Close;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_RingBuffer,
-                                            RingBuffer,
-                                            DMF_CONTEXT_RingBuffer,
-                                            DMF_MODULE_OPTIONS_DISPATCH,
-                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+    DmfAssert(moduleContext->RingBuffer.VariableSizeRecords);
 
-    dmfModuleDescriptor_RingBuffer.CallbacksDmf = &dmfCallbacksDmf_RingBuffer;
+    DMF_ModuleLock(DmfModule);
 
-    ntStatus = DMF_ModuleCreate(Device,
-                                DmfModuleAttributes,
-                                ObjectAttributes,
-                                &dmfModuleDescriptor_RingBuffer,
-                                DmfModule);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
-    }
+    ntStatus = RingBuffer_RecordRead(&moduleContext->RingBuffer,
+                                     TargetBuffer,
+                                     TargetBufferSize,
+                                     BytesRead,
+                                     RingBuffer_ItemProcessCallbackRead);
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    DMF_ModuleUnlock(DmfModule);
 
-    return(ntStatus);
+    return ntStatus;
 }
-#pragma code_seg()
-
-// Module Methods
-//
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-DMF_RingBuffer_Enumerate(
+DMF_RingBuffer_Reorder(
     _In_ DMFMODULE DmfModule,
-    _In_ BOOLEAN Lock,
-    _In_ EVT_DMF_RingBuffer_Enumeration* RingBufferItemCallback,
-    _In_opt_ VOID* RingBufferItemCallbackContext
+    _In_ BOOLEAN Lock
     )
 /*++
 
 Routine Description:
 
-    Calls Client provided function for all ring buffer entries.
+    Reorder the elements of the Ring Buffer data so that elements are sorted by
+    oldest at the beginning of the buffer to the newest at the end.
+    NOTE: This function is called in unlocked state since it is designed to be used by 
+          crash dump processing. If you need to use this for other purpose, be sure
+          to acquire this Module's lock!.
+          In RingBuffer_Mode_SingleProducerSingleConsumer, neither the producer nor the
+          consumer may run at the same time as this Method since it moves all the items.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Lock - Indicates if this Method should lock the Ring Buffer during enumeration.
-    RingBufferItemCallback - Client provided callback function.
-    RingBufferItemCallbackContext - Context passed to the callback.
+    Lock - Set to TRUE if the this Method should lock the Module while performing the
+           reorder operation.
 
 Return Value:
 
@@ -881,15 +3730,15 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_RingBuffer* moduleContext;
+    UCHAR* endOfRingBuffer;
     RING_BUFFER* ringBuffer;
-    UCHAR* readPointer;
-    UCHAR* writePointer;
+    ULONG unitSize;
+    ULONG bytesPresent;
+    ULONG numberOfBytesToClear;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
     // When this Method is executed from a Crash Dump Handler, it must not lock since
     // the lock may already be held.
     //
@@ -898,46 +3747,94 @@ Return Value:
         DMF_ModuleLock(DmfModule);
     }
 
-    ringBuffer = &(moduleContext->RingBuffer);
-
-    readPointer = ringBuffer->ReadPointer;
-    writePointer = ringBuffer->WritePointer;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
 
-    // Check if ring buffer is empty.
+    // The end of the Ring Buffer data area.
     //
+    endOfRingBuffer = ringBuffer->BufferEnd;
+
+    if (ringBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        RingBuffer_SidesSynchronize(ringBuffer);
+    }
+
     DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
-    if (0 == ringBuffer->ItemsPresentCount)
+    if (ringBuffer->ItemsPresentCount == 0)
     {
-        DmfAssert(readPointer == writePointer);
+        // The buffer is empty. Nothing to reorder.
+        //
+        DmfAssert(ringBuffer->ReadPointer == ringBuffer->WritePointer);
         goto Exit;
     }
 
-    DmfAssert(ringBuffer->ItemSize > 0);
+    // Rotate the whole Ring Buffer so that the entry at the Read Pointer moves to the
+    // beginning of the Ring Buffer's memory. This is the address of the first byte that
+    // will be output during a crash dump. Since the present entries are contiguous
+    // (modulo wrap) starting at the Read Pointer, they end up in order at the beginning.
+    // Variable size records are rotated in units of the record alignment. Padding keeps
+    // its size, so it remains valid.
+    //
+    if (ringBuffer->VariableSizeRecords)
+    {
+        unitSize = RingBuffer_RecordAlignment;
+        bytesPresent = ringBuffer->BytesPresentCount;
+    }
+    else
+    {
+        unitSize = ringBuffer->ItemSize;
+        bytesPresent = ringBuffer->ItemsPresentCount * ringBuffer->ItemSize;
+    }
 
-    BOOLEAN continueEnumeration;
+    if (ringBuffer->ReadPointer != ringBuffer->Items)
+    {
+        RingBuffer_RotateLeft(ringBuffer,
+                              unitSize,
+                              (ULONG)((ringBuffer->ReadPointer - ringBuffer->Items) / unitSize));
+    }
 
-    do
+    // Update the Read and Write pointers.
+    //
+    ringBuffer->ReadPointer = ringBuffer->Items;
+    ringBuffer->WritePointer = ringBuffer->Items + bytesPresent;
+    if (ringBuffer->WritePointer == endOfRingBuffer)
     {
-        // Enumerate each entry and call the client supplied callback.
+        // This case occurs when the Ring Buffer is full.
         //
-        continueEnumeration = RingBufferItemCallback(DmfModule,
-                                                     readPointer,
-                                                     ringBuffer->ItemSize,
-                                                     RingBufferItemCallbackContext);
-        // Update the read pointer.
+        ringBuffer->WritePointer = ringBuffer->Items;
+    }
+
+    if (ringBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        // The number of items written and read does not change. Only their location does.
         //
-        readPointer += ringBuffer->ItemSize;
+        ringBuffer->Consumer.Pointer = ringBuffer->ReadPointer;
+        ringBuffer->Producer.Pointer = ringBuffer->WritePointer;
+    }
 
-        if (readPointer == ringBuffer->BufferEnd)
-        {
-            readPointer = ringBuffer->Items;
-        }
-    } 
-    while (continueEnumeration &&
-           (readPointer != writePointer));
+    if (ringBuffer->Index.KeyLength > 0)
+    {
+        // The items have moved to other slots.
+        //
+        RingBuffer_IndexRebuild(ringBuffer);
+    }
 
 Exit:
 
+    // Erase all items that are not present. (Erase stale data.)
+    //
+    if (ringBuffer->VariableSizeRecords)
+    {
+        numberOfBytesToClear = ringBuffer->TotalSize - ringBuffer->BytesPresentCount;
+    }
+    else
+    {
+        numberOfBytesToClear = (ringBuffer->ItemsCount - ringBuffer->ItemsPresentCount) * ringBuffer->ItemSize;
+    }
+    UCHAR* eraseStartAddress = endOfRingBuffer - numberOfBytesToClear;
+    RtlZeroMemory(eraseStartAddress,
+                  numberOfBytesToClear);
+
     if (Lock)
     {
         DMF_ModuleUnlock(DmfModule);
@@ -945,74 +3842,116 @@ Exit:
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_RingBuffer_EnumerateToFindItem(
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_SegmentsRead(
     _In_ DMFMODULE DmfModule,
-    _In_ EVT_DMF_RingBuffer_Enumeration* RingBufferItemCallback,
-    _In_opt_ VOID* RingBufferItemCallbackContext,
-    _In_ UCHAR* Item,
-    _In_ ULONG ItemSize
+    _In_reads_(NumberOfSegments) UCHAR** Segments,
+    _In_reads_(NumberOfSegments) ULONG* SegmentSizes,
+    _In_reads_(NumberOfSegments) ULONG* SegmentOffsets,
+    _In_ ULONG NumberOfSegments
     )
 /*++
 
 Routine Description:
 
-    Calls Client provided function for ring buffer entries that match the client provided buffer.
+    Read data from the Ring Buffer. (Reads via a map of segments.)
 
 Arguments:
 
     DmfModule - This Module's handle.
-    RingBufferItemCallback - Client provided callback function.
-    RingBufferItemCallbackContext - Context passed to the callback.
-    Item - A buffer with data that the client is looking for.
-    ItemSize - Size of the data that the client is looking for.
+    Segments - Table of addresses to read (each segment) (target buffer).
+    SegmentSizes - The size of each segment (size of each target buffer).
+    SegmentOffsets - The offset in the Ring Buffer entry of each segment.
+    NumberOfSegments - Number of segments in the above tables.
 
 Return Value:
 
-    None
+    NTSTATUS indicates if the Ring Buffer is empty.
 
 --*/
 {
-    BUFFER_TO_FIND bufferToFind;
+    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
+    RingBuffer_CustomItemProcessContext customItemProcessContext;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    bufferToFind.Item = Item;
-    bufferToFind.ItemSize = ItemSize;
-    bufferToFind.CallbackIfFound = RingBufferItemCallback;
-    bufferToFind.CallbackContextIfFound = RingBufferItemCallbackContext;
+    customItemProcessContext.Segments = Segments;
+    customItemProcessContext.SegmentSizes = SegmentSizes;
+    customItemProcessContext.SegmentOffsets = SegmentOffsets;
+    customItemProcessContext.NumberOfSegments = NumberOfSegments;
+    customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackRead;
 
-    DmfAssert(bufferToFind.ItemSize <= moduleContext->RingBuffer.ItemSize);
+    if (moduleContext->RingBuffer.VariableSizeRecords)
+    {
+        // Entries do not have a fixed layout.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (moduleContext->RingBuffer.ReadCursors != NULL)
+    {
+        // Each consumer reads through its own cursor. Use DMF_RingBuffer_ReadCursorRead().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        // Only the consumer reads, so no lock is necessary.
+        //
+        ntStatus = RingBuffer_ReadSingleConsumer(&moduleContext->RingBuffer,
+                                                 (UCHAR*)&customItemProcessContext,
+                                                 moduleContext->RingBuffer.ItemSize,
+                                                 RingBuffer_ItemProcessCallbackSegments);
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
 
-    DMF_RingBuffer_Enumerate(DmfModule,
-                             TRUE,
-                             RingBuffer_ItemMatch,
-                             &bufferToFind);
+    ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
+                               (UCHAR*)&customItemProcessContext,
+                               moduleContext->RingBuffer.ItemSize,
+                               RingBuffer_ItemProcessCallbackSegments);
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_RingBuffer_Read(
+DMF_RingBuffer_SegmentsWrite(
     _In_ DMFMODULE DmfModule,
-    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
-    _In_ ULONG TargetBufferSize
+    _In_reads_(NumberOfSegments) UCHAR** Segments,
+    _In_reads_(NumberOfSegments) ULONG* SegmentSizes,
+    _In_reads_(NumberOfSegments) ULONG* SegmentOffsets,
+    _In_ ULONG NumberOfSegments
     )
 /*++
 
 Routine Description:
 
-    Read data from the Ring Buffer. (Reads the whole entry.)
+    Write data to the Ring Buffer. (Writes via a map of segments.)
 
 Arguments:
 
     DmfModule - This Module's handle.
-    TargetBuffer - Address of data to copy data read from the Read Pointer.
-    TargetBufferSize - Amount of data in bytes to read from the Read Pointer.
+    Segments - Table of addresses to write (each segment) (source buffer).
+    SegmentSizes - The size of each segment (size of each source buffer).
+    SegmentOffsets - The offset in the Ring Buffer entry of each segment.
+    NumberOfSegments - Number of segments in the above tables.
 
 Return Value:
 
@@ -1022,369 +3961,340 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
+    RingBuffer_CustomItemProcessContext customItemProcessContext;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    customItemProcessContext.Segments = Segments;
+    customItemProcessContext.SegmentSizes = SegmentSizes;
+    customItemProcessContext.SegmentOffsets = SegmentOffsets;
+    customItemProcessContext.NumberOfSegments = NumberOfSegments;
+    customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackWrite;
+
+    if (moduleContext->RingBuffer.VariableSizeRecords)
+    {
+        // Entries do not have a fixed layout.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        // Only the producer writes, so no lock is necessary.
+        //
+        ntStatus = RingBuffer_WriteSingleProducer(&moduleContext->RingBuffer,
+                                                  (UCHAR*)&customItemProcessContext,
+                                                  moduleContext->RingBuffer.ItemSize,
+                                                  RingBuffer_ItemProcessCallbackSegments);
+        goto Exit;
+    }
+
     DMF_ModuleLock(DmfModule);
 
-    DmfAssert(TargetBufferSize == moduleContext->RingBuffer.ItemSize);
-    ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
-                               TargetBuffer,
-                               TargetBufferSize,
-                               RingBuffer_ItemProcessCallbackRead);
+    ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
+                                (UCHAR*)&customItemProcessContext,
+                                moduleContext->RingBuffer.ItemSize,
+                                RingBuffer_ItemProcessCallbackSegments);
 
     DMF_ModuleUnlock(DmfModule);
 
+Exit:
+
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_RingBuffer_ReadAll(
+VOID
+DMF_RingBuffer_TotalSizeGet(
     _In_ DMFMODULE DmfModule,
-    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
-    _In_ ULONG TargetBufferSize,
-    _Out_ ULONG* BytesWritten
+    _Out_ ULONG* TotalSize
     )
 /*++
 
 Routine Description:
 
-    Capture data from the Ring Buffer. (Reads the full Ring Buffer.)
+    Return the total size of the Ring Buffer in bytes.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    TargetBuffer - Address of buffer to store data in.
-    TargetBufferSize - Size of Buffer.
-    BytesWritten - Number of actual bytes written.
+    TotalSize - Receives the size of the Ring Buffer.
 
 Return Value:
 
-    NTSTATUS
+    None
 
 --*/
 {
     DMF_CONTEXT_RingBuffer* moduleContext;
-    NTSTATUS ntStatus;
-    ULONG entriesRead;
-    ULONG sizeOfEachItem;
-
-    UNREFERENCED_PARAMETER(TargetBufferSize);
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DmfAssert(moduleContext != NULL);
-    DmfAssert(NULL != TargetBuffer);
-    DmfAssert(TargetBufferSize >= moduleContext->RingBuffer.TotalSize);
-
-    ntStatus = STATUS_UNSUCCESSFUL;
-
-    DMF_ModuleLock(DmfModule);
-
-    entriesRead = 0;
-    sizeOfEachItem = moduleContext->RingBuffer.ItemSize;
-    DmfAssert(sizeOfEachItem > 0);
-    do
-    {
-        ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
-                                   TargetBuffer,
-                                   sizeOfEachItem,
-                                   RingBuffer_ItemProcessCallbackRead);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            break;
-        }
-        TargetBuffer += sizeOfEachItem;
-        entriesRead++;
-    } while (NT_SUCCESS(ntStatus));
-
-    DmfAssert(BytesWritten != NULL);
-    *BytesWritten = entriesRead * sizeOfEachItem;
-
-    DMF_ModuleUnlock(DmfModule);
+    // No need to lock because this value never changes after initialization.
+    //
 
-    return STATUS_SUCCESS;
+    *TotalSize = moduleContext->RingBuffer.TotalSize;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_RingBuffer_Reorder(
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_Write(
     _In_ DMFMODULE DmfModule,
-    _In_ BOOLEAN Lock
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize
     )
 /*++
 
 Routine Description:
 
-    Reorder the elements of the Ring Buffer data so that elements are sorted by
-    oldest at the beginning of the buffer to the newest at the end.
-    NOTE: This function is called in unlocked state since it is designed to be used by 
-          crash dump processing. If you need to use this for other purpose, be sure
-          to acquire this Module's lock!.
+    Write data to the Ring Buffer. (Writes the whole entry.)
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Lock - Set to TRUE if the this Method should lock the Module while performing the
-           reorder operation.
+    SourceBuffer - Address of data to write to the Write Pointer.
+    SourceBufferSize - Amount of data in bytes to write to the Write Pointer.
 
 Return Value:
 
-    None
+    NTSTATUS
 
 --*/
 {
+    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
-    UCHAR* addressToOverwrite;
-    UCHAR* addressOfDataToMove;
-    UCHAR* endOfRingBuffer;
-    UCHAR* addressForSwap;
-    ULONG swapsNeeded;
-    RING_BUFFER* ringBuffer;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
-    // When this Method is executed from a Crash Dump Handler, it must not lock since
-    // the lock may already be held.
-    //
-    if (Lock)
-    {
-        DMF_ModuleLock(DmfModule);
-    }
-
     moduleContext = DMF_CONTEXT_GET(DmfModule);
-    ringBuffer = &moduleContext->RingBuffer;
-
-    // The beginning of the Ring Buffer's memory. This is the address of the first
-    // byte that will be output during a crash dump.
-    //
-    addressToOverwrite = ringBuffer->Items;
-    // The location of Read Pointer.
-    //
-    addressOfDataToMove = ringBuffer->ReadPointer;
-    // The end of the Ring Buffer data area.
-    //
-    endOfRingBuffer = ringBuffer->BufferEnd;
-    addressForSwap = endOfRingBuffer;
 
-    DmfAssert(ringBuffer->ItemsPresentCount <= ringBuffer->ItemsCount);
-    if (ringBuffer->ItemsPresentCount == 0)
+    if (moduleContext->RingBuffer.VariableSizeRecords)
     {
-        // The buffer is empty. Nothing to reorder.
-        //
-        DmfAssert(ringBuffer->ReadPointer == ringBuffer->WritePointer);
+        ntStatus = DMF_RingBuffer_WriteRecord(DmfModule,
+                                              SourceBuffer,
+                                              SourceBufferSize);
         goto Exit;
     }
 
-    // Copy all the items from the read pointer until the write pointer or until
-    // the end of the ring buffer.
-    //
-    // TODO: Swapping always happens leftward. An optimization would be to choose the
-    //       direction with fewest swaps. (m items swapped leftward n times require only
-    //       (m - n) swaps rightward.) Also, by adding conditions it is possible to 
-    //       reduce the number of shifts of empty spaces (by using Write - Items and 
-    //       adding checks for conditions).
-    //
-    swapsNeeded = (ULONG)((ringBuffer->ReadPointer - ringBuffer->Items) / ringBuffer->ItemSize);
-    while (swapsNeeded > 0)
-    {
-        // Copy entry to be overwritten to temporary swap location.
-        //
-        RtlCopyMemory(addressForSwap,
-                      addressToOverwrite,
-                      ringBuffer->ItemSize);
+    DmfAssert(SourceBufferSize <= moduleContext->RingBuffer.ItemSize);
 
-        // There is now space to shift, so shift.
+    if (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        // Only the producer writes, so no lock is necessary.
         //
-        UCHAR* addressOfDataToShift = addressToOverwrite + ringBuffer->ItemSize;
-        size_t bytesToMove = endOfRingBuffer - addressOfDataToShift;
-        RtlMoveMemory(addressToOverwrite,
-                      addressOfDataToShift,
-                      bytesToMove);
+        ntStatus = RingBuffer_WriteSingleProducer(&moduleContext->RingBuffer,
+                                                  SourceBuffer,
+                                                  SourceBufferSize,
+                                                  RingBuffer_ItemProcessCallbackWrite);
+        goto Exit;
+    }
 
-        // Copy from temporary swap location to complete swap.
-        //
-        UCHAR* destinationAddress = endOfRingBuffer - ringBuffer->ItemSize;
-        RtlCopyMemory(destinationAddress,
-                      addressForSwap,
-                      ringBuffer->ItemSize);
+    DMF_ModuleLock(DmfModule);
 
-        swapsNeeded--;
-    }
+    ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
+                                SourceBuffer,
+                                SourceBufferSize,
+                                RingBuffer_ItemProcessCallbackWrite);
 
-    // Update the Read and Write pointers.
-    //
-    ringBuffer->ReadPointer = ringBuffer->Items;
-    ringBuffer->WritePointer = ringBuffer->Items + 
-                               (ringBuffer->ItemsPresentCount * ringBuffer->ItemSize);
-    if (ringBuffer->WritePointer == endOfRingBuffer)
-    {
-        // This case occurs when the Ring Buffer is full.
-        //
-        ringBuffer->WritePointer = ringBuffer->Items;
-    }
+    DMF_ModuleUnlock(DmfModule);
 
 Exit:
 
-    // Erase all items that are not present. (Erase stale data.)
-    //
-    ULONG numberOfItemsToClear =  ringBuffer->ItemsCount - ringBuffer->ItemsPresentCount;
-    UCHAR* eraseStartAddress = endOfRingBuffer - (numberOfItemsToClear * ringBuffer->ItemSize);
-    RtlZeroMemory(eraseStartAddress,
-                  (numberOfItemsToClear * ringBuffer->ItemSize));
-
-    if (Lock)
-    {
-        DMF_ModuleUnlock(DmfModule);
-    }
+    return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-_Must_inspect_result_
-NTSTATUS
-DMF_RingBuffer_SegmentsRead(
+VOID
+DMF_RingBuffer_WriteCommit(
     _In_ DMFMODULE DmfModule,
-    _In_reads_(NumberOfSegments) UCHAR** Segments,
-    _In_reads_(NumberOfSegments) ULONG* SegmentSizes,
-    _In_reads_(NumberOfSegments) ULONG* SegmentOffsets,
-    _In_ ULONG NumberOfSegments
+    _In_ ULONG NumberOfItems
     )
 /*++
 
 Routine Description:
 
-    Read data from the Ring Buffer. (Reads via a map of segments.)
+    Publish entries written directly into the Ring Buffer's memory after a successful call to
+    DMF_RingBuffer_WriteReserve(). The entries become the newest entries. Reserved entries that
+    are not committed are released.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Segments - Table of addresses to read (each segment) (target buffer).
-    SegmentSizes - The size of each segment (size of each target buffer).
-    SegmentOffsets - The offset in the Ring Buffer entry of each segment.
-    NumberOfSegments - Number of segments in the above tables.
+    NumberOfItems - Number of reserved entries that have been written. It is not larger than
+                    the number of entries reserved. It may be zero to cancel the reservation.
 
 Return Value:
 
-    NTSTATUS indicates if the Ring Buffer is empty.
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
-    RingBuffer_CustomItemProcessContext customItemProcessContext;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    customItemProcessContext.Segments = Segments;
-    customItemProcessContext.SegmentSizes = SegmentSizes;
-    customItemProcessContext.SegmentOffsets = SegmentOffsets;
-    customItemProcessContext.NumberOfSegments = NumberOfSegments;
-    customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackRead;
-
-    DMF_ModuleLock(DmfModule);
-
-    ntStatus = RingBuffer_Read(&moduleContext->RingBuffer,
-                               (UCHAR*)&customItemProcessContext,
-                               moduleContext->RingBuffer.ItemSize,
-                               RingBuffer_ItemProcessCallbackSegments);
+    DmfAssert(! moduleContext->RingBuffer.VariableSizeRecords);
+    DmfAssert(moduleContext->RingBuffer.ItemsReserved > 0);
 
-    DMF_ModuleUnlock(DmfModule);
+    RingBuffer_WriteCommit(&moduleContext->RingBuffer,
+                           NumberOfItems);
 
-    return ntStatus;
+    // The lock was acquired by DMF_RingBuffer_WriteReserve().
+    //
+    if (moduleContext->RingBuffer.Mode != RingBuffer_Mode_SingleProducerSingleConsumer)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_RingBuffer_SegmentsWrite(
+DMF_RingBuffer_WriteMany(
     _In_ DMFMODULE DmfModule,
-    _In_reads_(NumberOfSegments) UCHAR** Segments,
-    _In_reads_(NumberOfSegments) ULONG* SegmentSizes,
-    _In_reads_(NumberOfSegments) ULONG* SegmentOffsets,
-    _In_ ULONG NumberOfSegments
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize,
+    _Out_ ULONG* BytesWritten
     )
 /*++
 
 Routine Description:
 
-    Write data to the Ring Buffer. (Writes via a map of segments.)
+    Write a number of entries to the Ring Buffer. The entries are copied with (at most) two
+    copies instead of one copy per entry.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Segments - Table of addresses to write (each segment) (source buffer).
-    SegmentSizes - The size of each segment (size of each source buffer).
-    SegmentOffsets - The offset in the Ring Buffer entry of each segment.
-    NumberOfSegments - Number of segments in the above tables.
+    SourceBuffer - Address of the entries to write. The last entry becomes the newest entry.
+    SourceBufferSize - Size of SourceBuffer. It must be a multiple of the size of each entry.
+    BytesWritten - Number of bytes written. In RingBuffer_Mode_DeleteOldestIfFullOnWrite,
+                   all the entries are written. Otherwise, fewer entries are written if the
+                   Ring Buffer becomes full.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if at least one entry was written.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full.
 
 --*/
 {
-    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
-    RingBuffer_CustomItemProcessContext customItemProcessContext;
+    NTSTATUS ntStatus;
+    ULONG entriesWritten;
+    BOOLEAN singleProducer;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    customItemProcessContext.Segments = Segments;
-    customItemProcessContext.SegmentSizes = SegmentSizes;
-    customItemProcessContext.SegmentOffsets = SegmentOffsets;
-    customItemProcessContext.NumberOfSegments = NumberOfSegments;
-    customItemProcessContext.DataCopy = RingBuffer_ItemProcessCallbackWrite;
+    DmfAssert(NULL != SourceBuffer);
+    DmfAssert(BytesWritten != NULL);
 
-    DMF_ModuleLock(DmfModule);
+    *BytesWritten = 0;
 
-    ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
-                                (UCHAR*)&customItemProcessContext,
-                                moduleContext->RingBuffer.ItemSize,
-                                RingBuffer_ItemProcessCallbackSegments);
+    if (moduleContext->RingBuffer.VariableSizeRecords)
+    {
+        // Record sizes are not known. Use DMF_RingBuffer_WriteRecord().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
 
-    DMF_ModuleUnlock(DmfModule);
+    if (moduleContext->RingBuffer.ReadCursors != NULL)
+    {
+        // Read cursors are only updated by single item writes. Use DMF_RingBuffer_Write().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if ((0 == SourceBufferSize) ||
+        (SourceBufferSize % moduleContext->RingBuffer.ItemSize != 0))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Only the producer writes in RingBuffer_Mode_SingleProducerSingleConsumer, so no lock
+    // is necessary.
+    //
+    singleProducer = (moduleContext->RingBuffer.Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+    if (! singleProducer)
+    {
+        DMF_ModuleLock(DmfModule);
+    }
+
+    entriesWritten = RingBuffer_WriteMany(&moduleContext->RingBuffer,
+                                          SourceBuffer,
+                                          SourceBufferSize / moduleContext->RingBuffer.ItemSize);
+
+    if (! singleProducer)
+    {
+        DMF_ModuleUnlock(DmfModule);
+    }
+
+    if (0 == entriesWritten)
+    {
+        // Ring Buffer is Full.
+        //
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    *BytesWritten = entriesWritten * moduleContext->RingBuffer.ItemSize;
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
 
     return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_RingBuffer_TotalSizeGet(
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteRecord(
     _In_ DMFMODULE DmfModule,
-    _Out_ ULONG* TotalSize
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize
     )
 /*++
 
 Routine Description:
 
-    Return the total size of the Ring Buffer in bytes.
+    Write a record to a Ring Buffer of variable size records. Only the space the record
+    needs (plus a small header) is used.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    TotalSize - Receives the size of the Ring Buffer.
+    SourceBuffer - Address of the record's data.
+    SourceBufferSize - Size in bytes of the record's data. It must not be larger than ItemSize.
 
 Return Value:
 
-    None
+    NTSTATUS
 
 --*/
 {
+    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
@@ -1392,55 +4302,153 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // No need to lock because this value never changes after initialization.
-    //
+    DmfAssert(moduleContext->RingBuffer.VariableSizeRecords);
 
-    *TotalSize = moduleContext->RingBuffer.TotalSize;
+    DMF_ModuleLock(DmfModule);
+
+    ntStatus = RingBuffer_RecordWrite(&moduleContext->RingBuffer,
+                                      SourceBuffer,
+                                      SourceBufferSize,
+                                      RingBuffer_ItemProcessCallbackWrite);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
-DMF_RingBuffer_Write(
+DMF_RingBuffer_WriteReserve(
     _In_ DMFMODULE DmfModule,
-    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
-    _In_ ULONG SourceBufferSize
+    _In_ ULONG NumberOfItems,
+    _Out_ UCHAR** FirstSegment,
+    _Out_ ULONG* FirstSegmentSize,
+    _Out_ UCHAR** SecondSegment,
+    _Out_ ULONG* SecondSegmentSize
     )
 /*++
 
 Routine Description:
 
-    Write data to the Ring Buffer. (Writes the whole entry.)
+    Reserve space for a number of entries in the Ring Buffer so that the Client can write
+    the entries directly into the Ring Buffer's memory (without an intermediate buffer).
+    The space is returned as (up to) two contiguous segments. After writing the entries, the
+    Client must call DMF_RingBuffer_WriteCommit().
+    In RingBuffer_Mode_DeleteOldestIfFullOnWrite, the oldest entries are deleted to make space
+    for all the entries. Otherwise, fewer entries are reserved if the Ring Buffer is almost full.
+    NOTE: Except in RingBuffer_Mode_SingleProducerSingleConsumer, the Module is locked from this
+          call until DMF_RingBuffer_WriteCommit() is called. The Client must not call other
+          Methods of this Module in between.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    SourceBuffer - Address of data to write to the Write Pointer.
-    SourceBufferSize - Amount of data in bytes to write to the Write Pointer.
+    NumberOfItems - Number of entries to reserve. It is not larger than the number of entries
+                    the Ring Buffer can hold.
+    FirstSegment - Receives the address of the first reserved entry.
+    FirstSegmentSize - Receives the size in bytes of the first segment.
+    SecondSegment - Receives the address of the second segment or NULL if the reserved space
+                    does not wrap around the end of the Ring Buffer.
+    SecondSegmentSize - Receives the size in bytes of the second segment.
+                        (FirstSegmentSize + SecondSegmentSize) / ItemSize entries are reserved.
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if at least one entry was reserved.
+    STATUS_UNSUCCESSFUL if the Ring Buffer is full. In this case, DMF_RingBuffer_WriteCommit()
+    must not be called.
 
 --*/
 {
-    NTSTATUS ntStatus;
     DMF_CONTEXT_RingBuffer* moduleContext;
+    RING_BUFFER* ringBuffer;
+    NTSTATUS ntStatus;
+    ULONG entriesReserved;
+    BOOLEAN singleProducer;
+    UCHAR* writePointer;
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ringBuffer = &moduleContext->RingBuffer;
 
-    DMF_ModuleLock(DmfModule);
+    DmfAssert(FirstSegment != NULL);
+    DmfAssert(FirstSegmentSize != NULL);
+    DmfAssert(SecondSegment != NULL);
+    DmfAssert(SecondSegmentSize != NULL);
 
-    DmfAssert(SourceBufferSize <= moduleContext->RingBuffer.ItemSize);
-    ntStatus = RingBuffer_Write(&moduleContext->RingBuffer,
-                                SourceBuffer,
-                                SourceBufferSize,
-                                RingBuffer_ItemProcessCallbackWrite);
+    *FirstSegment = NULL;
+    *FirstSegmentSize = 0;
+    *SecondSegment = NULL;
+    *SecondSegmentSize = 0;
 
-    DMF_ModuleUnlock(DmfModule);
+    if (ringBuffer->VariableSizeRecords)
+    {
+        // Use DMF_RingBuffer_WriteRecord().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (ringBuffer->ReadCursors != NULL)
+    {
+        // Read cursors are only updated by single item writes. Use DMF_RingBuffer_Write().
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if ((0 == NumberOfItems) ||
+        (NumberOfItems > ringBuffer->ItemsCount))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Only the producer writes in RingBuffer_Mode_SingleProducerSingleConsumer, so no lock
+    // is necessary. Otherwise, the lock is held until the entries are committed so that
+    // the reserved space is not used by anyone else.
+    //
+    singleProducer = (ringBuffer->Mode == RingBuffer_Mode_SingleProducerSingleConsumer);
+    if (! singleProducer)
+    {
+        DMF_ModuleLock(DmfModule);
+        writePointer = ringBuffer->WritePointer;
+    }
+    else
+    {
+        writePointer = ringBuffer->Producer.Pointer;
+    }
+
+    entriesReserved = RingBuffer_WriteReserve(ringBuffer,
+                                              NumberOfItems);
+    if (0 == entriesReserved)
+    {
+        // Ring Buffer is Full.
+        //
+        if (! singleProducer)
+        {
+            DMF_ModuleUnlock(DmfModule);
+        }
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    RingBuffer_RegionSplit(ringBuffer,
+                           writePointer,
+                           entriesReserved * ringBuffer->ItemSize,
+                           FirstSegment,
+                           FirstSegmentSize,
+                           SecondSegment,
+                           SecondSegmentSize);
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
 
     return ntStatus;
 }
@@ -32,6 +32,11 @@ typedef enum
     // Thus, writes never fail.
     //
     RingBuffer_Mode_DeleteOldestIfFullOnWrite,
+    // Exactly one thread writes and exactly one thread reads. Write and Read Methods do not
+    // acquire a lock. If the Ring Buffer is full, an error will occur when Client writes to it.
+    // (The producer cannot delete the oldest item because only the consumer removes items.)
+    //
+    RingBuffer_Mode_SingleProducerSingleConsumer,
     RingBuffer_Mode_Maximum,
 } RingBuffer_ModeType;
 
@@ -48,6 +53,24 @@ typedef struct
     // Indicates the mode of the Ring Buffer. 
     //
     RingBuffer_ModeType Mode;
+    // If not zero, the Ring Buffer is a byte stream of this many bytes that holds variable
+    // size records (see DMF_RingBuffer_WriteRecord). In this case, ItemSize is the maximum
+    // size of a record and ItemCount is not used.
+    // RingBuffer_Mode_SingleProducerSingleConsumer is not supported with variable size records.
+    //
+    ULONG RecordBufferSize;
+    // If not zero, the maximum number of consumers that each read all the items through their
+    // own read cursor (see DMF_RingBuffer_ReadCursorOpen). Not supported with variable size
+    // records or RingBuffer_Mode_SingleProducerSingleConsumer.
+    //
+    ULONG ReadCursorCount;
+    // If IndexKeyLength is not zero, the items are indexed by the IndexKeyLength bytes at
+    // IndexKeyOffset in each item. DMF_RingBuffer_EnumerateToFindItem then only compares the
+    // items that have the same key as the item to find. Not supported with variable size
+    // records or RingBuffer_Mode_SingleProducerSingleConsumer.
+    //
+    ULONG IndexKeyOffset;
+    ULONG IndexKeyLength;
 } DMF_CONFIG_RingBuffer;
 
 // This macro declares the following functions:
@@ -73,6 +96,17 @@ EVT_DMF_RingBuffer_Enumeration(_In_ DMFMODULE DmfModule,
 // Module Methods
 //
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ContiguousSegmentsGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _Out_ UCHAR** FirstSegment,
+    _Out_ ULONG* FirstSegmentSize,
+    _Out_ UCHAR** SecondSegment,
+    _Out_ ULONG* SecondSegmentSize
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_RingBuffer_Enumerate(
@@ -111,6 +145,70 @@ DMF_RingBuffer_ReadAll(
     _Out_ ULONG* BytesWritten
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_ReadCursorClose(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorDroppedCountGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor,
+    _Out_ ULONG* ItemsDropped
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorOpen(
+    _In_ DMFMODULE DmfModule,
+    _Out_ ULONG* ReadCursor
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorRead(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor,
+    _Out_writes_(TargetBufferSize) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadCursorReadInPlace(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ReadCursor,
+    _In_ EVT_DMF_RingBuffer_Enumeration* ItemCallback,
+    _In_opt_ VOID* ItemCallbackContext
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadMany(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_to_(TargetBufferSize, *BytesRead) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_ReadRecord(
+    _In_ DMFMODULE DmfModule,
+    _Out_writes_to_(TargetBufferSize, *BytesRead) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesRead
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_RingBuffer_Reorder(
@@ -156,5 +254,43 @@ DMF_RingBuffer_Write(
     _In_ ULONG SourceBufferSize
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBuffer_WriteCommit(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfItems
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteMany(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize,
+    _Out_ ULONG* BytesWritten
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteRecord(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBuffer_WriteReserve(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG NumberOfItems,
+    _Out_ UCHAR** FirstSegment,
+    _Out_ ULONG* FirstSegmentSize,
+    _Out_ UCHAR** SecondSegment,
+    _Out_ ULONG* SecondSegmentSize
+    );
+
 // eof: Dmf_RingBuffer.h
 //
@@ -0,0 +1,1107 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_RingBufferPerProcessor.c
+
+Abstract:
+
+    An in-memory event log that uses one Ring Buffer per processor. Writers write to the
+    current processor's Ring Buffer so that processors do not contend for a single lock.
+    Each entry is time stamped so that readers see all the entries in time order.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Core.h"
+#include "DmfModules.Core.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_RingBufferPerProcessor.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Position of the merge in one processor's Ring Buffer.
+//
+typedef struct
+{
+    // The (up to) two contiguous regions that hold the entries of the Ring Buffer, oldest first.
+    //
+    UCHAR* Segments[2];
+    ULONG SegmentSizes[2];
+    // Index of the region and offset in that region of the next entry.
+    //
+    ULONG SegmentIndex;
+    ULONG SegmentOffset;
+} RINGBUFFERPERPROCESSOR_CURSOR;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Number of processors (and Ring Buffers).
+    //
+    ULONG NumberOfProcessors;
+    // Size of each entry in the Ring Buffers (header and data).
+    //
+    ULONG EntrySize;
+    // Memory that holds the arrays below.
+    //
+    WDFMEMORY ArraysMemory;
+    // The Ring Buffer of each processor.
+    //
+    DMFMODULE* DmfModuleRingBuffers;
+    // Position of the merge in each Ring Buffer.
+    //
+    RINGBUFFERPERPROCESSOR_CURSOR* Cursors;
+    // Min-heap of the indexes of the Ring Buffers that have entries left to merge,
+    // ordered by the time stamp of their next entry.
+    //
+    ULONG* Heap;
+} DMF_CONTEXT_RingBufferPerProcessor;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(RingBufferPerProcessor)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(RingBufferPerProcessor)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'PPBR'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Context used by DMF_RingBufferPerProcessor_Export().
+//
+typedef struct
+{
+    // Where the next entry is written.
+    //
+    UCHAR* TargetBuffer;
+    // Space left in the target buffer.
+    //
+    ULONG TargetBufferSizeRemaining;
+    // Number of bytes written.
+    //
+    ULONG BytesWritten;
+    // Size of each entry.
+    //
+    ULONG EntrySize;
+    // Set if an entry did not fit.
+    //
+    BOOLEAN Overflow;
+} RINGBUFFERPERPROCESSOR_EXPORT_CONTEXT;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+RINGBUFFERPERPROCESSOR_ENTRY_HEADER*
+RingBufferPerProcessor_CursorEntryGet(
+    _In_ RINGBUFFERPERPROCESSOR_CURSOR* Cursor
+    )
+/*++
+
+Routine Description:
+
+    Return the entry a given cursor points to.
+
+Arguments:
+
+    Cursor - The given cursor.
+
+Return Value:
+
+    The entry or NULL if all the entries of the cursor's Ring Buffer have been merged.
+
+--*/
+{
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* entryHeader;
+
+    entryHeader = NULL;
+    if ((Cursor->SegmentIndex < ARRAYSIZE(Cursor->Segments)) &&
+        (Cursor->Segments[Cursor->SegmentIndex] != NULL))
+    {
+        DmfAssert(Cursor->SegmentOffset < Cursor->SegmentSizes[Cursor->SegmentIndex]);
+        entryHeader = (RINGBUFFERPERPROCESSOR_ENTRY_HEADER*)(Cursor->Segments[Cursor->SegmentIndex] + Cursor->SegmentOffset);
+    }
+
+    return entryHeader;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBufferPerProcessor_CursorAdvance(
+    _Inout_ RINGBUFFERPERPROCESSOR_CURSOR* Cursor,
+    _In_ ULONG EntrySize
+    )
+/*++
+
+Routine Description:
+
+    Move a given cursor to the next entry of its Ring Buffer.
+
+Arguments:
+
+    Cursor - The given cursor.
+    EntrySize - Size of each entry.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(Cursor->SegmentIndex < ARRAYSIZE(Cursor->Segments));
+
+    Cursor->SegmentOffset += EntrySize;
+    if (Cursor->SegmentOffset >= Cursor->SegmentSizes[Cursor->SegmentIndex])
+    {
+        DmfAssert(Cursor->SegmentOffset == Cursor->SegmentSizes[Cursor->SegmentIndex]);
+        Cursor->SegmentIndex++;
+        Cursor->SegmentOffset = 0;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+RingBufferPerProcessor_CursorIsEarlier(
+    _In_ DMF_CONTEXT_RingBufferPerProcessor* ModuleContext,
+    _In_ ULONG FirstIndex,
+    _In_ ULONG SecondIndex
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the next entry of a given Ring Buffer was written before the next entry of
+    another given Ring Buffer. Entries with the same time stamp are ordered by processor.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    FirstIndex - Index of the first Ring Buffer.
+    SecondIndex - Index of the second Ring Buffer.
+
+Return Value:
+
+    TRUE if the first Ring Buffer's next entry comes first.
+
+--*/
+{
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* firstEntry;
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* secondEntry;
+
+    firstEntry = RingBufferPerProcessor_CursorEntryGet(&ModuleContext->Cursors[FirstIndex]);
+    secondEntry = RingBufferPerProcessor_CursorEntryGet(&ModuleContext->Cursors[SecondIndex]);
+    DmfAssert(firstEntry != NULL);
+    DmfAssert(secondEntry != NULL);
+
+    if (firstEntry->Timestamp != secondEntry->Timestamp)
+    {
+        return (firstEntry->Timestamp < secondEntry->Timestamp);
+    }
+
+    return (FirstIndex < SecondIndex);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBufferPerProcessor_HeapSiftDown(
+    _In_ DMF_CONTEXT_RingBufferPerProcessor* ModuleContext,
+    _In_ ULONG HeapSize,
+    _In_ ULONG HeapIndex
+    )
+/*++
+
+Routine Description:
+
+    Move the element at a given position of the heap down until both its children come
+    after it.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    HeapSize - Number of elements in the heap.
+    HeapIndex - The given position.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG* heap;
+    ULONG childIndex;
+    ULONG earliestIndex;
+    ULONG swap;
+
+    heap = ModuleContext->Heap;
+
+    for (;;)
+    {
+        earliestIndex = HeapIndex;
+
+        childIndex = (2 * HeapIndex) + 1;
+        if ((childIndex < HeapSize) &&
+            RingBufferPerProcessor_CursorIsEarlier(ModuleContext,
+                                                   heap[childIndex],
+                                                   heap[earliestIndex]))
+        {
+            earliestIndex = childIndex;
+        }
+
+        childIndex++;
+        if ((childIndex < HeapSize) &&
+            RingBufferPerProcessor_CursorIsEarlier(ModuleContext,
+                                                   heap[childIndex],
+                                                   heap[earliestIndex]))
+        {
+            earliestIndex = childIndex;
+        }
+
+        if (earliestIndex == HeapIndex)
+        {
+            break;
+        }
+
+        swap = heap[HeapIndex];
+        heap[HeapIndex] = heap[earliestIndex];
+        heap[earliestIndex] = swap;
+        HeapIndex = earliestIndex;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBufferPerProcessor_Merge(
+    _In_ DMFMODULE DmfModule,
+    _In_ EVT_DMF_RingBufferPerProcessor_Enumeration* EntryCallback,
+    _In_opt_ VOID* EntryCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Call a given callback for every entry of all the Ring Buffers in time order
+    (k-way merge). Each Ring Buffer is already in time order.
+    NOTE: The caller makes sure that the Ring Buffers do not change during this call.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    EntryCallback - The given callback.
+    EntryCallbackContext - Context passed to the callback.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+    RINGBUFFERPERPROCESSOR_CURSOR* cursor;
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* entryHeader;
+    ULONG heapSize;
+    ULONG processorIndex;
+    BOOLEAN continueEnumeration;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Start each cursor at the oldest entry of its Ring Buffer. Ring Buffers that have
+    // entries are added to the heap.
+    //
+    heapSize = 0;
+    for (processorIndex = 0; processorIndex < moduleContext->NumberOfProcessors; processorIndex++)
+    {
+        cursor = &moduleContext->Cursors[processorIndex];
+        DMF_RingBuffer_ContiguousSegmentsGet(moduleContext->DmfModuleRingBuffers[processorIndex],
+                                             FALSE,
+                                             &cursor->Segments[0],
+                                             &cursor->SegmentSizes[0],
+                                             &cursor->Segments[1],
+                                             &cursor->SegmentSizes[1]);
+        cursor->SegmentIndex = 0;
+        cursor->SegmentOffset = 0;
+        if (cursor->Segments[0] != NULL)
+        {
+            moduleContext->Heap[heapSize] = processorIndex;
+            heapSize++;
+        }
+    }
+
+    for (ULONG heapIndex = heapSize / 2; heapIndex > 0; heapIndex--)
+    {
+        RingBufferPerProcessor_HeapSiftDown(moduleContext,
+                                            heapSize,
+                                            heapIndex - 1);
+    }
+
+    // The earliest entry is always the next entry of the Ring Buffer at the top of the heap.
+    //
+    continueEnumeration = TRUE;
+    while ((heapSize > 0) && continueEnumeration)
+    {
+        processorIndex = moduleContext->Heap[0];
+        cursor = &moduleContext->Cursors[processorIndex];
+        entryHeader = RingBufferPerProcessor_CursorEntryGet(cursor);
+        DmfAssert(entryHeader != NULL);
+
+        continueEnumeration = EntryCallback(DmfModule,
+                                            entryHeader,
+                                            (UCHAR*)(entryHeader + 1),
+                                            entryHeader->DataSize,
+                                            EntryCallbackContext);
+
+        RingBufferPerProcessor_CursorAdvance(cursor,
+                                             moduleContext->EntrySize);
+        if (NULL == RingBufferPerProcessor_CursorEntryGet(cursor))
+        {
+            // All the entries of this Ring Buffer have been merged.
+            //
+            heapSize--;
+            moduleContext->Heap[0] = moduleContext->Heap[heapSize];
+        }
+        RingBufferPerProcessor_HeapSiftDown(moduleContext,
+                                            heapSize,
+                                            0);
+    }
+}
+
+_Function_class_(EVT_DMF_RingBufferPerProcessor_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+RingBufferPerProcessor_ExportEntry(
+    _In_ DMFMODULE DmfModule,
+    _In_ RINGBUFFERPERPROCESSOR_ENTRY_HEADER* EntryHeader,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Copy an entry (header and data) to the target buffer of DMF_RingBufferPerProcessor_Export().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    EntryHeader - The entry's header. The entry's data follows it.
+    Buffer - The entry's data.
+    BufferSize - Size of the data written by the Client.
+    CallbackContext - RINGBUFFERPERPROCESSOR_EXPORT_CONTEXT.
+
+Return Value:
+
+    FALSE if the target buffer is full.
+
+--*/
+{
+    RINGBUFFERPERPROCESSOR_EXPORT_CONTEXT* exportContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(BufferSize);
+
+    exportContext = (RINGBUFFERPERPROCESSOR_EXPORT_CONTEXT*)CallbackContext;
+    DmfAssert(exportContext != NULL);
+
+    // 'Dereferencing NULL pointer. 'exportContext' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    if (exportContext->TargetBufferSizeRemaining < exportContext->EntrySize)
+    {
+        exportContext->Overflow = TRUE;
+        return FALSE;
+    }
+
+    // The whole entry is copied so that all the entries in the export have the same size.
+    //
+    RtlCopyMemory(exportContext->TargetBuffer,
+                  EntryHeader,
+                  exportContext->EntrySize);
+    exportContext->TargetBuffer += exportContext->EntrySize;
+    exportContext->TargetBufferSizeRemaining -= exportContext->EntrySize;
+    exportContext->BytesWritten += exportContext->EntrySize;
+
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBufferPerProcessor_AllLock(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Lock this Module (which protects the merge state) and all the Ring Buffers so that
+    no entry is written during a merge. Locks are always acquired in the same order.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    for (ULONG processorIndex = 0; processorIndex < moduleContext->NumberOfProcessors; processorIndex++)
+    {
+        DMF_ModuleLock(moduleContext->DmfModuleRingBuffers[processorIndex]);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+RingBufferPerProcessor_AllUnlock(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Unlock all the locks acquired by RingBufferPerProcessor_AllLock().
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG processorIndex = moduleContext->NumberOfProcessors; processorIndex > 0; processorIndex--)
+    {
+        DMF_ModuleUnlock(moduleContext->DmfModuleRingBuffers[processorIndex - 1]);
+    }
+    DMF_ModuleUnlock(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONGLONG
+RingBufferPerProcessor_TimestampGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Return the current value of the performance counter. It is the same on all processors.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    The current value of the performance counter.
+
+--*/
+{
+    LARGE_INTEGER counter;
+
+#if !defined(DMF_USER_MODE)
+    counter = KeQueryPerformanceCounter(NULL);
+#else
+    QueryPerformanceCounter(&counter);
+#endif // !defined(DMF_USER_MODE)
+
+    return (ULONGLONG)counter.QuadPart;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+RingBufferPerProcessor_RingBuffersDelete(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Delete the Ring Buffers and the memory that holds the arrays.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->DmfModuleRingBuffers != NULL)
+    {
+        for (ULONG processorIndex = 0; processorIndex < moduleContext->NumberOfProcessors; processorIndex++)
+        {
+            if (moduleContext->DmfModuleRingBuffers[processorIndex] != NULL)
+            {
+                WdfObjectDelete(moduleContext->DmfModuleRingBuffers[processorIndex]);
+                moduleContext->DmfModuleRingBuffers[processorIndex] = NULL;
+            }
+        }
+    }
+
+    if (moduleContext->ArraysMemory != NULL)
+    {
+        WdfObjectDelete(moduleContext->ArraysMemory);
+        moduleContext->ArraysMemory = NULL;
+    }
+
+    moduleContext->DmfModuleRingBuffers = NULL;
+    moduleContext->Cursors = NULL;
+    moduleContext->Heap = NULL;
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_RingBufferPerProcessor_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type RingBufferPerProcessor.
+    One Ring Buffer is created for each processor.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+    DMF_CONFIG_RingBufferPerProcessor* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    WDFDEVICE device;
+    size_t sizeToAllocate;
+    UCHAR* arraysBuffer;
+
+    PAGED_CODE();
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    device = DMF_ParentDeviceGet(DmfModule);
+
+    if ((0 == moduleConfig->ItemCountPerProcessor) ||
+        (0 == moduleConfig->ItemSize) ||
+        (moduleConfig->ItemSize > ULONG_MAX - sizeof(RINGBUFFERPERPROCESSOR_ENTRY_HEADER)) ||
+        ((moduleConfig->Mode != RingBuffer_Mode_FailIfFullOnWrite) &&
+         (moduleConfig->Mode != RingBuffer_Mode_DeleteOldestIfFullOnWrite)))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Entries are aligned so that the header of each entry is aligned.
+    //
+    moduleContext->EntrySize = ((ULONG)sizeof(RINGBUFFERPERPROCESSOR_ENTRY_HEADER) + moduleConfig->ItemSize + sizeof(ULONGLONG) - 1) & ~((ULONG)sizeof(ULONGLONG) - 1);
+
+#if !defined(DMF_USER_MODE)
+    moduleContext->NumberOfProcessors = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+#else
+    moduleContext->NumberOfProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#endif // !defined(DMF_USER_MODE)
+    DmfAssert(moduleContext->NumberOfProcessors > 0);
+
+    // Allocate all the arrays in a single allocation.
+    //
+    sizeToAllocate = moduleContext->NumberOfProcessors * (sizeof(DMFMODULE) + sizeof(RINGBUFFERPERPROCESSOR_CURSOR) + sizeof(ULONG));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeToAllocate,
+                               &moduleContext->ArraysMemory,
+                               (VOID**)&arraysBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->ArraysMemory = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(arraysBuffer,
+                  sizeToAllocate);
+    moduleContext->DmfModuleRingBuffers = (DMFMODULE*)arraysBuffer;
+    moduleContext->Cursors = (RINGBUFFERPERPROCESSOR_CURSOR*)(moduleContext->DmfModuleRingBuffers + moduleContext->NumberOfProcessors);
+    moduleContext->Heap = (ULONG*)(moduleContext->Cursors + moduleContext->NumberOfProcessors);
+
+    // RingBuffer (one per processor)
+    // ------------------------------
+    //
+    for (ULONG processorIndex = 0; processorIndex < moduleContext->NumberOfProcessors; processorIndex++)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+
+        DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                                  &moduleAttributes);
+        moduleConfigRingBuffer.ItemCount = moduleConfig->ItemCountPerProcessor;
+        moduleConfigRingBuffer.ItemSize = moduleContext->EntrySize;
+        moduleConfigRingBuffer.Mode = moduleConfig->Mode;
+        ntStatus = DMF_RingBuffer_Create(device,
+                                         &moduleAttributes,
+                                         &objectAttributes,
+                                         &moduleContext->DmfModuleRingBuffers[processorIndex]);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_RingBuffer_Create processorIndex=%d fails: ntStatus=%!STATUS!", processorIndex, ntStatus);
+            moduleContext->DmfModuleRingBuffers[processorIndex] = NULL;
+            RingBufferPerProcessor_RingBuffersDelete(DmfModule);
+            goto Exit;
+        }
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_RingBufferPerProcessor_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type RingBufferPerProcessor.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    RingBufferPerProcessor_RingBuffersDelete(DmfModule);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBufferPerProcessor_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type RingBufferPerProcessor.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_RingBufferPerProcessor;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_RingBufferPerProcessor;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_RingBufferPerProcessor);
+    dmfCallbacksDmf_RingBufferPerProcessor.DeviceOpen = DMF_RingBufferPerProcessor_Open;
+    dmfCallbacksDmf_RingBufferPerProcessor.DeviceClose = DMF_RingBufferPerProcessor_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_RingBufferPerProcessor,
+                                            RingBufferPerProcessor,
+                                            DMF_CONTEXT_RingBufferPerProcessor,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_RingBufferPerProcessor.CallbacksDmf = &dmfCallbacksDmf_RingBufferPerProcessor;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_RingBufferPerProcessor,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBufferPerProcessor_Enumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _In_ EVT_DMF_RingBufferPerProcessor_Enumeration* EntryCallback,
+    _In_opt_ VOID* EntryCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Call a given callback for every entry of all the processors' Ring Buffers, oldest first.
+    The entries are not removed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Lock - Set to TRUE if this Method should lock the Module and all the Ring Buffers.
+           (Set to FALSE only when nothing else can run, as in a crash dump callback.)
+    EntryCallback - The given callback. It returns FALSE to stop the enumeration.
+    EntryCallbackContext - Context passed to the callback.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBufferPerProcessor);
+
+    DmfAssert(EntryCallback != NULL);
+
+    if (Lock)
+    {
+        RingBufferPerProcessor_AllLock(DmfModule);
+    }
+
+    RingBufferPerProcessor_Merge(DmfModule,
+                                 EntryCallback,
+                                 EntryCallbackContext);
+
+    if (Lock)
+    {
+        RingBufferPerProcessor_AllUnlock(DmfModule);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBufferPerProcessor_Export(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _Out_writes_to_(TargetBufferSize, *BytesWritten) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesWritten
+    )
+/*++
+
+Routine Description:
+
+    Copy all the entries of all the processors' Ring Buffers, oldest first, to a given buffer.
+    Each entry is a RINGBUFFERPERPROCESSOR_ENTRY_HEADER followed by the entry's data. All the
+    entries have the same size. The entries are not removed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Lock - Set to TRUE if this Method should lock the Module and all the Ring Buffers.
+           (Set to FALSE only when nothing else can run, as in a crash dump callback.)
+    TargetBuffer - The given buffer.
+    TargetBufferSize - Size of the given buffer. DMF_RingBufferPerProcessor_TotalSizeGet()
+                       returns the size needed for all the entries.
+    BytesWritten - Number of bytes written to the given buffer.
+
+Return Value:
+
+    STATUS_SUCCESS if all the entries were copied.
+    STATUS_BUFFER_OVERFLOW if the given buffer is too small. The oldest entries that fit are copied.
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+    RINGBUFFERPERPROCESSOR_EXPORT_CONTEXT exportContext;
+    NTSTATUS ntStatus;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBufferPerProcessor);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(TargetBuffer != NULL);
+    DmfAssert(BytesWritten != NULL);
+
+    exportContext.TargetBuffer = TargetBuffer;
+    exportContext.TargetBufferSizeRemaining = TargetBufferSize;
+    exportContext.BytesWritten = 0;
+    exportContext.EntrySize = moduleContext->EntrySize;
+    exportContext.Overflow = FALSE;
+
+    DMF_RingBufferPerProcessor_Enumerate(DmfModule,
+                                         Lock,
+                                         RingBufferPerProcessor_ExportEntry,
+                                         &exportContext);
+
+    *BytesWritten = exportContext.BytesWritten;
+
+    if (exportContext.Overflow)
+    {
+        ntStatus = STATUS_BUFFER_OVERFLOW;
+    }
+    else
+    {
+        ntStatus = STATUS_SUCCESS;
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBufferPerProcessor_TotalSizeGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ ULONG* TotalSize
+    )
+/*++
+
+Routine Description:
+
+    Return the size of all the processors' Ring Buffers. This is the size of the buffer
+    needed by DMF_RingBufferPerProcessor_Export() to copy all the entries.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TotalSize - Returns the size of all the Ring Buffers.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+    ULONG ringBufferSize;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBufferPerProcessor);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(TotalSize != NULL);
+
+    *TotalSize = 0;
+    for (ULONG processorIndex = 0; processorIndex < moduleContext->NumberOfProcessors; processorIndex++)
+    {
+        DMF_RingBuffer_TotalSizeGet(moduleContext->DmfModuleRingBuffers[processorIndex],
+                                    &ringBufferSize);
+        *TotalSize += ringBufferSize;
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBufferPerProcessor_Write(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize
+    )
+/*++
+
+Routine Description:
+
+    Write an entry to the current processor's Ring Buffer. The entry is time stamped.
+    Only the current processor's Ring Buffer is locked.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SourceBuffer - Address of the entry's data.
+    SourceBufferSize - Size of the entry's data. It must not be larger than ItemSize.
+
+Return Value:
+
+    NTSTATUS This Method fails if the Ring Buffer is full in RingBuffer_Mode_FailIfFullOnWrite.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_RingBufferPerProcessor* moduleContext;
+    DMFMODULE dmfModuleRingBuffer;
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* entryHeader;
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG processorIndex;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 RingBufferPerProcessor);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (SourceBufferSize > moduleContext->EntrySize - sizeof(RINGBUFFERPERPROCESSOR_ENTRY_HEADER))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // If the thread moves to another processor after this, the entry is still written
+    // correctly (under the Ring Buffer's lock), only to another processor's Ring Buffer.
+    //
+#if !defined(DMF_USER_MODE)
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+#else
+    processorIndex = GetCurrentProcessorNumber();
+#endif // !defined(DMF_USER_MODE)
+    processorIndex %= moduleContext->NumberOfProcessors;
+    dmfModuleRingBuffer = moduleContext->DmfModuleRingBuffers[processorIndex];
+
+    // Write the entry directly into the Ring Buffer. The Ring Buffer is locked until the
+    // entry is committed, so the time stamps in each Ring Buffer are in order.
+    //
+    ntStatus = DMF_RingBuffer_WriteReserve(dmfModuleRingBuffer,
+                                           1,
+                                           &firstSegment,
+                                           &firstSegmentSize,
+                                           &secondSegment,
+                                           &secondSegmentSize);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // A single entry never wraps around the end of the Ring Buffer.
+    //
+    DmfAssert(firstSegmentSize == moduleContext->EntrySize);
+    DmfAssert(NULL == secondSegment);
+
+    entryHeader = (RINGBUFFERPERPROCESSOR_ENTRY_HEADER*)firstSegment;
+    entryHeader->Timestamp = RingBufferPerProcessor_TimestampGet();
+    entryHeader->ProcessorIndex = processorIndex;
+    entryHeader->DataSize = SourceBufferSize;
+    RtlCopyMemory(entryHeader + 1,
+                  SourceBuffer,
+                  SourceBufferSize);
+    RtlZeroMemory((UCHAR*)(entryHeader + 1) + SourceBufferSize,
+                  moduleContext->EntrySize - sizeof(RINGBUFFERPERPROCESSOR_ENTRY_HEADER) - SourceBufferSize);
+
+    DMF_RingBuffer_WriteCommit(dmfModuleRingBuffer,
+                               1);
+
+Exit:
+
+    return ntStatus;
+}
+
+// eof: Dmf_RingBufferPerProcessor.c
+//
@@ -0,0 +1,115 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_RingBufferPerProcessor.h
+
+Abstract:
+
+    Companion file to Dmf_RingBufferPerProcessor.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// Client uses this structure to configure the Module specific parameters.
+//
+typedef struct
+{
+    // Maximum number of entries to store for each processor.
+    //
+    ULONG ItemCountPerProcessor;
+    // The maximum size of the data of each entry (not including RINGBUFFERPERPROCESSOR_ENTRY_HEADER).
+    //
+    ULONG ItemSize;
+    // Indicates the mode of each processor's Ring Buffer.
+    // RingBuffer_Mode_SingleProducerSingleConsumer is not supported.
+    //
+    RingBuffer_ModeType Mode;
+} DMF_CONFIG_RingBufferPerProcessor;
+
+// This macro declares the following functions:
+// DMF_RingBufferPerProcessor_ATTRIBUTES_INIT()
+// DMF_CONFIG_RingBufferPerProcessor_AND_ATTRIBUTES_INIT()
+// DMF_RingBufferPerProcessor_Create()
+//
+DECLARE_DMF_MODULE(RingBufferPerProcessor)
+
+// Each entry starts with this header. It is followed by ItemSize bytes of data.
+// DMF_RingBufferPerProcessor_Export() writes entries in this format.
+//
+typedef struct
+{
+    // Value of the performance counter when the entry was written.
+    //
+    ULONGLONG Timestamp;
+    // Index of the processor's Ring Buffer the entry was written to.
+    //
+    ULONG ProcessorIndex;
+    // Size in bytes of the data written by the Client.
+    //
+    ULONG DataSize;
+} RINGBUFFERPERPROCESSOR_ENTRY_HEADER;
+
+// Callback that allows client to process each entry, in time order.
+//
+typedef
+_Function_class_(EVT_DMF_RingBufferPerProcessor_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+BOOLEAN
+EVT_DMF_RingBufferPerProcessor_Enumeration(_In_ DMFMODULE DmfModule,
+                                           _In_ RINGBUFFERPERPROCESSOR_ENTRY_HEADER* EntryHeader,
+                                           _In_reads_(BufferSize) UCHAR* Buffer,
+                                           _In_ ULONG BufferSize,
+                                           _In_opt_ VOID* CallbackContext);
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBufferPerProcessor_Enumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _In_ EVT_DMF_RingBufferPerProcessor_Enumeration* EntryCallback,
+    _In_opt_ VOID* EntryCallbackContext
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBufferPerProcessor_Export(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN Lock,
+    _Out_writes_to_(TargetBufferSize, *BytesWritten) UCHAR* TargetBuffer,
+    _In_ ULONG TargetBufferSize,
+    _Out_ ULONG* BytesWritten
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_RingBufferPerProcessor_TotalSizeGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ ULONG* TotalSize
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_RingBufferPerProcessor_Write(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(SourceBufferSize) UCHAR* SourceBuffer,
+    _In_ ULONG SourceBufferSize
+    );
+
+// eof: Dmf_RingBufferPerProcessor.h
+//
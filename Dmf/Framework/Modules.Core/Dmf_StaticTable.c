@@ -0,0 +1,1159 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_StaticTable.c
+
+Abstract:
+
+    A read-only table of Key-Value pairs that are all known when the Module is created. A minimal
+    perfect hash function is built for the Keys when the Module opens, so each lookup reads a single
+    slot and compares a single Key.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Core.h"
+#include "DmfModules.Core.Trace.h"
+#include "DmfModules.Core.Hash.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_StaticTable.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Average number of Keys in each bucket. Larger buckets use less memory but take longer to build.
+//
+#define STATICTABLE_KEYS_PER_BUCKET                 (4)
+
+// Maximum number of entries. It keeps all the sizes computed by the Module within a ULONG.
+//
+#define STATICTABLE_ENTRY_COUNT_MAXIMUM             (0x01000000)
+
+// Number of first displacement values tried for each bucket. For each of them, every
+// second displacement value (0 to EntryCount - 1) is tried.
+//
+#define STATICTABLE_FIRST_DISPLACEMENT_MAXIMUM      (32)
+
+// Number of hash seeds tried before the build fails.
+//
+#define STATICTABLE_SEED_ATTEMPTS_MAXIMUM           (32)
+
+// Displacement of the Keys of one bucket. The slot of each Key in the bucket is
+// (First + D0 * Second + D1) modulo EntryCount (see STATICTABLE_KEY_HASH).
+//
+typedef struct
+{
+    ULONG D0;
+    ULONG D1;
+} STATICTABLE_DISPLACEMENT;
+
+// Location of one Key-Value pair.
+//
+typedef struct
+{
+    // Offset of the Key and the Value in the Module's data.
+    //
+    ULONG KeyOffset;
+    ULONG ValueOffset;
+    // Length of the Key and the Value in bytes.
+    //
+    ULONG KeyLength;
+    ULONG ValueLength;
+    // Index of the Key-Value pair in the Client's Entries array.
+    //
+    ULONG EntryIndex;
+} STATICTABLE_SLOT;
+
+// The three values derived from the hash of a Key. All of them are less than the number
+// of buckets or the number of entries, respectively.
+//
+typedef struct
+{
+    ULONG Bucket;
+    ULONG First;
+    ULONG Second;
+} STATICTABLE_KEY_HASH;
+
+// Arrays that are only used while the table is built.
+//
+typedef struct
+{
+    // Hash of each Key.
+    //
+    STATICTABLE_KEY_HASH* KeyHashes;
+    // Indexes of the Keys, grouped by bucket.
+    //
+    ULONG* KeyOrder;
+    // Index in KeyOrder of the first Key of each bucket (BucketCount + 1 elements).
+    //
+    ULONG* BucketStart;
+    // Indexes of the buckets, largest first.
+    //
+    ULONG* BucketOrder;
+    // Used to sort the buckets by size (EntryCount + 2 elements).
+    //
+    ULONG* SizeStart;
+    // Slots of the Keys of the bucket being placed.
+    //
+    ULONG* TrialSlots;
+    // Indicates which slots have been assigned a Key.
+    //
+    BOOLEAN* SlotUsed;
+    // Slots before this one are all used. Only valid once buckets with one Key are placed.
+    //
+    ULONG FreeSlotSearchStart;
+} STATICTABLE_BUILD;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Number of Key-Value pairs (and slots).
+    //
+    ULONG EntryCount;
+    // Number of buckets.
+    //
+    ULONG BucketCount;
+    // Seed of the hash function for which the table was built.
+    //
+    ULONGLONG Seed;
+    // Memory that holds the arrays below. It is allocated from non-paged pool when the
+    // Module opens, and nothing else is allocated after that.
+    //
+    WDFMEMORY TableMemory;
+    // Displacement of each bucket.
+    //
+    STATICTABLE_DISPLACEMENT* Displacements;
+    // Location of the Key-Value pair in each slot.
+    //
+    STATICTABLE_SLOT* Slots;
+    // The Keys and Values.
+    //
+    UCHAR* Data;
+} DMF_CONTEXT_StaticTable;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(StaticTable)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(StaticTable)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'bTtS'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+inline
+ULONG
+StaticTable_Reduce(
+    _In_ ULONG Value,
+    _In_ ULONG Range
+    )
+/*++
+
+Routine Description:
+
+    Maps a 32 bit value uniformly to [0, Range) without a division.
+
+Arguments:
+
+    Value - The value to map.
+    Range - Number of possible results.
+
+Return Value:
+
+    The mapped value.
+
+--*/
+{
+    return (ULONG)(((ULONGLONG)Value * Range) >> 32);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+StaticTable_HashCalculate(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _In_ ULONGLONG Seed,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ STATICTABLE_KEY_HASH* KeyHash
+    )
+/*++
+
+Routine Description:
+
+    Calculates the hash of a Key with the word-at-a-time hash function that DMF_HashTable also
+    uses, and derives the Key's bucket and the two values used to find its slot.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Seed - Seed of the hash function.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    KeyHash - Where the bucket and the two values are written.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONGLONG result;
+
+    result = DMF_Hash_WordAtATime(Seed,
+                                  Key,
+                                  KeyLength);
+
+    // The bucket and the first value use different halves of the hash. The second value is
+    // taken from a second mix of it so that it does not depend on the other two.
+    //
+    KeyHash->Bucket = StaticTable_Reduce((ULONG)(result >> 32),
+                                         ModuleContext->BucketCount);
+    KeyHash->First = StaticTable_Reduce((ULONG)result,
+                                        ModuleContext->EntryCount);
+    KeyHash->Second = StaticTable_Reduce((ULONG)DMF_Hash_Avalanche(result + DMF_HASH_PRIME_1),
+                                         ModuleContext->EntryCount);
+}
+
+static
+inline
+ULONG
+StaticTable_SlotIndexGet(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _In_ STATICTABLE_KEY_HASH* KeyHash,
+    _In_ ULONG D0,
+    _In_ ULONG D1
+    )
+/*++
+
+Routine Description:
+
+    Returns the slot of a Key for a given displacement of its bucket.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    KeyHash - The Key's hash.
+    D0 - First displacement value (multiplies KeyHash->Second).
+    D1 - Second displacement value.
+
+Return Value:
+
+    Index of the slot.
+
+--*/
+{
+    return (ULONG)(((ULONGLONG)KeyHash->First + ((ULONGLONG)D0 * KeyHash->Second) + D1) % ModuleContext->EntryCount);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+STATICTABLE_SLOT*
+StaticTable_SlotFind(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength
+    )
+/*++
+
+Routine Description:
+
+    Finds the slot that holds a given Key. Only one slot can hold it, so only one Key is compared.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+
+Return Value:
+
+    The slot or NULL if the Key is not in the table.
+
+--*/
+{
+    STATICTABLE_KEY_HASH keyHash;
+    STATICTABLE_DISPLACEMENT* displacement;
+    STATICTABLE_SLOT* slot;
+
+    if (0 == ModuleContext->EntryCount)
+    {
+        return NULL;
+    }
+
+    StaticTable_HashCalculate(ModuleContext,
+                              ModuleContext->Seed,
+                              Key,
+                              KeyLength,
+                              &keyHash);
+
+    displacement = &ModuleContext->Displacements[keyHash.Bucket];
+    slot = &ModuleContext->Slots[StaticTable_SlotIndexGet(ModuleContext,
+                                                          &keyHash,
+                                                          displacement->D0,
+                                                          displacement->D1)];
+
+    if ((slot->KeyLength != KeyLength) ||
+        (RtlCompareMemory(&ModuleContext->Data[slot->KeyOffset],
+                          Key,
+                          KeyLength) != KeyLength))
+    {
+        return NULL;
+    }
+
+    return slot;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+StaticTable_BucketsSort(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _Inout_ STATICTABLE_BUILD* Build
+    )
+/*++
+
+Routine Description:
+
+    Groups the Keys by bucket and orders the buckets from largest to smallest (counting sorts).
+    Large buckets are placed first, while most slots are free.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Build - Arrays used to build the table. KeyHashes is already set.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG keyIndex;
+    ULONG bucketIndex;
+    ULONG bucketSize;
+    ULONG position;
+    ULONG count;
+
+    PAGED_CODE();
+
+    // Count the Keys of each bucket. Then, BucketStart[bucketIndex + 1] is the end of each bucket.
+    //
+    RtlZeroMemory(Build->BucketStart,
+                  ((SIZE_T)ModuleContext->BucketCount + 1) * sizeof(ULONG));
+    for (keyIndex = 0; keyIndex < ModuleContext->EntryCount; keyIndex++)
+    {
+        Build->BucketStart[Build->KeyHashes[keyIndex].Bucket + 1]++;
+    }
+    for (bucketIndex = 0; bucketIndex < ModuleContext->BucketCount; bucketIndex++)
+    {
+        Build->BucketStart[bucketIndex + 1] += Build->BucketStart[bucketIndex];
+    }
+
+    // Use SizeStart as the next position of each bucket while the Keys are grouped.
+    //
+    RtlCopyMemory(Build->SizeStart,
+                  Build->BucketStart,
+                  (SIZE_T)ModuleContext->BucketCount * sizeof(ULONG));
+    for (keyIndex = 0; keyIndex < ModuleContext->EntryCount; keyIndex++)
+    {
+        bucketIndex = Build->KeyHashes[keyIndex].Bucket;
+        Build->KeyOrder[Build->SizeStart[bucketIndex]] = keyIndex;
+        Build->SizeStart[bucketIndex]++;
+    }
+
+    // Sort the buckets by decreasing size. A bucket holds at most EntryCount Keys.
+    //
+    RtlZeroMemory(Build->SizeStart,
+                  ((SIZE_T)ModuleContext->EntryCount + 2) * sizeof(ULONG));
+    for (bucketIndex = 0; bucketIndex < ModuleContext->BucketCount; bucketIndex++)
+    {
+        bucketSize = Build->BucketStart[bucketIndex + 1] - Build->BucketStart[bucketIndex];
+        Build->SizeStart[ModuleContext->EntryCount - bucketSize + 1]++;
+    }
+    position = 0;
+    for (bucketSize = 0; bucketSize <= ModuleContext->EntryCount + 1; bucketSize++)
+    {
+        count = Build->SizeStart[bucketSize];
+        Build->SizeStart[bucketSize] = position;
+        position += count;
+    }
+    for (bucketIndex = 0; bucketIndex < ModuleContext->BucketCount; bucketIndex++)
+    {
+        bucketSize = Build->BucketStart[bucketIndex + 1] - Build->BucketStart[bucketIndex];
+        Build->BucketOrder[Build->SizeStart[ModuleContext->EntryCount - bucketSize + 1]] = bucketIndex;
+        Build->SizeStart[ModuleContext->EntryCount - bucketSize + 1]++;
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+BOOLEAN
+StaticTable_DuplicateFind(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _In_ DMF_CONFIG_StaticTable* ModuleConfig,
+    _In_ STATICTABLE_BUILD* Build
+    )
+/*++
+
+Routine Description:
+
+    Indicates if two entries have the same Key. Such Keys have the same hash, so they
+    are always in the same bucket.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    ModuleConfig - This Module's config.
+    Build - Arrays used to build the table. The Keys are already grouped by bucket.
+
+Return Value:
+
+    TRUE if two entries have the same Key.
+
+--*/
+{
+    STATICTABLE_ENTRY* firstEntry;
+    STATICTABLE_ENTRY* secondEntry;
+
+    PAGED_CODE();
+
+    for (ULONG bucketIndex = 0; bucketIndex < ModuleContext->BucketCount; bucketIndex++)
+    {
+        for (ULONG firstPosition = Build->BucketStart[bucketIndex]; firstPosition < Build->BucketStart[bucketIndex + 1]; firstPosition++)
+        {
+            firstEntry = &ModuleConfig->Entries[Build->KeyOrder[firstPosition]];
+            for (ULONG secondPosition = firstPosition + 1; secondPosition < Build->BucketStart[bucketIndex + 1]; secondPosition++)
+            {
+                secondEntry = &ModuleConfig->Entries[Build->KeyOrder[secondPosition]];
+                if ((firstEntry->KeyLength == secondEntry->KeyLength) &&
+                    (RtlCompareMemory(firstEntry->Key,
+                                      secondEntry->Key,
+                                      firstEntry->KeyLength) == firstEntry->KeyLength))
+                {
+                    TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Duplicate Key: EntryIndex=%u EntryIndex=%u", Build->KeyOrder[firstPosition], Build->KeyOrder[secondPosition]);
+                    return TRUE;
+                }
+            }
+        }
+    }
+
+    return FALSE;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+BOOLEAN
+StaticTable_BucketPlace(
+    _In_ DMF_CONTEXT_StaticTable* ModuleContext,
+    _Inout_ STATICTABLE_BUILD* Build,
+    _In_ ULONG BucketIndex
+    )
+/*++
+
+Routine Description:
+
+    Finds a displacement that puts every Key of a given bucket in a free slot, and marks these
+    slots as used. For each first displacement value, every second displacement value is tried.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Build - Arrays used to build the table.
+    BucketIndex - The given bucket.
+
+Return Value:
+
+    TRUE if a displacement was found.
+
+--*/
+{
+    STATICTABLE_KEY_HASH* keyHash;
+    ULONG bucketStart;
+    ULONG bucketSize;
+    ULONG keyPosition;
+    ULONG slotIndex;
+    ULONG d0;
+    ULONG d1;
+
+    PAGED_CODE();
+
+    bucketStart = Build->BucketStart[BucketIndex];
+    bucketSize = Build->BucketStart[BucketIndex + 1] - bucketStart;
+
+    // Buckets with one Key are placed last, when most slots are used. Instead of searching for a
+    // displacement, put the Key in the next free slot. Free slots are found in increasing order
+    // so that all of them are found in a single pass.
+    //
+    if (1 == bucketSize)
+    {
+        while (Build->SlotUsed[Build->FreeSlotSearchStart])
+        {
+            Build->FreeSlotSearchStart++;
+        }
+        slotIndex = Build->FreeSlotSearchStart;
+        keyHash = &Build->KeyHashes[Build->KeyOrder[bucketStart]];
+        Build->SlotUsed[slotIndex] = TRUE;
+        ModuleContext->Displacements[BucketIndex].D0 = 0;
+        ModuleContext->Displacements[BucketIndex].D1 = (slotIndex >= keyHash->First) ? (slotIndex - keyHash->First) : (slotIndex + ModuleContext->EntryCount - keyHash->First);
+        return TRUE;
+    }
+
+    for (d0 = 0; d0 < STATICTABLE_FIRST_DISPLACEMENT_MAXIMUM; d0++)
+    {
+        for (d1 = 0; d1 < ModuleContext->EntryCount; d1++)
+        {
+            // Mark the slots as the Keys are placed, so that two Keys of the bucket
+            // cannot use the same slot. Unmark them if a Key does not fit.
+            //
+            for (keyPosition = 0; keyPosition < bucketSize; keyPosition++)
+            {
+                keyHash = &Build->KeyHashes[Build->KeyOrder[bucketStart + keyPosition]];
+                slotIndex = StaticTable_SlotIndexGet(ModuleContext,
+                                                     keyHash,
+                                                     d0,
+                                                     d1);
+                if (Build->SlotUsed[slotIndex])
+                {
+                    break;
+                }
+                Build->SlotUsed[slotIndex] = TRUE;
+                Build->TrialSlots[keyPosition] = slotIndex;
+            }
+
+            if (keyPosition == bucketSize)
+            {
+                ModuleContext->Displacements[BucketIndex].D0 = d0;
+                ModuleContext->Displacements[BucketIndex].D1 = d1;
+                return TRUE;
+            }
+
+            while (keyPosition > 0)
+            {
+                keyPosition--;
+                Build->SlotUsed[Build->TrialSlots[keyPosition]] = FALSE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+StaticTable_Build(
+    _In_ DMFMODULE DmfModule,
+    _Inout_ STATICTABLE_BUILD* Build
+    )
+/*++
+
+Routine Description:
+
+    Builds a minimal perfect hash function for the Client's Keys (hash and displace, as in CHD):
+    Keys are hashed into buckets, then the buckets are placed from largest to smallest by finding a
+    displacement that puts all their Keys in free slots. If a bucket cannot be placed, the build
+    restarts with another hash seed. Then, the Keys and Values are copied into their slots.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Build - Arrays used to build the table.
+
+Return Value:
+
+    STATUS_SUCCESS - The table was built.
+    STATUS_INVALID_PARAMETER - Two entries have the same Key.
+    STATUS_UNSUCCESSFUL - No displacement was found with any seed.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_StaticTable* moduleContext;
+    DMF_CONFIG_StaticTable* moduleConfig;
+    STATICTABLE_ENTRY* entry;
+    STATICTABLE_SLOT* slot;
+    STATICTABLE_KEY_HASH* keyHash;
+    ULONG seedAttempt;
+    ULONG bucketPosition;
+    ULONG entryIndex;
+    ULONG dataOffset;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    for (seedAttempt = 0; seedAttempt < STATICTABLE_SEED_ATTEMPTS_MAXIMUM; seedAttempt++)
+    {
+        // Seeds are not random, so the same Keys always produce the same table.
+        //
+        moduleContext->Seed = seedAttempt * DMF_HASH_PRIME_3;
+
+        for (entryIndex = 0; entryIndex < moduleContext->EntryCount; entryIndex++)
+        {
+            entry = &moduleConfig->Entries[entryIndex];
+            StaticTable_HashCalculate(moduleContext,
+                                      moduleContext->Seed,
+                                      entry->Key,
+                                      entry->KeyLength,
+                                      &Build->KeyHashes[entryIndex]);
+        }
+
+        StaticTable_BucketsSort(moduleContext,
+                                Build);
+
+        if ((0 == seedAttempt) &&
+            StaticTable_DuplicateFind(moduleContext,
+                                      moduleConfig,
+                                      Build))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+
+        RtlZeroMemory(Build->SlotUsed,
+                      (SIZE_T)moduleContext->EntryCount * sizeof(BOOLEAN));
+        Build->FreeSlotSearchStart = 0;
+
+        // Empty buckets are last. Their displacement is never used.
+        //
+        for (bucketPosition = 0; bucketPosition < moduleContext->BucketCount; bucketPosition++)
+        {
+            if (! StaticTable_BucketPlace(moduleContext,
+                                          Build,
+                                          Build->BucketOrder[bucketPosition]))
+            {
+                break;
+            }
+        }
+
+        if (bucketPosition == moduleContext->BucketCount)
+        {
+            break;
+        }
+
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Bucket cannot be placed: seedAttempt=%u", seedAttempt);
+    }
+
+    if (seedAttempt == STATICTABLE_SEED_ATTEMPTS_MAXIMUM)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No perfect hash function found: EntryCount=%u", moduleContext->EntryCount);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    // Copy each Key and Value to the Module's data, and record them in the Key's slot.
+    //
+    dataOffset = 0;
+    for (entryIndex = 0; entryIndex < moduleContext->EntryCount; entryIndex++)
+    {
+        entry = &moduleConfig->Entries[entryIndex];
+        keyHash = &Build->KeyHashes[entryIndex];
+        slot = &moduleContext->Slots[StaticTable_SlotIndexGet(moduleContext,
+                                                              keyHash,
+                                                              moduleContext->Displacements[keyHash->Bucket].D0,
+                                                              moduleContext->Displacements[keyHash->Bucket].D1)];
+
+        slot->EntryIndex = entryIndex;
+        slot->KeyOffset = dataOffset;
+        slot->KeyLength = entry->KeyLength;
+        RtlCopyMemory(&moduleContext->Data[dataOffset],
+                      entry->Key,
+                      entry->KeyLength);
+        dataOffset += entry->KeyLength;
+
+        slot->ValueOffset = dataOffset;
+        slot->ValueLength = entry->ValueLength;
+        if (entry->ValueLength > 0)
+        {
+            RtlCopyMemory(&moduleContext->Data[dataOffset],
+                          entry->Value,
+                          entry->ValueLength);
+            dataOffset += entry->ValueLength;
+        }
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "Build static table: EntryCount=%u, BucketCount=%u, seedAttempt=%u, DataSize=%u",
+                moduleContext->EntryCount,
+                moduleContext->BucketCount,
+                seedAttempt,
+                dataOffset);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_StaticTable_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type StaticTable.
+    The table is built here. Memory used only by the build is freed before this function returns.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_StaticTable* moduleContext;
+    DMF_CONFIG_StaticTable* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY buildMemory;
+    STATICTABLE_BUILD build;
+    ULONGLONG dataSize;
+    SIZE_T tableSize;
+    SIZE_T buildSize;
+    UCHAR* tableBuffer;
+    UCHAR* buildBuffer;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    buildMemory = NULL;
+
+    if ((moduleConfig->EntryCount > STATICTABLE_ENTRY_COUNT_MAXIMUM) ||
+        ((moduleConfig->EntryCount > 0) && (NULL == moduleConfig->Entries)))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    dataSize = 0;
+    for (ULONG entryIndex = 0; entryIndex < moduleConfig->EntryCount; entryIndex++)
+    {
+        if ((0 == moduleConfig->Entries[entryIndex].KeyLength) ||
+            (NULL == moduleConfig->Entries[entryIndex].Key) ||
+            ((moduleConfig->Entries[entryIndex].ValueLength > 0) && (NULL == moduleConfig->Entries[entryIndex].Value)))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+        dataSize += (ULONGLONG)moduleConfig->Entries[entryIndex].KeyLength + moduleConfig->Entries[entryIndex].ValueLength;
+    }
+    if (dataSize > ULONG_MAX)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    moduleContext->EntryCount = moduleConfig->EntryCount;
+    moduleContext->BucketCount = (moduleConfig->EntryCount + STATICTABLE_KEYS_PER_BUCKET - 1) / STATICTABLE_KEYS_PER_BUCKET;
+
+    // An empty table is valid. No Key is ever found in it.
+    //
+    if (0 == moduleContext->EntryCount)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // The table is a single allocation from non-paged pool so that it can be read at DISPATCH_LEVEL.
+    //
+    tableSize = ((SIZE_T)moduleContext->BucketCount * sizeof(STATICTABLE_DISPLACEMENT)) +
+                ((SIZE_T)moduleContext->EntryCount * sizeof(STATICTABLE_SLOT)) +
+                (SIZE_T)dataSize;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               tableSize,
+                               &moduleContext->TableMemory,
+                               (VOID**)&tableBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->TableMemory = NULL;
+        goto Exit;
+    }
+    RtlZeroMemory(tableBuffer,
+                  tableSize);
+
+    moduleContext->Displacements = (STATICTABLE_DISPLACEMENT*)tableBuffer;
+    moduleContext->Slots = (STATICTABLE_SLOT*)(moduleContext->Displacements + moduleContext->BucketCount);
+    moduleContext->Data = (UCHAR*)(moduleContext->Slots + moduleContext->EntryCount);
+
+    // The arrays used only by the build are also a single allocation. Open runs at PASSIVE_LEVEL,
+    // so they are allocated from paged pool.
+    //
+    buildSize = ((SIZE_T)moduleContext->EntryCount * (sizeof(STATICTABLE_KEY_HASH) + sizeof(ULONG) + sizeof(ULONG) + sizeof(ULONG) + sizeof(BOOLEAN))) +
+                (((SIZE_T)moduleContext->BucketCount * 2 + 1) * sizeof(ULONG)) +
+                (2 * sizeof(ULONG));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               PagedPool,
+                               MemoryTag,
+                               buildSize,
+                               &buildMemory,
+                               (VOID**)&buildBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        buildMemory = NULL;
+        goto Exit;
+    }
+
+    build.KeyHashes = (STATICTABLE_KEY_HASH*)buildBuffer;
+    build.KeyOrder = (ULONG*)(build.KeyHashes + moduleContext->EntryCount);
+    build.TrialSlots = build.KeyOrder + moduleContext->EntryCount;
+    build.SizeStart = build.TrialSlots + moduleContext->EntryCount;
+    build.BucketStart = build.SizeStart + moduleContext->EntryCount + 2;
+    build.BucketOrder = build.BucketStart + moduleContext->BucketCount + 1;
+    build.SlotUsed = (BOOLEAN*)(build.BucketOrder + moduleContext->BucketCount);
+
+    ntStatus = StaticTable_Build(DmfModule,
+                                 &build);
+
+Exit:
+
+    if (buildMemory != NULL)
+    {
+        WdfObjectDelete(buildMemory);
+    }
+
+    if ((! NT_SUCCESS(ntStatus)) &&
+        (moduleContext->TableMemory != NULL))
+    {
+        WdfObjectDelete(moduleContext->TableMemory);
+        moduleContext->TableMemory = NULL;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_StaticTable_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type StaticTable.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_StaticTable* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->TableMemory != NULL)
+    {
+        WdfObjectDelete(moduleContext->TableMemory);
+        moduleContext->TableMemory = NULL;
+    }
+
+    moduleContext->Displacements = NULL;
+    moduleContext->Slots = NULL;
+    moduleContext->Data = NULL;
+    moduleContext->EntryCount = 0;
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_StaticTable_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type StaticTable.
+
+Arguments:
+
+    Device - Client Driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_StaticTable;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_StaticTable;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_StaticTable);
+    dmfCallbacksDmf_StaticTable.DeviceOpen = DMF_StaticTable_Open;
+    dmfCallbacksDmf_StaticTable.DeviceClose = DMF_StaticTable_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_StaticTable,
+                                            StaticTable,
+                                            DMF_CONTEXT_StaticTable,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_StaticTable.CallbacksDmf = &dmfCallbacksDmf_StaticTable;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_StaticTable,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_StaticTable_Find(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ ULONG* EntryIndex
+    )
+/*++
+
+Routine Description:
+
+    Finds a given Key and returns the index of its entry in the Client's Entries array.
+    The table never changes after the Module opens, so the Module is not locked.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    EntryIndex - Where the index of the Key's entry is written.
+
+Return Value:
+
+    STATUS_SUCCESS - The Key was found.
+    STATUS_NOT_FOUND - The Key is not in the table.
+
+--*/
+{
+    DMF_CONTEXT_StaticTable* moduleContext;
+    STATICTABLE_SLOT* slot;
+    NTSTATUS ntStatus;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 StaticTable);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    slot = StaticTable_SlotFind(moduleContext,
+                                Key,
+                                KeyLength);
+    if (NULL == slot)
+    {
+        *EntryIndex = 0;
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    *EntryIndex = slot->EntryIndex;
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_StaticTable_Read(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Reads the Value of a given Key.
+    The table never changes after the Module opens, so the Module is not locked.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - Address of the buffer containing Key data.
+    KeyLength - Length of Key data in bytes.
+    ValueBuffer - Address of the output buffer to store Value data.
+    ValueBufferLength - Output buffer length.
+    ValueLength - Address to store the actual Value length (optional).
+
+Return Value:
+
+    STATUS_SUCCESS - The Key was found and its Value was successfully stored to the output buffer.
+    STATUS_NOT_FOUND - The Key is not in the table.
+    STATUS_BUFFER_TOO_SMALL - The Key was found, but the output buffer is too small to store the Value.
+
+--*/
+{
+    DMF_CONTEXT_StaticTable* moduleContext;
+    STATICTABLE_SLOT* slot;
+    NTSTATUS ntStatus;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 StaticTable);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    slot = StaticTable_SlotFind(moduleContext,
+                                Key,
+                                KeyLength);
+    if (NULL == slot)
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    if (ValueLength != NULL)
+    {
+        *ValueLength = slot->ValueLength;
+    }
+
+    if (ValueBufferLength < slot->ValueLength)
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto Exit;
+    }
+
+    RtlCopyMemory(ValueBuffer,
+                  &moduleContext->Data[slot->ValueOffset],
+                  slot->ValueLength);
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
+// eof: Dmf_StaticTable.c
+//
@@ -0,0 +1,88 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_StaticTable.h
+
+Abstract:
+
+    Companion file to Dmf_StaticTable.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// One Key-Value pair of the table.
+//
+typedef struct
+{
+    // The Key. Keys must be unique.
+    //
+    UCHAR* Key;
+    // Length of the Key in bytes. It cannot be zero.
+    //
+    ULONG KeyLength;
+    // The Value. It can be NULL if ValueLength is zero.
+    //
+    UCHAR* Value;
+    // Length of the Value in bytes.
+    //
+    ULONG ValueLength;
+} STATICTABLE_ENTRY;
+
+// Client uses this structure to configure the Module specific parameters.
+//
+typedef struct
+{
+    // All the Key-Value pairs of the table. The Module copies them when it opens, so this array
+    // and the buffers it points to only need to remain valid until then.
+    //
+    STATICTABLE_ENTRY* Entries;
+
+    // Number of elements in Entries.
+    //
+    ULONG EntryCount;
+} DMF_CONFIG_StaticTable;
+
+// This macro declares the following functions:
+// DMF_StaticTable_ATTRIBUTES_INIT()
+// DMF_CONFIG_StaticTable_AND_ATTRIBUTES_INIT()
+// DMF_StaticTable_Create()
+//
+DECLARE_DMF_MODULE(StaticTable)
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_StaticTable_Find(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_ ULONG* EntryIndex
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_StaticTable_Read(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Out_writes_(ValueBufferLength) UCHAR* ValueBuffer,
+    _In_ ULONG ValueBufferLength,
+    _Out_opt_ ULONG* ValueLength
+    );
+
+// eof: Dmf_StaticTable.h
+//
@@ -43,10 +43,13 @@ extern "C"
 #include "Dmf_Tests_BufferPool.h"
 #include "Dmf_Tests_BufferQueue.h"
 #include "Dmf_Tests_RingBuffer.h"
+#include "Dmf_Tests_RingBufferPerProcessor.h"
 #include "Dmf_Tests_Registry.h"
 #include "Dmf_Tests_PingPongBuffer.h"
 #include "Dmf_Tests_ScheduledTask.h"
 #include "Dmf_Tests_HashTable.h"
+#include "Dmf_Tests_LruCache.h"
+#include "Dmf_Tests_StaticTable.h"
 #include "Dmf_Tests_IoctlHandler.h"
 #include "Dmf_Tests_SelfTarget.h"
 #include "Dmf_Tests_DeviceInterfaceTarget.h"
@@ -33,18 +33,28 @@ Environment:
 //
 
 #define BUFFER_SIZE                 (32)
-#if !defined(DMF_USER_MODE)
-    #define BUFFER_COUNT_MAX            (24)
-    #define BUFFER_COUNT_PREALLOCATED   (16)
-#else
-    // NOTE: Cannot use lookaside with timer in User-mode because deleting the memory from
-    //       timer callback causes verifier issue.
-    //
-    #define BUFFER_COUNT_MAX            (2400)
-    #define BUFFER_COUNT_PREALLOCATED   BUFFER_COUNT_MAX
-#endif
+#define BUFFER_COUNT_MAX            (24)
+#define BUFFER_COUNT_PREALLOCATED   (16)
 #define THREAD_COUNT                (2)
 
+// Performance tests compare the throughput of a source-mode pool that uses only its lock
+// with one that uses per-processor caches and one whose buffers are allocated in a slab.
+//
+#define PERFORMANCE_THREAD_COUNT        (4)
+#define PERFORMANCE_BUFFER_COUNT        (64)
+#define PERFORMANCE_BATCH_SIZE          (4)
+#define PERFORMANCE_ITERATIONS          (1000)
+
+// The trim test uses a pool that allocates more buffers than it preallocates during a burst
+// and retains some of them after the burst. Each retained buffer must be deleted by the trim
+// timer within a bounded number of trim intervals after the burst ends.
+//
+#define TRIM_BUFFER_COUNT               (4)
+#define TRIM_MAXIMUM_RETAINED_BUFFERS   (8)
+#define TRIM_BURST_BUFFER_COUNT         (TRIM_BUFFER_COUNT + TRIM_MAXIMUM_RETAINED_BUFFERS + 4)
+#define TRIM_INTERVAL_MILLISECONDS      (100)
+#define TRIM_INTERVAL_COUNT_MAXIMUM     (32)
+
 #define CLIENT_CONTEXT_SIGNATURE    'GISB'
 
 typedef struct
@@ -76,6 +86,13 @@ typedef enum _GET_ACTION {
     GET_ACTION_MAX      = GET_ACTION_WITH_MEMORY_DESCRIPTOR
 } GET_ACTION;
 
+typedef enum _PERFORMANCE_POOL {
+    PERFORMANCE_POOL_LOCKED,
+    PERFORMANCE_POOL_PER_PROCESSOR_CACHE,
+    PERFORMANCE_POOL_SLAB,
+    PERFORMANCE_POOL_COUNT
+} PERFORMANCE_POOL;
+
 typedef enum _PUT_ACTION {
     PUT_ACTION_PLAIN,
     PUT_ACTION_WITH_TIMEOUT,
@@ -99,6 +116,21 @@ typedef struct
     // Work threads
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
+    // BufferPool source Modules used for performance tests.
+    //
+    DMFMODULE DmfModuleBufferPoolPerformance[PERFORMANCE_POOL_COUNT];
+    // Performance test threads.
+    //
+    DMFMODULE DmfModuleThreadPerformance[PERFORMANCE_THREAD_COUNT];
+    // Thread that verifies retained buffers are trimmed.
+    //
+    DMFMODULE DmfModuleThreadTrim;
+    // Total number of Get and Put operations performed by all performance test threads.
+    //
+    LONGLONG volatile PerformanceOperations[PERFORMANCE_POOL_COUNT];
+    // Total time spent performing those operations.
+    //
+    LONGLONG volatile PerformanceMicroseconds[PERFORMANCE_POOL_COUNT];
 } DMF_CONTEXT_Tests_BufferPool;
 
 // This macro declares the following function:
@@ -535,6 +567,7 @@ Tests_BufferPool_ThreadAction_BufferCount(
     DMF_CONTEXT_Tests_BufferPool* moduleContext;
     ULONG currentCount;
     NTSTATUS ntStatus;
+    BufferPool_Statistics statistics;
 
     PAGED_CODE();
 
@@ -551,6 +584,23 @@ Tests_BufferPool_ThreadAction_BufferCount(
     //
     DmfAssert(currentCount <= BUFFER_COUNT_MAX + THREAD_COUNT);
 
+    // Water marks always bound the current number of buffers in the list.
+    //
+    DMF_BufferPool_StatisticsGet(moduleContext->DmfModuleBufferPoolSink,
+                                 &statistics);
+    DmfAssert(statistics.LowWaterMark <= statistics.HighWaterMark);
+    DmfAssert(statistics.NumberOfBuffersInList <= statistics.HighWaterMark);
+    DmfAssert(statistics.NumberOfBuffersInList >= statistics.LowWaterMark);
+    DmfAssert(0 == statistics.NumberOfLookasideAllocations);
+
+    // The source never holds more than its preallocated buffers and it has no timers.
+    //
+    DMF_BufferPool_StatisticsGet(moduleContext->DmfModuleBufferPoolSource,
+                                 &statistics);
+    DmfAssert(statistics.LowWaterMark <= statistics.HighWaterMark);
+    DmfAssert(statistics.HighWaterMark <= BUFFER_COUNT_PREALLOCATED);
+    DmfAssert(0 == statistics.NumberOfTimerExpirations);
+
     return ntStatus;
 }
 #pragma code_seg()
@@ -614,6 +664,300 @@ Tests_BufferPool_WorkThread(
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_BufferPool_PerformanceMeasure(
+    _In_ DMF_CONTEXT_Tests_BufferPool* ModuleContext,
+    _In_ PERFORMANCE_POOL PerformancePool
+    )
+/*++
+
+Routine Description:
+
+    Repeatedly get a small batch of buffers from a source-mode pool and put them back.
+    Accumulate the number of operations and the time it took to perform them.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    PerformancePool - Indicates which pool to use.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModuleBufferPool;
+    VOID* clientBuffers[PERFORMANCE_BATCH_SIZE];
+    VOID* clientBufferContext;
+    ULONG iteration;
+    ULONG bufferIndex;
+    ULONG numberOfBuffers;
+    LONGLONG numberOfOperations;
+    ULONGLONG startTime;
+    ULONGLONG endTime;
+    NTSTATUS ntStatus;
+
+    dmfModuleBufferPool = ModuleContext->DmfModuleBufferPoolPerformance[PerformancePool];
+    numberOfOperations = 0;
+
+    startTime = TestsUtility_MicrosecondsGet();
+
+    for (iteration = 0; iteration < PERFORMANCE_ITERATIONS; iteration++)
+    {
+        numberOfBuffers = 0;
+        for (bufferIndex = 0; bufferIndex < PERFORMANCE_BATCH_SIZE; bufferIndex++)
+        {
+            ntStatus = DMF_BufferPool_Get(dmfModuleBufferPool,
+                                          &clientBuffers[numberOfBuffers],
+                                          &clientBufferContext);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                // Other threads have the rest of the buffers.
+                //
+                break;
+            }
+            numberOfBuffers++;
+        }
+
+        for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+        {
+            DMF_BufferPool_Put(dmfModuleBufferPool,
+                               clientBuffers[bufferIndex]);
+        }
+
+        numberOfOperations += (2 * numberOfBuffers);
+    }
+
+    endTime = TestsUtility_MicrosecondsGet();
+
+    InterlockedAdd64(&ModuleContext->PerformanceOperations[PerformancePool],
+                     numberOfOperations);
+    InterlockedAdd64(&ModuleContext->PerformanceMicroseconds[PerformancePool],
+                     (LONGLONG)(endTime - startTime));
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferPool_PerformanceThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_BufferPool* moduleContext;
+    ULONG performancePool;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Measure all the pools under the same load so that the results are comparable.
+    //
+    for (performancePool = 0; performancePool < PERFORMANCE_POOL_COUNT; performancePool++)
+    {
+        Tests_BufferPool_PerformanceMeasure(moduleContext,
+                                            (PERFORMANCE_POOL)performancePool);
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_BufferPool_Trim(
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Create a source-mode pool that retains buffers allocated from the lookaside list.
+    Get more buffers than the pool has in a burst and return them. Verify that the
+    pool retains up to MaximumRetainedBuffers of them, that the next burst reuses them
+    and that the trim timer deletes them after the pool is no longer used.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_BufferPool moduleConfigBufferPool;
+    DMFMODULE dmfModuleBufferPool;
+    VOID* clientBuffers[TRIM_BURST_BUFFER_COUNT];
+    VOID* clientBufferContext;
+    ULONG bufferIndex;
+    ULONG burstIndex;
+    ULONG intervalIndex;
+    BufferPool_Statistics statistics;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = TRIM_BUFFER_COUNT;
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferPool.Mode.SourceSettings.MaximumRetainedBuffers = TRIM_MAXIMUM_RETAINED_BUFFERS;
+    moduleConfigBufferPool.Mode.SourceSettings.RetainedBuffersTrimIntervalMilliseconds = TRIM_INTERVAL_MILLISECONDS;
+    ntStatus = DMF_BufferPool_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleBufferPool);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        dmfModuleBufferPool = NULL;
+        goto Exit;
+    }
+
+    // The second burst reuses the buffers retained after the first burst.
+    //
+    for (burstIndex = 0; burstIndex < 2; burstIndex++)
+    {
+        for (bufferIndex = 0; bufferIndex < TRIM_BURST_BUFFER_COUNT; bufferIndex++)
+        {
+            ntStatus = DMF_BufferPool_Get(dmfModuleBufferPool,
+                                          &clientBuffers[bufferIndex],
+                                          &clientBufferContext);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                // Return the buffers retrieved so far.
+                //
+                while (bufferIndex > 0)
+                {
+                    bufferIndex--;
+                    DMF_BufferPool_Put(dmfModuleBufferPool,
+                                       clientBuffers[bufferIndex]);
+                }
+                goto Exit;
+            }
+        }
+
+        DMF_BufferPool_StatisticsGet(dmfModuleBufferPool,
+                                     &statistics);
+        DmfAssert(TRIM_BURST_BUFFER_COUNT - TRIM_BUFFER_COUNT == statistics.NumberOfAdditionalBuffersAllocated);
+        DmfAssert(0 == statistics.NumberOfBuffersInList);
+        DmfAssert((0 == burstIndex) ||
+                  (statistics.NumberOfLookasideAllocations < 2 * (TRIM_BURST_BUFFER_COUNT - TRIM_BUFFER_COUNT)));
+
+        for (bufferIndex = 0; bufferIndex < TRIM_BURST_BUFFER_COUNT; bufferIndex++)
+        {
+            DMF_BufferPool_Put(dmfModuleBufferPool,
+                               clientBuffers[bufferIndex]);
+        }
+
+        // Buffers beyond MaximumRetainedBuffers are deleted as soon as they are returned.
+        // The trim timer does not delete the others before the interval after the burst ends.
+        //
+        DMF_BufferPool_StatisticsGet(dmfModuleBufferPool,
+                                     &statistics);
+        DmfAssert(statistics.NumberOfAdditionalBuffersAllocated <= TRIM_MAXIMUM_RETAINED_BUFFERS);
+        DmfAssert(statistics.NumberOfAdditionalBuffersAllocated > 0);
+        DmfAssert(TRIM_BUFFER_COUNT + statistics.NumberOfAdditionalBuffersAllocated == statistics.NumberOfBuffersInList);
+    }
+
+    // The pool is not used now. Its estimate of the buffers in use decays each interval
+    // until all the retained buffers are deleted.
+    //
+    for (intervalIndex = 0; intervalIndex < TRIM_INTERVAL_COUNT_MAXIMUM; intervalIndex++)
+    {
+        DMF_Utility_DelayMilliseconds(TRIM_INTERVAL_MILLISECONDS);
+
+        DMF_BufferPool_StatisticsGet(dmfModuleBufferPool,
+                                     &statistics);
+        if (0 == statistics.NumberOfAdditionalBuffersAllocated)
+        {
+            break;
+        }
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Trim intervalCount=%d NumberOfAdditionalBuffersAllocated=%d NumberOfLookasideAllocations=%I64d",
+                intervalIndex,
+                statistics.NumberOfAdditionalBuffersAllocated,
+                statistics.NumberOfLookasideAllocations);
+
+    DmfAssert(0 == statistics.NumberOfAdditionalBuffersAllocated);
+    DmfAssert(TRIM_BUFFER_COUNT == statistics.NumberOfBuffersInList);
+    if (statistics.NumberOfAdditionalBuffersAllocated != 0)
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleBufferPool != NULL)
+    {
+        WdfObjectDelete(dmfModuleBufferPool);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferPool_TrimThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+
+    ntStatus = Tests_BufferPool_Trim(DMF_ParentDeviceGet(dmfModule));
+    DmfAssert(NT_SUCCESS(ntStatus) ||
+              DMF_Thread_IsStopPending(DmfModuleThread));
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -671,11 +1015,35 @@ Return Value:
         }
     }
 
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadPerformance[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadTrim);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
     for (index = 0; index < THREAD_COUNT; index++)
     {
         DMF_Thread_WorkReady(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadPerformance[index]);
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadTrim);
+
 Exit:
     
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
@@ -722,6 +1090,25 @@ Return Value:
         DMF_Thread_Stop(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadPerformance[index]);
+    }
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadTrim);
+
+    // Report the throughput of each pool.
+    //
+    for (index = 0; index < PERFORMANCE_POOL_COUNT; index++)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Performance pool=%d operations=%I64d microseconds=%I64d operationsPerMillisecond=%I64d",
+                    index,
+                    moduleContext->PerformanceOperations[index],
+                    moduleContext->PerformanceMicroseconds[index],
+                    (moduleContext->PerformanceMicroseconds[index] > 0) ? 
+                        (moduleContext->PerformanceOperations[index] * 1000) / moduleContext->PerformanceMicroseconds[index] : 0);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -776,13 +1163,7 @@ Return Value:
     moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
     moduleConfigBufferPool.Mode.SourceSettings.BufferCount = BUFFER_COUNT_PREALLOCATED;
     moduleConfigBufferPool.Mode.SourceSettings.CreateWithTimer = TRUE;
-#if !defined(DMF_USER_MODE)
-    // TODO: Cannot use "lookaside" in User-mode with timer since deleting buffers
-    //       from timer callback causes corresponding timer to delete which causes 
-    //       a deadlock (and verifier issue).
-    //
     moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
-#endif
     moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
     DMF_DmfModuleAdd(DmfModuleInit,
                      &moduleAttributes,
@@ -815,6 +1196,53 @@ Return Value:
                          &moduleContext->DmfModuleThread[threadIndex]);
     }
 
+    // BufferPool Source (Performance)
+    // -------------------------------
+    //
+    for (ULONG poolIndex = 0; poolIndex < PERFORMANCE_POOL_COUNT; poolIndex++)
+    {
+        DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                                  &moduleAttributes);
+        moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+        moduleConfigBufferPool.Mode.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+        moduleConfigBufferPool.Mode.SourceSettings.BufferSize = BUFFER_SIZE;
+        moduleConfigBufferPool.Mode.SourceSettings.BufferCount = PERFORMANCE_BUFFER_COUNT;
+        moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+        moduleConfigBufferPool.Mode.SourceSettings.EnablePerProcessorCache = (poolIndex == PERFORMANCE_POOL_PER_PROCESSOR_CACHE);
+        moduleConfigBufferPool.Mode.SourceSettings.EnableSlabAllocation = (poolIndex == PERFORMANCE_POOL_SLAB);
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleBufferPoolPerformance[poolIndex]);
+    }
+
+    // Thread (Performance)
+    // --------------------
+    //
+    for (ULONG threadIndex = 0; threadIndex < PERFORMANCE_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferPool_PerformanceThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadPerformance[threadIndex]);
+    }
+
+    // Thread (Trim)
+    // -------------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferPool_TrimThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadTrim);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -44,6 +44,43 @@ Environment:
 // Number of working threads
 //
 #define THREAD_COUNT                (2)
+// Number of buffers enqueued or dequeued by a single batch action
+//
+#define BATCH_SIZE                  (4)
+// Watermarks of the consumer list
+//
+#define HIGH_WATERMARK              (BUFFER_COUNT_PREALLOCATED)
+#define LOW_WATERMARK               (BATCH_SIZE)
+// Maximum time a wait action waits for a buffer
+//
+#define WAIT_TIMEOUT_MILLISECONDS   (10)
+
+// Performance tests compare enqueuing and dequeuing buffers one at a time with
+// enqueuing and dequeuing the same buffers using the batch Methods.
+//
+#define PERFORMANCE_THREAD_COUNT        (4)
+#define PERFORMANCE_BUFFER_COUNT        (64)
+#define PERFORMANCE_BATCH_SIZE          (8)
+#define PERFORMANCE_ITERATIONS          (1000)
+
+// Lock-free queue tests use several producer threads and a single consumer thread.
+//
+#define LOCKFREE_PRODUCER_THREAD_COUNT  (4)
+#define LOCKFREE_BUFFER_COUNT           (64)
+#define LOCKFREE_BATCH_SIZE             (8)
+
+// Priority tests use several producer threads that mostly enqueue low priority buffers and
+// a single consumer thread that measures how long buffers of each priority wait in the queue.
+//
+#define PRIORITY_PRODUCER_THREAD_COUNT  (3)
+#define PRIORITY_BUFFER_COUNT           (64)
+#define PRIORITY_BATCH_SIZE             (8)
+#define PRIORITY_LANE_COUNT             (4)
+#define PRIORITY_HIGHEST                (PRIORITY_LANE_COUNT - 1)
+#define PRIORITY_AGING_THRESHOLD        (32)
+// Latency histogram bucket N counts latencies of less than 2^N microseconds.
+//
+#define PRIORITY_LATENCY_BUCKET_COUNT   (24)
 
 #define CLIENT_CONTEXT_SIGNATURE    'GISB'
 
@@ -59,6 +96,28 @@ typedef struct
     BOOLEAN ClientOwnsBuffer;
 } ENUM_CONTEXT_Tests_BufferQueue, *PENUM_CONTEXT_Tests_BufferQueue;
 
+// Contents of the buffers used by the lock-free queue tests.
+//
+typedef struct
+{
+    ULONG ProducerIndex;
+    ULONG SequenceNumber;
+} LOCKFREE_BUFFER, *PLOCKFREE_BUFFER;
+
+// Contents of the buffers used by the priority tests.
+//
+typedef struct
+{
+    ULONG Priority;
+    ULONGLONG EnqueueTime;
+} PRIORITY_BUFFER, *PPRIORITY_BUFFER;
+
+typedef enum _PERFORMANCE_MODE {
+    PERFORMANCE_MODE_SINGLE,
+    PERFORMANCE_MODE_BATCH,
+    PERFORMANCE_MODE_COUNT
+} PERFORMANCE_MODE;
+
 typedef
 VOID
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -74,9 +133,63 @@ typedef struct
     // BufferQueue Module to test
     //
     DMFMODULE DmfModuleBufferQueue;
+    // Nonzero between the high watermark callback and the low watermark callback of DmfModuleBufferQueue.
+    //
+    LONG volatile HighWatermarkReached;
     // Work threads
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
+    // BufferQueue Modules used for performance tests.
+    //
+    DMFMODULE DmfModuleBufferQueuePerformance[PERFORMANCE_MODE_COUNT];
+    // Performance test threads.
+    //
+    DMFMODULE DmfModuleThreadPerformance[PERFORMANCE_THREAD_COUNT];
+    // Total number of Enqueue and Dequeue operations performed by all performance test threads.
+    //
+    LONGLONG volatile PerformanceOperations[PERFORMANCE_MODE_COUNT];
+    // Total time spent performing those operations.
+    //
+    LONGLONG volatile PerformanceMicroseconds[PERFORMANCE_MODE_COUNT];
+    // BufferQueue Module that uses the lock-free queue.
+    //
+    DMFMODULE DmfModuleBufferQueueLockFree;
+    // Lock-free queue producer threads.
+    //
+    DMFMODULE DmfModuleThreadLockFreeProducer[LOCKFREE_PRODUCER_THREAD_COUNT];
+    // Lock-free queue consumer thread.
+    //
+    DMFMODULE DmfModuleThreadLockFreeConsumer;
+    // Next sequence number written by each producer thread.
+    //
+    ULONG LockFreeSequenceNumberProduced[LOCKFREE_PRODUCER_THREAD_COUNT];
+    // Next sequence number expected by the consumer thread from each producer thread.
+    //
+    ULONG LockFreeSequenceNumberConsumed[LOCKFREE_PRODUCER_THREAD_COUNT];
+    // Total number of buffers dequeued by the consumer thread.
+    //
+    LONGLONG LockFreeBuffersConsumed;
+    // Time the lock-free queue test threads started.
+    //
+    ULONGLONG LockFreeStartTime;
+    // BufferQueue Module that uses priority lanes.
+    //
+    DMFMODULE DmfModuleBufferQueuePriority;
+    // Priority queue producer threads.
+    //
+    DMFMODULE DmfModuleThreadPriorityProducer[PRIORITY_PRODUCER_THREAD_COUNT];
+    // Priority queue consumer thread.
+    //
+    DMFMODULE DmfModuleThreadPriorityConsumer;
+    // Histogram of the time buffers of each priority spent in the queue.
+    //
+    ULONG PriorityLatencyHistogram[PRIORITY_LANE_COUNT][PRIORITY_LATENCY_BUCKET_COUNT];
+    // Longest time a buffer of each priority spent in the queue.
+    //
+    ULONGLONG PriorityLatencyMaximum[PRIORITY_LANE_COUNT];
+    // Number of buffers of each priority dequeued by the consumer thread.
+    //
+    ULONG PriorityBuffersConsumed[PRIORITY_LANE_COUNT];
 } DMF_CONTEXT_Tests_BufferQueue, *PDMF_CONTEXT_Tests_BufferQueue;
 
 // This macro declares the following function:
@@ -148,6 +261,64 @@ Tests_BufferQueue_EnumerationCallback(
     return enumContext->Disposition;
 }
 
+_Function_class_(EVT_DMF_BufferQueue_Watermark)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_BufferQueue_HighWatermark(
+    _In_ DMFMODULE DmfModuleBufferQueue,
+    _In_ ULONG NumberOfBuffersInQueue
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    LONG highWatermarkReached;
+
+    UNREFERENCED_PARAMETER(NumberOfBuffersInQueue);
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleBufferQueue);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(NumberOfBuffersInQueue >= HIGH_WATERMARK);
+
+    // The high and low watermark callbacks must alternate.
+    //
+    highWatermarkReached = InterlockedExchange(&moduleContext->HighWatermarkReached,
+                                               1);
+    DmfAssert(0 == highWatermarkReached);
+    UNREFERENCED_PARAMETER(highWatermarkReached);
+}
+
+_Function_class_(EVT_DMF_BufferQueue_Watermark)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_BufferQueue_LowWatermark(
+    _In_ DMFMODULE DmfModuleBufferQueue,
+    _In_ ULONG NumberOfBuffersInQueue
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_BufferQueue* moduleContext;
+    LONG highWatermarkReached;
+
+    UNREFERENCED_PARAMETER(NumberOfBuffersInQueue);
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleBufferQueue);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(NumberOfBuffersInQueue <= LOW_WATERMARK);
+
+    // The high and low watermark callbacks must alternate.
+    //
+    highWatermarkReached = InterlockedExchange(&moduleContext->HighWatermarkReached,
+                                               0);
+    DmfAssert(1 == highWatermarkReached);
+    UNREFERENCED_PARAMETER(highWatermarkReached);
+}
+
 #pragma code_seg("PAGE")
 static
 void
@@ -246,6 +417,116 @@ Exit:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_EnqueueMany(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PUINT8 clientBuffers[BATCH_SIZE];
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    ULONG numberOfBuffers;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Don't enqueue more then BUFFER_COUNT_MAX buffers
+    //
+    if (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) + BATCH_SIZE > BUFFER_COUNT_MAX)
+    {
+        goto Exit;
+    }
+
+    for (numberOfBuffers = 0; numberOfBuffers < BATCH_SIZE; numberOfBuffers++)
+    {
+        // Fetch a new buffer from producer list.
+        //
+        ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueue,
+                                         (PVOID*)&clientBuffers[numberOfBuffers],
+                                         (PVOID*)&clientBufferContext);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(clientBuffers[numberOfBuffers] != NULL);
+        DmfAssert(clientBufferContext != NULL);
+
+        // Populate the buffer with test data
+        //
+        TestsUtility_FillWithSequentialData(clientBuffers[numberOfBuffers],
+                                            BUFFER_SIZE);
+
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContext->CheckSum = TestsUtility_CrcCompute(clientBuffers[numberOfBuffers],
+                                                                BUFFER_SIZE);
+    }
+
+    // Add all the buffers to the queue at once.
+    //
+    DMF_BufferQueue_EnqueueMany(moduleContext->DmfModuleBufferQueue,
+                                (PVOID*)clientBuffers,
+                                numberOfBuffers);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_DequeueMany(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PUINT8 clientBuffers[BATCH_SIZE];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[BATCH_SIZE];
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Dequeue several buffers at once.
+    //
+    ntStatus = DMF_BufferQueue_DequeueMany(moduleContext->DmfModuleBufferQueue,
+                                           BATCH_SIZE,
+                                           (PVOID*)clientBuffers,
+                                           (PVOID*)clientBufferContexts,
+                                           &numberOfBuffers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(0 == numberOfBuffers);
+        goto Exit;
+    }
+
+    DmfAssert((numberOfBuffers > 0) && (numberOfBuffers <= BATCH_SIZE));
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        // Validate this buffer
+        //
+        Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueue,
+                                   clientBuffers[bufferIndex],
+                                   clientBufferContexts[bufferIndex]);
+
+        // Return it to the queue's producer list for reuse.
+        //
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue, 
+                              clientBuffers[bufferIndex]);
+    }
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 static
 void
@@ -341,6 +622,108 @@ Tests_BufferQueue_ThreadAction_Flush(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_FetchWait(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PUINT8 clientBuffer;
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Don't enqueue more then BUFFER_COUNT_MAX buffers
+    //
+    if (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) >= BUFFER_COUNT_MAX)
+    {
+        goto Exit;
+    }
+
+    // Fetch a new buffer from producer list, waiting if necessary.
+    //
+    ntStatus = DMF_BufferQueue_FetchWait(moduleContext->DmfModuleBufferQueue,
+                                         WAIT_TIMEOUT_MILLISECONDS,
+                                         (PVOID*)&clientBuffer,
+                                         (PVOID*)&clientBufferContext);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(STATUS_IO_TIMEOUT == ntStatus);
+        goto Exit;
+    }
+    DmfAssert(clientBuffer != NULL);
+    DmfAssert(clientBufferContext != NULL);
+
+    // Populate the buffer with test data
+    //
+    TestsUtility_FillWithSequentialData(clientBuffer,
+                                        BUFFER_SIZE);
+
+    clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+    clientBufferContext->CheckSum = TestsUtility_CrcCompute(clientBuffer,
+                                                            BUFFER_SIZE);
+
+    // Add this buffer to the queue
+    //
+    DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
+                            clientBuffer);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_BufferQueue_ThreadAction_DequeueWait(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PUINT8 clientBuffer;
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Dequeue the buffer, waiting for one to be enqueued if necessary.
+    //
+    ntStatus = DMF_BufferQueue_DequeueWait(moduleContext->DmfModuleBufferQueue,
+                                           WAIT_TIMEOUT_MILLISECONDS,
+                                           (PVOID*)&clientBuffer,
+                                           (PVOID*)&clientBufferContext);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(STATUS_IO_TIMEOUT == ntStatus);
+        goto Exit;
+    }
+
+    // Validate this buffer
+    //
+    Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueue,
+                               clientBuffer,
+                               clientBufferContext);
+
+    // Return it to the queue's producer list for reuse.
+    //
+    DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue, 
+                          clientBuffer);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
 // Test actions executed by work threads.
 //
 static
@@ -350,7 +733,11 @@ TestActionArray[] = {
     Tests_BufferQueue_ThreadAction_Dequeue,
     Tests_BufferQueue_ThreadAction_Enumerate,
     Tests_BufferQueue_ThreadAction_Count,
-    Tests_BufferQueue_ThreadAction_Flush
+    Tests_BufferQueue_ThreadAction_Flush,
+    Tests_BufferQueue_ThreadAction_EnqueueMany,
+    Tests_BufferQueue_ThreadAction_DequeueMany,
+    Tests_BufferQueue_ThreadAction_FetchWait,
+    Tests_BufferQueue_ThreadAction_DequeueWait
 };
 
 #pragma code_seg("PAGE")
@@ -393,68 +780,639 @@ Tests_BufferQueue_WorkThread(
 }
 #pragma code_seg()
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-#pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
-_IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
+_IRQL_requires_max_(DISPATCH_LEVEL)
 static
-NTSTATUS
-Tests_BufferQueue_Open(
-    _In_ DMFMODULE DmfModule
+VOID
+Tests_BufferQueue_PerformanceMeasure(
+    _In_ PDMF_CONTEXT_Tests_BufferQueue ModuleContext,
+    _In_ PERFORMANCE_MODE PerformanceMode
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type Test_BufferQueue.
+    Repeatedly fetch a batch of buffers, enqueue them, dequeue them and return them
+    to the producer list. Depending on the given mode, buffers are enqueued and dequeued
+    either one at a time or using the batch Methods. Accumulate the number of Enqueue
+    and Dequeue operations and the time it took to perform them.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    PerformanceMode - Indicates whether to use the batch Methods.
 
 Return Value:
 
-    STATUS_SUCCESS
+    None
 
 --*/
 {
-    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    DMFMODULE dmfModuleBufferQueue;
+    VOID* clientBuffers[PERFORMANCE_BATCH_SIZE];
+    VOID* clientBufferContext;
+    ULONG iteration;
+    ULONG bufferIndex;
+    ULONG numberOfBuffers;
+    ULONG numberOfBuffersDequeued;
+    LONGLONG numberOfOperations;
+    ULONGLONG startTime;
+    ULONGLONG endTime;
     NTSTATUS ntStatus;
-    LONG index;
-
-    PAGED_CODE();
-
-    FuncEntry(DMF_TRACE);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleBufferQueue = ModuleContext->DmfModuleBufferQueuePerformance[PerformanceMode];
+    numberOfOperations = 0;
 
-    ntStatus = STATUS_SUCCESS;
+    startTime = TestsUtility_MicrosecondsGet();
 
-    for (index = 0; index < THREAD_COUNT; index++)
+    for (iteration = 0; iteration < PERFORMANCE_ITERATIONS; iteration++)
     {
-        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread[index]);
-        if (!NT_SUCCESS(ntStatus))
+        numberOfBuffers = 0;
+        for (bufferIndex = 0; bufferIndex < PERFORMANCE_BATCH_SIZE; bufferIndex++)
         {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
-            goto Exit;
+            ntStatus = DMF_BufferQueue_Fetch(dmfModuleBufferQueue,
+                                             &clientBuffers[numberOfBuffers],
+                                             &clientBufferContext);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                // Other threads have the rest of the buffers.
+                //
+                break;
+            }
+            numberOfBuffers++;
         }
-    }
+
+        if (PerformanceMode == PERFORMANCE_MODE_BATCH)
+        {
+            DMF_BufferQueue_EnqueueMany(dmfModuleBufferQueue,
+                                        clientBuffers,
+                                        numberOfBuffers);
+            ntStatus = DMF_BufferQueue_DequeueMany(dmfModuleBufferQueue,
+                                                   numberOfBuffers,
+                                                   clientBuffers,
+                                                   NULL,
+                                                   &numberOfBuffersDequeued);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                numberOfBuffersDequeued = 0;
+            }
+        }
+        else
+        {
+            for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+            {
+                DMF_BufferQueue_Enqueue(dmfModuleBufferQueue,
+                                        clientBuffers[bufferIndex]);
+            }
+            for (numberOfBuffersDequeued = 0; numberOfBuffersDequeued < numberOfBuffers; numberOfBuffersDequeued++)
+            {
+                ntStatus = DMF_BufferQueue_Dequeue(dmfModuleBufferQueue,
+                                                   &clientBuffers[numberOfBuffersDequeued],
+                                                   NULL);
+                if (!NT_SUCCESS(ntStatus))
+                {
+                    break;
+                }
+            }
+        }
+
+        // Other threads may have dequeued buffers this thread enqueued and vice versa.
+        // Each thread returns the buffers it dequeued.
+        //
+        for (bufferIndex = 0; bufferIndex < numberOfBuffersDequeued; bufferIndex++)
+        {
+            DMF_BufferQueue_Reuse(dmfModuleBufferQueue,
+                                  clientBuffers[bufferIndex]);
+        }
+
+        numberOfOperations += (numberOfBuffers + numberOfBuffersDequeued);
+    }
+
+    endTime = TestsUtility_MicrosecondsGet();
+
+    InterlockedAdd64(&ModuleContext->PerformanceOperations[PerformanceMode],
+                     numberOfOperations);
+    InterlockedAdd64(&ModuleContext->PerformanceMicroseconds[PerformanceMode],
+                     (LONGLONG)(endTime - startTime));
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferQueue_PerformanceThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    ULONG performanceMode;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Measure both modes under the same load so that the results are comparable.
+    //
+    for (performanceMode = 0; performanceMode < PERFORMANCE_MODE_COUNT; performanceMode++)
+    {
+        Tests_BufferQueue_PerformanceMeasure(moduleContext,
+                                             (PERFORMANCE_MODE)performanceMode);
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferQueue_LockFreeProducerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Fetch a batch of buffers, write this thread's index and the next sequence numbers
+    in them and enqueue them in the lock-free queue, either one at a time or all at once.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PLOCKFREE_BUFFER clientBuffers[LOCKFREE_BATCH_SIZE];
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    ULONG producerIndex;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    for (producerIndex = 0; producerIndex < LOCKFREE_PRODUCER_THREAD_COUNT; producerIndex++)
+    {
+        if (moduleContext->DmfModuleThreadLockFreeProducer[producerIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(producerIndex < LOCKFREE_PRODUCER_THREAD_COUNT);
+
+    numberOfBuffers = 0;
+    for (bufferIndex = 0; bufferIndex < LOCKFREE_BATCH_SIZE; bufferIndex++)
+    {
+        ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueueLockFree,
+                                         (PVOID*)&clientBuffers[numberOfBuffers],
+                                         (PVOID*)&clientBufferContext);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // The rest of the buffers are in the queue or owned by other threads.
+            //
+            break;
+        }
+
+        clientBuffers[numberOfBuffers]->ProducerIndex = producerIndex;
+        clientBuffers[numberOfBuffers]->SequenceNumber = moduleContext->LockFreeSequenceNumberProduced[producerIndex]++;
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBufferContext->CheckSum = TestsUtility_CrcCompute((UINT8*)clientBuffers[numberOfBuffers],
+                                                                BUFFER_SIZE);
+        numberOfBuffers++;
+    }
+
+    if (numberOfBuffers > 0)
+    {
+        // Alternate between the single and batch Methods.
+        //
+        if (clientBuffers[0]->SequenceNumber % 2)
+        {
+            DMF_BufferQueue_EnqueueMany(moduleContext->DmfModuleBufferQueueLockFree,
+                                        (PVOID*)clientBuffers,
+                                        numberOfBuffers);
+        }
+        else
+        {
+            for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+            {
+                DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueueLockFree,
+                                        clientBuffers[bufferIndex]);
+            }
+        }
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferQueue_LockFreeConsumerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Dequeue buffers from the lock-free queue, validate them and return them to the
+    producer list. Buffers written by the same producer thread must be dequeued in the
+    order they were enqueued.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PLOCKFREE_BUFFER clientBuffers[LOCKFREE_BATCH_SIZE];
+    PCLIENT_BUFFER_CONTEXT clientBufferContexts[LOCKFREE_BATCH_SIZE];
+    ENUM_CONTEXT_Tests_BufferQueue enumContext;
+    ULONG numberOfBuffers;
+    ULONG bufferIndex;
+    ULONG producerIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Occasionally enumerate the queue without removing buffers. The buffers must still
+    // be dequeued in order afterward.
+    //
+    if (0 == TestsUtility_GenerateRandomNumber(0,
+                                               15))
+    {
+        enumContext.Disposition = BufferPool_EnumerationDisposition_ContinueEnumeration;
+        enumContext.ClientOwnsBuffer = FALSE;
+        DMF_BufferQueue_Enumerate(moduleContext->DmfModuleBufferQueueLockFree,
+                                  Tests_BufferQueue_EnumerationCallback,
+                                  &enumContext,
+                                  NULL,
+                                  NULL);
+        DmfAssert(! enumContext.ClientOwnsBuffer);
+    }
+
+    ntStatus = DMF_BufferQueue_DequeueMany(moduleContext->DmfModuleBufferQueueLockFree,
+                                           LOCKFREE_BATCH_SIZE,
+                                           (PVOID*)clientBuffers,
+                                           (PVOID*)clientBufferContexts,
+                                           &numberOfBuffers);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        numberOfBuffers = 0;
+    }
+
+    for (bufferIndex = 0; bufferIndex < numberOfBuffers; bufferIndex++)
+    {
+        Tests_BufferQueue_Validate(moduleContext->DmfModuleBufferQueueLockFree,
+                                   (UINT8*)clientBuffers[bufferIndex],
+                                   clientBufferContexts[bufferIndex]);
+
+        producerIndex = clientBuffers[bufferIndex]->ProducerIndex;
+        DmfAssert(producerIndex < LOCKFREE_PRODUCER_THREAD_COUNT);
+        DmfAssert(clientBuffers[bufferIndex]->SequenceNumber == moduleContext->LockFreeSequenceNumberConsumed[producerIndex]);
+        moduleContext->LockFreeSequenceNumberConsumed[producerIndex]++;
+
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueueLockFree,
+                              clientBuffers[bufferIndex]);
+    }
+
+    moduleContext->LockFreeBuffersConsumed += numberOfBuffers;
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    if (0 == numberOfBuffers)
+    {
+        TestsUtility_YieldExecution();
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferQueue_PriorityProducerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Fetch a batch of buffers and enqueue them in the priority queue. Most buffers have
+    a low priority. Occasionally a buffer has the highest priority.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PPRIORITY_BUFFER clientBuffer;
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    ULONG bufferIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    for (bufferIndex = 0; bufferIndex < PRIORITY_BATCH_SIZE; bufferIndex++)
+    {
+        ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueuePriority,
+                                         (PVOID*)&clientBuffer,
+                                         (PVOID*)&clientBufferContext);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // All the buffers are in the queue. The queue is under load.
+            //
+            break;
+        }
+
+        if (0 == TestsUtility_GenerateRandomNumber(0,
+                                                   15))
+        {
+            clientBuffer->Priority = PRIORITY_HIGHEST;
+        }
+        else
+        {
+            clientBuffer->Priority = TestsUtility_GenerateRandomNumber(0,
+                                                                       PRIORITY_HIGHEST - 1);
+        }
+        clientBufferContext->Signature = CLIENT_CONTEXT_SIGNATURE;
+        clientBuffer->EnqueueTime = TestsUtility_MicrosecondsGet();
+
+        DMF_BufferQueue_EnqueueWithPriority(moduleContext->DmfModuleBufferQueuePriority,
+                                            clientBuffer,
+                                            clientBuffer->Priority);
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_BufferQueue_PriorityConsumerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Wait for a buffer in the priority queue, record how long it waited in the queue
+    and return it to the producer list.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    PPRIORITY_BUFFER clientBuffer;
+    PCLIENT_BUFFER_CONTEXT clientBufferContext;
+    ULONGLONG latency;
+    ULONG bucketIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    ntStatus = DMF_BufferQueue_DequeueWait(moduleContext->DmfModuleBufferQueuePriority,
+                                           WAIT_TIMEOUT_MILLISECONDS,
+                                           (PVOID*)&clientBuffer,
+                                           (PVOID*)&clientBufferContext);
+    if (NT_SUCCESS(ntStatus))
+    {
+        latency = TestsUtility_MicrosecondsGet() - clientBuffer->EnqueueTime;
+
+        DmfAssert(clientBufferContext->Signature == CLIENT_CONTEXT_SIGNATURE);
+        DmfAssert(clientBuffer->Priority < PRIORITY_LANE_COUNT);
+
+        bucketIndex = 0;
+        while ((bucketIndex < PRIORITY_LATENCY_BUCKET_COUNT - 1) &&
+               (latency >= (1ULL << bucketIndex)))
+        {
+            bucketIndex++;
+        }
+        moduleContext->PriorityLatencyHistogram[clientBuffer->Priority][bucketIndex]++;
+        if (latency > moduleContext->PriorityLatencyMaximum[clientBuffer->Priority])
+        {
+            moduleContext->PriorityLatencyMaximum[clientBuffer->Priority] = latency;
+        }
+        moduleContext->PriorityBuffersConsumed[clientBuffer->Priority]++;
+
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueuePriority,
+                              clientBuffer);
+    }
+    else
+    {
+        DmfAssert((STATUS_IO_TIMEOUT == ntStatus) ||
+                  (STATUS_INVALID_DEVICE_STATE == ntStatus));
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_BufferQueue_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_BufferQueue.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    PDMF_CONTEXT_Tests_BufferQueue moduleContext;
+    NTSTATUS ntStatus;
+    LONG index;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    for (index = 0; index < THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
 
     for (index = 0; index < THREAD_COUNT; index++)
     {
         DMF_Thread_WorkReady(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadPerformance[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadPerformance[index]);
+    }
+
+    moduleContext->LockFreeStartTime = TestsUtility_MicrosecondsGet();
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadLockFreeConsumer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    for (index = 0; index < LOCKFREE_PRODUCER_THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadLockFreeProducer[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadLockFreeConsumer);
+    for (index = 0; index < LOCKFREE_PRODUCER_THREAD_COUNT; index++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadLockFreeProducer[index]);
+    }
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadPriorityConsumer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    for (index = 0; index < PRIORITY_PRODUCER_THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadPriorityProducer[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadPriorityConsumer);
+    for (index = 0; index < PRIORITY_PRODUCER_THREAD_COUNT; index++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadPriorityProducer[index]);
+    }
+
 Exit:
     
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
@@ -489,6 +1447,10 @@ Return Value:
 {
     PDMF_CONTEXT_Tests_BufferQueue moduleContext;
     LONG index;
+    LONGLONG lockFreeMicroseconds;
+    ULONG bucketIndex;
+    ULONG numberOfBuffers;
+    ULONG p99BucketIndex;
 
     PAGED_CODE();
 
@@ -501,6 +1463,79 @@ Return Value:
         DMF_Thread_Stop(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < PERFORMANCE_THREAD_COUNT; index++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadPerformance[index]);
+    }
+
+    // Stop the producers before the consumer so that the consumer is the last to
+    // access the lock-free queue.
+    //
+    for (index = 0; index < LOCKFREE_PRODUCER_THREAD_COUNT; index++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadLockFreeProducer[index]);
+    }
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadLockFreeConsumer);
+
+    for (index = 0; index < PRIORITY_PRODUCER_THREAD_COUNT; index++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadPriorityProducer[index]);
+    }
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadPriorityConsumer);
+
+    // Every buffer is either in the queue or has been consumed in order.
+    //
+    for (index = 0; index < LOCKFREE_PRODUCER_THREAD_COUNT; index++)
+    {
+        DmfAssert(moduleContext->LockFreeSequenceNumberConsumed[index] <= moduleContext->LockFreeSequenceNumberProduced[index]);
+    }
+
+    // Report the throughput of each mode.
+    //
+    for (index = 0; index < PERFORMANCE_MODE_COUNT; index++)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Performance mode=%d operations=%I64d microseconds=%I64d operationsPerMillisecond=%I64d",
+                    index,
+                    moduleContext->PerformanceOperations[index],
+                    moduleContext->PerformanceMicroseconds[index],
+                    (moduleContext->PerformanceMicroseconds[index] > 0) ? 
+                        (moduleContext->PerformanceOperations[index] * 1000) / moduleContext->PerformanceMicroseconds[index] : 0);
+    }
+
+    // Report the throughput of the lock-free queue.
+    //
+    lockFreeMicroseconds = (LONGLONG)(TestsUtility_MicrosecondsGet() - moduleContext->LockFreeStartTime);
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "LockFree producers=%d buffersConsumed=%I64d microseconds=%I64d buffersPerMillisecond=%I64d",
+                LOCKFREE_PRODUCER_THREAD_COUNT,
+                moduleContext->LockFreeBuffersConsumed,
+                lockFreeMicroseconds,
+                (lockFreeMicroseconds > 0) ? 
+                    (moduleContext->LockFreeBuffersConsumed * 1000) / lockFreeMicroseconds : 0);
+
+    // Report the tail latency of each priority. High priority buffers should wait much
+    // less than low priority buffers while the queue is under load.
+    //
+    for (index = 0; index < PRIORITY_LANE_COUNT; index++)
+    {
+        numberOfBuffers = 0;
+        p99BucketIndex = 0;
+        for (bucketIndex = 0; bucketIndex < PRIORITY_LATENCY_BUCKET_COUNT; bucketIndex++)
+        {
+            numberOfBuffers += moduleContext->PriorityLatencyHistogram[index][bucketIndex];
+            if ((ULONGLONG)numberOfBuffers * 100 < (ULONGLONG)moduleContext->PriorityBuffersConsumed[index] * 99)
+            {
+                p99BucketIndex = bucketIndex + 1;
+            }
+        }
+        DmfAssert(numberOfBuffers == moduleContext->PriorityBuffersConsumed[index]);
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Priority=%d buffersConsumed=%d p99Microseconds<%I64d maximumMicroseconds=%I64d",
+                    index,
+                    moduleContext->PriorityBuffersConsumed[index],
+                    (p99BucketIndex < PRIORITY_LATENCY_BUCKET_COUNT) ? (1ULL << p99BucketIndex) : 0,
+                    moduleContext->PriorityLatencyMaximum[index]);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -556,6 +1591,10 @@ Return Value:
     moduleConfigBufferQueue.SourceSettings.CreateWithTimer = FALSE;
     moduleConfigBufferQueue.SourceSettings.EnableLookAside = TRUE;
     moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferQueue.HighWatermark = HIGH_WATERMARK;
+    moduleConfigBufferQueue.LowWatermark = LOW_WATERMARK;
+    moduleConfigBufferQueue.EvtBufferQueueHighWatermark = Tests_BufferQueue_HighWatermark;
+    moduleConfigBufferQueue.EvtBufferQueueLowWatermark = Tests_BufferQueue_LowWatermark;
     DMF_DmfModuleAdd(DmfModuleInit,
                      &moduleAttributes,
                      WDF_NO_OBJECT_ATTRIBUTES,
@@ -576,6 +1615,123 @@ Return Value:
                          &moduleContext->DmfModuleThread[threadIndex]);
     }
 
+    // BufferQueue (Performance)
+    // -------------------------
+    //
+    for (ULONG queueIndex = 0; queueIndex < PERFORMANCE_MODE_COUNT; queueIndex++)
+    {
+        DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigBufferQueue,
+                                                   &moduleAttributes);
+        moduleConfigBufferQueue.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+        moduleConfigBufferQueue.SourceSettings.BufferSize = BUFFER_SIZE;
+        moduleConfigBufferQueue.SourceSettings.BufferCount = PERFORMANCE_BUFFER_COUNT;
+        moduleConfigBufferQueue.SourceSettings.CreateWithTimer = FALSE;
+        moduleConfigBufferQueue.SourceSettings.EnableLookAside = FALSE;
+        moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleBufferQueuePerformance[queueIndex]);
+    }
+
+    // Thread (Performance)
+    // --------------------
+    //
+    for (ULONG threadIndex = 0; threadIndex < PERFORMANCE_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferQueue_PerformanceThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadPerformance[threadIndex]);
+    }
+
+    // BufferQueue (Lock-free)
+    // -----------------------
+    //
+    DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigBufferQueue,
+                                               &moduleAttributes);
+    moduleConfigBufferQueue.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferQueue.SourceSettings.BufferSize = BUFFER_SIZE;
+    moduleConfigBufferQueue.SourceSettings.BufferCount = LOCKFREE_BUFFER_COUNT;
+    moduleConfigBufferQueue.SourceSettings.CreateWithTimer = FALSE;
+    moduleConfigBufferQueue.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferQueue.EnableLockFreeQueue = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferQueueLockFree);
+
+    // Thread (Lock-free)
+    // ------------------
+    //
+    for (ULONG threadIndex = 0; threadIndex < LOCKFREE_PRODUCER_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferQueue_LockFreeProducerThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadLockFreeProducer[threadIndex]);
+    }
+
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferQueue_LockFreeConsumerThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadLockFreeConsumer);
+
+    // BufferQueue (Priority)
+    // ----------------------
+    //
+    DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&moduleConfigBufferQueue,
+                                               &moduleAttributes);
+    moduleConfigBufferQueue.SourceSettings.BufferContextSize = sizeof(CLIENT_BUFFER_CONTEXT);
+    moduleConfigBufferQueue.SourceSettings.BufferSize = sizeof(PRIORITY_BUFFER);
+    moduleConfigBufferQueue.SourceSettings.BufferCount = PRIORITY_BUFFER_COUNT;
+    moduleConfigBufferQueue.SourceSettings.CreateWithTimer = FALSE;
+    moduleConfigBufferQueue.SourceSettings.EnableLookAside = FALSE;
+    moduleConfigBufferQueue.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferQueue.NumberOfPriorityLanes = PRIORITY_LANE_COUNT;
+    moduleConfigBufferQueue.PriorityAgingThreshold = PRIORITY_AGING_THRESHOLD;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferQueuePriority);
+
+    // Thread (Priority)
+    // -----------------
+    //
+    for (ULONG threadIndex = 0; threadIndex < PRIORITY_PRODUCER_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferQueue_PriorityProducerThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadPriorityProducer[threadIndex]);
+    }
+
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_BufferQueue_PriorityConsumerThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadPriorityConsumer);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
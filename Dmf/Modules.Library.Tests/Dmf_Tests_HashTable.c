@@ -44,6 +44,43 @@ Environment:
 // Number of threads that access the table.
 //
 #define THREAD_COUNT                (2)
+// Number of entries the growing hash table has space for when it is created.
+//
+#define GROWTH_INITIAL_TABLE_SIZE   (16)
+// Number of operations on the growing hash table done by each growth test action.
+//
+#define GROWTH_OPERATION_COUNT      (64)
+// Number of growing hash tables. One for each layout.
+//
+#define GROWTH_TABLE_COUNT          (HashTable_Layout_Maximum)
+// Maximum number of entries in the hash tables used to measure performance.
+//
+#define PERFORMANCE_TABLE_SIZE      (16384)
+// Number of lookups of each kind done to measure performance.
+//
+#define PERFORMANCE_LOOKUP_COUNT    (16384)
+// Number of fill levels (in quarters of PERFORMANCE_TABLE_SIZE) at which performance is measured.
+//
+#define PERFORMANCE_FILL_LEVELS     (4)
+// Number of Keys written to the hash tables used to measure the hash functions.
+//
+#define HASH_PERFORMANCE_KEY_COUNT  (8192)
+// Size of the Keys of PERFORMANCE_KEY_SET_LONG. They resemble the file and branch name strings
+// used by BranchTrack.
+//
+#define HASH_PERFORMANCE_LONG_KEY_SIZE      (128)
+// Size of the Keys of PERFORMANCE_KEY_SET_SPARSE.
+//
+#define HASH_PERFORMANCE_SPARSE_KEY_SIZE    (64)
+
+// Concurrency tests compare the throughput of Find called by many threads at the same time
+// on a table that uses the Module lock with one that lets lookups share a reader-writer lock.
+// The Keys are ULONGLONG so that the Values are aligned for interlocked operations.
+//
+#define CONCURRENCY_TABLE_COUNT     (HashTable_Concurrency_Maximum)
+#define CONCURRENCY_THREAD_COUNT    (4)
+#define CONCURRENCY_KEY_COUNT       (1024)
+#define CONCURRENCY_ITERATIONS      (1000)
 
 // It is a table of data that is automatically generated. This data is
 // then written to the hash table. Then, this table is used to find 
@@ -62,11 +99,30 @@ typedef enum _TEST_ACTION
     TEST_ACTION_READSUCCESS,
     TEST_ACTION_READFAIL,
     TEST_ACTION_ENUMERATE,
+    TEST_ACTION_GROWTH,
+    TEST_ACTION_PRECOMPUTEDHASH,
     TEST_ACTION_COUNT,
     TEST_ACTION_MINIMUM     = TEST_ACTION_READSUCCESS,
-    TEST_ACTION_MAXIMUM     = TEST_ACTION_ENUMERATE
+    TEST_ACTION_MAXIMUM     = TEST_ACTION_PRECOMPUTEDHASH
 } TEST_ACTION;
 
+// Keys used to measure performance. Keys with indexes past the number of Keys written to a table
+// are used for lookups that fail.
+//
+typedef enum _PERFORMANCE_KEY_SET
+{
+    // ULONG Keys spread over the range of ULONG so that they are not consecutive.
+    //
+    PERFORMANCE_KEY_SET_SPREAD,
+    // Long Keys that only differ in their last bytes.
+    //
+    PERFORMANCE_KEY_SET_LONG,
+    // Keys that have only two bits set, one in each half.
+    //
+    PERFORMANCE_KEY_SET_SPARSE,
+    PERFORMANCE_KEY_SET_COUNT
+} PERFORMANCE_KEY_SET;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -83,9 +139,32 @@ typedef struct
     // HashTable Module to test using custom hash function.
     //
     DMFMODULE DmfModuleHashTableCustom; 
+    // HashTable Modules that start small, grow as entries are written and have entries removed.
+    // There is one for each layout.
+    //
+    DMFMODULE DmfModuleHashTableGrowing[GROWTH_TABLE_COUNT];
+    // Indicates which records are in each growing hash table. Each thread only writes and
+    // removes the records whose index modulo THREAD_COUNT is the thread's index.
+    //
+    BOOLEAN GrowingRecordPresent[GROWTH_TABLE_COUNT][BUFFER_COUNT_MAXIMUM];
+    // Indicates that performance of the layouts has been measured.
+    //
+    BOOLEAN PerformanceMeasured;
     // Work threads that perform actions on the HashTable Module.
     //
     DMFMODULE DmfModuleThread[THREAD_COUNT];
+    // HashTable Modules that many threads look up at the same time. There is one for each concurrency mode.
+    //
+    DMFMODULE DmfModuleHashTableConcurrency[CONCURRENCY_TABLE_COUNT];
+    // Concurrency test threads.
+    //
+    DMFMODULE DmfModuleThreadConcurrency[CONCURRENCY_THREAD_COUNT];
+    // Total number of lookups performed by all concurrency test threads.
+    //
+    LONGLONG volatile ConcurrencyOperations[CONCURRENCY_TABLE_COUNT];
+    // Total time spent performing those lookups.
+    //
+    LONGLONG volatile ConcurrencyMicroseconds[CONCURRENCY_TABLE_COUNT];
 } DMF_CONTEXT_Tests_HashTable;
 
 // This macro declares the following function:
@@ -478,6 +557,652 @@ Tests_HashTable_ThreadAction_Enumerate(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_ThreadAction_Growth(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG ThreadIndex
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    HashTable_DataRecord* dataRecord;
+    UCHAR valueBuffer[BUFFER_SIZE];
+    ULONG valueSize;
+    ULONG recordIndex;
+    ULONG operationIndex;
+    ULONG operation;
+    ULONG tableIndex;
+    DMFMODULE dmfModuleHashTable;
+    BOOLEAN* recordPresent;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Write, remove and read random records owned by this thread while the other threads
+    // do the same with their records. More records are written than removed, so the
+    // tables grow while other threads access them. The same operations are done on
+    // the growing table of each layout.
+    //
+    for (operationIndex = 0; operationIndex < GROWTH_OPERATION_COUNT; operationIndex++)
+    {
+        recordIndex = TestsUtility_GenerateRandomNumber(0,
+                                                        (BUFFER_COUNT_MAXIMUM / THREAD_COUNT) - 1);
+        recordIndex = (recordIndex * THREAD_COUNT) + ThreadIndex;
+        dataRecord = &moduleContext->DataRecords[recordIndex];
+        operation = TestsUtility_GenerateRandomNumber(0,
+                                                      3);
+
+        for (tableIndex = 0; tableIndex < GROWTH_TABLE_COUNT; tableIndex++)
+        {
+            dmfModuleHashTable = moduleContext->DmfModuleHashTableGrowing[tableIndex];
+            recordPresent = &moduleContext->GrowingRecordPresent[tableIndex][recordIndex];
+
+            switch (operation)
+            {
+                case 0:
+                case 1:
+                    ntStatus = DMF_HashTable_Write(dmfModuleHashTable,
+                                                   dataRecord->Key,
+                                                   dataRecord->KeySize,
+                                                   dataRecord->Buffer,
+                                                   dataRecord->BufferSize);
+                    DmfAssert(NT_SUCCESS(ntStatus));
+                    *recordPresent = TRUE;
+                    break;
+                case 2:
+                    ntStatus = DMF_HashTable_Remove(dmfModuleHashTable,
+                                                    dataRecord->Key,
+                                                    dataRecord->KeySize);
+                    DmfAssert(NT_SUCCESS(ntStatus) == *recordPresent);
+                    *recordPresent = FALSE;
+                    break;
+                default:
+                    if (*recordPresent)
+                    {
+                        // DMF_HashTable_Find would add the record if it were not present.
+                        //
+                        ntStatus = DMF_HashTable_Find(dmfModuleHashTable,
+                                                      dataRecord->Key,
+                                                      dataRecord->KeySize,
+                                                      HashTable_Find);
+                        DmfAssert(NT_SUCCESS(ntStatus));
+                    }
+                    valueSize = sizeof(valueBuffer);
+                    ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                                  dataRecord->Key,
+                                                  dataRecord->KeySize,
+                                                  valueBuffer,
+                                                  valueSize,
+                                                  &valueSize);
+                    DmfAssert(NT_SUCCESS(ntStatus) == *recordPresent);
+                    if (NT_SUCCESS(ntStatus))
+                    {
+                        DmfAssert(valueSize == dataRecord->BufferSize);
+                        DmfAssert(RtlCompareMemory(valueBuffer,
+                                                   dataRecord->Buffer,
+                                                   valueSize) == valueSize);
+                    }
+                    break;
+            }
+        }
+    }
+
+    // All the entries enumerated must be valid records.
+    //
+    for (tableIndex = 0; tableIndex < GROWTH_TABLE_COUNT; tableIndex++)
+    {
+        DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableGrowing[tableIndex],
+                                HashTable_Enumerate,
+                                DmfModule);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+void
+Tests_HashTable_ThreadAction_PrecomputedHash(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    NTSTATUS ntStatus;
+    HashTable_DataRecord* dataRecord;
+    HASHTABLE_KEY_HASH keyHash;
+    DMFMODULE dmfModuleHashTable[2];
+    UCHAR valueBuffer[BUFFER_SIZE];
+    ULONG valueSize;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    dmfModuleHashTable[0] = moduleContext->DmfModuleHashTableDefault;
+    dmfModuleHashTable[1] = moduleContext->DmfModuleHashTableCustom;
+
+    // Generate a random index and access the corresponding record in both hash tables
+    // using a hash that is calculated only once for each table.
+    //
+    ULONG recordIndex = TestsUtility_GenerateRandomNumber(0,
+                                                          BUFFER_COUNT_MAXIMUM - 1);
+
+    dataRecord = &moduleContext->DataRecords[recordIndex];
+
+    for (ULONG tableIndex = 0; tableIndex < ARRAYSIZE(dmfModuleHashTable); tableIndex++)
+    {
+        DMF_HashTable_HashCompute(dmfModuleHashTable[tableIndex],
+                                  dataRecord->Key,
+                                  dataRecord->KeySize,
+                                  &keyHash);
+
+        valueSize = sizeof(valueBuffer);
+        ntStatus = DMF_HashTable_ReadWithHash(dmfModuleHashTable[tableIndex],
+                                              dataRecord->Key,
+                                              dataRecord->KeySize,
+                                              &keyHash,
+                                              valueBuffer,
+                                              valueSize,
+                                              &valueSize);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(valueSize == dataRecord->BufferSize);
+        DmfAssert(RtlCompareMemory(valueBuffer,
+                                   dataRecord->Buffer,
+                                   valueSize) == valueSize);
+
+        ntStatus = DMF_HashTable_FindWithHash(dmfModuleHashTable[tableIndex],
+                                              dataRecord->Key,
+                                              dataRecord->KeySize,
+                                              &keyHash,
+                                              HashTable_Find);
+        DmfAssert(NT_SUCCESS(ntStatus));
+
+        // Write the same Value, so that other threads still read the expected data.
+        //
+        ntStatus = DMF_HashTable_WriteWithHash(dmfModuleHashTable[tableIndex],
+                                               dataRecord->Key,
+                                               dataRecord->KeySize,
+                                               &keyHash,
+                                               dataRecord->Buffer,
+                                               dataRecord->BufferSize);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+}
+#pragma code_seg()
+
+static
+ULONG
+Tests_HashTable_PerformanceKeyGenerate(
+    _In_ PERFORMANCE_KEY_SET KeySet,
+    _In_ ULONG KeyIndex,
+    _Out_writes_(HASH_PERFORMANCE_LONG_KEY_SIZE) UCHAR* Key
+    )
+/*++
+
+Routine Description:
+
+    Generate the Key with a given index of a given Key set. PERFORMANCE_KEY_SET_LONG and
+    PERFORMANCE_KEY_SET_SPARSE are hard for hash functions that do not mix all the bits of the Key.
+
+Arguments:
+
+    KeySet - The given Key set.
+    KeyIndex - The given index. Keys of PERFORMANCE_KEY_SET_SPARSE are only distinct for indexes
+               less than (HASH_PERFORMANCE_SPARSE_KEY_SIZE * 4) squared.
+    Key - The generated Key.
+
+Return Value:
+
+    Length of the generated Key in bytes.
+
+--*/
+{
+    ULONG keyLength;
+    ULONG byteIndex;
+    ULONG bitIndex;
+    ULONG key;
+
+    if (PERFORMANCE_KEY_SET_SPREAD == KeySet)
+    {
+        key = KeyIndex * 0x9E3779B1;
+        keyLength = sizeof(key);
+        RtlCopyMemory(Key,
+                      &key,
+                      keyLength);
+    }
+    else if (PERFORMANCE_KEY_SET_LONG == KeySet)
+    {
+        keyLength = HASH_PERFORMANCE_LONG_KEY_SIZE;
+        for (byteIndex = 0; byteIndex < keyLength - sizeof(KeyIndex); byteIndex++)
+        {
+            Key[byteIndex] = (UCHAR)('a' + (byteIndex % 26));
+        }
+        RtlCopyMemory(&Key[keyLength - sizeof(KeyIndex)],
+                      &KeyIndex,
+                      sizeof(KeyIndex));
+    }
+    else
+    {
+        DmfAssert(PERFORMANCE_KEY_SET_SPARSE == KeySet);
+        keyLength = HASH_PERFORMANCE_SPARSE_KEY_SIZE;
+        RtlZeroMemory(Key,
+                      keyLength);
+        bitIndex = KeyIndex % (keyLength * 4);
+        Key[bitIndex / 8] |= (UCHAR)(1 << (bitIndex % 8));
+        bitIndex = (keyLength * 4) + ((KeyIndex / (keyLength * 4)) % (keyLength * 4));
+        Key[bitIndex / 8] |= (UCHAR)(1 << (bitIndex % 8));
+    }
+
+    return keyLength;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_HashTable_PerformanceMeasure(
+    _In_ WDFDEVICE Device,
+    _In_ HashTable_LayoutType Layout,
+    _In_ HashTable_HashFunctionType HashFunction,
+    _In_ ULONG MaximumTableSize,
+    _In_ PERFORMANCE_KEY_SET KeySet,
+    _In_ ULONG KeyCount,
+    _Out_ DMFMODULE* DmfModuleHashTable
+    )
+/*++
+
+Routine Description:
+
+    Create a hash table and measure how long inserting a given number of Keys of a given Key set,
+    looking them up and looking up Keys that are absent take. Trace the times and the distribution
+    of the Keys in the hash map, which shows the quality of the hash function independently of the
+    speed of the machine.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    Layout - Layout of the hash table.
+    HashFunction - Hash function of the hash table.
+    MaximumTableSize - Maximum number of entries of the hash table.
+    KeySet - The Key set.
+    KeyCount - Number of Keys written to the hash table.
+    DmfModuleHashTable - Receives the hash table so that the caller can measure more operations.
+                         The caller deletes it. NULL if this function fails.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_HashTable moduleConfigHashTable;
+    DMFMODULE dmfModuleHashTable;
+    UCHAR key[HASH_PERFORMANCE_LONG_KEY_SIZE];
+    ULONG keyLength;
+    ULONGLONG startTime;
+    ULONGLONG insertMicroseconds;
+    ULONGLONG hitMicroseconds;
+    ULONGLONG missMicroseconds;
+    HashTable_Statistics statistics;
+    ULONG lookupIndex;
+    ULONG keyIndex;
+    ULONG value;
+    ULONG valueSize;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    DmfAssert(KeyCount > 0);
+    DmfAssert(KeyCount <= MaximumTableSize);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleConfigHashTable.MaximumTableSize = MaximumTableSize;
+    moduleConfigHashTable.MaximumValueLength = sizeof(ULONG);
+    // All the Keys of a Key set have the same length.
+    //
+    moduleConfigHashTable.MaximumKeyLength = Tests_HashTable_PerformanceKeyGenerate(KeySet,
+                                                                                    0,
+                                                                                    key);
+    moduleConfigHashTable.Layout = Layout;
+    moduleConfigHashTable.HashFunction = HashFunction;
+    ntStatus = DMF_HashTable_Create(Device,
+                                    &moduleAttributes,
+                                    &objectAttributes,
+                                    &dmfModuleHashTable);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        dmfModuleHashTable = NULL;
+        goto Exit;
+    }
+
+    startTime = TestsUtility_MicrosecondsGet();
+    for (keyIndex = 0; keyIndex < KeyCount; keyIndex++)
+    {
+        keyLength = Tests_HashTable_PerformanceKeyGenerate(KeySet,
+                                                           keyIndex,
+                                                           key);
+        ntStatus = DMF_HashTable_Write(dmfModuleHashTable,
+                                       key,
+                                       keyLength,
+                                       (UCHAR*)&keyIndex,
+                                       sizeof(keyIndex));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+    insertMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    startTime = TestsUtility_MicrosecondsGet();
+    for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+    {
+        keyIndex = lookupIndex % KeyCount;
+        keyLength = Tests_HashTable_PerformanceKeyGenerate(KeySet,
+                                                           keyIndex,
+                                                           key);
+        ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                      key,
+                                      keyLength,
+                                      (UCHAR*)&value,
+                                      sizeof(value),
+                                      &valueSize);
+        if ((!NT_SUCCESS(ntStatus)) ||
+            (value != keyIndex))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+    hitMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    startTime = TestsUtility_MicrosecondsGet();
+    for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+    {
+        keyLength = Tests_HashTable_PerformanceKeyGenerate(KeySet,
+                                                           KeyCount + lookupIndex,
+                                                           key);
+        ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                      key,
+                                      keyLength,
+                                      (UCHAR*)&value,
+                                      sizeof(value),
+                                      &valueSize);
+        if (NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+    missMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    // Every Key is compared at least once by the lookup that finds it.
+    //
+    DMF_HashTable_StatisticsGet(dmfModuleHashTable,
+                                &statistics);
+    DmfAssert(KeyCount == statistics.NumberOfEntries);
+    DmfAssert(statistics.MaximumProbeLength >= 1);
+    DmfAssert(statistics.TotalProbeLength >= KeyCount);
+    DmfAssert(statistics.TotalProbeLength <= (ULONGLONG)KeyCount * statistics.MaximumProbeLength);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "HashTable layout=%d hashFunction=%d keySet=%d entries=%d lookups=%d insert microseconds=%I64d hit microseconds=%I64d miss microseconds=%I64d",
+                Layout,
+                HashFunction,
+                KeySet,
+                KeyCount,
+                PERFORMANCE_LOOKUP_COUNT,
+                (LONGLONG)insertMicroseconds,
+                (LONGLONG)hitMicroseconds,
+                (LONGLONG)missMicroseconds);
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "HashTable layout=%d hashFunction=%d keySet=%d entries=%d hashMapSize=%d maximum probe length=%d average probe length x100=%I64d",
+                Layout,
+                HashFunction,
+                KeySet,
+                KeyCount,
+                statistics.HashMapSize,
+                statistics.MaximumProbeLength,
+                (LONGLONG)((statistics.TotalProbeLength * 100) / KeyCount));
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if ((!NT_SUCCESS(ntStatus)) &&
+        (dmfModuleHashTable != NULL))
+    {
+        WdfObjectDelete(dmfModuleHashTable);
+        dmfModuleHashTable = NULL;
+    }
+
+    *DmfModuleHashTable = dmfModuleHashTable;
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_HashTable_Performance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Measure inserts, lookups of present keys and lookups of absent keys in the chained and open
+    addressing layouts. Each layout is measured with tables filled to a quarter, half, three quarters
+    and all of PERFORMANCE_TABLE_SIZE, so the load factor of the hash map ranges from 1/8 to 1/2.
+    Both layouts must find the same keys.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMFMODULE dmfModuleHashTable;
+    ULONG fillLevel;
+    ULONG fillCount;
+    ULONG layout;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    for (fillLevel = 1; fillLevel <= PERFORMANCE_FILL_LEVELS; fillLevel++)
+    {
+        fillCount = (PERFORMANCE_TABLE_SIZE / PERFORMANCE_FILL_LEVELS) * fillLevel;
+
+        for (layout = 0; layout < HashTable_Layout_Maximum; layout++)
+        {
+            ntStatus = Tests_HashTable_PerformanceMeasure(Device,
+                                                          (HashTable_LayoutType)layout,
+                                                          HashTable_HashFunction_Fnv1a,
+                                                          PERFORMANCE_TABLE_SIZE,
+                                                          PERFORMANCE_KEY_SET_SPREAD,
+                                                          fillCount,
+                                                          &dmfModuleHashTable);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+
+            WdfObjectDelete(dmfModuleHashTable);
+        }
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_HashTable_HashPerformance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Measure the built-in hash functions. The same Keys are written to open addressing hash
+    tables that use each hash function, then looked up. Lookups that succeed measure the cost
+    of hashing long Keys. The probe lengths of the Keys measure how well each hash function
+    distributes them.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMFMODULE dmfModuleHashTable;
+    UCHAR key[HASH_PERFORMANCE_LONG_KEY_SIZE];
+    ULONG keyLength;
+    ULONGLONG startTime;
+    ULONGLONG repeatMicroseconds;
+    ULONGLONG repeatWithHashMicroseconds;
+    HASHTABLE_KEY_HASH keyHash;
+    ULONG lookupIndex;
+    ULONG keySet;
+    ULONG hashFunction;
+    ULONG keyIndex;
+    ULONG value;
+    ULONG valueSize;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    dmfModuleHashTable = NULL;
+    ntStatus = STATUS_SUCCESS;
+
+    for (keySet = PERFORMANCE_KEY_SET_LONG; keySet < PERFORMANCE_KEY_SET_COUNT; keySet++)
+    {
+        for (hashFunction = 0; hashFunction < HashTable_HashFunction_Maximum; hashFunction++)
+        {
+            ntStatus = Tests_HashTable_PerformanceMeasure(Device,
+                                                          HashTable_Layout_OpenAddressing,
+                                                          (HashTable_HashFunctionType)hashFunction,
+                                                          HASH_PERFORMANCE_KEY_COUNT,
+                                                          (PERFORMANCE_KEY_SET)keySet,
+                                                          HASH_PERFORMANCE_KEY_COUNT,
+                                                          &dmfModuleHashTable);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+
+            // Look up the same Key many times, as BranchTrack does. Compare calculating its hash
+            // every time with calculating it once.
+            //
+            keyIndex = 0;
+            keyLength = Tests_HashTable_PerformanceKeyGenerate((PERFORMANCE_KEY_SET)keySet,
+                                                               keyIndex,
+                                                               key);
+            startTime = TestsUtility_MicrosecondsGet();
+            for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+            {
+                ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                              key,
+                                              keyLength,
+                                              (UCHAR*)&value,
+                                              sizeof(value),
+                                              &valueSize);
+                if ((!NT_SUCCESS(ntStatus)) ||
+                    (value != keyIndex))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+            }
+            repeatMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+            startTime = TestsUtility_MicrosecondsGet();
+            DMF_HashTable_HashCompute(dmfModuleHashTable,
+                                      key,
+                                      keyLength,
+                                      &keyHash);
+            for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+            {
+                ntStatus = DMF_HashTable_ReadWithHash(dmfModuleHashTable,
+                                                      key,
+                                                      keyLength,
+                                                      &keyHash,
+                                                      (UCHAR*)&value,
+                                                      sizeof(value),
+                                                      &valueSize);
+                if ((!NT_SUCCESS(ntStatus)) ||
+                    (value != keyIndex))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+            }
+            repeatWithHashMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+            ntStatus = STATUS_SUCCESS;
+
+            TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                        "HashTable hashFunction=%d keySet=%d lookups=%d repeat microseconds=%I64d repeat with hash microseconds=%I64d",
+                        hashFunction,
+                        keySet,
+                        PERFORMANCE_LOOKUP_COUNT,
+                        (LONGLONG)repeatMicroseconds,
+                        (LONGLONG)repeatWithHashMicroseconds);
+
+            WdfObjectDelete(dmfModuleHashTable);
+            dmfModuleHashTable = NULL;
+        }
+    }
+
+Exit:
+
+    if (dmfModuleHashTable != NULL)
+    {
+        WdfObjectDelete(dmfModuleHashTable);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_DMF_Thread_Function)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -490,12 +1215,44 @@ Tests_HashTable_WorkThread(
     DMFMODULE dmfModule;
     DMF_CONTEXT_Tests_HashTable* moduleContext;
     TEST_ACTION testAction;
+    ULONG threadIndex;
+    NTSTATUS ntStatus;
 
     PAGED_CODE();
 
     dmfModule = DMF_ParentModuleGet(DmfModuleThread);
     moduleContext = DMF_CONTEXT_GET(dmfModule);
 
+    for (threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        if (moduleContext->DmfModuleThread[threadIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(threadIndex < THREAD_COUNT);
+
+    // Only the first thread measures performance so that the other thread does not
+    // slow it down by doing the same.
+    //
+    if ((0 == threadIndex) &&
+        (! moduleContext->PerformanceMeasured))
+    {
+        moduleContext->PerformanceMeasured = TRUE;
+        ntStatus = Tests_HashTable_Performance(dmfModule,
+                                               DMF_ParentDeviceGet(dmfModule));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        ntStatus = Tests_HashTable_HashPerformance(dmfModule,
+                                                   DMF_ParentDeviceGet(dmfModule));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
     // Generate a random test action Id for a current iteration.
     //
     testAction = (TEST_ACTION)TestsUtility_GenerateRandomNumber(TEST_ACTION_MINIMUM,
@@ -513,11 +1270,167 @@ Tests_HashTable_WorkThread(
         case TEST_ACTION_ENUMERATE:
             Tests_HashTable_ThreadAction_Enumerate(dmfModule);
             break;
+        case TEST_ACTION_GROWTH:
+            Tests_HashTable_ThreadAction_Growth(dmfModule,
+                                                threadIndex);
+            break;
+        case TEST_ACTION_PRECOMPUTEDHASH:
+            Tests_HashTable_ThreadAction_PrecomputedHash(dmfModule);
+            break;
         default:
             DmfAssert(FALSE);
             break;
     }
 
+Exit:
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+_Function_class_(EVT_DMF_HashTable_Find)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_HashTable_ConcurrencyFind(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _Inout_updates_to_(*ValueLength, *ValueLength) UCHAR* Value,
+    _Inout_ ULONG* ValueLength
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(Key);
+    UNREFERENCED_PARAMETER(KeyLength);
+
+    // Other threads may update the same Value at the same time.
+    //
+    DmfAssert(sizeof(LONG) == *ValueLength);
+    InterlockedIncrement((LONG volatile*)Value);
+}
+
+_Function_class_(EVT_DMF_HashTable_Enumerate)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_HashTable_ConcurrencySum(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength,
+    _In_ VOID* CallbackContext
+    )
+{
+    LONGLONG* sum;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(Key);
+    UNREFERENCED_PARAMETER(KeyLength);
+
+    DmfAssert(sizeof(LONG) == ValueLength);
+
+    sum = (LONGLONG*)CallbackContext;
+    *sum += *((LONG*)Value);
+
+    return TRUE;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_HashTable_ConcurrencyMeasure(
+    _In_ DMF_CONTEXT_Tests_HashTable* ModuleContext,
+    _In_ ULONG TableIndex
+    )
+/*++
+
+Routine Description:
+
+    Repeatedly look up Keys that are in a table while other threads do the same.
+    Each lookup increments the Value of its Key. Accumulate the number of lookups and
+    the time it took to perform them.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    TableIndex - Indicates which table to use.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModuleHashTable;
+    ULONGLONG key;
+    ULONG iteration;
+    ULONGLONG startTime;
+    ULONGLONG endTime;
+    NTSTATUS ntStatus;
+
+    dmfModuleHashTable = ModuleContext->DmfModuleHashTableConcurrency[TableIndex];
+
+    startTime = TestsUtility_MicrosecondsGet();
+
+    // Each thread starts at a different Key, so threads look up both the same and different Keys at the same time.
+    //
+    key = startTime % CONCURRENCY_KEY_COUNT;
+    for (iteration = 0; iteration < CONCURRENCY_ITERATIONS; iteration++)
+    {
+        ntStatus = DMF_HashTable_Find(dmfModuleHashTable,
+                                      (UCHAR*)&key,
+                                      sizeof(key),
+                                      Tests_HashTable_ConcurrencyFind);
+        DmfAssert(NT_SUCCESS(ntStatus));
+
+        key = (key + 1) % CONCURRENCY_KEY_COUNT;
+    }
+
+    endTime = TestsUtility_MicrosecondsGet();
+
+    InterlockedAdd64(&ModuleContext->ConcurrencyOperations[TableIndex],
+                     CONCURRENCY_ITERATIONS);
+    InterlockedAdd64(&ModuleContext->ConcurrencyMicroseconds[TableIndex],
+                     (LONGLONG)(endTime - startTime));
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_HashTable_ConcurrencyThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_HashTable* moduleContext;
+    ULONG tableIndex;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Measure all the tables under the same load so that the results are comparable.
+    //
+    for (tableIndex = 0; tableIndex < CONCURRENCY_TABLE_COUNT; tableIndex++)
+    {
+        Tests_HashTable_ConcurrencyMeasure(moduleContext,
+                                           tableIndex);
+    }
+
     // Repeat the test, until stop is signaled.
     //
     if (!DMF_Thread_IsStopPending(DmfModuleThread))
@@ -588,6 +1501,27 @@ Return Value:
     Tests_HashTable_Populate(DmfModule,
                              moduleContext->DmfModuleHashTableCustom);
 
+    // Write the Keys looked up by the concurrency test threads. Each Value counts the lookups of its Key.
+    //
+    for (index = 0; index < CONCURRENCY_TABLE_COUNT; index++)
+    {
+        for (ULONGLONG key = 0; key < CONCURRENCY_KEY_COUNT; key++)
+        {
+            LONG lookupCount = 0;
+
+            ntStatus = DMF_HashTable_Write(moduleContext->DmfModuleHashTableConcurrency[index],
+                                           (UCHAR*)&key,
+                                           sizeof(key),
+                                           (UCHAR*)&lookupCount,
+                                           sizeof(lookupCount));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_HashTable_Write fails: ntStatus=%!STATUS!", ntStatus);
+                goto Exit;
+            }
+        }
+    }
+
     // Create threads that read with expected success, read with expected failure
     // and enumerate.
     //
@@ -601,11 +1535,26 @@ Return Value:
         }
     }
 
+    for (index = 0; index < CONCURRENCY_THREAD_COUNT; index++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadConcurrency[index]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
     for (index = 0; index < THREAD_COUNT; index++)
     {
         DMF_Thread_WorkReady(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < CONCURRENCY_THREAD_COUNT; index++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadConcurrency[index]);
+    }
+
 Exit:
     
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
@@ -640,6 +1589,7 @@ Return Value:
 {
     DMF_CONTEXT_Tests_HashTable* moduleContext;
     LONG index;
+    LONGLONG lookupCount;
 
     PAGED_CODE();
 
@@ -652,6 +1602,29 @@ Return Value:
         DMF_Thread_Stop(moduleContext->DmfModuleThread[index]);
     }
 
+    for (index = 0; index < CONCURRENCY_THREAD_COUNT; index++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadConcurrency[index]);
+    }
+
+    // Report the throughput of each table. No lookup may have been lost.
+    //
+    for (index = 0; index < CONCURRENCY_TABLE_COUNT; index++)
+    {
+        lookupCount = 0;
+        DMF_HashTable_Enumerate(moduleContext->DmfModuleHashTableConcurrency[index],
+                                Tests_HashTable_ConcurrencySum,
+                                &lookupCount);
+        DmfAssert(lookupCount == moduleContext->ConcurrencyOperations[index]);
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Concurrency table=%d operations=%I64d microseconds=%I64d operationsPerMillisecond=%I64d",
+                    index,
+                    moduleContext->ConcurrencyOperations[index],
+                    moduleContext->ConcurrencyMicroseconds[index],
+                    (moduleContext->ConcurrencyMicroseconds[index] > 0) ?
+                        (moduleContext->ConcurrencyOperations[index] * 1000) / moduleContext->ConcurrencyMicroseconds[index] : 0);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -726,6 +1699,26 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleHashTableCustom);
 
+    // HashTable (Growing, one for each layout)
+    // ----------------------------------------
+    //
+    for (ULONG tableIndex = 0; tableIndex < GROWTH_TABLE_COUNT; tableIndex++)
+    {
+        DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                                 &moduleAttributes);
+        moduleAttributes.ClientModuleInstanceName = "HastTable.Growing";
+        moduleConfigHashTable.MaximumTableSize = BUFFER_COUNT_MAXIMUM;
+        moduleConfigHashTable.InitialTableSize = GROWTH_INITIAL_TABLE_SIZE;
+        moduleConfigHashTable.MaximumValueLength = BUFFER_SIZE;
+        moduleConfigHashTable.MaximumKeyLength = KEY_SIZE;
+        moduleConfigHashTable.Layout = (HashTable_LayoutType)tableIndex;
+        moduleConfigHashTable.EvtHashTableHashCalculate = NULL;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleHashTableGrowing[tableIndex]);
+    }
+
     // Thread
     // ------
     //
@@ -741,6 +1734,39 @@ Return Value:
                          &moduleContext->DmfModuleThread[threadIndex]);
     }
 
+    // HashTable (Concurrency, one for each concurrency mode)
+    // ------------------------------------------------------
+    //
+    for (ULONG tableIndex = 0; tableIndex < CONCURRENCY_TABLE_COUNT; tableIndex++)
+    {
+        DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                                 &moduleAttributes);
+        moduleAttributes.ClientModuleInstanceName = "HastTable.Concurrency";
+        moduleConfigHashTable.MaximumTableSize = CONCURRENCY_KEY_COUNT;
+        moduleConfigHashTable.MaximumValueLength = sizeof(LONG);
+        moduleConfigHashTable.MaximumKeyLength = sizeof(ULONGLONG);
+        moduleConfigHashTable.Concurrency = (HashTable_ConcurrencyType)tableIndex;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleHashTableConcurrency[tableIndex]);
+    }
+
+    // Thread (Concurrency)
+    // --------------------
+    //
+    for (ULONG threadIndex = 0; threadIndex < CONCURRENCY_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_HashTable_ConcurrencyThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadConcurrency[threadIndex]);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -0,0 +1,1174 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_LruCache.c
+
+Abstract:
+
+    Functional and performance tests for Dmf_LruCache Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_Tests_LruCache.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of threads that use the shared cache at the same time.
+//
+#define THREAD_COUNT                        (2)
+
+// Number of different Keys the threads use. It is larger than the cache so that entries are evicted.
+//
+#define KEY_COUNT                           (256)
+
+// Capacity of the shared cache.
+//
+#define CACHE_ENTRY_COUNT                   (64)
+#define CACHE_TOTAL_BYTES                   (CACHE_ENTRY_COUNT * 16)
+
+// Maximum length of the Values.
+//
+#define VALUE_LENGTH_MAXIMUM                (32)
+
+// Time to live of the entries that expire.
+//
+#define TIME_TO_LIVE_MILLISECONDS           (20)
+
+// Capacity of the cache used to verify the order of eviction.
+//
+#define ORDER_ENTRY_COUNT                   (8)
+
+// Capacity of the cache used to measure performance and the number of lookups measured.
+//
+#define PERFORMANCE_ENTRY_COUNT             (4096)
+#define PERFORMANCE_LOOKUP_COUNT            (100000)
+
+// Capacities of the caches that are kept full while entries are added, and the number of times
+// all the entries of each cache are replaced.
+//
+#define FULL_CACHE_COUNT                    (4)
+#define FULL_CYCLE_COUNT                    (16)
+
+typedef enum _TEST_ACTION
+{
+    TEST_ACTION_GET,
+    TEST_ACTION_PUT,
+    TEST_ACTION_REMOVE,
+    TEST_ACTION_STATISTICS,
+    TEST_ACTION_COUNT,
+    TEST_ACTION_MINIMUM     = TEST_ACTION_GET,
+    TEST_ACTION_MAXIMUM     = TEST_ACTION_STATISTICS
+} TEST_ACTION;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // LruCache Module that all the threads use.
+    //
+    DMFMODULE DmfModuleLruCache;
+    // LruCache Module used to verify the order of eviction. Only one thread uses it.
+    //
+    DMFMODULE DmfModuleLruCacheOrder;
+    // Keys evicted from DmfModuleLruCacheOrder, in order, and the reason of each eviction.
+    //
+    ULONG OrderEvictedKeys[ORDER_ENTRY_COUNT];
+    LruCache_EvictionReasonType OrderEvictionReasons[ORDER_ENTRY_COUNT];
+    ULONG OrderEvictionCount;
+    // Indicates that the order of eviction and full caches have been verified and performance has been measured.
+    //
+    BOOLEAN OrderAndPerformanceTested;
+    // Work threads that perform actions on the shared LruCache Module.
+    //
+    DMFMODULE DmfModuleThread[THREAD_COUNT];
+} DMF_CONTEXT_Tests_LruCache;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_LruCache)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_LruCache)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+Tests_LruCache_ValueGenerate(
+    _In_ ULONG Key,
+    _Out_writes_(VALUE_LENGTH_MAXIMUM) UCHAR* Value
+    )
+/*++
+
+Routine Description:
+
+    Generate the Value of a given Key. Every Key always has the same Value, so that any
+    thread can verify a Value written by another thread.
+
+Arguments:
+
+    Key - The given Key.
+    Value - Where the Value is written.
+
+Return Value:
+
+    Length of the Value.
+
+--*/
+{
+    ULONG valueLength;
+
+    valueLength = 1 + (Key % VALUE_LENGTH_MAXIMUM);
+    for (ULONG byteIndex = 0; byteIndex < valueLength; byteIndex++)
+    {
+        Value[byteIndex] = (UCHAR)((Key * 7) + byteIndex);
+    }
+
+    return valueLength;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_LruCache_ValueVerify(
+    _In_ ULONG Key,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength
+    )
+/*++
+
+Routine Description:
+
+    Verify that a given Value is the Value of a given Key.
+
+Arguments:
+
+    Key - The given Key.
+    Value - The given Value.
+    ValueLength - Length of the given Value.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UCHAR expectedValue[VALUE_LENGTH_MAXIMUM];
+    ULONG expectedValueLength;
+
+    expectedValueLength = Tests_LruCache_ValueGenerate(Key,
+                                                       expectedValue);
+    DmfAssert(ValueLength == expectedValueLength);
+    DmfAssert(RtlCompareMemory(Value,
+                               expectedValue,
+                               expectedValueLength) == expectedValueLength);
+}
+
+_Function_class_(EVT_DMF_LruCache_Evict)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_LruCache_Evict(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength,
+    _In_ LruCache_EvictionReasonType EvictionReason
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(sizeof(ULONG) == KeyLength);
+    DmfAssert(EvictionReason < LruCache_EvictionReason_Maximum);
+    Tests_LruCache_ValueVerify(*(ULONG*)Key,
+                               Value,
+                               ValueLength);
+}
+
+_Function_class_(EVT_DMF_LruCache_Evict)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_LruCache_OrderEvict(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(KeyLength) UCHAR* Key,
+    _In_ ULONG KeyLength,
+    _In_reads_(ValueLength) UCHAR* Value,
+    _In_ ULONG ValueLength,
+    _In_ LruCache_EvictionReasonType EvictionReason
+    )
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+
+    UNREFERENCED_PARAMETER(Value);
+    UNREFERENCED_PARAMETER(ValueLength);
+
+    moduleContext = DMF_CONTEXT_GET(DMF_ParentModuleGet(DmfModule));
+
+    DmfAssert(sizeof(ULONG) == KeyLength);
+    if (moduleContext->OrderEvictionCount < ORDER_ENTRY_COUNT)
+    {
+        moduleContext->OrderEvictedKeys[moduleContext->OrderEvictionCount] = *(ULONG*)Key;
+        moduleContext->OrderEvictionReasons[moduleContext->OrderEvictionCount] = EvictionReason;
+    }
+    moduleContext->OrderEvictionCount++;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_LruCache_Order(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Verify that the least recently used entry is evicted, that Get makes an entry the most
+    recently used entry and that entries expire after their time to live.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    DMFMODULE dmfModuleLruCache;
+    UCHAR value[VALUE_LENGTH_MAXIMUM];
+    ULONG valueLength;
+    ULONG key;
+    LruCache_Statistics statistics;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    dmfModuleLruCache = moduleContext->DmfModuleLruCacheOrder;
+
+    DMF_LruCache_Flush(dmfModuleLruCache);
+    moduleContext->OrderEvictionCount = 0;
+
+    // Fill the cache. Keys are used in order 0, 1, ...
+    //
+    for (key = 0; key < ORDER_ENTRY_COUNT; key++)
+    {
+        valueLength = Tests_LruCache_ValueGenerate(key,
+                                                   value);
+        ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    value,
+                                    valueLength,
+                                    LRUCACHE_TIME_TO_LIVE_DEFAULT);
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    DmfAssert(0 == moduleContext->OrderEvictionCount);
+
+    // Key 0 becomes the most recently used entry, so Key 1 is the least recently used entry.
+    //
+    key = 0;
+    ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                sizeof(value),
+                                &valueLength);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    Tests_LruCache_ValueVerify(key,
+                               value,
+                               valueLength);
+
+    key = ORDER_ENTRY_COUNT;
+    valueLength = Tests_LruCache_ValueGenerate(key,
+                                               value);
+    ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                valueLength,
+                                LRUCACHE_TIME_TO_LIVE_DEFAULT);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(1 == moduleContext->OrderEvictionCount);
+    DmfAssert(1 == moduleContext->OrderEvictedKeys[0]);
+    DmfAssert(LruCache_EvictionReason_Capacity == moduleContext->OrderEvictionReasons[0]);
+
+    key = 1;
+    ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                sizeof(value),
+                                &valueLength);
+    DmfAssert(STATUS_NOT_FOUND == ntStatus);
+
+    // Writing an existing Key replaces its Value and does not evict another entry.
+    //
+    key = 2;
+    valueLength = Tests_LruCache_ValueGenerate(key,
+                                               value);
+    ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                valueLength,
+                                TIME_TO_LIVE_MILLISECONDS);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(2 == moduleContext->OrderEvictionCount);
+    DmfAssert(2 == moduleContext->OrderEvictedKeys[1]);
+    DmfAssert(LruCache_EvictionReason_Replaced == moduleContext->OrderEvictionReasons[1]);
+
+    // Key 2 now expires.
+    //
+    DMF_Utility_DelayMilliseconds(TIME_TO_LIVE_MILLISECONDS * 2);
+    ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                sizeof(value),
+                                &valueLength);
+    DmfAssert(STATUS_NOT_FOUND == ntStatus);
+    DmfAssert(3 == moduleContext->OrderEvictionCount);
+    DmfAssert(2 == moduleContext->OrderEvictedKeys[2]);
+    DmfAssert(LruCache_EvictionReason_Expired == moduleContext->OrderEvictionReasons[2]);
+
+    DMF_LruCache_StatisticsGet(dmfModuleLruCache,
+                               &statistics);
+    DmfAssert(ORDER_ENTRY_COUNT - 1 == statistics.NumberOfEntries);
+
+    DMF_LruCache_Flush(dmfModuleLruCache);
+    DmfAssert(3 + ORDER_ENTRY_COUNT - 1 == moduleContext->OrderEvictionCount);
+
+    DMF_LruCache_StatisticsGet(dmfModuleLruCache,
+                               &statistics);
+    DmfAssert(0 == statistics.NumberOfEntries);
+    DmfAssert(0 == statistics.NumberOfBytes);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_LruCache_Performance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Measure how long inserts into a cache that has space, lookups of present Keys, lookups of
+    absent Keys and inserts that evict the least recently used entry take.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_LruCache moduleConfigLruCache;
+    DMFMODULE dmfModuleLruCache;
+    ULONGLONG startTime;
+    ULONGLONG insertMicroseconds;
+    ULONGLONG hitMicroseconds;
+    ULONGLONG missMicroseconds;
+    ULONGLONG evictMicroseconds;
+    ULONG itemIndex;
+    ULONG lookupIndex;
+    ULONG key;
+    ULONG value;
+    ULONG valueSize;
+    LruCache_Statistics statistics;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_LruCache_AND_ATTRIBUTES_INIT(&moduleConfigLruCache,
+                                            &moduleAttributes);
+    moduleConfigLruCache.MaximumEntryCount = PERFORMANCE_ENTRY_COUNT;
+    moduleConfigLruCache.MaximumKeyLength = sizeof(ULONG);
+    moduleConfigLruCache.MaximumValueLength = sizeof(ULONG);
+    ntStatus = DMF_LruCache_Create(Device,
+                                   &moduleAttributes,
+                                   &objectAttributes,
+                                   &dmfModuleLruCache);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        dmfModuleLruCache = NULL;
+        goto Exit;
+    }
+
+    // Keys are spread over the range of ULONG so that they are not consecutive.
+    //
+    startTime = TestsUtility_MicrosecondsGet();
+    for (itemIndex = 0; itemIndex < PERFORMANCE_ENTRY_COUNT; itemIndex++)
+    {
+        key = itemIndex * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&itemIndex,
+                                    sizeof(itemIndex),
+                                    LRUCACHE_TIME_TO_LIVE_DEFAULT);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+    insertMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    startTime = TestsUtility_MicrosecondsGet();
+    for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+    {
+        itemIndex = lookupIndex % PERFORMANCE_ENTRY_COUNT;
+        key = itemIndex * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    &valueSize);
+        if ((!NT_SUCCESS(ntStatus)) ||
+            (value != itemIndex))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+    hitMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    startTime = TestsUtility_MicrosecondsGet();
+    for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+    {
+        key = (PERFORMANCE_ENTRY_COUNT + lookupIndex) * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    &valueSize);
+        if (NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+    }
+    missMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    // The cache is full, so each of these inserts evicts an entry.
+    //
+    startTime = TestsUtility_MicrosecondsGet();
+    for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+    {
+        key = (PERFORMANCE_ENTRY_COUNT + lookupIndex) * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&lookupIndex,
+                                    sizeof(lookupIndex),
+                                    LRUCACHE_TIME_TO_LIVE_DEFAULT);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+    }
+    evictMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+    ntStatus = STATUS_SUCCESS;
+
+    DMF_LruCache_StatisticsGet(dmfModuleLruCache,
+                               &statistics);
+    DmfAssert(PERFORMANCE_LOOKUP_COUNT == statistics.NumberOfHits);
+    DmfAssert(PERFORMANCE_LOOKUP_COUNT == statistics.NumberOfMisses);
+    DmfAssert(PERFORMANCE_LOOKUP_COUNT == statistics.NumberOfEvictions);
+    DmfAssert(PERFORMANCE_ENTRY_COUNT == statistics.NumberOfEntries);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "LruCache entries=%d operations=%d insert microseconds=%I64d hit microseconds=%I64d miss microseconds=%I64d evicting insert microseconds=%I64d",
+                PERFORMANCE_ENTRY_COUNT,
+                PERFORMANCE_LOOKUP_COUNT,
+                (LONGLONG)insertMicroseconds,
+                (LONGLONG)hitMicroseconds,
+                (LONGLONG)missMicroseconds,
+                (LONGLONG)evictMicroseconds);
+
+Exit:
+
+    if (dmfModuleLruCache != NULL)
+    {
+        WdfObjectDelete(dmfModuleLruCache);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_LruCache_Full(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG MaximumEntryCount
+    )
+/*++
+
+Routine Description:
+
+    Fill a cache to its capacity and keep adding Keys so that each insert evicts the least
+    recently used entry. Verify every eviction and that the entries that remain are found.
+    The child HashTable stays full for the whole test, so this also exercises it at its
+    maximum number of entries.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    MaximumEntryCount - Capacity of the cache.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_LruCache moduleConfigLruCache;
+    DMFMODULE dmfModuleLruCache;
+    ULONG itemIndex;
+    ULONG itemCount;
+    ULONG checkIndex;
+    ULONG key;
+    ULONG value;
+    ULONG valueSize;
+    LruCache_Statistics statistics;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_LruCache_AND_ATTRIBUTES_INIT(&moduleConfigLruCache,
+                                            &moduleAttributes);
+    moduleConfigLruCache.MaximumEntryCount = MaximumEntryCount;
+    moduleConfigLruCache.MaximumKeyLength = sizeof(ULONG);
+    moduleConfigLruCache.MaximumValueLength = sizeof(ULONG);
+    ntStatus = DMF_LruCache_Create(Device,
+                                   &moduleAttributes,
+                                   &objectAttributes,
+                                   &dmfModuleLruCache);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        dmfModuleLruCache = NULL;
+        goto Exit;
+    }
+
+    itemCount = MaximumEntryCount * FULL_CYCLE_COUNT;
+    for (itemIndex = 0; itemIndex < itemCount; itemIndex++)
+    {
+        key = itemIndex * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Put(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&itemIndex,
+                                    sizeof(itemIndex),
+                                    LRUCACHE_TIME_TO_LIVE_DEFAULT);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            DmfAssert(FALSE);
+            goto Exit;
+        }
+
+        DMF_LruCache_StatisticsGet(dmfModuleLruCache,
+                                   &statistics);
+        if (itemIndex < MaximumEntryCount)
+        {
+            DmfAssert(itemIndex + 1 == statistics.NumberOfEntries);
+            DmfAssert(0 == statistics.NumberOfEvictions);
+            continue;
+        }
+
+        // The cache is full. The Key added MaximumEntryCount Puts ago was evicted.
+        // Looking it up does not change the order of the other entries.
+        //
+        DmfAssert(MaximumEntryCount == statistics.NumberOfEntries);
+        DmfAssert(itemIndex + 1 - MaximumEntryCount == statistics.NumberOfEvictions);
+        key = (itemIndex - MaximumEntryCount) * 0x9E3779B1;
+        ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                    (UCHAR*)&key,
+                                    sizeof(key),
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    &valueSize);
+        if (STATUS_NOT_FOUND != ntStatus)
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+
+        // Once per cycle, all the remaining entries are found. They are read from the least
+        // to the most recently used so that their order does not change.
+        //
+        if (0 == (itemIndex + 1) % MaximumEntryCount)
+        {
+            for (checkIndex = itemIndex + 1 - MaximumEntryCount; checkIndex <= itemIndex; checkIndex++)
+            {
+                key = checkIndex * 0x9E3779B1;
+                ntStatus = DMF_LruCache_Get(dmfModuleLruCache,
+                                            (UCHAR*)&key,
+                                            sizeof(key),
+                                            (UCHAR*)&value,
+                                            sizeof(value),
+                                            &valueSize);
+                if ((!NT_SUCCESS(ntStatus)) ||
+                    (value != checkIndex))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+            }
+        }
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleLruCache != NULL)
+    {
+        WdfObjectDelete(dmfModuleLruCache);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_LruCache_ThreadAction_Get(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    UCHAR value[VALUE_LENGTH_MAXIMUM];
+    ULONG valueLength;
+    ULONG key;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    key = TestsUtility_GenerateRandomNumber(0,
+                                            KEY_COUNT - 1);
+    ntStatus = DMF_LruCache_Get(moduleContext->DmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                sizeof(value),
+                                &valueLength);
+    // Other threads add and evict the same Keys, so the Key may or may not be found.
+    //
+    DmfAssert(NT_SUCCESS(ntStatus) || (STATUS_NOT_FOUND == ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        Tests_LruCache_ValueVerify(key,
+                                   value,
+                                   valueLength);
+    }
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_LruCache_ThreadAction_Put(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    UCHAR value[VALUE_LENGTH_MAXIMUM];
+    ULONG valueLength;
+    ULONG key;
+    ULONG timeToLiveMilliseconds;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    key = TestsUtility_GenerateRandomNumber(0,
+                                            KEY_COUNT - 1);
+    valueLength = Tests_LruCache_ValueGenerate(key,
+                                               value);
+
+    // Some entries expire. The others use the default time to live (never).
+    //
+    timeToLiveMilliseconds = LRUCACHE_TIME_TO_LIVE_DEFAULT;
+    if (0 == TestsUtility_GenerateRandomNumber(0, 3))
+    {
+        timeToLiveMilliseconds = TIME_TO_LIVE_MILLISECONDS;
+    }
+
+    ntStatus = DMF_LruCache_Put(moduleContext->DmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                valueLength,
+                                timeToLiveMilliseconds);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    // Too small a buffer returns the length of the Value.
+    //
+    ntStatus = DMF_LruCache_Get(moduleContext->DmfModuleLruCache,
+                                (UCHAR*)&key,
+                                sizeof(key),
+                                value,
+                                0,
+                                &valueLength);
+    DmfAssert((STATUS_BUFFER_TOO_SMALL == ntStatus) || (STATUS_NOT_FOUND == ntStatus));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_LruCache_ThreadAction_Remove(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    ULONG key;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    key = TestsUtility_GenerateRandomNumber(0,
+                                            KEY_COUNT - 1);
+    ntStatus = DMF_LruCache_Remove(moduleContext->DmfModuleLruCache,
+                                   (UCHAR*)&key,
+                                   sizeof(key));
+    DmfAssert(NT_SUCCESS(ntStatus) || (STATUS_NOT_FOUND == ntStatus));
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_LruCache_ThreadAction_Statistics(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    LruCache_Statistics statistics;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_LruCache_StatisticsGet(moduleContext->DmfModuleLruCache,
+                               &statistics);
+    DmfAssert(statistics.NumberOfEntries <= CACHE_ENTRY_COUNT);
+    DmfAssert(statistics.NumberOfBytes <= CACHE_TOTAL_BYTES);
+    DmfAssert(statistics.NumberOfBytes >= statistics.NumberOfEntries * (sizeof(ULONG) + 1));
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_LruCache_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    TEST_ACTION testAction;
+    NTSTATUS ntStatus;
+    static ULONG fullCacheEntryCounts[FULL_CACHE_COUNT] = { 1, 2, ORDER_ENTRY_COUNT, PERFORMANCE_ENTRY_COUNT };
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Only the first thread verifies the order of eviction and measures performance.
+    //
+    if ((moduleContext->DmfModuleThread[0] == DmfModuleThread) &&
+        (! moduleContext->OrderAndPerformanceTested))
+    {
+        moduleContext->OrderAndPerformanceTested = TRUE;
+        Tests_LruCache_Order(dmfModule);
+        for (ULONG cacheIndex = 0; cacheIndex < FULL_CACHE_COUNT; cacheIndex++)
+        {
+            ntStatus = Tests_LruCache_Full(DMF_ParentDeviceGet(dmfModule),
+                                           fullCacheEntryCounts[cacheIndex]);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                goto Exit;
+            }
+        }
+        ntStatus = Tests_LruCache_Performance(dmfModule,
+                                              DMF_ParentDeviceGet(dmfModule));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    // Generate a random test action Id for a current iteration.
+    //
+    testAction = (TEST_ACTION)TestsUtility_GenerateRandomNumber(TEST_ACTION_MINIMUM,
+                                                                TEST_ACTION_MAXIMUM);
+    // Execute the test action.
+    //
+    switch (testAction)
+    {
+        case TEST_ACTION_GET:
+            Tests_LruCache_ThreadAction_Get(dmfModule);
+            break;
+        case TEST_ACTION_PUT:
+            Tests_LruCache_ThreadAction_Put(dmfModule);
+            break;
+        case TEST_ACTION_REMOVE:
+            Tests_LruCache_ThreadAction_Remove(dmfModule);
+            break;
+        case TEST_ACTION_STATISTICS:
+            Tests_LruCache_ThreadAction_Statistics(dmfModule);
+            break;
+        default:
+            DmfAssert(FALSE);
+            break;
+    }
+
+Exit:
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_LruCache_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_LruCache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread[threadIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_LruCache_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_LruCache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_LruCache_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_LruCache* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+    DMF_CONFIG_LruCache moduleConfigLruCache;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // LruCache (shared by the threads)
+    // --------------------------------
+    //
+    DMF_CONFIG_LruCache_AND_ATTRIBUTES_INIT(&moduleConfigLruCache,
+                                            &moduleAttributes);
+    moduleConfigLruCache.MaximumEntryCount = CACHE_ENTRY_COUNT;
+    moduleConfigLruCache.MaximumTotalBytes = CACHE_TOTAL_BYTES;
+    moduleConfigLruCache.MaximumKeyLength = sizeof(ULONG);
+    moduleConfigLruCache.MaximumValueLength = VALUE_LENGTH_MAXIMUM;
+    moduleConfigLruCache.EvtLruCacheEvict = Tests_LruCache_Evict;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleLruCache);
+
+    // LruCache (eviction order)
+    // -------------------------
+    //
+    DMF_CONFIG_LruCache_AND_ATTRIBUTES_INIT(&moduleConfigLruCache,
+                                            &moduleAttributes);
+    moduleConfigLruCache.MaximumEntryCount = ORDER_ENTRY_COUNT;
+    moduleConfigLruCache.MaximumKeyLength = sizeof(ULONG);
+    moduleConfigLruCache.MaximumValueLength = VALUE_LENGTH_MAXIMUM;
+    moduleConfigLruCache.EvtLruCacheEvict = Tests_LruCache_OrderEvict;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleLruCacheOrder);
+
+    // Threads
+    // -------
+    //
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_LruCache_WorkThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_LruCache_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_LruCache.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_LruCache;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_LruCache;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_LruCache);
+    dmfCallbacksDmf_Tests_LruCache.ChildModulesAdd = DMF_Tests_LruCache_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_LruCache.DeviceOpen = Tests_LruCache_Open;
+    dmfCallbacksDmf_Tests_LruCache.DeviceClose = Tests_LruCache_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_LruCache,
+                                            Tests_LruCache,
+                                            DMF_CONTEXT_Tests_LruCache,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_LruCache.CallbacksDmf = &dmfCallbacksDmf_Tests_LruCache;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_LruCache,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_LruCache.c
+//
@@ -35,6 +35,21 @@ Environment:
 #define SAMPLE_BUFFER_SIZE          (64)
 #define PINGPONG_BUFFER_SIZE        (64)
 
+// Parse throughput is measured by writing PERFORMANCE_BYTE_COUNT bytes in chunks of
+// PERFORMANCE_CHUNK_SIZE and parsing them in records of PERFORMANCE_RECORD_SIZE_MINIMUM bytes,
+// then 4 times as many bytes, and so on until PERFORMANCE_RECORD_SIZE_MAXIMUM.
+//
+#define PERFORMANCE_BUFFER_SIZE             (4096)
+#define PERFORMANCE_CHUNK_SIZE              (1024)
+#define PERFORMANCE_BYTE_COUNT              (16 * 1024 * 1024)
+#define PERFORMANCE_RECORD_SIZE_MINIMUM     (8)
+#define PERFORMANCE_RECORD_SIZE_MAXIMUM     (512)
+
+// The byte at each offset of the stream is the offset modulo this prime, so that
+// records and chunks never start with the same pattern.
+//
+#define PERFORMANCE_PATTERN_PERIOD          (251)
+
 typedef enum _TEST_ACTION {
     TEST_ACTION_RESET    = 0,
     TEST_ACTION_SHIFT    = 1,
@@ -69,6 +84,9 @@ typedef struct
     // Write thread
     //
     DMFMODULE DmfModuleWriteThread;
+    // Indicates that parse throughput has been measured.
+    //
+    BOOLEAN PerformanceTested;
 } DMF_CONTEXT_Tests_PingPongBuffer;
 
 // This macro declares the following function:
@@ -271,6 +289,228 @@ Tests_PingPongBuffer_ActionConsume(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_PingPongBuffer_ParseMeasure(
+    _In_ WDFDEVICE Device,
+    _In_ PingPongBuffer_ShiftModeType ShiftMode,
+    _In_ ULONG RecordSize,
+    _In_reads_(PERFORMANCE_CHUNK_SIZE + PERFORMANCE_PATTERN_PERIOD) UCHAR* Pattern,
+    _Out_ ULONGLONG* Microseconds
+    )
+/*++
+
+Routine Description:
+
+    Measure how long parsing a stream takes in a given ShiftMode. The stream is written in chunks
+    whenever there is space for one, and parsed by discarding one record at a time with
+    DMF_PingPongBuffer_Shift(). The first byte of each record is verified.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    ShiftMode - The given ShiftMode.
+    RecordSize - Number of bytes discarded by each call to DMF_PingPongBuffer_Shift().
+    Pattern - The bytes of the stream (repeated).
+    Microseconds - Where the time is written.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_PingPongBuffer moduleConfigPingPongBuffer;
+    DMFMODULE dmfModulePingPongBuffer;
+    ULONGLONG startTime;
+    ULONG bytesWritten;
+    ULONG bytesParsed;
+    ULONG currentSize;
+    UCHAR* buffer;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    *Microseconds = 0;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_PingPongBuffer_AND_ATTRIBUTES_INIT(&moduleConfigPingPongBuffer,
+                                                  &moduleAttributes);
+    moduleConfigPingPongBuffer.BufferSize = PERFORMANCE_BUFFER_SIZE;
+    moduleConfigPingPongBuffer.PoolType = PagedPool;
+    moduleConfigPingPongBuffer.ShiftMode = ShiftMode;
+    moduleAttributes.PassiveLevel = TRUE;
+    ntStatus = DMF_PingPongBuffer_Create(Device,
+                                         &moduleAttributes,
+                                         &objectAttributes,
+                                         &dmfModulePingPongBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        dmfModulePingPongBuffer = NULL;
+        goto Exit;
+    }
+
+    bytesWritten = 0;
+    bytesParsed = 0;
+
+    startTime = TestsUtility_MicrosecondsGet();
+    while (bytesParsed < PERFORMANCE_BYTE_COUNT)
+    {
+        buffer = DMF_PingPongBuffer_Get(dmfModulePingPongBuffer,
+                                        &currentSize);
+
+        if ((PERFORMANCE_BUFFER_SIZE - currentSize >= PERFORMANCE_CHUNK_SIZE) &&
+            (bytesWritten < PERFORMANCE_BYTE_COUNT))
+        {
+            ntStatus = DMF_PingPongBuffer_Write(dmfModulePingPongBuffer,
+                                                Pattern + (bytesWritten % PERFORMANCE_PATTERN_PERIOD),
+                                                PERFORMANCE_CHUNK_SIZE,
+                                                &currentSize);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+            bytesWritten += PERFORMANCE_CHUNK_SIZE;
+            continue;
+        }
+
+        // Parse all the complete records.
+        //
+        while (currentSize >= RecordSize)
+        {
+            if (buffer[0] != (UCHAR)(bytesParsed % PERFORMANCE_PATTERN_PERIOD))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+            DMF_PingPongBuffer_Shift(dmfModulePingPongBuffer,
+                                     RecordSize);
+            bytesParsed += RecordSize;
+            buffer = DMF_PingPongBuffer_Get(dmfModulePingPongBuffer,
+                                            &currentSize);
+        }
+    }
+    *Microseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModulePingPongBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModulePingPongBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_PingPongBuffer_Performance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Measure parse throughput in each ShiftMode for several record sizes.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY patternMemory;
+    UCHAR* pattern;
+    ULONGLONG copyMicroseconds;
+    ULONGLONG offsetMicroseconds;
+    ULONG recordSize;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               PagedPool,
+                               MemoryTag,
+                               PERFORMANCE_CHUNK_SIZE + PERFORMANCE_PATTERN_PERIOD,
+                               &patternMemory,
+                               (VOID**)&pattern);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        patternMemory = NULL;
+        goto Exit;
+    }
+    for (ULONG byteIndex = 0; byteIndex < PERFORMANCE_CHUNK_SIZE + PERFORMANCE_PATTERN_PERIOD; byteIndex++)
+    {
+        pattern[byteIndex] = (UCHAR)(byteIndex % PERFORMANCE_PATTERN_PERIOD);
+    }
+
+    for (recordSize = PERFORMANCE_RECORD_SIZE_MINIMUM; recordSize <= PERFORMANCE_RECORD_SIZE_MAXIMUM; recordSize *= 4)
+    {
+        ntStatus = Tests_PingPongBuffer_ParseMeasure(Device,
+                                                     PingPongBuffer_ShiftMode_Copy,
+                                                     recordSize,
+                                                     pattern,
+                                                     &copyMicroseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        ntStatus = Tests_PingPongBuffer_ParseMeasure(Device,
+                                                     PingPongBuffer_ShiftMode_Offset,
+                                                     recordSize,
+                                                     pattern,
+                                                     &offsetMicroseconds);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "PingPongBuffer parse bytes=%d record size=%d copy microseconds=%I64d offset microseconds=%I64d",
+                    PERFORMANCE_BYTE_COUNT,
+                    recordSize,
+                    (LONGLONG)copyMicroseconds,
+                    (LONGLONG)offsetMicroseconds);
+    }
+
+Exit:
+
+    if (patternMemory != NULL)
+    {
+        WdfObjectDelete(patternMemory);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_DMF_Thread_Function)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -283,12 +523,26 @@ Tests_PingPongBuffer_ReadThreadWork(
     DMFMODULE dmfModule;
     DMF_CONTEXT_Tests_PingPongBuffer* moduleContext;
     TEST_ACTION testAction;
+    NTSTATUS ntStatus;
 
     PAGED_CODE();
 
     dmfModule = DMF_ParentModuleGet(DmfModuleThread);
     moduleContext = DMF_CONTEXT_GET(dmfModule);
 
+    // Measure parse throughput once. It uses its own PingPongBuffer Modules.
+    //
+    if (! moduleContext->PerformanceTested)
+    {
+        moduleContext->PerformanceTested = TRUE;
+        ntStatus = Tests_PingPongBuffer_Performance(dmfModule,
+                                                    DMF_ParentDeviceGet(dmfModule));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
     // Generate a random test action Id for a current iteration.
     //
     testAction = (TEST_ACTION)TestsUtility_GenerateRandomNumber(TEST_ACTION_MINIMUM,
@@ -314,6 +568,8 @@ Tests_PingPongBuffer_ReadThreadWork(
         break;
     }
 
+Exit:
+
     // Repeat the test, until stop is signaled.
     //
     if (!DMF_Thread_IsStopPending(DmfModuleThread))
@@ -34,6 +34,88 @@ Environment:
 
 #define ITEM_COUNT_MAX           (64)
 
+// Reorder performance is measured on Ring Buffers from 1 MB to 64 MB.
+//
+#define PERFORMANCE_RING_SIZE_MINIMUM       (1024 * 1024)
+#define PERFORMANCE_RING_SIZE_MAXIMUM       (64 * 1024 * 1024)
+// Items that are not a power of two in size make sure the rotation works on any item size.
+//
+#define PERFORMANCE_ITEM_SIZE               (12)
+
+// DMF_RingBuffer_EnumerateToFindItem performance is measured on a Ring Buffer of this many
+// items, with and without an index.
+//
+#define FIND_ITEM_COUNT                     (16 * 1024)
+// Each item holds a key, a sequence number and padding.
+//
+#define FIND_ITEM_SIZE                      (12)
+// Keys are chosen from this many values so that most keys are in several items.
+//
+#define FIND_KEY_COUNT                      (4 * 1024)
+// Number of keys looked up in each Ring Buffer.
+//
+#define FIND_LOOKUP_COUNT                   (1024)
+
+// Two-thread (producer/consumer) throughput and latency is compared between a Ring Buffer
+// that uses the Module's lock and one that uses RingBuffer_Mode_SingleProducerSingleConsumer.
+//
+typedef enum
+{
+    STREAMING_MODE_LOCKED = 0,
+    STREAMING_MODE_SINGLE_PRODUCER_SINGLE_CONSUMER,
+    STREAMING_MODE_COUNT
+} STREAMING_MODE;
+
+#define STREAMING_ITEM_COUNT                (1024)
+#define STREAMING_BATCH_SIZE                (256)
+
+typedef struct
+{
+    // Consecutive for each Ring Buffer, so the consumer can check the order.
+    //
+    ULONG SequenceNumber;
+    ULONG Reserved;
+    // Time the producer wrote the item (microseconds).
+    //
+    ULONGLONG WriteTime;
+} STREAMING_ITEM;
+
+// Size of the Ring Buffers of variable size records.
+//
+#define RECORD_BUFFER_SIZE                  (512)
+// Records are between sizeof(ULONG) and this size. Each record starts with its sequence number.
+//
+#define RECORD_SIZE_MAXIMUM                 (40)
+// Number of records written to a Ring Buffer that deletes the oldest record when it is full.
+//
+#define RECORD_COUNT                        (1024)
+// Set in the header of the unused space at the end of a Ring Buffer of variable size records.
+//
+#define RECORD_HEADER_PADDING               (0x80000000)
+
+typedef struct
+{
+    ULONG SequenceNumberExpected;
+    ULONG RecordsFound;
+} RECORD_ENUM_CONTEXT_Tests_RingBuffer;
+
+// Number of items in the Ring Buffers used by the bulk write/read tests.
+//
+#define BULK_ITEM_COUNT                     (64)
+// Number of bulk operations done on each Ring Buffer.
+//
+#define BULK_OPERATION_COUNT                (1024)
+
+// Number of items in the Ring Buffers used by the read cursor tests.
+//
+#define CURSOR_ITEM_COUNT                   (16)
+// Number of read cursors in the Ring Buffers used by the read cursor tests.
+//
+#define CURSOR_COUNT                        (3)
+// Number of operations done on each Ring Buffer by the read cursor tests.
+//
+#define CURSOR_OPERATION_COUNT              (4096)
+
 typedef struct
 {
     BOOLEAN ValueIncrement;
@@ -42,6 +124,14 @@ typedef struct
     ULONG ItemsTotal;
 } ENUM_CONTEXT_Tests_RingBuffer, *PENUM_CONTEXT_Tests_RingBuffer;
 
+typedef struct
+{
+    ULONG ItemsFound;
+    ULONG ItemsTotal;
+    ULONG LastSequence;
+    ULONGLONG SequenceSum;
+} FIND_CONTEXT_Tests_RingBuffer;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +142,31 @@ typedef struct
     // Thread that executes tests.
     //
     DMFMODULE DmfModuleThread;
+    // Reorder performance is only measured the first time the tests run.
+    //
+    BOOLEAN PerformanceMeasured;
+    // Ring Buffers used by the producer/consumer tests.
+    //
+    DMFMODULE DmfModuleRingBufferStreaming[STREAMING_MODE_COUNT];
+    // Thread that writes to each Ring Buffer.
+    //
+    DMFMODULE DmfModuleThreadStreamingProducer[STREAMING_MODE_COUNT];
+    // Thread that reads from each Ring Buffer.
+    //
+    DMFMODULE DmfModuleThreadStreamingConsumer[STREAMING_MODE_COUNT];
+    // Sequence number of the next item each producer writes.
+    //
+    ULONG StreamingSequenceNumberProduced[STREAMING_MODE_COUNT];
+    // Sequence number of the next item each consumer expects.
+    //
+    ULONG StreamingSequenceNumberConsumed[STREAMING_MODE_COUNT];
+    // Sum and maximum of the time items spent in each Ring Buffer (microseconds).
+    //
+    ULONGLONG StreamingLatencyTotal[STREAMING_MODE_COUNT];
+    ULONGLONG StreamingLatencyMaximum[STREAMING_MODE_COUNT];
+    // Time the producer/consumer tests started.
+    //
+    ULONGLONG StreamingStartTime;
 } DMF_CONTEXT_Tests_RingBuffer;
 
 // This macro declares the following function:
@@ -169,6 +284,118 @@ Tests_RingBuffer_Enumeration(
     return TRUE;
 }
 
+static
+ULONG
+Tests_RingBuffer_RecordFill(
+    _Out_writes_(RECORD_SIZE_MAXIMUM) UCHAR* Record,
+    _In_ ULONG SequenceNumber
+    )
+/*++
+
+Routine Description:
+
+    Fill a record for a given sequence number. The size of the record and its content depend only
+    on the sequence number so that the reader can verify them.
+
+Arguments:
+
+    Record - The buffer to fill.
+    SequenceNumber - The given sequence number.
+
+Return Value:
+
+    The size of the record in bytes.
+
+--*/
+{
+    ULONG recordSize;
+
+    recordSize = sizeof(ULONG) + ((SequenceNumber * 7) % (RECORD_SIZE_MAXIMUM - sizeof(ULONG) + 1));
+    *(ULONG*)Record = SequenceNumber;
+    for (ULONG byteIndex = sizeof(ULONG); byteIndex < recordSize; byteIndex++)
+    {
+        Record[byteIndex] = (UCHAR)(SequenceNumber + byteIndex);
+    }
+
+    return recordSize;
+}
+
+static
+BOOLEAN
+Tests_RingBuffer_RecordVerify(
+    _In_reads_(RecordSize) UCHAR* Record,
+    _In_ ULONG RecordSize,
+    _In_ ULONG SequenceNumber
+    )
+/*++
+
+Routine Description:
+
+    Verify that a record read from a Ring Buffer is the record written for a given sequence number.
+
+Arguments:
+
+    Record - The record read from the Ring Buffer.
+    RecordSize - The size of the record read from the Ring Buffer.
+    SequenceNumber - The given sequence number.
+
+Return Value:
+
+    TRUE if the record is correct.
+
+--*/
+{
+    UCHAR recordExpected[RECORD_SIZE_MAXIMUM];
+    ULONG recordSizeExpected;
+
+    recordSizeExpected = Tests_RingBuffer_RecordFill(recordExpected,
+                                                     SequenceNumber);
+    if (RecordSize != recordSizeExpected)
+    {
+        return FALSE;
+    }
+
+    return (RtlCompareMemory(Record,
+                             recordExpected,
+                             RecordSize) == RecordSize);
+}
+
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+BOOLEAN
+Tests_RingBuffer_RecordEnumeration(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    RECORD_ENUM_CONTEXT_Tests_RingBuffer* enumContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    enumContext = (RECORD_ENUM_CONTEXT_Tests_RingBuffer*)CallbackContext;
+    DmfAssert(enumContext != NULL);
+
+    // The oldest record may have been deleted, so start from the first record found.
+    //
+    DmfAssert(BufferSize >= sizeof(ULONG));
+    // 'Dereferencing NULL pointer. 'enumContext' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    if (0 == enumContext->RecordsFound)
+    {
+        enumContext->SequenceNumberExpected = *(ULONG*)Buffer;
+    }
+    DmfAssert(Tests_RingBuffer_RecordVerify(Buffer,
+                                            BufferSize,
+                                            enumContext->SequenceNumberExpected));
+
+    enumContext->RecordsFound++;
+    enumContext->SequenceNumberExpected++;
+
+    return TRUE;
+}
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -214,6 +441,13 @@ Tests_RingBuffer_RunTests(
         moduleConfigRingBuffer.ItemCount = itemCountIndex;
         moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
         moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+        // Index every other Ring Buffer so that DMF_RingBuffer_EnumerateToFindItem is
+        // verified with and without the index.
+        //
+        if (itemCountIndex % 2)
+        {
+            moduleConfigRingBuffer.IndexKeyLength = sizeof(ULONG);
+        }
         ntStatus = DMF_RingBuffer_Create(Device,
                                          &moduleAttributes,
                                          &objectAttributes,
@@ -325,98 +559,1466 @@ Exit:
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(EVT_DMF_Thread_Function)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
-VOID
-Tests_RingBuffer_WorkThread(
-    _In_ DMFMODULE DmfModuleThread
+NTSTATUS
+Tests_RingBuffer_ReorderPerformance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
     )
+/*++
+
+Routine Description:
+
+    Measure how long DMF_RingBuffer_Reorder takes on large Ring Buffers (1 MB to 64 MB).
+    Each Ring Buffer is overfilled so that the Read Pointer is in the middle of the buffer
+    (the worst case). The contents are verified before and after the reorder using
+    DMF_RingBuffer_ContiguousSegmentsGet.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
 {
-    DMFMODULE dmfModule;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
-    WDFDEVICE device;
-    ULONG itemCountMax;
+    ULONG item[PERFORMANCE_ITEM_SIZE / sizeof(ULONG)];
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG ringSize;
+    ULONG itemCount;
+    ULONG itemsToWrite;
+    ULONG itemIndex;
+    ULONGLONG startTime;
+    ULONGLONG endTime;
     NTSTATUS ntStatus;
 
     PAGED_CODE();
 
-    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
-    moduleContext = DMF_CONTEXT_GET(dmfModule);
-    device = DMF_ParentDeviceGet(dmfModule);
+    dmfModuleRingBuffer = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ntStatus = STATUS_SUCCESS;
 
-    itemCountMax = TestsUtility_GenerateRandomNumber(4, 
-                                                     ITEM_COUNT_MAX);
+    RtlZeroMemory(item,
+                  sizeof(item));
 
-    ntStatus = Tests_RingBuffer_RunTests(dmfModule,
-                                         device, 
-                                         itemCountMax);
+    for (ringSize = PERFORMANCE_RING_SIZE_MINIMUM; ringSize <= PERFORMANCE_RING_SIZE_MAXIMUM; ringSize *= 2)
+    {
+        if (DMF_Thread_IsStopPending(moduleContext->DmfModuleThread))
+        {
+            break;
+        }
 
-    // Repeat the test, until stop is signaled or the function stopped because the
-    // driver is stopping.
-    //
-    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
-        (NT_SUCCESS(ntStatus)))
+        itemCount = ringSize / PERFORMANCE_ITEM_SIZE;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = Device;
+
+        DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                                  &moduleAttributes);
+        moduleConfigRingBuffer.ItemCount = itemCount;
+        moduleConfigRingBuffer.ItemSize = PERFORMANCE_ITEM_SIZE;
+        moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+        ntStatus = DMF_RingBuffer_Create(Device,
+                                         &moduleAttributes,
+                                         &objectAttributes,
+                                         &dmfModuleRingBuffer);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // Large allocations may fail on small systems. Skip the larger sizes.
+            //
+            TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "DMF_RingBuffer_Create ringSize=%d fails: ntStatus=%!STATUS!", ringSize, ntStatus);
+            ntStatus = STATUS_SUCCESS;
+            break;
+        }
+
+        // Write a bit more than half again the number of items so the oldest item is in
+        // the middle of the buffer. Each item starts with its sequence number.
+        //
+        itemsToWrite = itemCount + (itemCount / 2) + 1;
+        for (itemIndex = 0; itemIndex < itemsToWrite; itemIndex++)
+        {
+            item[0] = itemIndex;
+            ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                            (UCHAR*)item,
+                                            sizeof(item));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        }
+
+        // Before reordering, the data is split in two regions.
+        //
+        DMF_RingBuffer_ContiguousSegmentsGet(dmfModuleRingBuffer,
+                                             TRUE,
+                                             &firstSegment,
+                                             &firstSegmentSize,
+                                             &secondSegment,
+                                             &secondSegmentSize);
+        DmfAssert(firstSegment != NULL);
+        DmfAssert(secondSegment != NULL);
+        DmfAssert(firstSegmentSize + secondSegmentSize == itemCount * PERFORMANCE_ITEM_SIZE);
+        DmfAssert(*(ULONG*)firstSegment == itemsToWrite - itemCount);
+
+        startTime = TestsUtility_MicrosecondsGet();
+        DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                               TRUE);
+        endTime = TestsUtility_MicrosecondsGet();
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "Reorder: ringSize=%d itemCount=%d microseconds=%I64d",
+                    ringSize,
+                    itemCount,
+                    (LONGLONG)(endTime - startTime));
+
+        // After reordering, all the data is in a single region in order.
+        //
+        DMF_RingBuffer_ContiguousSegmentsGet(dmfModuleRingBuffer,
+                                             TRUE,
+                                             &firstSegment,
+                                             &firstSegmentSize,
+                                             &secondSegment,
+                                             &secondSegmentSize);
+        DmfAssert(firstSegment != NULL);
+        DmfAssert(NULL == secondSegment);
+        DmfAssert(0 == secondSegmentSize);
+        DmfAssert(firstSegmentSize == itemCount * PERFORMANCE_ITEM_SIZE);
+        for (itemIndex = 0; itemIndex < itemCount; itemIndex++)
+        {
+            if (*(ULONG*)(firstSegment + ((size_t)itemIndex * PERFORMANCE_ITEM_SIZE)) != itemsToWrite - itemCount + itemIndex)
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+
+        WdfObjectDelete(dmfModuleRingBuffer);
+        dmfModuleRingBuffer = NULL;
+    }
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
     {
-        DMF_Thread_WorkReady(DmfModuleThread);
+        WdfObjectDelete(dmfModuleRingBuffer);
     }
 
-    TestsUtility_YieldExecution();
+    return ntStatus;
 }
 #pragma code_seg()
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_RingBuffer_FindCount(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    FIND_CONTEXT_Tests_RingBuffer* findContext;
+    ULONG* item;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    findContext = (FIND_CONTEXT_Tests_RingBuffer*)CallbackContext;
+    DmfAssert(findContext != NULL);
+    DmfAssert(BufferSize == FIND_ITEM_SIZE);
+
+    // Items are found from oldest to newest.
+    // 'Dereferencing NULL pointer. 'findContext' contains the same NULL value as 'CallbackContext' did.'
+    //
+    item = (ULONG*)Buffer;
+    #pragma warning(suppress:28182)
+    DmfAssert((0 == findContext->ItemsFound) || (item[1] > findContext->LastSequence));
+    #pragma warning(suppress:28182)
+    findContext->LastSequence = item[1];
+    findContext->ItemsFound++;
+    findContext->SequenceSum += item[1];
+
+    return TRUE;
+}
 
 #pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
 _IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
 static
 NTSTATUS
-Tests_RingBuffer_Open(
-    _In_ DMFMODULE DmfModule
+Tests_RingBuffer_FindPerformance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type Test_RingBuffer.
+    Measure how long DMF_RingBuffer_EnumerateToFindItem takes on a 16K item Ring Buffer
+    without and with an index. The same items are written to both Ring Buffers (enough
+    to wrap) and some are read, then the same random keys are looked up in both. Both
+    Ring Buffers must find the same items.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
 
 Return Value:
 
-    STATUS_SUCCESS
+    NTSTATUS
 
 --*/
 {
-    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer[2];
+    FIND_CONTEXT_Tests_RingBuffer findContext[2];
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG item[FIND_ITEM_SIZE / sizeof(ULONG)];
+    ULONG keys[FIND_LOOKUP_COUNT];
+    ULONGLONG microseconds[2];
+    ULONGLONG startTime;
+    ULONG ringIndex;
+    ULONG itemIndex;
+    ULONG lookupIndex;
+    NTSTATUS ntStatus;
 
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
-
+    dmfModuleRingBuffer[0] = NULL;
+    dmfModuleRingBuffer[1] = NULL;
     moduleContext = DMF_CONTEXT_GET(DmfModule);
-    // Start the thread.
-    //
-    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    ntStatus = STATUS_SUCCESS;
 
-    // Tell the thread it has work to do.
+    // The first Ring Buffer has no index. The second is indexed by the first ULONG of each item.
     //
-    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
-
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+    for (ringIndex = 0; ringIndex < 2; ringIndex++)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = Device;
+
+        DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                                  &moduleAttributes);
+        moduleConfigRingBuffer.ItemCount = FIND_ITEM_COUNT;
+        moduleConfigRingBuffer.ItemSize = FIND_ITEM_SIZE;
+        moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+        if (ringIndex > 0)
+        {
+            moduleConfigRingBuffer.IndexKeyOffset = 0;
+            moduleConfigRingBuffer.IndexKeyLength = sizeof(ULONG);
+        }
+        ntStatus = DMF_RingBuffer_Create(Device,
+                                         &moduleAttributes,
+                                         &objectAttributes,
+                                         &dmfModuleRingBuffer[ringIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // It can fail when driver is being removed.
+            //
+            dmfModuleRingBuffer[ringIndex] = NULL;
+            goto Exit;
+        }
+    }
+
+    // Write more items than fit so that the oldest items are deleted, then read some
+    // so that the index contains items that are no longer present.
+    //
+    RtlZeroMemory(item,
+                  sizeof(item));
+    for (itemIndex = 0; itemIndex < FIND_ITEM_COUNT + (FIND_ITEM_COUNT / 2); itemIndex++)
+    {
+        item[0] = TestsUtility_GenerateRandomNumber(0,
+                                                    FIND_KEY_COUNT - 1);
+        item[1] = itemIndex;
+        for (ringIndex = 0; ringIndex < 2; ringIndex++)
+        {
+            ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer[ringIndex],
+                                            (UCHAR*)item,
+                                            sizeof(item));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        }
+    }
+    for (itemIndex = 0; itemIndex < FIND_ITEM_COUNT / 4; itemIndex++)
+    {
+        for (ringIndex = 0; ringIndex < 2; ringIndex++)
+        {
+            ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer[ringIndex],
+                                           (UCHAR*)item,
+                                           sizeof(item));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        }
+    }
+
+    for (lookupIndex = 0; lookupIndex < FIND_LOOKUP_COUNT; lookupIndex++)
+    {
+        keys[lookupIndex] = TestsUtility_GenerateRandomNumber(0,
+                                                              FIND_KEY_COUNT - 1);
+    }
+
+    // Look up the same keys in both Ring Buffers.
+    //
+    for (ringIndex = 0; ringIndex < 2; ringIndex++)
+    {
+        RtlZeroMemory(&findContext[ringIndex],
+                      sizeof(findContext[ringIndex]));
+
+        startTime = TestsUtility_MicrosecondsGet();
+        for (lookupIndex = 0; lookupIndex < FIND_LOOKUP_COUNT; lookupIndex++)
+        {
+            findContext[ringIndex].ItemsFound = 0;
+            DMF_RingBuffer_EnumerateToFindItem(dmfModuleRingBuffer[ringIndex],
+                                               Tests_RingBuffer_FindCount,
+                                               &findContext[ringIndex],
+                                               (UCHAR*)&keys[lookupIndex],
+                                               sizeof(ULONG));
+            findContext[ringIndex].ItemsTotal += findContext[ringIndex].ItemsFound;
+        }
+        microseconds[ringIndex] = TestsUtility_MicrosecondsGet() - startTime;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                "EnumerateToFindItem: itemCount=%d lookups=%d itemsFound=%d linear microseconds=%I64d indexed microseconds=%I64d",
+                FIND_ITEM_COUNT,
+                FIND_LOOKUP_COUNT,
+                findContext[0].ItemsTotal,
+                (LONGLONG)microseconds[0],
+                (LONGLONG)microseconds[1]);
+
+    if ((findContext[0].ItemsTotal != findContext[1].ItemsTotal) ||
+        (findContext[0].SequenceSum != findContext[1].SequenceSum))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+
+Exit:
+
+    for (ringIndex = 0; ringIndex < 2; ringIndex++)
+    {
+        if (dmfModuleRingBuffer[ringIndex] != NULL)
+        {
+            WdfObjectDelete(dmfModuleRingBuffer[ringIndex]);
+        }
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_RingBuffer_RecordTests(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_ModeType Mode
+    )
+/*++
+
+Routine Description:
+
+    Test a Ring Buffer of variable size records.
+    RingBuffer_Mode_FailIfFullOnWrite: Interleave writes and reads so that records wrap around
+    the end of the buffer. No record may be lost.
+    RingBuffer_Mode_DeleteOldestIfFullOnWrite: Write many records, then verify that the newest
+    records are present in order using DMF_RingBuffer_Enumerate, the memory returned by
+    DMF_RingBuffer_ContiguousSegmentsGet after DMF_RingBuffer_Reorder and DMF_RingBuffer_ReadRecord.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+    Mode - The mode of the Ring Buffer to test.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    RECORD_ENUM_CONTEXT_Tests_RingBuffer enumContext;
+    UCHAR record[RECORD_SIZE_MAXIMUM];
+    ULONG recordSize;
+    ULONG bytesRead;
+    ULONG sequenceNumberWritten;
+    ULONG sequenceNumberRead;
+    ULONG recordsToWrite;
+    ULONG recordsToRead;
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG offset;
+    ULONG header;
+    ULONG recordsFound;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModuleRingBuffer = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemSize = RECORD_SIZE_MAXIMUM;
+    moduleConfigRingBuffer.RecordBufferSize = RECORD_BUFFER_SIZE;
+    moduleConfigRingBuffer.Mode = Mode;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    sequenceNumberWritten = 0;
+    sequenceNumberRead = 0;
+
+    // Records that are too small or too large are rejected.
+    //
+    ntStatus = DMF_RingBuffer_WriteRecord(dmfModuleRingBuffer,
+                                          record,
+                                          0);
+    DmfAssert(!NT_SUCCESS(ntStatus));
+    ntStatus = DMF_RingBuffer_WriteRecord(dmfModuleRingBuffer,
+                                          record,
+                                          RECORD_SIZE_MAXIMUM + 1);
+    DmfAssert(!NT_SUCCESS(ntStatus));
+
+    // A record that does not fit in the target buffer is not removed.
+    //
+    recordSize = Tests_RingBuffer_RecordFill(record,
+                                             sequenceNumberWritten);
+    ntStatus = DMF_RingBuffer_WriteRecord(dmfModuleRingBuffer,
+                                          record,
+                                          recordSize);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+    sequenceNumberWritten++;
+    ntStatus = DMF_RingBuffer_ReadRecord(dmfModuleRingBuffer,
+                                         record,
+                                         recordSize - 1,
+                                         &bytesRead);
+    DmfAssert(STATUS_BUFFER_TOO_SMALL == ntStatus);
+    DmfAssert(bytesRead == recordSize);
+
+    if (RingBuffer_Mode_FailIfFullOnWrite == Mode)
+    {
+        // Write and read a random number of records at a time so that the records wrap around
+        // the end of the buffer at all possible offsets. No record may be lost.
+        //
+        while (sequenceNumberWritten < RECORD_COUNT && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)))
+        {
+            recordsToWrite = TestsUtility_GenerateRandomNumber(1, 
+                                                               8);
+            for (ULONG recordIndex = 0; recordIndex < recordsToWrite; recordIndex++)
+            {
+                recordSize = Tests_RingBuffer_RecordFill(record,
+                                                         sequenceNumberWritten);
+                ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                                record,
+                                                recordSize);
+                if (!NT_SUCCESS(ntStatus))
+                {
+                    // Ring Buffer is full. It is not possible for it to be empty.
+                    //
+                    DmfAssert(sequenceNumberRead < sequenceNumberWritten);
+                    break;
+                }
+                sequenceNumberWritten++;
+            }
+
+            recordsToRead = TestsUtility_GenerateRandomNumber(1, 
+                                                              8);
+            for (ULONG recordIndex = 0; recordIndex < recordsToRead && sequenceNumberRead < sequenceNumberWritten; recordIndex++)
+            {
+                ntStatus = DMF_RingBuffer_ReadRecord(dmfModuleRingBuffer,
+                                                     record,
+                                                     sizeof(record),
+                                                     &bytesRead);
+                if ((!NT_SUCCESS(ntStatus)) ||
+                    (! Tests_RingBuffer_RecordVerify(record,
+                                                     bytesRead,
+                                                     sequenceNumberRead)))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+                sequenceNumberRead++;
+            }
+        }
+    }
+    else
+    {
+        // Write many more records than fit. Only the newest records remain.
+        //
+        for (; sequenceNumberWritten < RECORD_COUNT; sequenceNumberWritten++)
+        {
+            recordSize = Tests_RingBuffer_RecordFill(record,
+                                                     sequenceNumberWritten);
+            ntStatus = DMF_RingBuffer_WriteRecord(dmfModuleRingBuffer,
+                                                  record,
+                                                  recordSize);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        }
+
+        // The remaining records are in order and end with the newest record.
+        //
+        enumContext.SequenceNumberExpected = 0;
+        enumContext.RecordsFound = 0;
+        DMF_RingBuffer_Enumerate(dmfModuleRingBuffer,
+                                 TRUE,
+                                 Tests_RingBuffer_RecordEnumeration,
+                                 &enumContext);
+        DmfAssert(enumContext.RecordsFound > 0);
+        DmfAssert(enumContext.SequenceNumberExpected == sequenceNumberWritten);
+        sequenceNumberRead = sequenceNumberWritten - enumContext.RecordsFound;
+
+        // After reordering, the memory of the Ring Buffer is a sequence of records (header
+        // followed by data padded to sizeof(ULONG)) that starts with the oldest record. The
+        // unused space at the end of the buffer where a record did not fit is marked by a
+        // header with the high bit set and the size of that space.
+        //
+        DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
+                               TRUE);
+        DMF_RingBuffer_ContiguousSegmentsGet(dmfModuleRingBuffer,
+                                             TRUE,
+                                             &firstSegment,
+                                             &firstSegmentSize,
+                                             &secondSegment,
+                                             &secondSegmentSize);
+        DmfAssert(firstSegment != NULL);
+        DmfAssert(NULL == secondSegment);
+        offset = 0;
+        recordsFound = 0;
+        while (offset < firstSegmentSize)
+        {
+            header = *(ULONG*)(firstSegment + offset);
+            if (header & RECORD_HEADER_PADDING)
+            {
+                offset += header & ~RECORD_HEADER_PADDING;
+                continue;
+            }
+            DmfAssert(header <= RECORD_SIZE_MAXIMUM);
+            DmfAssert(Tests_RingBuffer_RecordVerify(firstSegment + offset + sizeof(ULONG),
+                                                    header,
+                                                    sequenceNumberRead + recordsFound));
+            offset += sizeof(ULONG) + ((header + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1));
+            recordsFound++;
+        }
+        DmfAssert(recordsFound == enumContext.RecordsFound);
+        DmfAssert(offset == firstSegmentSize);
+
+        // Read back all the records.
+        //
+        for (; sequenceNumberRead < sequenceNumberWritten; sequenceNumberRead++)
+        {
+            ntStatus = DMF_RingBuffer_ReadRecord(dmfModuleRingBuffer,
+                                                 record,
+                                                 sizeof(record),
+                                                 &bytesRead);
+            if ((!NT_SUCCESS(ntStatus)) ||
+                (! Tests_RingBuffer_RecordVerify(record,
+                                                 bytesRead,
+                                                 sequenceNumberRead)))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+    }
+
+    // Read the records that remain. Then, the Ring Buffer is empty.
+    //
+    while (sequenceNumberRead < sequenceNumberWritten)
+    {
+        ntStatus = DMF_RingBuffer_ReadRecord(dmfModuleRingBuffer,
+                                             record,
+                                             sizeof(record),
+                                             &bytesRead);
+        if ((!NT_SUCCESS(ntStatus)) ||
+            (! Tests_RingBuffer_RecordVerify(record,
+                                             bytesRead,
+                                             sequenceNumberRead)))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_UNSUCCESSFUL;
+            goto Exit;
+        }
+        sequenceNumberRead++;
+    }
+    ntStatus = DMF_RingBuffer_ReadRecord(dmfModuleRingBuffer,
+                                         record,
+                                         sizeof(record),
+                                         &bytesRead);
+    DmfAssert(!NT_SUCCESS(ntStatus));
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_RingBuffer_BulkTests(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_ModeType Mode
+    )
+/*++
+
+Routine Description:
+
+    Randomly write and read many items at a time using DMF_RingBuffer_WriteMany,
+    DMF_RingBuffer_WriteReserve/DMF_RingBuffer_WriteCommit and DMF_RingBuffer_ReadMany.
+    Each item is its sequence number, so the items read must be consecutive.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+    Mode - The mode of the Ring Buffer to test.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG items[BULK_ITEM_COUNT * 2];
+    ULONG sequenceNumberWritten;
+    ULONG sequenceNumberRead;
+    ULONG itemsPresent;
+    ULONG itemsExpected;
+    ULONG numberOfItems;
+    ULONG bytesWritten;
+    ULONG bytesRead;
+    UCHAR* firstSegment;
+    UCHAR* secondSegment;
+    ULONG firstSegmentSize;
+    ULONG secondSegmentSize;
+    ULONG itemsReserved;
+    ULONG itemsCommitted;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModuleRingBuffer = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = BULK_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = Mode;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    sequenceNumberWritten = 0;
+    sequenceNumberRead = 0;
+
+    for (ULONG operationIndex = 0; operationIndex < BULK_OPERATION_COUNT && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); operationIndex++)
+    {
+        itemsPresent = sequenceNumberWritten - sequenceNumberRead;
+        switch (TestsUtility_GenerateRandomNumber(0, 
+                                                  2))
+        {
+            case 0:
+            {
+                // Write many items. More items than fit may be written.
+                //
+                numberOfItems = TestsUtility_GenerateRandomNumber(1, 
+                                                                  ARRAYSIZE(items));
+                for (ULONG itemIndex = 0; itemIndex < numberOfItems; itemIndex++)
+                {
+                    items[itemIndex] = sequenceNumberWritten + itemIndex;
+                }
+                ntStatus = DMF_RingBuffer_WriteMany(dmfModuleRingBuffer,
+                                                    (UCHAR*)items,
+                                                    numberOfItems * sizeof(ULONG),
+                                                    &bytesWritten);
+                if (RingBuffer_Mode_DeleteOldestIfFullOnWrite == Mode)
+                {
+                    itemsExpected = numberOfItems;
+                }
+                else
+                {
+                    itemsExpected = min(numberOfItems, BULK_ITEM_COUNT - itemsPresent);
+                }
+                DmfAssert(NT_SUCCESS(ntStatus) == (itemsExpected > 0));
+                DmfAssert(bytesWritten == itemsExpected * sizeof(ULONG));
+                sequenceNumberWritten += itemsExpected;
+                break;
+            }
+            case 1:
+            {
+                // Reserve space for many items, write some of them in place and commit those.
+                //
+                numberOfItems = TestsUtility_GenerateRandomNumber(1, 
+                                                                  BULK_ITEM_COUNT);
+                ntStatus = DMF_RingBuffer_WriteReserve(dmfModuleRingBuffer,
+                                                       numberOfItems,
+                                                       &firstSegment,
+                                                       &firstSegmentSize,
+                                                       &secondSegment,
+                                                       &secondSegmentSize);
+                if (RingBuffer_Mode_DeleteOldestIfFullOnWrite == Mode)
+                {
+                    itemsExpected = numberOfItems;
+                }
+                else
+                {
+                    itemsExpected = min(numberOfItems, BULK_ITEM_COUNT - itemsPresent);
+                }
+                itemsReserved = (firstSegmentSize + secondSegmentSize) / sizeof(ULONG);
+                DmfAssert(itemsReserved == itemsExpected);
+                if (!NT_SUCCESS(ntStatus))
+                {
+                    DmfAssert(0 == itemsExpected);
+                    break;
+                }
+
+                itemsCommitted = TestsUtility_GenerateRandomNumber(0, 
+                                                                   itemsReserved);
+                for (ULONG itemIndex = 0; itemIndex < itemsCommitted; itemIndex++)
+                {
+                    if (itemIndex < firstSegmentSize / sizeof(ULONG))
+                    {
+                        ((ULONG*)firstSegment)[itemIndex] = sequenceNumberWritten + itemIndex;
+                    }
+                    else
+                    {
+                        DmfAssert(secondSegment != NULL);
+                        ((ULONG*)secondSegment)[itemIndex - (firstSegmentSize / sizeof(ULONG))] = sequenceNumberWritten + itemIndex;
+                    }
+                }
+                DMF_RingBuffer_WriteCommit(dmfModuleRingBuffer,
+                                           itemsCommitted);
+
+                // In RingBuffer_Mode_DeleteOldestIfFullOnWrite, the oldest items were deleted
+                // to make space for all the reserved items.
+                //
+                if (itemsPresent + itemsReserved > BULK_ITEM_COUNT)
+                {
+                    sequenceNumberRead += itemsPresent + itemsReserved - BULK_ITEM_COUNT;
+                }
+                sequenceNumberWritten += itemsCommitted;
+                break;
+            }
+            default:
+            {
+                // Read many items. The Client buffer may be larger than the number of items present.
+                //
+                numberOfItems = TestsUtility_GenerateRandomNumber(1, 
+                                                                  BULK_ITEM_COUNT + 1);
+                ntStatus = DMF_RingBuffer_ReadMany(dmfModuleRingBuffer,
+                                                   (UCHAR*)items,
+                                                   numberOfItems * sizeof(ULONG),
+                                                   &bytesRead);
+                itemsExpected = min(numberOfItems, itemsPresent);
+                DmfAssert(NT_SUCCESS(ntStatus) == (itemsExpected > 0));
+                DmfAssert(bytesRead == itemsExpected * sizeof(ULONG));
+                for (ULONG itemIndex = 0; itemIndex < itemsExpected; itemIndex++)
+                {
+                    if (items[itemIndex] != sequenceNumberRead + itemIndex)
+                    {
+                        DmfAssert(FALSE);
+                        ntStatus = STATUS_UNSUCCESSFUL;
+                        goto Exit;
+                    }
+                }
+                sequenceNumberRead += itemsExpected;
+                break;
+            }
+        }
+
+        // In RingBuffer_Mode_DeleteOldestIfFullOnWrite, only the newest items remain.
+        //
+        if (sequenceNumberWritten - sequenceNumberRead > BULK_ITEM_COUNT)
+        {
+            DmfAssert(RingBuffer_Mode_DeleteOldestIfFullOnWrite == Mode);
+            sequenceNumberRead = sequenceNumberWritten - BULK_ITEM_COUNT;
+        }
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_Function_class_(EVT_DMF_RingBuffer_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_RingBuffer_ReadCursorInPlace(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    ULONG* item;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    item = (ULONG*)CallbackContext;
+    DmfAssert(item != NULL);
+    DmfAssert(BufferSize == sizeof(ULONG));
+
+    // 'Dereferencing NULL pointer. 'item' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    *item = *((ULONG*)Buffer);
+
+    return TRUE;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_RingBuffer_ReadCursorTests(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device,
+    _In_ RingBuffer_ModeType Mode
+    )
+/*++
+
+Routine Description:
+
+    Randomly write items and read them through several read cursors, opening and closing
+    the cursors along the way. Each item is its sequence number, so each cursor must read
+    consecutive items (except for the items it dropped).
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+    Mode - The mode of the Ring Buffer to test.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+    DMFMODULE dmfModuleRingBuffer;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG readCursors[CURSOR_COUNT];
+    BOOLEAN readCursorOpen[CURSOR_COUNT];
+    ULONG sequenceNumberExpected[CURSOR_COUNT];
+    ULONG itemsDroppedExpected[CURSOR_COUNT];
+    ULONG sequenceNumberWritten;
+    ULONG itemsUnreadMaximum;
+    ULONG itemsDropped;
+    ULONG cursorIndex;
+    ULONG item;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModuleRingBuffer = NULL;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = CURSOR_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = Mode;
+    moduleConfigRingBuffer.ReadCursorCount = CURSOR_COUNT;
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     &dmfModuleRingBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    for (cursorIndex = 0; cursorIndex < CURSOR_COUNT; cursorIndex++)
+    {
+        readCursorOpen[cursorIndex] = FALSE;
+    }
+    sequenceNumberWritten = 0;
+
+    for (ULONG operationIndex = 0; operationIndex < CURSOR_OPERATION_COUNT && (! DMF_Thread_IsStopPending(moduleContext->DmfModuleThread)); operationIndex++)
+    {
+        cursorIndex = TestsUtility_GenerateRandomNumber(0, 
+                                                        CURSOR_COUNT - 1);
+
+        // Open cursors that are closed.
+        //
+        if (! readCursorOpen[cursorIndex])
+        {
+            ntStatus = DMF_RingBuffer_ReadCursorOpen(dmfModuleRingBuffer,
+                                                     &readCursors[cursorIndex]);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+            readCursorOpen[cursorIndex] = TRUE;
+            sequenceNumberExpected[cursorIndex] = sequenceNumberWritten;
+            itemsDroppedExpected[cursorIndex] = 0;
+            continue;
+        }
+
+        switch (TestsUtility_GenerateRandomNumber(0, 
+                                                  8))
+        {
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+            {
+                // Write an item. It fails only if the slowest cursor is full.
+                //
+                itemsUnreadMaximum = 0;
+                for (ULONG otherCursorIndex = 0; otherCursorIndex < CURSOR_COUNT; otherCursorIndex++)
+                {
+                    if (readCursorOpen[otherCursorIndex])
+                    {
+                        itemsUnreadMaximum = max(itemsUnreadMaximum,
+                                                 sequenceNumberWritten - sequenceNumberExpected[otherCursorIndex]);
+                    }
+                }
+
+                item = sequenceNumberWritten;
+                ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                                (UCHAR*)&item,
+                                                sizeof(item));
+                if ((RingBuffer_Mode_FailIfFullOnWrite == Mode) &&
+                    (CURSOR_ITEM_COUNT == itemsUnreadMaximum))
+                {
+                    DmfAssert(!NT_SUCCESS(ntStatus));
+                    break;
+                }
+                DmfAssert(NT_SUCCESS(ntStatus));
+                sequenceNumberWritten++;
+
+                // Full cursors skip their oldest item.
+                //
+                for (ULONG otherCursorIndex = 0; otherCursorIndex < CURSOR_COUNT; otherCursorIndex++)
+                {
+                    if ((readCursorOpen[otherCursorIndex]) &&
+                        (sequenceNumberWritten - sequenceNumberExpected[otherCursorIndex] > CURSOR_ITEM_COUNT))
+                    {
+                        DmfAssert(RingBuffer_Mode_DeleteOldestIfFullOnWrite == Mode);
+                        sequenceNumberExpected[otherCursorIndex]++;
+                        itemsDroppedExpected[otherCursorIndex]++;
+                    }
+                }
+                break;
+            }
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            {
+                // Read an item through this cursor, either copied or in place.
+                //
+                item = (ULONG)-1;
+                if (TestsUtility_GenerateRandomNumber(0, 
+                                                      1))
+                {
+                    ntStatus = DMF_RingBuffer_ReadCursorRead(dmfModuleRingBuffer,
+                                                             readCursors[cursorIndex],
+                                                             (UCHAR*)&item,
+                                                             sizeof(item));
+                }
+                else
+                {
+                    ntStatus = DMF_RingBuffer_ReadCursorReadInPlace(dmfModuleRingBuffer,
+                                                                    readCursors[cursorIndex],
+                                                                    Tests_RingBuffer_ReadCursorInPlace,
+                                                                    &item);
+                }
+                if (sequenceNumberExpected[cursorIndex] == sequenceNumberWritten)
+                {
+                    DmfAssert(!NT_SUCCESS(ntStatus));
+                    break;
+                }
+                if ((!NT_SUCCESS(ntStatus)) ||
+                    (item != sequenceNumberExpected[cursorIndex]))
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_UNSUCCESSFUL;
+                    goto Exit;
+                }
+                sequenceNumberExpected[cursorIndex]++;
+
+                ntStatus = DMF_RingBuffer_ReadCursorDroppedCountGet(dmfModuleRingBuffer,
+                                                                    readCursors[cursorIndex],
+                                                                    &itemsDropped);
+                DmfAssert(NT_SUCCESS(ntStatus));
+                DmfAssert(itemsDropped == itemsDroppedExpected[cursorIndex]);
+                break;
+            }
+            default:
+            {
+                // Close this cursor. It is opened again later.
+                //
+                DMF_RingBuffer_ReadCursorClose(dmfModuleRingBuffer,
+                                               readCursors[cursorIndex]);
+                readCursorOpen[cursorIndex] = FALSE;
+                break;
+            }
+        }
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    if (dmfModuleRingBuffer != NULL)
+    {
+        WdfObjectDelete(dmfModuleRingBuffer);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    WDFDEVICE device;
+    ULONG itemCountMax;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    device = DMF_ParentDeviceGet(dmfModule);
+
+    if (! moduleContext->PerformanceMeasured)
+    {
+        moduleContext->PerformanceMeasured = TRUE;
+        ntStatus = Tests_RingBuffer_ReorderPerformance(dmfModule,
+                                                       device);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        ntStatus = Tests_RingBuffer_FindPerformance(dmfModule,
+                                                    device);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    itemCountMax = TestsUtility_GenerateRandomNumber(4, 
+                                                     ITEM_COUNT_MAX);
+
+    ntStatus = Tests_RingBuffer_RunTests(dmfModule,
+                                         device, 
+                                         itemCountMax);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_RecordTests(dmfModule,
+                                            device,
+                                            RingBuffer_Mode_FailIfFullOnWrite);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_RecordTests(dmfModule,
+                                            device,
+                                            RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_BulkTests(dmfModule,
+                                          device,
+                                          RingBuffer_Mode_FailIfFullOnWrite);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_BulkTests(dmfModule,
+                                          device,
+                                          RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_ReadCursorTests(dmfModule,
+                                                device,
+                                                RingBuffer_Mode_FailIfFullOnWrite);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = Tests_RingBuffer_ReadCursorTests(dmfModule,
+                                                device,
+                                                RingBuffer_Mode_DeleteOldestIfFullOnWrite);
+
+Exit:
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (NT_SUCCESS(ntStatus)))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_StreamingProducerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Write a batch of items, each with the next sequence number and the current time,
+    to this thread's Ring Buffer until it is full.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    STREAMING_ITEM item;
+    ULONG streamingMode;
+    ULONG itemIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    for (streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        if (moduleContext->DmfModuleThreadStreamingProducer[streamingMode] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(streamingMode < STREAMING_MODE_COUNT);
+
+    ntStatus = STATUS_SUCCESS;
+    item.Reserved = 0;
+    for (itemIndex = 0; itemIndex < STREAMING_BATCH_SIZE; itemIndex++)
+    {
+        item.SequenceNumber = moduleContext->StreamingSequenceNumberProduced[streamingMode];
+        item.WriteTime = TestsUtility_MicrosecondsGet();
+        ntStatus = DMF_RingBuffer_Write(moduleContext->DmfModuleRingBufferStreaming[streamingMode],
+                                        (UCHAR*)&item,
+                                        sizeof(item));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // The Ring Buffer is full.
+            //
+            break;
+        }
+        moduleContext->StreamingSequenceNumberProduced[streamingMode]++;
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TestsUtility_YieldExecution();
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBuffer_StreamingConsumerThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Read a batch of items from this thread's Ring Buffer until it is empty. Items must be
+    read in the order they were written. Accumulate the time each item spent in the
+    Ring Buffer.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    STREAMING_ITEM item;
+    ULONG streamingMode;
+    ULONG itemIndex;
+    ULONGLONG latency;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    for (streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        if (moduleContext->DmfModuleThreadStreamingConsumer[streamingMode] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(streamingMode < STREAMING_MODE_COUNT);
+
+    ntStatus = STATUS_SUCCESS;
+    for (itemIndex = 0; itemIndex < STREAMING_BATCH_SIZE; itemIndex++)
+    {
+        ntStatus = DMF_RingBuffer_Read(moduleContext->DmfModuleRingBufferStreaming[streamingMode],
+                                       (UCHAR*)&item,
+                                       sizeof(item));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // The Ring Buffer is empty.
+            //
+            break;
+        }
+
+        DmfAssert(item.SequenceNumber == moduleContext->StreamingSequenceNumberConsumed[streamingMode]);
+        moduleContext->StreamingSequenceNumberConsumed[streamingMode]++;
+
+        latency = TestsUtility_MicrosecondsGet() - item.WriteTime;
+        moduleContext->StreamingLatencyTotal[streamingMode] += latency;
+        if (latency > moduleContext->StreamingLatencyMaximum[streamingMode])
+        {
+            moduleContext->StreamingLatencyMaximum[streamingMode] = latency;
+        }
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TestsUtility_YieldExecution();
+    }
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_RingBuffer_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_RingBuffer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    // Start the thread.
+    //
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // Tell the thread it has work to do.
+    //
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+    moduleContext->StreamingStartTime = TestsUtility_MicrosecondsGet();
+
+    for (ULONG streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadStreamingConsumer[streamingMode]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadStreamingProducer[streamingMode]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadStreamingConsumer[streamingMode]);
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadStreamingProducer[streamingMode]);
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
 }
@@ -447,6 +2049,9 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
+    ULONG streamingMode;
+    LONGLONG streamingMicroseconds;
+    ULONG itemsConsumed;
 
     PAGED_CODE();
 
@@ -456,6 +2061,35 @@ Return Value:
 
     DMF_Thread_Stop(moduleContext->DmfModuleThread);
 
+    // Stop the producers before the consumers.
+    //
+    for (streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadStreamingProducer[streamingMode]);
+    }
+    for (streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadStreamingConsumer[streamingMode]);
+    }
+
+    // Report the throughput and latency of each mode.
+    //
+    streamingMicroseconds = (LONGLONG)(TestsUtility_MicrosecondsGet() - moduleContext->StreamingStartTime);
+    for (streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        itemsConsumed = moduleContext->StreamingSequenceNumberConsumed[streamingMode];
+        DmfAssert(itemsConsumed <= moduleContext->StreamingSequenceNumberProduced[streamingMode]);
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Streaming mode=%d itemsConsumed=%d microseconds=%I64d itemsPerMillisecond=%I64d averageLatency=%I64d maximumLatency=%I64d",
+                    streamingMode,
+                    itemsConsumed,
+                    streamingMicroseconds,
+                    (streamingMicroseconds > 0) ? 
+                        ((LONGLONG)itemsConsumed * 1000) / streamingMicroseconds : 0,
+                    (itemsConsumed > 0) ? 
+                        (LONGLONG)(moduleContext->StreamingLatencyTotal[streamingMode] / itemsConsumed) : 0,
+                    (LONGLONG)moduleContext->StreamingLatencyMaximum[streamingMode]);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -490,6 +2124,7 @@ Return Value:
     DMF_MODULE_ATTRIBUTES moduleAttributes;
     DMF_CONTEXT_Tests_RingBuffer* moduleContext;
     DMF_CONFIG_Thread moduleConfigThread;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
 
     UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
 
@@ -508,6 +2143,47 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleThread);
 
+    // RingBuffer and Threads (Producer/Consumer)
+    // ------------------------------------------
+    //
+    for (ULONG streamingMode = 0; streamingMode < STREAMING_MODE_COUNT; streamingMode++)
+    {
+        DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                                  &moduleAttributes);
+        moduleConfigRingBuffer.ItemCount = STREAMING_ITEM_COUNT;
+        moduleConfigRingBuffer.ItemSize = sizeof(STREAMING_ITEM);
+        if (STREAMING_MODE_SINGLE_PRODUCER_SINGLE_CONSUMER == streamingMode)
+        {
+            moduleConfigRingBuffer.Mode = RingBuffer_Mode_SingleProducerSingleConsumer;
+        }
+        else
+        {
+            moduleConfigRingBuffer.Mode = RingBuffer_Mode_FailIfFullOnWrite;
+        }
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleRingBufferStreaming[streamingMode]);
+
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBuffer_StreamingProducerThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadStreamingProducer[streamingMode]);
+
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBuffer_StreamingConsumerThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadStreamingConsumer[streamingMode]);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -0,0 +1,663 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_RingBufferPerProcessor.c
+
+Abstract:
+
+    Functional tests for Dmf_RingBufferPerProcessor Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_Tests_RingBufferPerProcessor.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of threads that write at the same time.
+//
+#define WRITER_THREAD_COUNT                 (4)
+
+// Number of entries each writer writes each time it runs.
+//
+#define WRITER_BATCH_SIZE                   (64)
+
+// Number of entries each processor keeps.
+//
+#define ITEM_COUNT_PER_PROCESSOR            (128)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'PBRT'
+
+// Data written by the writers.
+//
+typedef struct
+{
+    // Index of the writer thread.
+    //
+    ULONG WriterIndex;
+    // Incremented for each entry a writer writes.
+    //
+    ULONG SequenceNumber;
+} ENTRY_Tests_RingBufferPerProcessor;
+
+// Verifies that entries are enumerated in time order.
+//
+typedef struct
+{
+    // Time stamp of the last entry enumerated.
+    //
+    ULONGLONG TimestampLast;
+    // Time stamp and sequence number of the last entry enumerated for each writer.
+    //
+    ULONGLONG WriterTimestampLast[WRITER_THREAD_COUNT];
+    ULONG WriterSequenceNumberLast[WRITER_THREAD_COUNT];
+    BOOLEAN WriterSeen[WRITER_THREAD_COUNT];
+    // Number of entries enumerated.
+    //
+    ULONG EntryCount;
+} ENUM_CONTEXT_Tests_RingBufferPerProcessor;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Module under test.
+    //
+    DMFMODULE DmfModuleRingBufferPerProcessor;
+    // Threads that write entries.
+    //
+    DMFMODULE DmfModuleThreadWriter[WRITER_THREAD_COUNT];
+    // Thread that reads the entries.
+    //
+    DMFMODULE DmfModuleThreadReader;
+    // Sequence number of the next entry each writer writes.
+    //
+    ULONG WriterSequenceNumber[WRITER_THREAD_COUNT];
+} DMF_CONTEXT_Tests_RingBufferPerProcessor;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_RingBufferPerProcessor)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_RingBufferPerProcessor)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_RingBufferPerProcessor_EntryVerify(
+    _Inout_ ENUM_CONTEXT_Tests_RingBufferPerProcessor* EnumContext,
+    _In_ RINGBUFFERPERPROCESSOR_ENTRY_HEADER* EntryHeader,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize
+    )
+/*++
+
+Routine Description:
+
+    Verify that a given entry was written after the entries before it.
+
+Arguments:
+
+    EnumContext - Time stamps and sequence numbers of the entries before it.
+    EntryHeader - The given entry's header.
+    Buffer - The given entry's data.
+    BufferSize - Size of the given entry's data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ENTRY_Tests_RingBufferPerProcessor* entry;
+    ULONG writerIndex;
+
+    DmfAssert(BufferSize == sizeof(ENTRY_Tests_RingBufferPerProcessor));
+    DmfAssert(EntryHeader->DataSize == BufferSize);
+    DmfAssert(EntryHeader->Timestamp >= EnumContext->TimestampLast);
+    EnumContext->TimestampLast = EntryHeader->Timestamp;
+
+    entry = (ENTRY_Tests_RingBufferPerProcessor*)Buffer;
+    writerIndex = entry->WriterIndex;
+    DmfAssert(writerIndex < WRITER_THREAD_COUNT);
+    if (writerIndex >= WRITER_THREAD_COUNT)
+    {
+        return;
+    }
+
+    // Each writer writes its entries one after the other, so its sequence numbers
+    // increase with time. Entries with the same time stamp on different processors
+    // are ordered by processor, not by sequence number.
+    //
+    if (EnumContext->WriterSeen[writerIndex] &&
+        (EntryHeader->Timestamp > EnumContext->WriterTimestampLast[writerIndex]))
+    {
+        DmfAssert(entry->SequenceNumber > EnumContext->WriterSequenceNumberLast[writerIndex]);
+    }
+    EnumContext->WriterSeen[writerIndex] = TRUE;
+    EnumContext->WriterTimestampLast[writerIndex] = EntryHeader->Timestamp;
+    EnumContext->WriterSequenceNumberLast[writerIndex] = entry->SequenceNumber;
+    EnumContext->EntryCount++;
+}
+
+_Function_class_(EVT_DMF_RingBufferPerProcessor_Enumeration)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+Tests_RingBufferPerProcessor_Enumeration(
+    _In_ DMFMODULE DmfModule,
+    _In_ RINGBUFFERPERPROCESSOR_ENTRY_HEADER* EntryHeader,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _In_opt_ VOID* CallbackContext
+    )
+{
+    ENUM_CONTEXT_Tests_RingBufferPerProcessor* enumContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    enumContext = (ENUM_CONTEXT_Tests_RingBufferPerProcessor*)CallbackContext;
+    DmfAssert(enumContext != NULL);
+
+    // 'Dereferencing NULL pointer. 'enumContext' contains the same NULL value as 'CallbackContext' did.'
+    //
+    #pragma warning(suppress:28182)
+    Tests_RingBufferPerProcessor_EntryVerify(enumContext,
+                                             EntryHeader,
+                                             Buffer,
+                                             BufferSize);
+
+    return TRUE;
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBufferPerProcessor_WriterThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    Write a batch of entries, each with this writer's next sequence number.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBufferPerProcessor* moduleContext;
+    ENTRY_Tests_RingBufferPerProcessor entry;
+    ULONG writerIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    for (writerIndex = 0; writerIndex < WRITER_THREAD_COUNT; writerIndex++)
+    {
+        if (moduleContext->DmfModuleThreadWriter[writerIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(writerIndex < WRITER_THREAD_COUNT);
+
+    entry.WriterIndex = writerIndex;
+    for (ULONG entryIndex = 0; entryIndex < WRITER_BATCH_SIZE; entryIndex++)
+    {
+        entry.SequenceNumber = moduleContext->WriterSequenceNumber[writerIndex];
+        // Writes never fail in RingBuffer_Mode_DeleteOldestIfFullOnWrite.
+        //
+        ntStatus = DMF_RingBufferPerProcessor_Write(moduleContext->DmfModuleRingBufferPerProcessor,
+                                                    (UCHAR*)&entry,
+                                                    sizeof(entry));
+        DmfAssert(NT_SUCCESS(ntStatus));
+        moduleContext->WriterSequenceNumber[writerIndex]++;
+    }
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBufferPerProcessor_ReaderThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    While the writers write, enumerate and export all the entries and verify that
+    they are in time order.
+
+Arguments:
+
+    DmfModuleThread - This thread's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_RingBufferPerProcessor* moduleContext;
+    ENUM_CONTEXT_Tests_RingBufferPerProcessor enumContext;
+    RINGBUFFERPERPROCESSOR_ENTRY_HEADER* entryHeader;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY exportMemory;
+    UCHAR* exportBuffer;
+    ULONG totalSize;
+    ULONG bytesWritten;
+    ULONG entrySize;
+    ULONG exportBufferSize;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Enumerate.
+    //
+    RtlZeroMemory(&enumContext,
+                  sizeof(enumContext));
+    DMF_RingBufferPerProcessor_Enumerate(moduleContext->DmfModuleRingBufferPerProcessor,
+                                         TRUE,
+                                         Tests_RingBufferPerProcessor_Enumeration,
+                                         &enumContext);
+
+    // Export all the entries.
+    //
+    DMF_RingBufferPerProcessor_TotalSizeGet(moduleContext->DmfModuleRingBufferPerProcessor,
+                                            &totalSize);
+    // Each entry is the header followed by the data, rounded up to 8 bytes.
+    //
+    entrySize = (sizeof(RINGBUFFERPERPROCESSOR_ENTRY_HEADER) + sizeof(ENTRY_Tests_RingBufferPerProcessor) + sizeof(ULONGLONG) - 1) & ~(sizeof(ULONGLONG) - 1);
+    DmfAssert((totalSize % (entrySize * ITEM_COUNT_PER_PROCESSOR)) == 0);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = dmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               totalSize,
+                               &exportMemory,
+                               (VOID**)&exportBuffer);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Half the time, use a buffer that is too small.
+    //
+    exportBufferSize = totalSize;
+    if (TestsUtility_GenerateRandomNumber(0, 1))
+    {
+        exportBufferSize = TestsUtility_GenerateRandomNumber(0, totalSize);
+    }
+
+    ntStatus = DMF_RingBufferPerProcessor_Export(moduleContext->DmfModuleRingBufferPerProcessor,
+                                                 TRUE,
+                                                 exportBuffer,
+                                                 exportBufferSize,
+                                                 &bytesWritten);
+    DmfAssert(bytesWritten <= exportBufferSize);
+    if (exportBufferSize == totalSize)
+    {
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    else
+    {
+        DmfAssert(NT_SUCCESS(ntStatus) || (STATUS_BUFFER_OVERFLOW == ntStatus));
+    }
+
+    // The export is a sequence of entries of the same size, in time order.
+    //
+    RtlZeroMemory(&enumContext,
+                  sizeof(enumContext));
+    for (ULONG offset = 0; offset < bytesWritten; offset += entrySize)
+    {
+        entryHeader = (RINGBUFFERPERPROCESSOR_ENTRY_HEADER*)(exportBuffer + offset);
+        Tests_RingBufferPerProcessor_EntryVerify(&enumContext,
+                                                 entryHeader,
+                                                 (UCHAR*)(entryHeader + 1),
+                                                 entryHeader->DataSize);
+    }
+
+    WdfObjectDelete(exportMemory);
+
+Exit:
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_RingBufferPerProcessor_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_RingBufferPerProcessor.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_RingBufferPerProcessor* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG writerIndex = 0; writerIndex < WRITER_THREAD_COUNT; writerIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadWriter[writerIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadWriter[writerIndex]);
+    }
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadReader);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadReader);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_RingBufferPerProcessor_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_RingBufferPerProcessor.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_RingBufferPerProcessor* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadReader);
+    for (ULONG writerIndex = 0; writerIndex < WRITER_THREAD_COUNT; writerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadWriter[writerIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_RingBufferPerProcessor_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_RingBufferPerProcessor* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+    DMF_CONFIG_RingBufferPerProcessor moduleConfigRingBufferPerProcessor;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // RingBufferPerProcessor
+    // ----------------------
+    //
+    DMF_CONFIG_RingBufferPerProcessor_AND_ATTRIBUTES_INIT(&moduleConfigRingBufferPerProcessor,
+                                                          &moduleAttributes);
+    moduleConfigRingBufferPerProcessor.ItemCountPerProcessor = ITEM_COUNT_PER_PROCESSOR;
+    moduleConfigRingBufferPerProcessor.ItemSize = sizeof(ENTRY_Tests_RingBufferPerProcessor);
+    moduleConfigRingBufferPerProcessor.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleRingBufferPerProcessor);
+
+    // Threads (Writers/Reader)
+    // ------------------------
+    //
+    for (ULONG writerIndex = 0; writerIndex < WRITER_THREAD_COUNT; writerIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBufferPerProcessor_WriterThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadWriter[writerIndex]);
+    }
+
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_RingBufferPerProcessor_ReaderThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadReader);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_RingBufferPerProcessor_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_RingBufferPerProcessor.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_RingBufferPerProcessor;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_RingBufferPerProcessor;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_RingBufferPerProcessor);
+    dmfCallbacksDmf_Tests_RingBufferPerProcessor.ChildModulesAdd = DMF_Tests_RingBufferPerProcessor_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_RingBufferPerProcessor.DeviceOpen = Tests_RingBufferPerProcessor_Open;
+    dmfCallbacksDmf_Tests_RingBufferPerProcessor.DeviceClose = Tests_RingBufferPerProcessor_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_RingBufferPerProcessor,
+                                            Tests_RingBufferPerProcessor,
+                                            DMF_CONTEXT_Tests_RingBufferPerProcessor,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_RingBufferPerProcessor.CallbacksDmf = &dmfCallbacksDmf_Tests_RingBufferPerProcessor;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_RingBufferPerProcessor,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_RingBufferPerProcessor.c
+//
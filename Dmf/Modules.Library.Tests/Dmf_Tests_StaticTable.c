@@ -0,0 +1,886 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_StaticTable.c
+
+Abstract:
+
+    Functional and performance tests for Dmf_StaticTable Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#if defined(DMF_INCLUDE_TMH)
+#include "Dmf_Tests_StaticTable.tmh"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of threads that read the shared table at the same time.
+//
+#define THREAD_COUNT                        (2)
+
+// Number of Keys in the shared table.
+//
+#define NAME_COUNT                          (ARRAYSIZE(g_StaticTable_Names))
+
+// Number of table sizes measured, the first of them and the number of lookups measured.
+// Each size is 16 times the previous one (16, 256, 4096 and 65536 entries).
+//
+#define PERFORMANCE_SIZE_COUNT              (4)
+#define PERFORMANCE_SIZE_MINIMUM            (16)
+#define PERFORMANCE_LOOKUP_COUNT            (100000)
+
+typedef enum _TEST_ACTION
+{
+    TEST_ACTION_READ,
+    TEST_ACTION_FIND,
+    TEST_ACTION_MISS,
+    TEST_ACTION_COUNT,
+    TEST_ACTION_MINIMUM     = TEST_ACTION_READ,
+    TEST_ACTION_MAXIMUM     = TEST_ACTION_MISS
+} TEST_ACTION;
+
+// Keys of the shared table. They have different lengths, and some of them are prefixes of
+// others, so that both the Key length and the Key data must be compared.
+//
+static
+const
+CHAR*
+g_StaticTable_Names[] =
+{
+    "Alpha",
+    "Bravo",
+    "Charlie",
+    "Delta",
+    "Echo",
+    "Foxtrot",
+    "Golf",
+    "Hotel",
+    "India",
+    "Juliett",
+    "Kilo",
+    "Lima",
+    "Mike",
+    "November",
+    "Oscar",
+    "Papa",
+    "Quebec",
+    "Romeo",
+    "Sierra",
+    "Tango",
+    "Uniform",
+    "Victor",
+    "Whiskey",
+    "X-ray",
+    "Yankee",
+    "Zulu",
+    "Alph",
+    "AlphaAlpha",
+    "Bravo Bravo Bravo Bravo",
+    "A",
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // StaticTable Module that all the threads read.
+    //
+    DMFMODULE DmfModuleStaticTable;
+    // Entries and Values of the shared table. They only need to remain valid until it opens.
+    //
+    STATICTABLE_ENTRY Entries[NAME_COUNT];
+    ULONG Values[NAME_COUNT];
+    // Indicates that performance has been measured.
+    //
+    BOOLEAN PerformanceTested;
+    // Work threads that read the shared StaticTable Module.
+    //
+    DMFMODULE DmfModuleThread[THREAD_COUNT];
+} DMF_CONTEXT_Tests_StaticTable;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_StaticTable)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_StaticTable)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'TStT'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+ULONG
+Tests_StaticTable_ValueGenerate(
+    _In_ ULONG NameIndex
+    )
+/*++
+
+Routine Description:
+
+    Generate the Value of the Key with a given index.
+
+Arguments:
+
+    NameIndex - Index of the Key in g_StaticTable_Names.
+
+Return Value:
+
+    The Value.
+
+--*/
+{
+    return (NameIndex * 0x01010101) ^ 0xA5A5A5A5;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_StaticTable_Performance(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Measure how long building a table, lookups of present Keys and lookups of absent Keys take,
+    and compare them with a DMF_HashTable (open addressing) that holds the same Keys.
+    Each comparison is measured with 16, 256, 4096 and 65536 entries.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Device - Client driver's WDFDEVICE object.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_StaticTable moduleConfigStaticTable;
+    DMF_CONFIG_HashTable moduleConfigHashTable;
+    DMFMODULE dmfModuleStaticTable;
+    DMFMODULE dmfModuleHashTable;
+    WDFMEMORY entriesMemory;
+    STATICTABLE_ENTRY* entries;
+    ULONG* keys;
+    ULONGLONG startTime;
+    ULONGLONG staticBuildMicroseconds;
+    ULONGLONG staticHitMicroseconds;
+    ULONGLONG staticMissMicroseconds;
+    ULONGLONG hashBuildMicroseconds;
+    ULONGLONG hashHitMicroseconds;
+    ULONGLONG hashMissMicroseconds;
+    ULONG sizeIndex;
+    ULONG entryCount;
+    ULONG itemIndex;
+    ULONG lookupIndex;
+    ULONG key;
+    ULONG value;
+    ULONG valueSize;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    dmfModuleStaticTable = NULL;
+    dmfModuleHashTable = NULL;
+    entriesMemory = NULL;
+    ntStatus = STATUS_SUCCESS;
+
+    entryCount = PERFORMANCE_SIZE_MINIMUM;
+    for (sizeIndex = 0; sizeIndex < PERFORMANCE_SIZE_COUNT; sizeIndex++)
+    {
+        // The Keys are also the Values, so a Value read shows which entry was found.
+        // Keys are spread over the range of ULONG so that they are not consecutive.
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = Device;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   PagedPool,
+                                   MemoryTag,
+                                   (SIZE_T)entryCount * (sizeof(STATICTABLE_ENTRY) + sizeof(ULONG)),
+                                   &entriesMemory,
+                                   (VOID**)&entries);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            entriesMemory = NULL;
+            goto Exit;
+        }
+        keys = (ULONG*)(entries + entryCount);
+        for (itemIndex = 0; itemIndex < entryCount; itemIndex++)
+        {
+            keys[itemIndex] = itemIndex * 0x9E3779B1;
+            entries[itemIndex].Key = (UCHAR*)&keys[itemIndex];
+            entries[itemIndex].KeyLength = sizeof(ULONG);
+            entries[itemIndex].Value = (UCHAR*)&keys[itemIndex];
+            entries[itemIndex].ValueLength = sizeof(ULONG);
+        }
+
+        // StaticTable
+        // -----------
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = Device;
+
+        DMF_CONFIG_StaticTable_AND_ATTRIBUTES_INIT(&moduleConfigStaticTable,
+                                                   &moduleAttributes);
+        moduleConfigStaticTable.Entries = entries;
+        moduleConfigStaticTable.EntryCount = entryCount;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        ntStatus = DMF_StaticTable_Create(Device,
+                                          &moduleAttributes,
+                                          &objectAttributes,
+                                          &dmfModuleStaticTable);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // It can fail when driver is being removed.
+            //
+            dmfModuleStaticTable = NULL;
+            goto Exit;
+        }
+        staticBuildMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+        {
+            key = (lookupIndex % entryCount) * 0x9E3779B1;
+            ntStatus = DMF_StaticTable_Read(dmfModuleStaticTable,
+                                            (UCHAR*)&key,
+                                            sizeof(key),
+                                            (UCHAR*)&value,
+                                            sizeof(value),
+                                            &valueSize);
+            if ((!NT_SUCCESS(ntStatus)) ||
+                (value != key))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+        staticHitMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+        {
+            key = (entryCount + lookupIndex) * 0x9E3779B1;
+            ntStatus = DMF_StaticTable_Read(dmfModuleStaticTable,
+                                            (UCHAR*)&key,
+                                            sizeof(key),
+                                            (UCHAR*)&value,
+                                            sizeof(value),
+                                            &valueSize);
+            if (NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+        staticMissMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+        WdfObjectDelete(dmfModuleStaticTable);
+        dmfModuleStaticTable = NULL;
+
+        // HashTable
+        // ---------
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = Device;
+
+        DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                                 &moduleAttributes);
+        moduleConfigHashTable.MaximumTableSize = entryCount;
+        moduleConfigHashTable.MaximumValueLength = sizeof(ULONG);
+        moduleConfigHashTable.MaximumKeyLength = sizeof(ULONG);
+        moduleConfigHashTable.Layout = HashTable_Layout_OpenAddressing;
+        moduleConfigHashTable.HashFunction = HashTable_HashFunction_WordAtATime;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        ntStatus = DMF_HashTable_Create(Device,
+                                        &moduleAttributes,
+                                        &objectAttributes,
+                                        &dmfModuleHashTable);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // It can fail when driver is being removed.
+            //
+            dmfModuleHashTable = NULL;
+            goto Exit;
+        }
+        for (itemIndex = 0; itemIndex < entryCount; itemIndex++)
+        {
+            ntStatus = DMF_HashTable_Write(dmfModuleHashTable,
+                                           (UCHAR*)&keys[itemIndex],
+                                           sizeof(ULONG),
+                                           (UCHAR*)&keys[itemIndex],
+                                           sizeof(ULONG));
+            if (!NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                goto Exit;
+            }
+        }
+        hashBuildMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+        {
+            key = (lookupIndex % entryCount) * 0x9E3779B1;
+            ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                          (UCHAR*)&key,
+                                          sizeof(key),
+                                          (UCHAR*)&value,
+                                          sizeof(value),
+                                          &valueSize);
+            if ((!NT_SUCCESS(ntStatus)) ||
+                (value != key))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+        hashHitMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+
+        startTime = TestsUtility_MicrosecondsGet();
+        for (lookupIndex = 0; lookupIndex < PERFORMANCE_LOOKUP_COUNT; lookupIndex++)
+        {
+            key = (entryCount + lookupIndex) * 0x9E3779B1;
+            ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                          (UCHAR*)&key,
+                                          sizeof(key),
+                                          (UCHAR*)&value,
+                                          sizeof(value),
+                                          &valueSize);
+            if (NT_SUCCESS(ntStatus))
+            {
+                DmfAssert(FALSE);
+                ntStatus = STATUS_UNSUCCESSFUL;
+                goto Exit;
+            }
+        }
+        hashMissMicroseconds = TestsUtility_MicrosecondsGet() - startTime;
+        ntStatus = STATUS_SUCCESS;
+
+        WdfObjectDelete(dmfModuleHashTable);
+        dmfModuleHashTable = NULL;
+        WdfObjectDelete(entriesMemory);
+        entriesMemory = NULL;
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "StaticTable entries=%d lookups=%d build microseconds=%I64d hit microseconds=%I64d miss microseconds=%I64d",
+                    entryCount,
+                    PERFORMANCE_LOOKUP_COUNT,
+                    (LONGLONG)staticBuildMicroseconds,
+                    (LONGLONG)staticHitMicroseconds,
+                    (LONGLONG)staticMissMicroseconds);
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE,
+                    "HashTable entries=%d lookups=%d build microseconds=%I64d hit microseconds=%I64d miss microseconds=%I64d",
+                    entryCount,
+                    PERFORMANCE_LOOKUP_COUNT,
+                    (LONGLONG)hashBuildMicroseconds,
+                    (LONGLONG)hashHitMicroseconds,
+                    (LONGLONG)hashMissMicroseconds);
+
+        entryCount *= 16;
+    }
+
+Exit:
+
+    if (dmfModuleStaticTable != NULL)
+    {
+        WdfObjectDelete(dmfModuleStaticTable);
+    }
+
+    if (dmfModuleHashTable != NULL)
+    {
+        WdfObjectDelete(dmfModuleHashTable);
+    }
+
+    if (entriesMemory != NULL)
+    {
+        WdfObjectDelete(entriesMemory);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_StaticTable_ThreadAction_Read(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+    ULONG nameIndex;
+    ULONG value;
+    ULONG valueLength;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    nameIndex = TestsUtility_GenerateRandomNumber(0,
+                                                  NAME_COUNT - 1);
+    ntStatus = DMF_StaticTable_Read(moduleContext->DmfModuleStaticTable,
+                                    (UCHAR*)g_StaticTable_Names[nameIndex],
+                                    (ULONG)strlen(g_StaticTable_Names[nameIndex]),
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    &valueLength);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(sizeof(ULONG) == valueLength);
+    DmfAssert(Tests_StaticTable_ValueGenerate(nameIndex) == value);
+
+    // Too small a buffer returns the length of the Value.
+    //
+    valueLength = 0;
+    ntStatus = DMF_StaticTable_Read(moduleContext->DmfModuleStaticTable,
+                                    (UCHAR*)g_StaticTable_Names[nameIndex],
+                                    (ULONG)strlen(g_StaticTable_Names[nameIndex]),
+                                    (UCHAR*)&value,
+                                    sizeof(value) - 1,
+                                    &valueLength);
+    DmfAssert(STATUS_BUFFER_TOO_SMALL == ntStatus);
+    DmfAssert(sizeof(ULONG) == valueLength);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_StaticTable_ThreadAction_Find(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+    ULONG nameIndex;
+    ULONG entryIndex;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    nameIndex = TestsUtility_GenerateRandomNumber(0,
+                                                  NAME_COUNT - 1);
+    ntStatus = DMF_StaticTable_Find(moduleContext->DmfModuleStaticTable,
+                                    (UCHAR*)g_StaticTable_Names[nameIndex],
+                                    (ULONG)strlen(g_StaticTable_Names[nameIndex]),
+                                    &entryIndex);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(nameIndex == entryIndex);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+Tests_StaticTable_ThreadAction_Miss(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+    ULONG nameIndex;
+    ULONG keyLength;
+    ULONG entryIndex;
+    ULONG value;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // All but the last character of a Key is not a Key unless it is another name ("Alph").
+    //
+    nameIndex = TestsUtility_GenerateRandomNumber(0,
+                                                  NAME_COUNT - 1);
+    keyLength = (ULONG)strlen(g_StaticTable_Names[nameIndex]) - 1;
+    ntStatus = DMF_StaticTable_Find(moduleContext->DmfModuleStaticTable,
+                                    (UCHAR*)g_StaticTable_Names[nameIndex],
+                                    keyLength,
+                                    &entryIndex);
+    if (NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(strlen(g_StaticTable_Names[entryIndex]) == keyLength);
+        DmfAssert(RtlCompareMemory(g_StaticTable_Names[entryIndex],
+                                   g_StaticTable_Names[nameIndex],
+                                   keyLength) == keyLength);
+    }
+    else
+    {
+        DmfAssert(STATUS_NOT_FOUND == ntStatus);
+    }
+
+    // A Key with a byte that is not ASCII is never found (the table only has ASCII names).
+    //
+    value = TestsUtility_GenerateRandomNumber(0,
+                                              0x7FFFFFFF) | 0x80000000;
+    ntStatus = DMF_StaticTable_Read(moduleContext->DmfModuleStaticTable,
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    (UCHAR*)&value,
+                                    sizeof(value),
+                                    NULL);
+    DmfAssert(STATUS_NOT_FOUND == ntStatus);
+}
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_StaticTable_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+    TEST_ACTION testAction;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Only the first thread measures performance.
+    //
+    if ((moduleContext->DmfModuleThread[0] == DmfModuleThread) &&
+        (! moduleContext->PerformanceTested))
+    {
+        moduleContext->PerformanceTested = TRUE;
+        ntStatus = Tests_StaticTable_Performance(dmfModule,
+                                                 DMF_ParentDeviceGet(dmfModule));
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    // Generate a random test action Id for a current iteration.
+    //
+    testAction = (TEST_ACTION)TestsUtility_GenerateRandomNumber(TEST_ACTION_MINIMUM,
+                                                                TEST_ACTION_MAXIMUM);
+    // Execute the test action.
+    //
+    switch (testAction)
+    {
+        case TEST_ACTION_READ:
+            Tests_StaticTable_ThreadAction_Read(dmfModule);
+            break;
+        case TEST_ACTION_FIND:
+            Tests_StaticTable_ThreadAction_Find(dmfModule);
+            break;
+        case TEST_ACTION_MISS:
+            Tests_StaticTable_ThreadAction_Miss(dmfModule);
+            break;
+        default:
+            DmfAssert(FALSE);
+            break;
+    }
+
+Exit:
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_StaticTable_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_StaticTable.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread[threadIndex]);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Thread_Start fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_StaticTable_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_StaticTable.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_StaticTable_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_StaticTable* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+    DMF_CONFIG_StaticTable moduleConfigStaticTable;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // StaticTable
+    // -----------
+    //
+    for (ULONG nameIndex = 0; nameIndex < NAME_COUNT; nameIndex++)
+    {
+        moduleContext->Values[nameIndex] = Tests_StaticTable_ValueGenerate(nameIndex);
+        moduleContext->Entries[nameIndex].Key = (UCHAR*)g_StaticTable_Names[nameIndex];
+        moduleContext->Entries[nameIndex].KeyLength = (ULONG)strlen(g_StaticTable_Names[nameIndex]);
+        moduleContext->Entries[nameIndex].Value = (UCHAR*)&moduleContext->Values[nameIndex];
+        moduleContext->Entries[nameIndex].ValueLength = sizeof(ULONG);
+    }
+
+    DMF_CONFIG_StaticTable_AND_ATTRIBUTES_INIT(&moduleConfigStaticTable,
+                                               &moduleAttributes);
+    moduleConfigStaticTable.Entries = moduleContext->Entries;
+    moduleConfigStaticTable.EntryCount = NAME_COUNT;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleStaticTable);
+
+    // Threads
+    // -------
+    //
+    for (ULONG threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_StaticTable_WorkThread;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThread[threadIndex]);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_StaticTable_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_StaticTable.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_StaticTable;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_StaticTable;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_StaticTable);
+    dmfCallbacksDmf_Tests_StaticTable.ChildModulesAdd = DMF_Tests_StaticTable_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_StaticTable.DeviceOpen = Tests_StaticTable_Open;
+    dmfCallbacksDmf_Tests_StaticTable.DeviceClose = Tests_StaticTable_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_StaticTable,
+                                            Tests_StaticTable,
+                                            DMF_CONTEXT_Tests_StaticTable,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_StaticTable.CallbacksDmf = &dmfCallbacksDmf_Tests_StaticTable;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_StaticTable,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_StaticTable.c
+//
@@ -262,5 +262,48 @@ Return Value:
     return accumulatedValue;
 }
 
+_Must_inspect_result_
+_IRQL_requires_same_
+ULONGLONG
+TestsUtility_MicrosecondsGet()
+/*++
+
+Routine Description:
+
+    This function returns the current value of the high resolution performance
+    counter converted to microseconds. It is used to measure elapsed time in
+    performance tests.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Current time in microseconds from an arbitrary starting point.
+
+--*/
+{
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    ULONGLONG microseconds;
+
+#if !defined(DMF_USER_MODE)
+    counter = KeQueryPerformanceCounter(&frequency);
+#else
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+#endif
+
+    DmfAssert(frequency.QuadPart > 0);
+
+    // Split the calculation to avoid overflow.
+    //
+    microseconds = ((ULONGLONG)counter.QuadPart / (ULONGLONG)frequency.QuadPart) * 1000000;
+    microseconds += (((ULONGLONG)counter.QuadPart % (ULONGLONG)frequency.QuadPart) * 1000000) / (ULONGLONG)frequency.QuadPart;
+
+    return microseconds;
+}
+
 // eof: TestsUtility.c
 //
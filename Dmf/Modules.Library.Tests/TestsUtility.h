@@ -49,5 +49,10 @@ TestsUtility_CrcCompute(
     _In_ UINT32 NumberOfBytes
     );
 
+_Must_inspect_result_
+_IRQL_requires_same_
+ULONGLONG
+TestsUtility_MicrosecondsGet();
+
 // eof: TestsUtility.h
 //
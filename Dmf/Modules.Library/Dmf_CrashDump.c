@@ -174,57 +174,6 @@ DMFMODULE g_DmfModuleCrashDump;
 
 KBUGCHECK_REASON_CALLBACK_ROUTINE CrashDump_BugCheckSecondaryDumpDataCallbackRingBuffer;
 
-_Function_class_(EVT_DMF_RingBuffer_Enumeration)
-BOOLEAN
-CrashDump_RingBufferElementsFirstBufferGet(
-    _In_ DMFMODULE DmfModule,
-    _Inout_updates_(BufferSize) UCHAR* Buffer,
-    _In_ ULONG BufferSize,
-    _In_opt_ VOID* CallbackContext
-    )
-/*++
-
-Routine Description:
-
-    Obfuscate/Unobfuscate Ring Buffer data one element at a time.
-
-Arguments:
-
-    DmfModule - Child Module.
-    Buffer - A single entry in the Ring Buffer.
-    BufferSize - The size of a single entry in the Ring Buffer.
-    CallbackContext - The DATA_SOURCE* which contains the key and current index into the total
-                      Ring Buffer data.
-
-Return Value:
-
-    FALSE because only the first element should be enumerated.
-
---*/
-{
-    DATA_SOURCE* dataSource;
-
-    UNREFERENCED_PARAMETER(DmfModule);
-    UNREFERENCED_PARAMETER(BufferSize);
-
-    dataSource = (DATA_SOURCE*)CallbackContext;
-
-    // The first time this callback is called, it is for the first block of data in the
-    // Ring Buffer. Store that address so that it can be written to the crash dump file.
-    // This is a bit unclean, but the system will crash immediately afterward.
-    //
-    
-    DmfAssert(NULL == dataSource->RingBufferData);
-    // 'Dereferencing NULL pointer. 'dataSource' contains the same NULL value as 'CallbackContext' did.'
-    //
-    #pragma warning(suppress:28182)
-    dataSource->RingBufferData = Buffer;
-
-    // Stop enumerating.
-    //
-    return FALSE;
-}
-
 _Function_class_(EVT_DMF_RingBuffer_Enumeration)
 BOOLEAN
 CrashDump_RingBufferElementsXor(
@@ -313,6 +262,10 @@ Return Value:
     GUID ringBufferGuid;
     ULONG totalLength;
     DATA_SOURCE* dataSource;
+    UCHAR* firstSegment;
+    ULONG firstSegmentSize;
+    UCHAR* secondSegment;
+    ULONG secondSegmentSize;
 
     UNREFERENCED_PARAMETER(Reason);
     UNREFERENCED_PARAMETER(Record);
@@ -340,11 +293,20 @@ Return Value:
         //
         DMF_RingBuffer_Reorder(dmfModuleRingBuffer,
                                FALSE);
-        dataSource->RingBufferData = NULL;
-        DMF_RingBuffer_Enumerate(dataSource->DmfModuleDataSourceRingBuffer,
-                                 FALSE,
-                                 CrashDump_RingBufferElementsFirstBufferGet,
-                                 dataSource);
+
+        // The first byte of the data is now the beginning of the Ring Buffer. (For Ring Buffers
+        // of variable size records, it is the header of the oldest record.) Store that address
+        // so that it can be written to the crash dump file.
+        // This is a bit unclean, but the system will crash immediately afterward.
+        //
+        DMF_RingBuffer_ContiguousSegmentsGet(dmfModuleRingBuffer,
+                                             FALSE,
+                                             &firstSegment,
+                                             &firstSegmentSize,
+                                             &secondSegment,
+                                             &secondSegmentSize);
+        DmfAssert(NULL == secondSegment);
+        dataSource->RingBufferData = firstSegment;
     }
     else if (secondaryDumpData->OutBuffer == secondaryDumpData->InBuffer)
     {
@@ -54,6 +54,9 @@ typedef struct
     // The size of the ping pong buffers.
     //
     ULONG BufferSize;
+    // Indicates how data is discarded (from Module Config).
+    //
+    PingPongBuffer_ShiftModeType ShiftMode;
 
     // Buffers and offsets.
     // --------------------
@@ -65,7 +68,8 @@ typedef struct
     // Indicates which buffer is the Ping Buffer.
     //
     ULONG PingBufferIndex;
-    // Each buffer has a Read Offset that skips invalid data.
+    // Each buffer has a Read Offset that skips invalid data. In PingPongBuffer_ShiftMode_Offset,
+    // it is also the start of the data that has not been discarded.
     //
     ULONG BufferOffsetRead[NUMBER_OF_PING_PONG_BUFFERS];
     // Each buffer has a Write Offset that indicates where the incoming
@@ -184,6 +188,8 @@ Return Value:
     //
     DmfAssert(moduleConfig->BufferSize > 0);
     moduleContext->BufferSize = moduleConfig->BufferSize;
+    DmfAssert(moduleConfig->ShiftMode < PingPongBuffer_ShiftMode_Maximum);
+    moduleContext->ShiftMode = moduleConfig->ShiftMode;
 
     // Create the collection that holds the buffer list.
     //
@@ -278,19 +284,23 @@ PingPongBuffer_PingGet(
 
 Routine Description:
 
-    Returns the Ping Buffer.
+    Returns the data in the Ping Buffer that has not been discarded. It always starts at the
+    Read Offset, which is only non-zero in PingPongBuffer_ShiftMode_Offset.
 
 Arguments:
 
     DmfModule - This Module's handle.
+    Size - Number of bytes of data.
 
 Return Value:
 
-    The Ping Buffer.
+    The first byte of data in the Ping Buffer.
 
 --*/
 {
     UCHAR* returnValue;
+    ULONG readOffset;
+    ULONG writeOffset;
     DMF_CONTEXT_PingPongBuffer* moduleContext;
 
     FuncEntry(DMF_TRACE);
@@ -300,15 +310,16 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DmfAssert(moduleContext->PingBufferIndex < NUMBER_OF_PING_PONG_BUFFERS);
-    returnValue = moduleContext->Buffer[moduleContext->PingBufferIndex];
+    readOffset = moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex];
+    writeOffset = moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
+    DmfAssert(readOffset <= writeOffset);
+    DmfAssert(writeOffset <= moduleContext->BufferSize);
 
-    // Return the current write offset address that corresponds with the current active buffer.
-    //
-    *Size = moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
+    returnValue = &moduleContext->Buffer[moduleContext->PingBufferIndex][readOffset];
 
-    // Return the address in the Ping Buffer where the next write should happen.
+    // The data ends where the next write should happen.
     //
-    DmfAssert(*Size <= moduleContext->BufferSize);
+    *Size = writeOffset - readOffset;
 
     FuncExit(DMF_TRACE, "returnValue=0x%p", returnValue);
 
@@ -523,6 +534,72 @@ Return Value:
     FuncExitVoid(DMF_TRACE);
 }
 
+static
+ULONG
+PingPongBuffer_DataMove(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG StartOffset
+    )
+/*++
+
+Routine Description:
+
+    Copies the data in the Ping Buffer from a given offset to the start of the Pong Buffer
+    and activates the Pong Buffer. Data before the given offset is discarded.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    StartOffset - The offset in the Ping Buffer of the first byte of data to keep.
+
+Return Value:
+
+    Number of bytes copied.
+
+--*/
+{
+    UCHAR* activePacket;
+    UCHAR* inactivePacket;
+    ULONG numberOfBytes;
+    ULONG writeOffset;
+    DMF_CONTEXT_PingPongBuffer* moduleContext;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Calculate number of bytes that need to be copied from Ping to Pong buffer.
+    //
+    writeOffset = moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
+    DmfAssert(StartOffset <= writeOffset);
+    numberOfBytes = writeOffset - StartOffset;
+
+    activePacket = moduleContext->Buffer[moduleContext->PingBufferIndex];
+    inactivePacket = PingPongBuffer_PongGet(DmfModule);
+
+    // Copy the data from Ping Buffer to Pong Buffer.
+    //
+    RtlCopyMemory(inactivePacket,
+                  activePacket + StartOffset,
+                  numberOfBytes);
+
+    // Data from the Ping Buffer has been copied to the Pong Buffer.
+    // Now activate the current Pong Buffer.
+    //
+    DmfAssert(moduleContext->PingBufferIndex < NUMBER_OF_PING_PONG_BUFFERS);
+    moduleContext->PingBufferIndex = (moduleContext->PingBufferIndex + 1) % NUMBER_OF_PING_PONG_BUFFERS;
+
+    // Next write will happen after the data that is just written.
+    //
+    moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex] = numberOfBytes;
+
+    // And reset the corresponding Read Offset.
+    //
+    moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex] = 0;
+
+    return numberOfBytes;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -712,7 +789,7 @@ Routine Description:
 Arguments:
 
     DmfModule - This Module's handle.
-    StartOffset - The offset in the Ping Buffer where the valid data begins.
+    StartOffset - The offset in the data returned by DMF_PingPongBuffer_Get() where the valid data begins.
     PacketLength - The number of bytes of data in the Ping Buffer.
 
 Return Value:
@@ -737,10 +814,11 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     // The caller will read the valid data from this offset. There may be invalid data
-    // before this offset.
+    // before this offset. StartOffset is relative to the data returned by DMF_PingPongBuffer_Get(),
+    // which starts at the current Read Offset.
     //
     readOffsetAddress = &moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex];
-    *readOffsetAddress = StartOffset;
+    *readOffsetAddress += StartOffset;
 
     // Save the buffer pointer that will be returned to the caller.
     //
@@ -750,10 +828,11 @@ Return Value:
     writeOffsetAddress = &moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
 
     // Before returning, determine if it is necessary to switch to the next Ping Buffer.
-    // If so, switch in preparation for the next incoming raw data.
+    // If so, switch in preparation for the next incoming raw data. This is done in every
+    // ShiftMode, so that the returned data remains valid until the next call that discards data.
     //
     PingPongBuffer_Switch(DmfModule,
-                          StartOffset,
+                          readOffset,
                           PacketLength,
                           *writeOffsetAddress,
                           packetBufferRead);
@@ -787,16 +866,16 @@ DMF_PingPongBuffer_Get(
 
 Routine Description:
 
-    Returns the Ping Buffer.
+    Returns the data in the Ping Buffer. The data is always contiguous.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Size - Current size of Ping buffer.
+    Size - Current size of the data in the Ping buffer.
 
 Return Value:
 
-    The Ping Buffer.
+    The first byte of data in the Ping Buffer.
 
 --*/
 {
@@ -871,12 +950,15 @@ DMF_PingPongBuffer_Shift(
 Routine Description:
 
     Cleanup the active buffer by discarding data that has already been processed.
-    Copy the remaining data to Pong Buffer and activate it.
+    In PingPongBuffer_ShiftMode_Copy, copy the remaining data to Pong Buffer and activate it.
+    In PingPongBuffer_ShiftMode_Offset, only advance the Read Offset. The remaining data is
+    copied later, only if new data does not fit after it (see DMF_PingPongBuffer_Write()).
 
 Arguments:
 
     DmfModule - This Module's handle.
-    StartOffset - The offset in the Ping Buffer where data that needs to be processed begins.
+    StartOffset - The offset in the data returned by DMF_PingPongBuffer_Get() where data that
+                  needs to be processed begins.
 
 Return Value:
 
@@ -884,11 +966,8 @@ Return Value:
 
 --*/
 {
-    UCHAR* activePacket;
-    UCHAR* inactivePacket;
     ULONG numberOfBytes;
     ULONG writeOffset;
-    ULONG* writeOffsetAddress;
     ULONG readOffset;
     ULONG* readOffsetAddress;
     DMF_CONTEXT_PingPongBuffer* moduleContext;
@@ -902,46 +981,40 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    readOffsetAddress = &moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex];
-    readOffset = *readOffsetAddress;
-    DmfAssert(StartOffset >= readOffset);
-    DmfAssert(StartOffset <= moduleContext->BufferSize);
-
-    // Calculate number of bytes that need to be copied from Ping to Pong buffer.
-    //
-    writeOffsetAddress = &moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
-    writeOffset = *writeOffsetAddress;
-    DmfAssert(StartOffset <= writeOffset);
-    numberOfBytes = writeOffset - StartOffset;
-
-    activePacket = moduleContext->Buffer[moduleContext->PingBufferIndex];
-    inactivePacket = PingPongBuffer_PongGet(DmfModule);
-
-    // Copy the data from Ping Buffer to Pong Buffer.
-    //
-    RtlCopyMemory(inactivePacket,
-                  activePacket + StartOffset,
-                  numberOfBytes);
-
-    // Data from the Ping Buffer has been copied to the Pong Buffer. 
-    // Now activate the current Pong Buffer.
+    // StartOffset is relative to the current Read Offset.
     //
-    DmfAssert(moduleContext->PingBufferIndex < NUMBER_OF_PING_PONG_BUFFERS);
-    moduleContext->PingBufferIndex = (moduleContext->PingBufferIndex + 1) % NUMBER_OF_PING_PONG_BUFFERS;
+    readOffsetAddress = &moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex];
+    readOffset = *readOffsetAddress + StartOffset;
+    DmfAssert(readOffset >= *readOffsetAddress);
+    DmfAssert(readOffset <= moduleContext->BufferSize);
 
-    // Next write will happen after the data that is just written.
-    //
-    moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex] = numberOfBytes;
+    writeOffset = moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex];
+    DmfAssert(readOffset <= writeOffset);
 
-    // And reset the corresponding Read Offset.
-    //
-    moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex] = 0;
+    if (PingPongBuffer_ShiftMode_Offset == moduleContext->ShiftMode)
+    {
+        numberOfBytes = writeOffset - readOffset;
+        if (0 == numberOfBytes)
+        {
+            // All the data has been discarded, so the next write can start at the beginning
+            // of the buffer without copying anything.
+            //
+            readOffset = 0;
+            moduleContext->BufferOffsetWrite[moduleContext->PingBufferIndex] = 0;
+        }
+        *readOffsetAddress = readOffset;
+    }
+    else
+    {
+        numberOfBytes = PingPongBuffer_DataMove(DmfModule,
+                                                readOffset);
+    }
 
     DMF_ModuleUnlock(DmfModule);
 
-    FuncExit(DMF_TRACE, "PingBufferIndex=%d, PingBuffer=0x%p, BytesToProcess:%d",
+    FuncExit(DMF_TRACE, "PingBufferIndex=%d, ReadOffset=%d, BytesToProcess:%d",
              moduleContext->PingBufferIndex,
-             activePacket,
+             moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex],
              numberOfBytes);
 }
 
@@ -966,7 +1039,8 @@ Arguments:
     SourceBuffer - The buffer of bytes to write.
     NumberOfBytesToWrite - The number of bytes to read from the above buffer and write
                             to the target buffer.
-    ResultSize - The next location where the next write of data should occur after this call.
+    ResultSize - The size of the data in the Ping Buffer after this call. The next write of data
+                 occurs after it.
 
 Return Value:
 
@@ -978,6 +1052,7 @@ Return Value:
     DMF_CONTEXT_PingPongBuffer* moduleContext;
     UCHAR* activeBuffer;
     ULONG writeOffsetAddress;
+    ULONG readOffset;
     NTSTATUS ntStatus;
 
     FuncEntry(DMF_TRACE);
@@ -999,6 +1074,22 @@ Return Value:
                                                      &writeOffsetAddress);
     DmfAssert(moduleContext->BufferSize >= NumberOfBytesToWrite);
 
+    // In PingPongBuffer_ShiftMode_Offset, discarded data may still be at the start of the buffer.
+    // If the new data does not fit after the remaining data, copy the remaining data to the start
+    // of the Pong Buffer (as DMF_PingPongBuffer_Shift() does in PingPongBuffer_ShiftMode_Copy).
+    //
+    readOffset = moduleContext->BufferOffsetRead[moduleContext->PingBufferIndex];
+    if ((writeOffsetAddress + NumberOfBytesToWrite > moduleContext->BufferSize) &&
+        (readOffset > 0))
+    {
+        DmfAssert(PingPongBuffer_ShiftMode_Offset == moduleContext->ShiftMode);
+        PingPongBuffer_DataMove(DmfModule,
+                                readOffset);
+        readOffset = 0;
+        activeBuffer = PingPongBuffer_PingWriteOffsetGet(DmfModule,
+                                                         &writeOffsetAddress);
+    }
+
     // Check if the Client is trying to perform an invalid write into the ping pong buffer. This should never happen
     // because the Client should have allocated a properly size buffer.
     //
@@ -1032,9 +1123,9 @@ Return Value:
 
 Exit:
 
-    // Tell the caller the updated write offset.
+    // Tell the caller the updated size of the data (as DMF_PingPongBuffer_Get() does).
     //
-    *ResultSize = writeOffsetAddress;
+    *ResultSize = writeOffsetAddress - readOffset;
 
     DMF_ModuleUnlock(DmfModule);
 
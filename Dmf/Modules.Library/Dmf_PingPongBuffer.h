@@ -20,6 +20,20 @@ Environment:
 
 #pragma once
 
+// Indicates how DMF_PingPongBuffer_Shift() discards data.
+//
+typedef enum
+{
+    // The remaining data is copied to the start of the Pong Buffer, which becomes the Ping Buffer.
+    //
+    PingPongBuffer_ShiftMode_Copy = 0,
+    // Only the Read Offset is advanced. The remaining data is copied to the start of the Pong Buffer
+    // only when new data written to the Ping Buffer would not fit after it.
+    //
+    PingPongBuffer_ShiftMode_Offset,
+    PingPongBuffer_ShiftMode_Maximum,
+} PingPongBuffer_ShiftModeType;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -31,6 +45,9 @@ typedef struct
     // Note: Pool type can be passive if PassiveLevel in Module Attributes is set to TRUE.
     //
     POOL_TYPE PoolType;
+    // Indicates how DMF_PingPongBuffer_Shift() discards data. The default is PingPongBuffer_ShiftMode_Copy.
+    //
+    PingPongBuffer_ShiftModeType ShiftMode;
 } DMF_CONFIG_PingPongBuffer;
 
 // This macro declares the following functions:
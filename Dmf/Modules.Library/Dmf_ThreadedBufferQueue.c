@@ -661,6 +661,58 @@ Return Value:
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    )
+/*++
+
+Routine Description:
+
+    Adds a Client Buffer to the list with a given priority and sets the work ready event.
+    The work thread processes buffers with higher priority first.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ClientBuffer - The buffer to add to the list.
+                   NOTE: This must be a properly formed buffer that was created by this Module.
+    Priority - Priority of the buffer. Zero is the lowest priority.
+               BufferQueueConfig.NumberOfPriorityLanes - 1 is the highest priority.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ThreadedBufferQueue* moduleContext;
+    ThreadedBufferQueue_WorkBufferInternal* workBuffer;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 ThreadedBufferQueue);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    workBuffer = ThreadedBufferQueueBuffer_ClientToInternal(ClientBuffer);
+
+    workBuffer->Event = NULL;
+    workBuffer->NtStatus = NULL;
+
+    DMF_BufferQueue_EnqueueWithPriority(moduleContext->DmfModuleBufferQueue,
+                                        workBuffer,
+                                        Priority);
+
+    ThreadedBufferQueue_WorkReady(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
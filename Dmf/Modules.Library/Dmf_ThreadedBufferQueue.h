@@ -95,6 +95,14 @@ DMF_ThreadedBufferQueue_EnqueueAndWait(
     _In_ VOID* ClientBuffer
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_ThreadedBufferQueue_EnqueueWithPriority(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ ULONG Priority
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
 NTSTATUS
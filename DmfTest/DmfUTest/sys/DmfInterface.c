@@ -207,6 +207,15 @@ Return Value:
                         WDF_NO_OBJECT_ATTRIBUTES,
                         NULL);
 
+    // Tests_RingBufferPerProcessor
+    // ----------------------------
+    //
+    DMF_Tests_RingBufferPerProcessor_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                        &moduleAttributes,
+                        WDF_NO_OBJECT_ATTRIBUTES,
+                        NULL);
+
     // Tests_PingPongBuffer
     // --------------------
     //
@@ -225,6 +234,24 @@ Return Value:
                         WDF_NO_OBJECT_ATTRIBUTES,
                         NULL);
 
+    // Tests_LruCache
+    // --------------
+    //
+    DMF_Tests_LruCache_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                        &moduleAttributes,
+                        WDF_NO_OBJECT_ATTRIBUTES,
+                        NULL);
+
+    // Tests_StaticTable
+    // -----------------
+    //
+    DMF_Tests_StaticTable_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                        &moduleAttributes,
+                        WDF_NO_OBJECT_ATTRIBUTES,
+                        NULL);
+
     // Tests_String
     // -------------
     //